@@ -19,6 +19,7 @@
 #include <efont/t1item.hh>
 #include <lcdf/clp.h>
 #include <lcdf/error.hh>
+#include <lcdf/mapfile.hh>
 #include "maket1font.hh"
 #include <efont/cff.hh>
 #include <efont/otf.hh>
@@ -45,10 +46,12 @@ using namespace Efont;
 #define PFA_OPT		305
 #define OUTPUT_OPT	306
 #define NAME_OPT	307
+#define FACE_OPT	308
 
 const Clp_Option options[] = {
     { "ascii", 'a', PFA_OPT, 0, 0 },
     { "binary", 'b', PFB_OPT, 0, 0 },
+    { "face", 0, FACE_OPT, Clp_ValInt, 0 },
     { "help", 'h', HELP_OPT, 0, 0 },
     { "name", 'n', NAME_OPT, Clp_ValString, 0 },
     { "output", 'o', OUTPUT_OPT, Clp_ValString, 0 },
@@ -61,6 +64,7 @@ const Clp_Option options[] = {
 
 static const char *program_name;
 static bool binary = true;
+static int face = 0;
 
 
 void
@@ -92,6 +96,7 @@ Options:\n\
   -a, --pfa                    Output PFA font.\n\
   -b, --pfb                    Output PFB font. This is the default.\n\
   -n, --name=NAME              Select font NAME from CFF.\n\
+      --face=N                 Select face N from an OpenType collection.\n\
   -o, --output=FILE            Write output to FILE.\n\
   -q, --quiet                  Do not generate any error messages.\n\
   -h, --help                   Print this message and exit.\n\
@@ -123,29 +128,34 @@ do_file(const char *infn, const char *outfn, PermString name, ErrorHandler *errh
 
     if (c == EOF)
 	errh->fatal("%s: empty file", infn);
-    if (c != 1 && c != 'O')
+    if (c != 1 && c != 'O' && c != 't')
 	errh->fatal("%s: not a CFF or OpenType/CFF font", infn);
 
-    StringAccum sa(150000);
-    int amt;
-    do {
-	if (char *x = sa.reserve(32768)) {
-	    amt = fread(x, 1, 32768, f);
-	    sa.adjust_length(amt);
-	} else
-	    amt = 0;
-    } while (amt != 0);
-    if (!feof(f) || ferror(f))
-	errh->lerror(infn, "%s", strerror(errno));
+    String data;
+    if (f != stdin)
+	data = map_file(f);
+    if (!data) {
+	StringAccum sa(150000);
+	int amt;
+	do {
+	    if (char *x = sa.reserve(32768)) {
+		amt = fread(x, 1, 32768, f);
+		sa.adjust_length(amt);
+	    } else
+		amt = 0;
+	} while (amt != 0);
+	if (!feof(f) || ferror(f))
+	    errh->lerror(infn, "%s", strerror(errno));
+	data = sa.take_string();
+    }
     if (f != stdin)
 	fclose(f);
 
     ContextErrorHandler cerrh(errh, "While processing %s:", infn);
     cerrh.set_indent(0);
-    String data = sa.take_string();
     unsigned units_per_em = 0;
-    if (c == 'O') {
-        Efont::OpenType::Font font(data, &cerrh);
+    if (c == 'O' || c == 't') {
+        Efont::OpenType::Font font(data, face, &cerrh);
 	data = font.table("CFF");
         units_per_em = font.units_per_em();
     }
@@ -206,6 +216,12 @@ main(int argc, char *argv[])
 	    binary = true;
 	    break;
 
+	  case FACE_OPT:
+	    if (clp->val.i < 0)
+		usage_error(errh, "%<--face%> must be at least 0");
+	    face = clp->val.i;
+	    break;
+
 	  case NAME_OPT:
 	    if (font_name)
 		usage_error(errh, "font name specified twice");
@@ -3,6 +3,7 @@
 #define EFONT_CFF_HH
 #include <lcdf/hashmap.hh>
 #include <efont/t1cs.hh>
+#include <mutex>
 class ErrorHandler;
 namespace Efont {
 class Type1Encoding;
@@ -125,11 +126,14 @@ class Cff { public:
     mutable HashMap<PermString, int> _strings_map;
 
     IndexIterator _gsubrs_index;
-    Vector<Charstring*> _gsubrs_cs;
+    Vector<CharstringView> _gsubrs_cs;
     Vector<FontParent*> _fonts;
 
     unsigned _units_per_em;
 
+    // Protects the lazily built string tables.
+    mutable std::mutex _lock;
+
     int parse_header(ErrorHandler *);
 
     enum { HEADER_SIZE = 4 };
@@ -232,6 +236,8 @@ class Cff::FontParent : public CharstringProgram { public:
     Charstring *gsubr(int) const;
     int gsubr_bias() const;
 
+    bool thread_safe() const            { return true; }
+
   private:
 
     Cff* _cff;
@@ -242,7 +248,7 @@ class Cff::FontParent : public CharstringProgram { public:
     FontParent(const FontParent &);
     FontParent &operator=(const FontParent &);
 
-    Charstring *charstring(const IndexIterator &, int) const;
+    void make_charstrings(const IndexIterator &, Vector<CharstringView> &) const;
 
     friend class Cff;
     friend class Cff::Font;
@@ -283,7 +289,7 @@ class Cff::CIDFont : public Cff::FontParent { public:
     Cff::Charset _charset;
 
     IndexIterator _charstrings_index;
-    mutable Vector<Charstring *> _charstrings_cs;
+    Vector<CharstringView> _charstrings_cs;
 
     Vector<ChildFont *> _child_fonts;
     Cff::FDSelect _fdselect;
@@ -326,7 +332,7 @@ class Cff::ChildFont : public Cff::FontParent { public:
     Dict _private_dict;
 
     IndexIterator _subrs_index;
-    mutable Vector<Charstring *> _subrs_cs;
+    Vector<CharstringView> _subrs_cs;
 
     double _default_width_x;
     double _nominal_width_x;
@@ -334,8 +340,6 @@ class Cff::ChildFont : public Cff::FontParent { public:
     ChildFont(const ChildFont &); // does not exist
     ChildFont &operator=(const ChildFont &); // does not exist
 
-    Charstring *charstring(const IndexIterator &, int) const;
-
     friend class Cff::Font;
 
 };
@@ -371,7 +375,7 @@ class Cff::Font : public Cff::ChildFont { public:
     Cff::Charset _charset;
 
     IndexIterator _charstrings_index;
-    mutable Vector<Charstring *> _charstrings_cs;
+    Vector<CharstringView> _charstrings_cs;
 
     int _encoding_pos;
     int _encoding[256];
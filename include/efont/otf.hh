@@ -3,10 +3,12 @@
 #define EFONT_OTF_HH
 #include <efont/otfdata.hh>
 #include <lcdf/hashcode.hh>
+#include <lcdf/hashmap.hh>
 class ErrorHandler;
 namespace Efont { namespace OpenType {
 class Post;
 class Name;
+class GlyphSet;
 
 typedef int Glyph;                      // 16-bit integer
 
@@ -46,9 +48,13 @@ inline hashcode_t hashcode(const Tag& t) {
     return t.value();
 }
 
+// A Font is one face of an sfnt file. For a TrueType or OpenType
+// collection (.ttc/.otc), the faces share the file's data and any tables
+// they have in common; data_string() returns the whole collection.
 class Font {
   public:
     Font(const String& str, ErrorHandler* errh = 0);
+    Font(const String& str, int face, ErrorHandler* errh = 0);
     // default destructor
 
     bool ok() const                     { return _error >= 0; }
@@ -59,6 +65,9 @@ class Font {
     const uint8_t* data() const         { return _str.udata(); }
     int length() const                  { return _str.length(); }
 
+    int face() const                    { return _face; }
+    static int nfaces(const String& str);
+
     unsigned units_per_em() const       { return _units_per_em; }
 
     int ntables() const;
@@ -76,8 +85,11 @@ class Font {
   private:
     String _str;
     int _error;
+    int _face;
+    uint32_t _dir;                      // offset of this face's directory
     unsigned _units_per_em;
 
+    const uint8_t* directory() const    { return data() + _dir; }
     int parse_header(ErrorHandler*);
 };
 
@@ -145,6 +157,7 @@ class Coverage {
     Coverage() noexcept;                // empty coverage
     Coverage(Glyph first, Glyph last) noexcept; // range coverage
     Coverage(const Vector<bool> &gmap) noexcept; // used-bytemap coverage
+    Coverage(const GlyphSet &gs) noexcept; // used-bytemap coverage
     Coverage(const String &str, ErrorHandler *errh = 0, bool check = true) noexcept;
     // default destructor
 
@@ -203,6 +216,9 @@ class Coverage {
     String _str;
 
     int check(ErrorHandler*);
+
+    friend class CompiledCoverage;
+    friend class CompiledTables;
 };
 
 Coverage operator&(const Coverage&, const Coverage&);
@@ -216,6 +232,7 @@ class GlyphSet {
   public:
     GlyphSet();
     GlyphSet(const GlyphSet&);
+    explicit GlyphSet(const Coverage&);
     ~GlyphSet();
 
     inline bool covers(Glyph g) const;
@@ -223,8 +240,22 @@ class GlyphSet {
     int change(Glyph, bool);
     void insert(Glyph g)                { change(g, true); }
     void remove(Glyph g)                { change(g, false); }
+    void clear();
+
+    int size() const;
+    bool empty() const                  { return next(0) < 0; }
+
+    // Returns the least glyph >= g in the set, or -1 if there is none.
+    // Iterate with 'for (g = gs.next(0); g >= 0; g = gs.next(g + 1))'.
+    Glyph next(Glyph g) const;
 
     GlyphSet& operator=(const GlyphSet&);
+    GlyphSet& operator|=(const GlyphSet&);
+    GlyphSet& operator&=(const GlyphSet&);
+    GlyphSet& operator-=(const GlyphSet&);
+    bool operator==(const GlyphSet&) const;
+    bool operator!=(const GlyphSet& o) const { return !(*this == o); }
+    bool intersects(const GlyphSet&) const;
 
   private:
     enum { GLYPHBITS = 16, SHIFT = 8,
@@ -234,6 +265,8 @@ class GlyphSet {
     };
 
     uint32_t* _v[VLEN];
+
+    friend class Coverage;
 };
 
 class ClassDef {
@@ -297,8 +330,70 @@ class ClassDef {
     String _str;
 
     int check(ErrorHandler*);
+
+    friend class CompiledClassDef;
+    friend class CompiledTables;
 };
 
+// Compiled forms of Coverage and ClassDef tables, for code that queries the
+// same table many times. A CompiledCoverage is a bitmap over the covered
+// glyph range plus the coverage index of each bitmap word's first glyph; a
+// CompiledClassDef is a paged array of classes.
+class CompiledCoverage { public:
+    explicit CompiledCoverage(const Coverage &);
+    // default destructor
+
+    inline int coverage_index(Glyph g) const;
+    bool covers(Glyph g) const          { return coverage_index(g) >= 0; }
+
+  private:
+    Coverage _raw;              // used directly if its indexes aren't ranks
+    bool _use_raw;
+    Glyph _first;
+    uint32_t _n;
+    Vector<uint32_t> _bits;
+    Vector<int> _rank;
+};
+
+class CompiledClassDef { public:
+    explicit CompiledClassDef(const ClassDef &);
+    // default destructor
+
+    inline int lookup(Glyph g) const;
+    int operator[](Glyph g) const       { return lookup(g); }
+
+  private:
+    ClassDef _raw;              // used directly if its ranges aren't sorted
+    bool _use_raw;
+    int _npages;
+    Vector<uint16_t> _page_map;
+    Vector<uint16_t> _classes;
+};
+
+// The compiled Coverage and ClassDef tables of one GSUB or GPOS table,
+// built on first use. The owning Gsub or Gpos keeps the table data alive,
+// so a table's address identifies it until the owner, and this cache, is
+// destroyed. Like the owner's other lazily built state, it must not be
+// shared between threads.
+class CompiledTables { public:
+    CompiledTables();
+    ~CompiledTables();
+
+    const CompiledCoverage *coverage(const Coverage &) const;
+    const CompiledClassDef *class_def(const ClassDef &) const;
+
+  private:
+    mutable HashMap<uintptr_t, CompiledCoverage *> _coverages;
+    mutable HashMap<uintptr_t, CompiledClassDef *> _class_defs;
+
+    CompiledTables(const CompiledTables &);
+    CompiledTables &operator=(const CompiledTables &);
+};
+
+// Query a table through 'ct', if there is one, or directly.
+inline int coverage_index(const CompiledTables *ct, const Coverage &c, Glyph g);
+inline int class_lookup(const CompiledTables *ct, const ClassDef &cd, Glyph g);
+
 extern Vector<PermString> debug_glyph_names;
 
 
@@ -365,6 +460,45 @@ inline bool GlyphSet::operator[](Glyph g) const {
     return covers(g);
 }
 
+inline int popcount32(uint32_t x) {
+#if defined(__GNUC__)
+    return __builtin_popcount(x);
+#else
+    x = x - ((x >> 1) & 0x55555555U);
+    x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);
+    return (((x + (x >> 4)) & 0x0F0F0F0FU) * 0x01010101U) >> 24;
+#endif
+}
+
+inline int CompiledCoverage::coverage_index(Glyph g) const {
+    if (_use_raw)
+        return _raw.coverage_index(g);
+    uint32_t x = g - _first;
+    if (x >= _n)
+        return -1;
+    uint32_t w = _bits[x >> 5], bit = 1U << (x & 31);
+    if (!(w & bit))
+        return -1;
+    return _rank[x >> 5] + popcount32(w & (bit - 1));
+}
+
+inline int CompiledClassDef::lookup(Glyph g) const {
+    if (_use_raw)
+        return _raw.lookup(g);
+    else if (g < 0 || (g >> 8) >= _npages)
+        return 0;
+    else
+        return _classes[(_page_map[g >> 8] << 8) + (g & 255)];
+}
+
+inline int coverage_index(const CompiledTables *ct, const Coverage &c, Glyph g) {
+    return ct ? ct->coverage(c)->coverage_index(g) : c.coverage_index(g);
+}
+
+inline int class_lookup(const CompiledTables *ct, const ClassDef &cd, Glyph g) {
+    return ct ? ct->class_def(cd)->lookup(g) : cd.lookup(g);
+}
+
 } // namespace Efont::OpenType
 } // namespace Efont
 
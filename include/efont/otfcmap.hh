@@ -16,8 +16,14 @@ class Cmap { public:
 
     inline Glyph map_uni(uint32_t c) const;
     int map_uni(const Vector<uint32_t> &in, Vector<Glyph> &out) const;
+    int map_uni(const uint32_t *in, int n, Glyph *out) const;
     inline void unmap_all(Vector<std::pair<uint32_t, Glyph> > &ugp) const;
 
+    // Appends the code points that map to 'g', in increasing order, and
+    // returns their number. Code points the table maps more than once are
+    // left out, although map_uni() returns their first mapping.
+    int unmap(Glyph g, Vector<uint32_t> &us) const;
+
   private:
 
     String _str;
@@ -26,11 +32,27 @@ class Cmap { public:
     mutable int _first_unicode_table;
     mutable Vector<int> _table_error;
 
+    // Compiled form of the first Unicode table, built on first use.
+    // _plane_map indexes _page_map by plane (uni >> 16); _page_map indexes
+    // 256-entry pages of _glyphs by the middle byte. Block 0 of _page_map
+    // and page 0 of _glyphs are empty, so unmapped code points cost the
+    // same three loads as mapped ones. The reverse map lists code points
+    // by glyph: those for glyph g are _unis[_unis_pos[g]..._unis_pos[g+1]).
+    // It omits code points with more than one mapping.
+    mutable bool _compiled;
+    mutable int _compiled_table;
+    mutable uint16_t _plane_map[17];
+    mutable Vector<uint16_t> _page_map;
+    mutable Vector<Glyph> _glyphs;
+    mutable Vector<int> _unis_pos;
+    mutable Vector<uint32_t> _unis;
+
     enum { HEADER_SIZE = 4, ENCODING_SIZE = 8,
            HIBYTE_SUBHEADERS = 524 };
     enum Format { F_BYTE = 0, F_HIBYTE = 2, F_SEGMENTED = 4, F_TRIMMED = 6,
                   F_HIBYTE32 = 8, F_TRIMMED32 = 10, F_SEGMENTED32 = 12 };
     enum { USE_FIRST_UNICODE_TABLE = -2 };
+    enum { NPLANES = 17 };
 
     int parse_header(ErrorHandler *);
     int first_unicode_table() const     { return _first_unicode_table; }
@@ -39,12 +61,24 @@ class Cmap { public:
     Glyph map_table(int t, uint32_t, ErrorHandler * = 0) const;
     void dump_table(int t, Vector<std::pair<uint32_t, Glyph> > &ugp, ErrorHandler * = 0) const;
     inline const uint8_t* table_data(int t) const;
+    void compile() const;
+    inline Glyph map_compiled(uint32_t c) const;
 
 };
 
 
+inline Glyph Cmap::map_compiled(uint32_t c) const {
+    int pm = _plane_map[c >> 16];
+    int p = _page_map[(pm << 8) + ((c >> 8) & 255)];
+    return _glyphs[(p << 8) + (c & 255)];
+}
+
 inline Glyph Cmap::map_uni(uint32_t c) const {
-    return map_table(USE_FIRST_UNICODE_TABLE, c, ErrorHandler::default_handler());
+    if (!_compiled)
+        compile();
+    if (_compiled_table < 0 || c >= (uint32_t) NPLANES << 16)
+        return map_table(USE_FIRST_UNICODE_TABLE, c, ErrorHandler::default_handler());
+    return map_compiled(c);
 }
 
 inline void Cmap::unmap_all(Vector<std::pair<uint32_t, Glyph> > &ugp) const {
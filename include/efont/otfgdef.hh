@@ -0,0 +1,83 @@
+// -*- related-file-name: "../../libefont/otfgdef.cc" -*-
+#ifndef EFONT_OTFGDEF_HH
+#define EFONT_OTFGDEF_HH
+#include <efont/otf.hh>
+#include <efont/otfdata.hh>
+namespace Efont { namespace OpenType {
+
+class Gdef { public:
+
+    Gdef(const Data &, ErrorHandler * = 0);
+    // default destructor
+
+    enum { C_NONE = 0, C_BASE = 1, C_LIGATURE = 2, C_MARK = 3,
+           C_COMPONENT = 4 };
+
+    int glyph_class(Glyph g) const;
+    int mark_attachment_class(Glyph g) const;
+    int nmark_sets() const              { return _mark_sets.size(); }
+    bool mark_set_covers(int set, Glyph g) const;
+
+    // Lookup flags, from a GSUB or GPOS lookup table.
+    enum { F_RIGHT_TO_LEFT = 0x0001, F_IGNORE_BASE_GLYPHS = 0x0002,
+           F_IGNORE_LIGATURES = 0x0004, F_IGNORE_MARKS = 0x0008,
+           F_USE_MARK_FILTERING_SET = 0x0010,
+           F_MARK_ATTACHMENT_TYPE = 0xFF00 };
+
+    // Returns true if a lookup with 'flags' skips over glyph 'g'.
+    // 'mark_set' is the lookup's mark filtering set, if any.
+    bool ignores(Glyph g, uint16_t flags, int mark_set) const;
+
+    enum { HEADERSIZE = 12, MARKSETS_HEADERSIZE = 4, MARKSETS_RECSIZE = 4 };
+
+  private:
+
+    CompiledClassDef _glyph_classes;
+    CompiledClassDef _mark_classes;
+    Vector<Coverage> _mark_sets;
+
+    static ClassDef class_def(const Data &, int offset_offset);
+
+};
+
+inline int
+Gdef::glyph_class(Glyph g) const
+{
+    int c = _glyph_classes.lookup(g);
+    return c > 0 ? c : C_NONE;
+}
+
+inline int
+Gdef::mark_attachment_class(Glyph g) const
+{
+    int c = _mark_classes.lookup(g);
+    return c > 0 ? c : 0;
+}
+
+inline bool
+Gdef::ignores(Glyph g, uint16_t flags, int mark_set) const
+{
+    if (!(flags & (F_IGNORE_BASE_GLYPHS | F_IGNORE_LIGATURES | F_IGNORE_MARKS
+                   | F_USE_MARK_FILTERING_SET | F_MARK_ATTACHMENT_TYPE)))
+        return false;
+    switch (glyph_class(g)) {
+    case C_BASE:
+        return (flags & F_IGNORE_BASE_GLYPHS) != 0;
+    case C_LIGATURE:
+        return (flags & F_IGNORE_LIGATURES) != 0;
+    case C_MARK:
+        if (flags & F_IGNORE_MARKS)
+            return true;
+        else if (flags & F_USE_MARK_FILTERING_SET)
+            return !mark_set_covers(mark_set, g);
+        else if (flags & F_MARK_ATTACHMENT_TYPE)
+            return mark_attachment_class(g) != (flags >> 8);
+        else
+            return false;
+    default:
+        return false;
+    }
+}
+
+}}
+#endif
@@ -7,10 +7,22 @@ namespace Efont { namespace OpenType {
 class GposLookup;
 class Positioning;
 
+// A PositioningVisitor receives positionings one at a time, as a lookup
+// decodes them. If visit() returns false, decoding stops.
+class PositioningVisitor { public:
+    PositioningVisitor()                : _stopped(false) { }
+    virtual ~PositioningVisitor()       { }
+    virtual bool visit(const Positioning &) = 0;
+    inline bool emit(const Positioning &);
+    bool stopped() const                { return _stopped; }
+  private:
+    bool _stopped;
+};
+
 class Gpos { public:
 
     Gpos(const Data &, ErrorHandler * = 0);
-    // default destructor
+    ~Gpos();
 
     const ScriptList &script_list() const { return _script_list; }
     const FeatureList &feature_list() const { return _feature_list; }
@@ -18,6 +30,10 @@ class Gpos { public:
     int nlookups() const;
     GposLookup lookup(unsigned) const;
 
+    // Returns the glyphs at which lookup 'i' can start to match: the union
+    // of its subtables' first coverages. The set is built on first use.
+    const GlyphSet &lookup_glyphs(unsigned i) const;
+
     enum { HEADERSIZE = 10 };
 
   private:
@@ -25,14 +41,27 @@ class Gpos { public:
     ScriptList _script_list;
     FeatureList _feature_list;
     Data _lookup_list;
+    mutable Vector<GlyphSet *> _lookup_glyphs;
+    CompiledTables _compiled;
+
+    Gpos(const Gpos &);
+    Gpos &operator=(const Gpos &);
 
 };
 
 class GposLookup { public:
-    GposLookup(const Data &);
+    GposLookup(const Data &, const CompiledTables * = 0);
     int type() const                    { return _type; }
     uint16_t flags() const              { return _d.u16(2); }
+    inline uint16_t mark_filtering_set() const;
+    void mark_first_glyphs(GlyphSet &) const;
     bool unparse_automatics(Vector<Positioning> &, ErrorHandler * = 0) const;
+    bool unparse_automatics(Vector<Positioning> &, const Coverage &limit, ErrorHandler * = 0) const;
+    bool unparse_automatics(PositioningVisitor &, ErrorHandler * = 0) const;
+    bool unparse_automatics(PositioningVisitor &, const Coverage &limit, ErrorHandler * = 0) const;
+    bool apply(const Glyph *, int pos, int n, Positioning &) const;
+    bool apply_cursive(const Glyph *, int pos, int n,
+                       int &exit_x, int &exit_y, int &entry_x, int &entry_y) const;
     enum {
         HEADERSIZE = 6, RECSIZE = 2,
         L_SINGLE = 1, L_PAIR = 2, L_CURSIVE = 3, L_MARKTOBASE = 4,
@@ -42,7 +71,10 @@ class GposLookup { public:
   private:
     Data _d;
     int _type;
+    const CompiledTables *_compiled;
     Data subtable(int i) const;
+    bool unparse(PositioningVisitor &, const Coverage *limit, ErrorHandler *) const;
+    friend class CompiledPairKern;
 };
 
 class GposValue { public:
@@ -66,25 +98,45 @@ class GposValue { public:
 };
 
 class GposSingle { public:
-    GposSingle(const Data &);
+    GposSingle(const Data &, const CompiledTables * = 0);
     // default destructor
     Coverage coverage() const noexcept;
-    void unparse(Vector<Positioning> &) const;
+    void unparse(PositioningVisitor &) const;
+    void unparse(PositioningVisitor &, const Coverage &limit) const;
+    bool apply(const Glyph *, int pos, int n, Positioning &) const;
     enum { F2_HEADERSIZE = 8 };
   private:
     Data _d;
+    const CompiledTables *_compiled;
 };
 
 class GposPair { public:
-    GposPair(const Data &);
+    GposPair(const Data &, const CompiledTables * = 0);
     // default destructor
     Coverage coverage() const noexcept;
-    void unparse(Vector<Positioning> &) const;
+    void unparse(PositioningVisitor &) const;
+    void unparse(PositioningVisitor &, const Coverage &limit) const;
+    bool apply(const Glyph *, int pos, int n, Positioning &) const;
     enum { F1_HEADERSIZE = 10, F1_RECSIZE = 2,
            PAIRSET_HEADERSIZE = 2, PAIRVALUE_HEADERSIZE = 2,
            F2_HEADERSIZE = 16 };
   private:
     Data _d;
+    const CompiledTables *_compiled;
+    friend class CompiledPairKern;
+};
+
+class GposCursive { public:
+    GposCursive(const Data &, const CompiledTables * = 0);
+    // default destructor
+    Coverage coverage() const noexcept;
+    bool entry_anchor(Glyph, int &x, int &y) const;
+    bool exit_anchor(Glyph, int &x, int &y) const;
+    enum { HEADERSIZE = 6, RECSIZE = 4 };
+  private:
+    Data _d;
+    const CompiledTables *_compiled;
+    bool anchor(Glyph, int which, int &x, int &y) const;
 };
 
 struct Position {
@@ -106,7 +158,7 @@ struct Position {
 
 class Positioning { public:
 
-    Positioning();
+    inline Positioning();
 
     // single positioning
     inline Positioning(const Position &);
@@ -177,6 +229,11 @@ inline int16_t GposValue::yadvance(uint16_t format, const Data &d)
         return 0;
 }
 
+inline uint16_t GposLookup::mark_filtering_set() const
+{
+    return _d.u16(HEADERSIZE + _d.u16(4)*RECSIZE);
+}
+
 inline Position::Position()
     : g(0)
 {
@@ -206,6 +263,10 @@ inline Position::Position(Glyph g_, int pdx_, int pdy_, int adx_, int ady_)
 {
 }
 
+inline Positioning::Positioning()
+{
+}
+
 inline Positioning::Positioning(const Position &left)
     : _left(left)
 {
@@ -245,5 +306,12 @@ inline void Positioning::all_in_glyphs(Vector<Glyph> &gs) const
         gs.push_back(_right.g);
 }
 
+inline bool PositioningVisitor::emit(const Positioning &p)
+{
+    if (!_stopped && !visit(p))
+        _stopped = true;
+    return !_stopped;
+}
+
 }}
 #endif
@@ -7,18 +7,35 @@ namespace Efont { namespace OpenType {
 class GsubLookup;
 class Substitution;
 
+// A SubstitutionVisitor receives substitutions one at a time, as a lookup
+// decodes them. If visit() returns false, decoding stops.
+class SubstitutionVisitor { public:
+    SubstitutionVisitor()               : _stopped(false) { }
+    virtual ~SubstitutionVisitor()      { }
+    virtual bool visit(const Substitution &) = 0;
+    inline bool emit(const Substitution &);
+    bool stopped() const                { return _stopped; }
+  private:
+    bool _stopped;
+};
+
 class Gsub { public:
 
     Gsub(const Data &, const Font *, ErrorHandler * = 0);
-    // default destructor
+    ~Gsub();
 
     const ScriptList &script_list() const { return _script_list; }
     const FeatureList &feature_list() const { return _feature_list; }
     bool chaincontext_reverse_backtrack() const { return _chaincontext_reverse_backtrack; }
+    void set_chaincontext_reverse_backtrack(bool x) { _chaincontext_reverse_backtrack = x; }
 
     int nlookups() const;
     GsubLookup lookup(unsigned) const;
 
+    // Returns the glyphs at which lookup 'i' can start to match: the union
+    // of its subtables' first coverages. The set is built on first use.
+    const GlyphSet &lookup_glyphs(unsigned i) const;
+
     enum { HEADERSIZE = 10 };
 
   private:
@@ -27,15 +44,23 @@ class Gsub { public:
     FeatureList _feature_list;
     Data _lookup_list;
     bool _chaincontext_reverse_backtrack;
+    mutable Vector<GlyphSet *> _lookup_glyphs;
+    CompiledTables _compiled;
+
+    Gsub(const Gsub &);
+    Gsub &operator=(const Gsub &);
 
 };
 
 class GsubLookup { public:
-    GsubLookup(const Data &);
+    GsubLookup(const Data &, const CompiledTables * = 0);
     int type() const                    { return _type; }
     uint16_t flags() const              { return _d.u16(2); }
-    void mark_out_glyphs(const Gsub &gsub, Vector<bool> &gmap) const;
+    uint16_t mark_filtering_set() const { return _d.u16(HEADERSIZE + _d.u16(4)*RECSIZE); }
+    void mark_first_glyphs(GlyphSet &) const;
+    void mark_out_glyphs(const Gsub &gsub, const GlyphSet &in, GlyphSet &out) const;
     bool unparse_automatics(const Gsub &gsub, Vector<Substitution> &subs, const Coverage &limit) const;
+    bool unparse_automatics(const Gsub &gsub, SubstitutionVisitor &v, const Coverage &limit) const;
     bool apply(const Glyph *, int pos, int n, Substitution &) const;
     enum {
         HEADERSIZE = 6, RECSIZE = 2,
@@ -45,69 +70,73 @@ class GsubLookup { public:
   private:
     Data _d;
     int _type;
+    const CompiledTables *_compiled;
     Data subtable(int i) const;
 };
 
 class GsubSingle { public:
-    GsubSingle(const Data &);
+    GsubSingle(const Data &, const CompiledTables * = 0);
     // default destructor
     Coverage coverage() const noexcept;
     Glyph map(Glyph) const;
-    void mark_out_glyphs(Vector<bool> &gmap) const;
-    void unparse(Vector<Substitution> &subs, const Coverage &limit) const;
+    void mark_out_glyphs(const GlyphSet &in, GlyphSet &out) const;
+    void unparse(SubstitutionVisitor &v, const Coverage &limit) const;
     bool apply(const Glyph *, int pos, int n, Substitution &) const;
     enum { HEADERSIZE = 6, FORMAT2_RECSIZE = 2 };
   private:
     Data _d;
+    const CompiledTables *_compiled;
 };
 
 class GsubMultiple { public:
-    GsubMultiple(const Data &);
+    GsubMultiple(const Data &, const CompiledTables * = 0);
     // default destructor
     Coverage coverage() const noexcept;
     bool map(Glyph, Vector<Glyph> &) const;
-    void mark_out_glyphs(Vector<bool> &gmap) const;
-    void unparse(Vector<Substitution> &, bool alternate = false) const;
+    void mark_out_glyphs(const GlyphSet &in, GlyphSet &out) const;
+    void unparse(SubstitutionVisitor &, bool alternate = false) const;
     bool apply(const Glyph *, int pos, int n, Substitution &, bool alternate = false) const;
     enum { HEADERSIZE = 6, RECSIZE = 2,
            SEQ_HEADERSIZE = 2, SEQ_RECSIZE = 2 };
   private:
     Data _d;
+    const CompiledTables *_compiled;
 };
 
 class GsubLigature { public:
-    GsubLigature(const Data &);
+    GsubLigature(const Data &, const CompiledTables * = 0);
     // default destructor
     Coverage coverage() const noexcept;
     bool map(const Vector<Glyph> &, Glyph &, int &) const;
-    void mark_out_glyphs(Vector<bool> &gmap) const;
-    void unparse(Vector<Substitution> &) const;
+    void mark_out_glyphs(const GlyphSet &in, GlyphSet &out) const;
+    void unparse(SubstitutionVisitor &) const;
     bool apply(const Glyph *, int pos, int n, Substitution &) const;
     enum { HEADERSIZE = 6, RECSIZE = 2,
            SET_HEADERSIZE = 2, SET_RECSIZE = 2,
            LIG_HEADERSIZE = 4, LIG_RECSIZE = 2 };
   private:
     Data _d;
+    const CompiledTables *_compiled;
 };
 
 class GsubContext { public:
     GsubContext(const Data &);
     // default destructor
     Coverage coverage() const noexcept;
-    void mark_out_glyphs(const Gsub &gsub, Vector<bool> &gmap) const;
-    bool unparse(const Gsub &gsub, Vector<Substitution> &out_subs, const Coverage &limit) const;
+    void mark_out_glyphs(const Gsub &gsub, const GlyphSet &in, GlyphSet &out) const;
+    bool unparse(const Gsub &gsub, SubstitutionVisitor &out_subs, const Coverage &limit) const;
     enum { F3_HSIZE = 6, SUBRECSIZE = 4 };
   private:
     Data _d;
-    static void subruleset_mark_out_glyphs(const Data &data, int nsub, int subtab_offset, const Gsub &gsub, Vector<bool> &gmap);
+    static void subruleset_mark_out_glyphs(const Data &data, int nsub, int subtab_offset, const Gsub &gsub, const GlyphSet &in, GlyphSet &out);
     static bool f1_unparse(const Data& data,
                            int nsub, int subtab_offset,
-                           const Gsub& gsub, Vector<Substitution>& outsubs,
+                           const Gsub& gsub, SubstitutionVisitor& outsubs,
                            Substitution prototype_sub);
     static bool f3_unparse(const Data &data,
                            int nglyph, int glyphtab_offset, const Coverage &limit,
                            int nsub, int subtab_offset,
-                           const Gsub &gsub, Vector<Substitution> &outsubs,
+                           const Gsub &gsub, SubstitutionVisitor &outsubs,
                            const Substitution &prototype_sub);
     friend class GsubChainContext;
 };
@@ -116,15 +145,15 @@ class GsubChainContext { public:
     GsubChainContext(const Data &);
     // default destructor
     Coverage coverage() const noexcept;
-    void mark_out_glyphs(const Gsub &gsub, Vector<bool> &gmap) const;
-    bool unparse(const Gsub &gsub, Vector<Substitution> &subs, const Coverage &limit) const;
+    void mark_out_glyphs(const Gsub &gsub, const GlyphSet &in, GlyphSet &out) const;
+    bool unparse(const Gsub &gsub, SubstitutionVisitor &subs, const Coverage &limit) const;
     enum { F1_HEADERSIZE = 6, F1_RECSIZE = 2,
            F1_SRS_HSIZE = 2, F1_SRS_RSIZE = 2,
            F3_HSIZE = 4, F3_INPUT_HSIZE = 2, F3_LOOKAHEAD_HSIZE = 2, F3_SUBST_HSIZE = 2 };
   private:
     Data _d;
-    bool f1_unparse(const Gsub &gsub, Vector<Substitution> &subs, const Coverage &limit) const;
-    bool f3_unparse(const Gsub &gsub, Vector<Substitution> &subs, const Coverage &limit) const;
+    bool f1_unparse(const Gsub &gsub, SubstitutionVisitor &subs, const Coverage &limit) const;
+    bool f3_unparse(const Gsub &gsub, SubstitutionVisitor &subs, const Coverage &limit) const;
 };
 
 class Substitution { public:
@@ -411,5 +440,12 @@ inline StringAccum &operator<<(StringAccum &sa, const Substitution &sub)
     return sa;
 }
 
+inline bool SubstitutionVisitor::emit(const Substitution &s)
+{
+    if (!_stopped && !visit(s))
+        _stopped = true;
+    return !_stopped;
+}
+
 }}
 #endif
@@ -0,0 +1,97 @@
+// -*- related-file-name: "../../libefont/otfpairkern.cc" -*-
+#ifndef EFONT_OTFPAIRKERN_HH
+#define EFONT_OTFPAIRKERN_HH
+#include <efont/otfgpos.hh>
+#include <efont/ttfkern.hh>
+#include <lcdf/hashmap.hh>
+namespace Efont { namespace OpenType {
+
+// A CompiledPairKern answers "how much kerning between glyphs a and b"
+// without expanding pair lookups into Positionings. Each added GPOS pair
+// lookup or kern table becomes a layer; kern(a, b) is the sum over layers
+// of the first glyph's x advance adjustment. A layer keeps explicit pairs
+// in a hash table and class-based subtables as a class2 map and a class
+// matrix row for each first glyph, so a query takes constant time per
+// layer.
+class CompiledPairKern { public:
+
+    CompiledPairKern();
+    ~CompiledPairKern();
+
+    int nlayers() const                 { return _layers.size(); }
+
+    // Adds a GPOS pair lookup. Returns false, and adds nothing, if the
+    // lookup isn't a pair lookup or has adjustments other than the first
+    // glyph's x advance, since kern() couldn't represent them.
+    bool add(const GposLookup &);
+    void add(const KernTable &, ErrorHandler * = 0);
+
+    inline int kern(Glyph a, Glyph b) const;
+
+    // Sets out[i] to kern(g[i], g[i+1]) for 0 <= i < n - 1, and out[n-1]
+    // to 0.
+    void kern(const Glyph *g, int n, int *out) const;
+
+  private:
+
+    enum { NONE = -0x7FFFFFFF - 1 };
+
+    struct Layer {
+        HashMap<uint32_t, int> pairs;
+        Vector<int> first_sub;          // by first glyph: class subtable,
+        Vector<int> first_row;          // and offset of its matrix row
+        Layer()                         : pairs(NONE) { }
+    };
+
+    Vector<Layer *> _layers;
+    Vector<CompiledClassDef *> _class2; // by class subtable
+    Vector<int> _nclass2;
+    Vector<int> _matrix;
+
+    CompiledPairKern(const CompiledPairKern &);
+    CompiledPairKern &operator=(const CompiledPairKern &);
+
+    static inline uint32_t pair_key(Glyph a, Glyph b);
+    inline int layer_kern(const Layer *l, Glyph a, Glyph b) const;
+    void add_pair(Layer *l, Glyph a, Glyph b, int value, bool sum);
+
+};
+
+inline uint32_t
+CompiledPairKern::pair_key(Glyph a, Glyph b)
+{
+    // multiplying by an odd constant is a bijection that spreads the
+    // second glyph's bits; only the pair (0, 0) maps to 0
+    return (((uint32_t) a << 16) | (uint32_t) b) * 0x9E3779B1U;
+}
+
+inline int
+CompiledPairKern::layer_kern(const Layer *l, Glyph a, Glyph b) const
+{
+    if (l->pairs.size()) {
+        uint32_t key = pair_key(a, b);
+        if (key) {
+            int v = l->pairs.find(key);
+            if (v != NONE)
+                return v;
+        }
+    }
+    int sub;
+    if (a >= 0 && a < l->first_sub.size() && (sub = l->first_sub[a]) >= 0) {
+        int c2 = _class2[sub]->lookup(b);
+        return c2 >= 0 && c2 < _nclass2[sub] ? _matrix[l->first_row[a] + c2] : 0;
+    } else
+        return 0;
+}
+
+inline int
+CompiledPairKern::kern(Glyph a, Glyph b) const
+{
+    int k = 0;
+    for (Layer * const *l = _layers.begin(); l != _layers.end(); ++l)
+        k += layer_kern(*l, a, b);
+    return k;
+}
+
+}}
+#endif
@@ -0,0 +1,113 @@
+// -*- related-file-name: "../../libefont/otfshaper.cc" -*-
+#ifndef EFONT_OTFSHAPER_HH
+#define EFONT_OTFSHAPER_HH
+#include <efont/otfgsub.hh>
+#include <efont/otfgpos.hh>
+#include <efont/otfgdef.hh>
+#include <efont/otfpairkern.hh>
+namespace Efont { namespace OpenType {
+
+// A ShapeBuffer holds one or more runs of glyphs for a Shaper, which
+// rewrites them in place. Each glyph carries a cluster number, usually
+// the index of the character it came from, and a Position whose fields
+// adjust the glyph's default placement and advance, as in GPOS. A buffer
+// keeps its storage when cleared, so a buffer reused for many runs
+// stops allocating once it has grown to the largest batch.
+class ShapeBuffer { public:
+
+    ShapeBuffer()                       { }
+    // default destructor
+
+    void clear();
+    void add(Glyph g, int cluster);
+    void end_run();
+
+    int size() const                    { return _glyphs.size(); }
+    int nruns() const                   { return _run_ends.size(); }
+    int run_begin(int r) const          { return r ? _run_ends[r - 1] : 0; }
+    int run_end(int r) const            { return _run_ends[r]; }
+
+    Glyph glyph(int i) const            { return _glyphs[i]; }
+    int cluster(int i) const            { return _clusters[i]; }
+    const Position &position(int i) const { return _pos[i]; }
+
+  private:
+
+    Vector<Glyph> _glyphs;
+    Vector<int> _clusters;
+    Vector<Position> _pos;
+    Vector<int> _run_ends;
+
+    friend class Shaper;
+
+};
+
+// A Shaper applies a font's GSUB and GPOS lookups for one script,
+// language system, and feature set to the runs in a ShapeBuffer. Lookups
+// run in lookup list order and honor lookup flags and mark filtering sets
+// from GDEF. Substitution supports single, multiple, alternate (the first
+// alternate), and ligature lookups; positioning supports single, pair, and
+// cursive lookups, with cursive glyphs chained left to right. Pair lookups
+// that only kern are compiled into CompiledPairKern tables.
+//
+// Contextual lookups are NOT applied: GSUB context, chaining context, and
+// reverse chaining lookups (types 5, 6, and 8), and GPOS mark attachment
+// and context lookups (types 4 through 8), are selected but leave the
+// buffer unchanged. Fonts that need them for correct text won't shape
+// correctly.
+class Shaper { public:
+
+    Shaper(const Font &, ErrorHandler * = 0);
+    ~Shaper();
+
+    bool has_gsub() const               { return _gsub != 0; }
+    bool has_gpos() const               { return _gpos != 0; }
+
+    // Selects the lookups for 'features', plus any required feature, in
+    // 'script' and 'langsys'.
+    int select(Tag script, Tag langsys, const Vector<Tag> &features,
+               ErrorHandler * = 0);
+
+    void shape(ShapeBuffer &);
+
+    int advance_width(Glyph g) const;
+
+  private:
+
+    struct Stage {
+        int lookup;
+        uint16_t flags;
+        int mark_set;
+        CompiledPairKern *kern;         // for pair lookups that only kern
+    };
+
+    Gsub *_gsub;
+    Gpos *_gpos;
+    Gdef *_gdef;
+    Data _hmtx;
+    int _nhmtx;
+
+    Vector<Stage> _gsub_stages;
+    Vector<Stage> _gpos_stages;
+
+    // scratch space, reused across calls
+    Vector<int> _view;
+    Vector<Glyph> _view_glyphs;
+    Vector<Glyph> _out_glyphs;
+    Vector<int> _out_clusters;
+    Vector<int> _out_run_ends;
+    Vector<Position> _saved_pos;
+
+    Shaper(const Shaper &);
+    Shaper &operator=(const Shaper &);
+
+    void clear_stages();
+    template <typename T> static void select_stages(const T *table, Tag script, Tag langsys, const Vector<Tag> &sorted_features, Vector<Stage> &stages, ErrorHandler *errh);
+    void make_view(const Stage &stage, const ShapeBuffer &buf, int begin, int end);
+    void substitute(const Stage &stage, ShapeBuffer &buf);
+    void position(const Stage &stage, ShapeBuffer &buf);
+
+};
+
+}}
+#endif
@@ -54,7 +54,57 @@ class CharstringBounds : public CharstringInterp { public:
     void xf_mark(const Bezier&);
 
     inline bool xf_inside(const Point&) const;
-    inline bool xf_controls_inside(const Bezier&) const;
+
+};
+
+
+// A CharstringBoundsTable caches the bounding boxes and widths of a
+// program's glyphs under one transform, exactly as CharstringBounds::bounds
+// computes them. Results live in parallel arrays indexed by glyph. bounds()
+// computes a glyph on first request; compute_all() fills in every glyph,
+// sharing the work among threads if the program is thread_safe().
+class CharstringBoundsTable { public:
+
+    CharstringBoundsTable(const CharstringProgram *, const Transform &);
+    // default destructor
+
+    const CharstringProgram *program() const    { return _program; }
+    const Transform &transform() const          { return _xf; }
+    int size() const                            { return _state.size(); }
+
+    // Same as CharstringBounds::bounds(transform(), program()->glyph_context(gi), bb, width).
+    bool bounds(int gi, double bb[4], double &width);
+    void compute_all(int nthreads = 1);
+
+    // Arrays are valid for glyphs that have been computed.
+    bool known(int gi) const                    { return _state[gi] != S_UNKNOWN; }
+    bool ok(int gi) const                       { return _state[gi] == S_OK; }
+    const Vector<double> &xmin() const          { return _xmin; }
+    const Vector<double> &ymin() const          { return _ymin; }
+    const Vector<double> &xmax() const          { return _xmax; }
+    const Vector<double> &ymax() const          { return _ymax; }
+    const Vector<double> &width() const         { return _width; }
+
+  private:
+
+    enum { S_UNKNOWN = 0, S_OK = 1, S_ERROR = 2 };
+
+    const CharstringProgram *_program;
+    Transform _xf;
+    Vector<uint8_t> _state;
+    Vector<double> _xmin;
+    Vector<double> _ymin;
+    Vector<double> _xmax;
+    Vector<double> _ymax;
+    Vector<double> _width;
+
+    CharstringBoundsTable(const CharstringBoundsTable &);
+    CharstringBoundsTable &operator=(const CharstringBoundsTable &);
+
+    struct Work;
+
+    void compute(int gi);
+    static void *compute_thread(void *);
 
 };
 
@@ -82,11 +132,6 @@ inline bool CharstringBounds::xf_inside(const Point& p) const
     return p.x >= _lb.x && p.x <= _rt.x && p.y >= _lb.y && p.y <= _rt.y;
 }
 
-inline bool CharstringBounds::xf_controls_inside(const Bezier& b) const
-{
-    return xf_inside(b.point(1)) && xf_inside(b.point(2));
-}
-
 inline Point CharstringBounds::transform(const Point& p) const
 {
     return p * _xf;
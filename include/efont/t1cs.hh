@@ -5,6 +5,7 @@
 #include <lcdf/string.hh>
 #include <lcdf/vector.hh>
 #include <lcdf/inttypes.h>
+#include <atomic>
 namespace Efont {
 
 // Allow unknown doubles to have some `fuzz' -- so if an unknown double
@@ -151,6 +152,7 @@ class Type1Charstring : public Charstring { public:
     void assign_substring(int pos, int len, const String &);
 
     bool process(CharstringInterp &) const;
+    static bool process_data(const uint8_t *, int, CharstringInterp &);
 
   private:
 
@@ -174,6 +176,7 @@ class Type2Charstring : public Charstring { public:
     int length() const                          { return _s.length(); }
 
     bool process(CharstringInterp &) const;
+    static bool process_data(const uint8_t *, int, CharstringInterp &);
 
   private:
 
@@ -182,6 +185,39 @@ class Type2Charstring : public Charstring { public:
 };
 
 
+// A CharstringView is an unencrypted Type 1 or Type 2 charstring that
+// refers to bytes it doesn't own, such as a CFF font's data, which must
+// outlive it. Views are small values, so a font can keep one per glyph in
+// a flat array rather than allocating a Charstring object for each.
+class CharstringView : public Charstring { public:
+
+    CharstringView()                            : _data(0), _len(0), _type(2) { }
+    CharstringView(int type, const uint8_t *data, int len)
+        : _data(data), _len(len), _type(type) { }
+    // default copy constructor
+    // default destructor
+    // default assignment operator
+
+    int type() const                            { return _type; }
+    const uint8_t *data() const                 { return _data; }
+    int length() const                          { return _len; }
+
+    // Points this view at the bytes of 'cs', which must be a
+    // Type1Charstring, Type2Charstring, or CharstringView. Returns false
+    // for other charstrings.
+    bool assign(const Charstring *cs);
+
+    bool process(CharstringInterp &) const;
+
+  private:
+
+    const uint8_t *_data;
+    int _len;
+    int _type;
+
+};
+
+
 struct CharstringContext {
 
     CharstringContext(const CharstringProgram *program_, const Charstring *cs_) : program(program_), cs(cs_) { }
@@ -196,6 +232,37 @@ struct CharstringContext {
 };
 
 
+// A CharstringCache holds a program's lazily created charstrings, one
+// slot per glyph or subroutine. get() never blocks. A program fills an
+// empty slot while holding its own lock, then publishes the charstring with
+// set(), so several threads can interpret the same program. The cache owns
+// its charstrings.
+class CharstringCache { public:
+
+    CharstringCache()                           : _cs(0), _n(0) { }
+    ~CharstringCache();
+
+    int size() const                            { return _n; }
+    void assign(int n);
+
+    Charstring *get(int i) const {
+        return _cs[i].load(std::memory_order_acquire);
+    }
+    void set(int i, Charstring *cs) {
+        _cs[i].store(cs, std::memory_order_release);
+    }
+
+  private:
+
+    std::atomic<Charstring *> *_cs;
+    int _n;
+
+    CharstringCache(const CharstringCache &);
+    CharstringCache &operator=(const CharstringCache &);
+
+};
+
+
 class CharstringProgram { public:
 
     explicit CharstringProgram(unsigned units_per_em);
@@ -240,6 +307,10 @@ class CharstringProgram { public:
 
     virtual double global_width_x(bool is_nominal) const;
 
+    // Returns true if several threads may interpret the program's glyphs
+    // at the same time.
+    virtual bool thread_safe() const            { return false; }
+
   private:
 
     bool _parent_program;
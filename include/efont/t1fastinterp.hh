@@ -0,0 +1,780 @@
+#ifndef EFONT_T1FASTINTERP_HH
+#define EFONT_T1FASTINTERP_HH
+#include <efont/t1cs.hh>
+#include <lcdf/point.hh>
+namespace Efont {
+
+// CharstringFastInterp<A> interprets the common subset of Type 1 and
+// Type 2 charstrings -- numbers, hints, paths, subroutines, and Type 1 hint
+// replacement -- and reports to a derived class A through statically
+// dispatched act_ functions with the same meanings as CharstringInterp's.
+// A declares the actions it wants; the others default to CharstringInterp's
+// behavior.
+//
+// interpret() returns false on anything outside the subset: arithmetic,
+// othersubrs other than hint replacement, seac, blend, multiple master
+// commands, errors, and charstrings that aren't Type1Charstring,
+// Type2Charstring, or CharstringView objects. By then A may have seen the
+// actions for a prefix of the charstring. The caller reruns the charstring
+// with a full CharstringInterp, which repeats that prefix exactly.
+template <typename A>
+class CharstringFastInterp { public:
+
+    CharstringFastInterp()                      : _program(0) { }
+
+    const CharstringProgram *program() const    { return _program; }
+
+    bool interpret(const CharstringContext &);
+
+    void act_sidebearing(int, const Point &)    { }
+    void act_width(int, const Point &)          { }
+    inline void act_default_width(int cmd);
+    inline void act_nominal_width_delta(int cmd, double delta);
+
+    void act_line(int cmd, const Point &p0, const Point &p1) {
+        derived()->act_curve(cmd, p0, p0, p1, p1);
+    }
+    void act_curve(int, const Point &, const Point &, const Point &, const Point &) { }
+    void act_closepath(int)                     { }
+    inline void act_flex(int cmd, const Point &p0, const Point &p1, const Point &p2, const Point &p3_4, const Point &p5, const Point &p6, const Point &p7, double flex_depth);
+
+    void act_hstem(int, double, double)         { }
+    void act_vstem(int, double, double)         { }
+    inline void act_hstem3(int cmd, double y0, double dy0, double y1, double dy1, double y2, double dy2);
+    inline void act_vstem3(int cmd, double x0, double dx0, double x1, double dx1, double x2, double dx2);
+    void act_hintmask(int, const uint8_t *, int) { }
+
+    enum { STACK_SIZE = 48, PS_STACK_SIZE = 24, MAX_SUBR_DEPTH = 10 };
+
+  private:
+
+    typedef Charstring Cs;
+
+    enum { R_FAIL = -1, R_RETURN = 0, R_DONE = 1 };
+
+    // same order as CharstringInterp::State
+    enum State {
+        S_INITIAL, S_SEAC, S_SBW, S_HSTEM, S_VSTEM, S_HINTMASK, S_IPATH, S_PATH
+    };
+
+    const CharstringProgram *_program;
+    double _s[STACK_SIZE];
+    int _sp;
+    double _ps_s[PS_STACK_SIZE];
+    int _ps_sp;
+    int _subr_depth;
+    State _state;
+    int _nhints;
+    double _cpx;
+    double _cpy;
+    double _lsbx;
+    double _lsby;
+
+    A *derived()                                { return static_cast<A *>(this); }
+    Point cp() const                            { return Point(_cpx, _cpy); }
+
+    inline int type2_width(int cmd, bool have_width);
+    inline void path_end(int cmd);
+    inline void rlineto(int cmd, double dx, double dy);
+    inline void rrcurveto(int cmd, double dx1, double dy1, double dx2, double dy2, double dx3, double dy3);
+    void rrflex(int cmd, double dx1, double dy1, double dx2, double dy2, double dx3, double dy3, double dx4, double dy4, double dx5, double dy5, double dx6, double dy6, double flex_depth);
+    inline void type2_stems(int cmd, bool horizontal, int bottom);
+
+    int callsubr(bool g);
+    int type1(const uint8_t *data, int left);
+    int type2(const uint8_t *data, int left);
+
+};
+
+
+template <typename A>
+inline void CharstringFastInterp<A>::act_default_width(int cmd)
+{
+    double d = (_program ? _program->global_width_x(false) : UNKDOUBLE);
+    if (KNOWN(d))
+        derived()->act_width(cmd, Point(d, 0));
+}
+
+template <typename A>
+inline void CharstringFastInterp<A>::act_nominal_width_delta(int cmd, double delta)
+{
+    double d = (_program ? _program->global_width_x(true) : UNKDOUBLE);
+    if (KNOWN(d))
+        derived()->act_width(cmd, Point(d + delta, 0));
+}
+
+template <typename A>
+inline void CharstringFastInterp<A>::act_flex(int cmd, const Point &p0, const Point &p1, const Point &p2, const Point &p3_4, const Point &p5, const Point &p6, const Point &p7, double)
+{
+    derived()->act_curve(cmd, p0, p1, p2, p3_4);
+    derived()->act_curve(cmd, p3_4, p5, p6, p7);
+}
+
+template <typename A>
+inline void CharstringFastInterp<A>::act_hstem3(int cmd, double y0, double dy0, double y1, double dy1, double y2, double dy2)
+{
+    derived()->act_hstem(cmd, y0, dy0);
+    derived()->act_hstem(cmd, y1, dy1);
+    derived()->act_hstem(cmd, y2, dy2);
+}
+
+template <typename A>
+inline void CharstringFastInterp<A>::act_vstem3(int cmd, double x0, double dx0, double x1, double dx1, double x2, double dx2)
+{
+    derived()->act_vstem(cmd, x0, dx0);
+    derived()->act_vstem(cmd, x1, dx1);
+    derived()->act_vstem(cmd, x2, dx2);
+}
+
+template <typename A>
+bool CharstringFastInterp<A>::interpret(const CharstringContext &g)
+{
+    CharstringView v;
+    if (!v.assign(g.cs))
+        return false;
+    _program = g.program;
+    _sp = _ps_sp = 0;
+    _subr_depth = 0;
+    _state = S_INITIAL;
+    _nhints = 0;
+    _cpx = _cpy = _lsbx = _lsby = 0;
+    int r = (v.type() == 1 ? type1(v.data(), v.length()) : type2(v.data(), v.length()));
+    return r != R_FAIL;
+}
+
+template <typename A>
+inline int CharstringFastInterp<A>::type2_width(int cmd, bool have_width)
+{
+    _cpx = _cpy = _lsbx = _lsby = 0;
+    if (_state != S_INITIAL)
+        /* ignore width */;
+    else if (have_width)
+        derived()->act_nominal_width_delta(cmd, _s[0]);
+    else
+        derived()->act_default_width(cmd);
+    return (have_width ? 1 : 0);
+}
+
+template <typename A>
+inline void CharstringFastInterp<A>::path_end(int cmd)
+{
+    if (_state == S_PATH)
+        derived()->act_closepath(cmd);
+    _state = S_IPATH;
+}
+
+template <typename A>
+inline void CharstringFastInterp<A>::rlineto(int cmd, double dx, double dy)
+{
+    Point p0 = cp();
+    _cpx += dx;
+    _cpy += dy;
+    derived()->act_line(cmd, p0, cp());
+}
+
+template <typename A>
+inline void CharstringFastInterp<A>::rrcurveto(int cmd, double dx1, double dy1, double dx2, double dy2, double dx3, double dy3)
+{
+    double x1 = _cpx + dx1, y1 = _cpy + dy1;
+    double x2 = x1 + dx2, y2 = y1 + dy2;
+    Point p0 = cp();
+    _cpx = x2 + dx3;
+    _cpy = y2 + dy3;
+    derived()->act_curve(cmd, p0, Point(x1, y1), Point(x2, y2), cp());
+}
+
+template <typename A>
+void CharstringFastInterp<A>::rrflex(int cmd, double dx1, double dy1, double dx2, double dy2, double dx3, double dy3, double dx4, double dy4, double dx5, double dy5, double dx6, double dy6, double flex_depth)
+{
+    double x1 = _cpx + dx1, y1 = _cpy + dy1;
+    double x2 = x1 + dx2, y2 = y1 + dy2;
+    double x3 = x2 + dx3, y3 = y2 + dy3;
+    double x4 = x3 + dx4, y4 = y3 + dy4;
+    double x5 = x4 + dx5, y5 = y4 + dy5;
+    Point p0 = cp();
+    _cpx = x5 + dx6;
+    _cpy = y5 + dy6;
+    derived()->act_flex(cmd, p0, Point(x1, y1), Point(x2, y2), Point(x3, y3),
+                        Point(x4, y4), Point(x5, y5), cp(), flex_depth);
+}
+
+template <typename A>
+inline void CharstringFastInterp<A>::type2_stems(int cmd, bool horizontal, int bottom)
+{
+    for (double pos = 0; bottom + 1 < _sp; bottom += 2) {
+        _nhints++;
+        if (horizontal)
+            derived()->act_hstem(cmd, pos + _s[bottom], _s[bottom + 1]);
+        else
+            derived()->act_vstem(cmd, pos + _s[bottom], _s[bottom + 1]);
+        pos += _s[bottom] + _s[bottom + 1];
+    }
+}
+
+template <typename A>
+int CharstringFastInterp<A>::callsubr(bool g)
+{
+    if (_sp < 1 || !_program || _subr_depth >= MAX_SUBR_DEPTH)
+        return R_FAIL;
+    int which = (int) _s[--_sp];
+    CharstringView subr;
+    if (!subr.assign(_program->xsubr(g, which)))
+        return R_FAIL;
+    _subr_depth++;
+    int r = (subr.type() == 1 ? type1(subr.data(), subr.length()) : type2(subr.data(), subr.length()));
+    _subr_depth--;
+    return r;
+}
+
+// Decodes the numbers shared by Type 1 and Type 2 charstrings, except for
+// 255, whose meaning differs. Expects 'data[0]' >= 32 and 'left' > 0.
+#define EFONT_FASTINTERP_NUMBER(data, left, v, ahead)                  \
+    if (data[0] <= 246) {                                               \
+        v = data[0] - 139;                                              \
+        ahead = 1;                                                      \
+    } else if (data[0] <= 250) {                                        \
+        if (left < 2)                                                   \
+            return R_FAIL;                                              \
+        v = ((data[0] - 247) << 8) + 108 + data[1];                     \
+        ahead = 2;                                                      \
+    } else if (data[0] <= 254) {                                        \
+        if (left < 2)                                                   \
+            return R_FAIL;                                              \
+        v = -((data[0] - 251) << 8) - 108 - data[1];                    \
+        ahead = 2;                                                      \
+    }
+
+template <typename A>
+int CharstringFastInterp<A>::type1(const uint8_t *data, int left)
+{
+    while (left > 0) {
+        int ahead;
+
+        if (*data >= 32) {
+            int32_t v;
+            EFONT_FASTINTERP_NUMBER(data, left, v, ahead)
+            else {
+                if (left < 5)
+                    return R_FAIL;
+                v = (int32_t) (((uint32_t) data[1] << 24) | (data[2] << 16) | (data[3] << 8) | data[4]);
+                ahead = 5;
+            }
+            if (_sp == STACK_SIZE)
+                return R_FAIL;
+            _s[_sp++] = v;
+            data += ahead;
+            left -= ahead;
+            continue;
+        }
+
+        int cmd = *data;
+        ahead = 1;
+        if (cmd == Cs::cEscape) {
+            if (left < 2)
+                return R_FAIL;
+            cmd = Cs::cEscapeDelta + data[1];
+            ahead = 2;
+        }
+
+        switch (cmd) {
+
+          case Cs::cShortint:
+            if (left < 3 || _sp == STACK_SIZE)
+                return R_FAIL;
+            _s[_sp++] = (int16_t) ((data[1] << 8) | data[2]);
+            data += 3;
+            left -= 3;
+            continue;
+
+          case Cs::cHsbw:
+            if (_sp < 2)
+                return R_FAIL;
+            _lsbx = _cpx = _s[0];
+            _lsby = _cpy = 0;
+            if (_state == S_INITIAL) {
+                derived()->act_sidebearing(cmd, Point(_lsbx, 0));
+                derived()->act_width(cmd, Point(_s[1], 0));
+            }
+            if (_state <= S_SEAC)
+                _state = S_SBW;
+            break;
+
+          case Cs::cSbw:
+            if (_sp < 4)
+                return R_FAIL;
+            _lsbx = _cpx = _s[0];
+            _lsby = _cpy = _s[1];
+            if (_state == S_INITIAL) {
+                derived()->act_sidebearing(cmd, Point(_lsbx, _lsby));
+                derived()->act_width(cmd, Point(_s[2], _s[3]));
+            }
+            if (_state <= S_SEAC)
+                _state = S_SBW;
+            break;
+
+          case Cs::cCallsubr: {
+              int r = callsubr(false);
+              if (r != R_RETURN)
+                  return r;
+              data += ahead;
+              left -= ahead;
+              continue;
+          }
+
+          case Cs::cReturn:
+            return R_RETURN;
+
+          case Cs::cCallothersubr: {
+              // only hint replacement: 'subr# 1 3 callothersubr pop callsubr'
+              if (_sp < 3)
+                  return R_FAIL;
+              int othersubrnum = (int) _s[_sp - 1];
+              int n = (int) _s[_sp - 2];
+              if (othersubrnum != Cs::othcReplacehints || n != 1)
+                  return R_FAIL;
+              _ps_s[0] = _s[_sp - 3];
+              _ps_sp = 1;
+              _sp -= 3;
+              data += ahead;
+              left -= ahead;
+              continue;
+          }
+
+          case Cs::cPop:
+            if (_ps_sp < 1 || _sp == STACK_SIZE)
+                return R_FAIL;
+            _s[_sp++] = _ps_s[--_ps_sp];
+            data += ahead;
+            left -= ahead;
+            continue;
+
+          case Cs::cHlineto:
+            if (_sp < 1)
+                return R_FAIL;
+            _state = S_PATH;
+            rlineto(cmd, _s[0], 0);
+            break;
+
+          case Cs::cHmoveto:
+            if (_sp < 1)
+                return R_FAIL;
+            path_end(cmd);
+            _cpx += _s[0];
+            break;
+
+          case Cs::cHvcurveto:
+            if (_sp < 4)
+                return R_FAIL;
+            _state = S_PATH;
+            rrcurveto(cmd, _s[0], 0, _s[1], _s[2], 0, _s[3]);
+            break;
+
+          case Cs::cRlineto:
+            if (_sp < 2)
+                return R_FAIL;
+            _state = S_PATH;
+            rlineto(cmd, _s[0], _s[1]);
+            break;
+
+          case Cs::cRmoveto:
+            if (_sp < 2)
+                return R_FAIL;
+            path_end(cmd);
+            _cpx += _s[0];
+            _cpy += _s[1];
+            break;
+
+          case Cs::cRrcurveto:
+            if (_sp < 6)
+                return R_FAIL;
+            _state = S_PATH;
+            rrcurveto(cmd, _s[0], _s[1], _s[2], _s[3], _s[4], _s[5]);
+            break;
+
+          case Cs::cVhcurveto:
+            if (_sp < 4)
+                return R_FAIL;
+            _state = S_PATH;
+            rrcurveto(cmd, 0, _s[0], _s[1], _s[2], _s[3], 0);
+            break;
+
+          case Cs::cVlineto:
+            if (_sp < 1)
+                return R_FAIL;
+            _state = S_PATH;
+            rlineto(cmd, 0, _s[0]);
+            break;
+
+          case Cs::cVmoveto:
+            if (_sp < 1)
+                return R_FAIL;
+            path_end(cmd);
+            _cpy += _s[0];
+            break;
+
+          case Cs::cDotsection:
+            break;
+
+          case Cs::cHstem:
+            if (_sp < 2)
+                return R_FAIL;
+            derived()->act_hstem(cmd, _lsby + _s[0], _s[1]);
+            break;
+
+          case Cs::cHstem3:
+            if (_sp < 6)
+                return R_FAIL;
+            derived()->act_hstem3(cmd, _lsby + _s[0], _s[1], _lsby + _s[2], _s[3], _lsby + _s[4], _s[5]);
+            break;
+
+          case Cs::cVstem:
+            if (_sp < 2)
+                return R_FAIL;
+            derived()->act_vstem(cmd, _lsbx + _s[0], _s[1]);
+            break;
+
+          case Cs::cVstem3:
+            if (_sp < 6)
+                return R_FAIL;
+            derived()->act_vstem3(cmd, _lsbx + _s[0], _s[1], _lsbx + _s[2], _s[3], _lsbx + _s[4], _s[5]);
+            break;
+
+          case Cs::cSetcurrentpoint:
+            if (_sp < 2)
+                return R_FAIL;
+            _cpx = _s[0];
+            _cpy = _s[1];
+            break;
+
+          case Cs::cClosepath:
+            path_end(cmd);
+            break;
+
+          case Cs::cEndchar:
+            path_end(cmd);
+            return R_DONE;
+
+          default:
+            return R_FAIL;
+
+        }
+
+        _sp = 0;
+        data += ahead;
+        left -= ahead;
+    }
+
+    return R_FAIL;
+}
+
+template <typename A>
+int CharstringFastInterp<A>::type2(const uint8_t *data, int left)
+{
+    while (left > 0) {
+        int ahead;
+
+        if (*data >= 32) {
+            int32_t v;
+            EFONT_FASTINTERP_NUMBER(data, left, v, ahead)
+            else {
+                if (left < 5)
+                    return R_FAIL;
+                int32_t f = (int32_t) (((uint32_t) data[1] << 24) | (data[2] << 16) | (data[3] << 8) | data[4]);
+                if (_sp == STACK_SIZE)
+                    return R_FAIL;
+                _s[_sp++] = f / 65536.;
+                data += 5;
+                left -= 5;
+                continue;
+            }
+            if (_sp == STACK_SIZE)
+                return R_FAIL;
+            _s[_sp++] = v;
+            data += ahead;
+            left -= ahead;
+            continue;
+        }
+
+        int cmd = *data;
+        int bottom = 0;
+        ahead = 1;
+        if (cmd == Cs::cEscape) {
+            if (left < 2)
+                return R_FAIL;
+            cmd = Cs::cEscapeDelta + data[1];
+            ahead = 2;
+        }
+
+        switch (cmd) {
+
+          case Cs::cShortint:
+            if (left < 3 || _sp == STACK_SIZE)
+                return R_FAIL;
+            _s[_sp++] = (int16_t) ((data[1] << 8) | data[2]);
+            data += 3;
+            left -= 3;
+            continue;
+
+          case Cs::cHstem:
+          case Cs::cHstemhm:
+            if (_sp < 2)
+                return R_FAIL;
+            if (_state <= S_SEAC)
+                bottom = type2_width(cmd, (_sp % 2) == 1);
+            if (_state > S_HSTEM)
+                return R_FAIL;
+            _state = S_HSTEM;
+            type2_stems(cmd, true, bottom);
+            break;
+
+          case Cs::cVstem:
+          case Cs::cVstemhm:
+            if (_sp < 2)
+                return R_FAIL;
+            if (_state <= S_SEAC)
+                bottom = type2_width(cmd, (_sp % 2) == 1);
+            if (_state > S_VSTEM)
+                return R_FAIL;
+            _state = S_VSTEM;
+            type2_stems(cmd, false, bottom);
+            break;
+
+          case Cs::cHintmask:
+          case Cs::cCntrmask: {
+              if (_state <= S_SEAC && _sp >= 1) {
+                  bottom = type2_width(cmd, (_sp % 2) == 1);
+                  type2_stems(cmd, true, bottom);
+                  bottom = _sp;
+              }
+              if ((_state == S_HSTEM || _state == S_VSTEM) && _sp >= 2)
+                  type2_stems(cmd, false, bottom);
+              if (_state < S_HINTMASK)
+                  _state = S_HINTMASK;
+              int masklen = ((_nhints - 1) >> 3) + 1;
+              if (_nhints == 0 || masklen > left - 1)
+                  return R_FAIL;
+              derived()->act_hintmask(cmd, data + 1, _nhints);
+              ahead += masklen;
+              break;
+          }
+
+          case Cs::cRmoveto:
+            if (_sp < 2)
+                return R_FAIL;
+            if (_state <= S_SEAC)
+                bottom = type2_width(cmd, _sp > 2);
+            path_end(cmd);
+            _cpx += _s[bottom];
+            _cpy += _s[bottom + 1];
+            break;
+
+          case Cs::cHmoveto:
+            if (_sp < 1)
+                return R_FAIL;
+            if (_state <= S_SEAC)
+                bottom = type2_width(cmd, _sp > 1);
+            path_end(cmd);
+            _cpx += _s[bottom];
+            break;
+
+          case Cs::cVmoveto:
+            if (_sp < 1)
+                return R_FAIL;
+            if (_state <= S_SEAC)
+                bottom = type2_width(cmd, _sp > 1);
+            path_end(cmd);
+            _cpy += _s[bottom];
+            break;
+
+          case Cs::cRlineto:
+            if (_sp < 2 || _state < S_IPATH)
+                return R_FAIL;
+            _state = S_PATH;
+            for (; bottom + 1 < _sp; bottom += 2)
+                rlineto(cmd, _s[bottom], _s[bottom + 1]);
+            break;
+
+          case Cs::cHlineto:
+            if (_sp < 1 || _state < S_IPATH)
+                return R_FAIL;
+            _state = S_PATH;
+            while (bottom < _sp) {
+                rlineto(cmd, _s[bottom++], 0);
+                if (bottom < _sp)
+                    rlineto(cmd, 0, _s[bottom++]);
+            }
+            break;
+
+          case Cs::cVlineto:
+            if (_sp < 1 || _state < S_IPATH)
+                return R_FAIL;
+            _state = S_PATH;
+            while (bottom < _sp) {
+                rlineto(cmd, 0, _s[bottom++]);
+                if (bottom < _sp)
+                    rlineto(cmd, _s[bottom++], 0);
+            }
+            break;
+
+          case Cs::cRrcurveto:
+            if (_sp < 6 || _state < S_IPATH)
+                return R_FAIL;
+            _state = S_PATH;
+            for (; bottom + 5 < _sp; bottom += 6)
+                rrcurveto(cmd, _s[bottom], _s[bottom + 1], _s[bottom + 2], _s[bottom + 3], _s[bottom + 4], _s[bottom + 5]);
+            break;
+
+          case Cs::cHhcurveto:
+            if (_sp < 4 || _state < S_IPATH)
+                return R_FAIL;
+            _state = S_PATH;
+            if (_sp % 2 == 1) {
+                rrcurveto(cmd, _s[bottom + 1], _s[bottom], _s[bottom + 2], _s[bottom + 3], _s[bottom + 4], 0);
+                bottom += 5;
+            }
+            for (; bottom + 3 < _sp; bottom += 4)
+                rrcurveto(cmd, _s[bottom], 0, _s[bottom + 1], _s[bottom + 2], _s[bottom + 3], 0);
+            break;
+
+          case Cs::cHvcurveto:
+            if (_sp < 4 || _state < S_IPATH)
+                return R_FAIL;
+            _state = S_PATH;
+            while (bottom + 3 < _sp) {
+                double dx3 = (bottom + 5 == _sp ? _s[bottom + 4] : 0);
+                rrcurveto(cmd, _s[bottom], 0, _s[bottom + 1], _s[bottom + 2], dx3, _s[bottom + 3]);
+                bottom += 4;
+                if (bottom + 3 < _sp) {
+                    double dy3 = (bottom + 5 == _sp ? _s[bottom + 4] : 0);
+                    rrcurveto(cmd, 0, _s[bottom], _s[bottom + 1], _s[bottom + 2], _s[bottom + 3], dy3);
+                    bottom += 4;
+                }
+            }
+            break;
+
+          case Cs::cRcurveline:
+            if (_sp < 8 || _state < S_IPATH)
+                return R_FAIL;
+            _state = S_PATH;
+            for (; bottom + 7 < _sp; bottom += 6)
+                rrcurveto(cmd, _s[bottom], _s[bottom + 1], _s[bottom + 2], _s[bottom + 3], _s[bottom + 4], _s[bottom + 5]);
+            rlineto(cmd, _s[bottom], _s[bottom + 1]);
+            break;
+
+          case Cs::cRlinecurve:
+            if (_sp < 8 || _state < S_IPATH)
+                return R_FAIL;
+            _state = S_PATH;
+            for (; bottom + 7 < _sp; bottom += 2)
+                rlineto(cmd, _s[bottom], _s[bottom + 1]);
+            rrcurveto(cmd, _s[bottom], _s[bottom + 1], _s[bottom + 2], _s[bottom + 3], _s[bottom + 4], _s[bottom + 5]);
+            break;
+
+          case Cs::cVhcurveto:
+            if (_sp < 4 || _state < S_IPATH)
+                return R_FAIL;
+            _state = S_PATH;
+            while (bottom + 3 < _sp) {
+                double dy3 = (bottom + 5 == _sp ? _s[bottom + 4] : 0);
+                rrcurveto(cmd, 0, _s[bottom], _s[bottom + 1], _s[bottom + 2], _s[bottom + 3], dy3);
+                bottom += 4;
+                if (bottom + 3 < _sp) {
+                    double dx3 = (bottom + 5 == _sp ? _s[bottom + 4] : 0);
+                    rrcurveto(cmd, _s[bottom], 0, _s[bottom + 1], _s[bottom + 2], dx3, _s[bottom + 3]);
+                    bottom += 4;
+                }
+            }
+            break;
+
+          case Cs::cVvcurveto:
+            if (_sp < 4 || _state < S_IPATH)
+                return R_FAIL;
+            _state = S_PATH;
+            if (_sp % 2 == 1) {
+                rrcurveto(cmd, _s[bottom], _s[bottom + 1], _s[bottom + 2], _s[bottom + 3], 0, _s[bottom + 4]);
+                bottom += 5;
+            }
+            for (; bottom + 3 < _sp; bottom += 4)
+                rrcurveto(cmd, 0, _s[bottom], _s[bottom + 1], _s[bottom + 2], 0, _s[bottom + 3]);
+            break;
+
+          case Cs::cFlex:
+            if (_sp < 13 || _state < S_IPATH)
+                return R_FAIL;
+            _state = S_PATH;
+            rrflex(cmd, _s[0], _s[1], _s[2], _s[3], _s[4], _s[5],
+                   _s[6], _s[7], _s[8], _s[9], _s[10], _s[11], _s[12]);
+            break;
+
+          case Cs::cHflex:
+            if (_sp < 7 || _state < S_IPATH)
+                return R_FAIL;
+            _state = S_PATH;
+            rrflex(cmd, _s[0], 0, _s[1], _s[2], _s[3], 0,
+                   _s[4], 0, _s[5], -_s[2], _s[6], 0, 50);
+            break;
+
+          case Cs::cHflex1:
+            if (_sp < 9 || _state < S_IPATH)
+                return R_FAIL;
+            _state = S_PATH;
+            rrflex(cmd, _s[0], _s[1], _s[2], _s[3], _s[4], 0,
+                   _s[5], 0, _s[6], _s[7], _s[8], -(_s[1] + _s[3] + _s[7]), 50);
+            break;
+
+          case Cs::cFlex1: {
+              if (_sp < 11 || _state < S_IPATH)
+                  return R_FAIL;
+              _state = S_PATH;
+              double dx = _s[0] + _s[2] + _s[4] + _s[6] + _s[8];
+              double dy = _s[1] + _s[3] + _s[5] + _s[7] + _s[9];
+              if ((dx < 0 ? -dx : dx) > (dy < 0 ? -dy : dy))
+                  rrflex(cmd, _s[0], _s[1], _s[2], _s[3], _s[4], _s[5],
+                         _s[6], _s[7], _s[8], _s[9], _s[10], -dy, 50);
+              else
+                  rrflex(cmd, _s[0], _s[1], _s[2], _s[3], _s[4], _s[5],
+                         _s[6], _s[7], _s[8], _s[9], -dx, _s[10], 50);
+              break;
+          }
+
+          case Cs::cEndchar:
+            if (_state <= S_SEAC)
+                bottom = type2_width(cmd, _sp > 0 && _sp != 4);
+            if (bottom + 3 < _sp && _state == S_INITIAL)
+                return R_FAIL;  // seac
+            path_end(cmd);
+            return R_DONE;
+
+          case Cs::cReturn:
+            return R_RETURN;
+
+          case Cs::cCallsubr:
+          case Cs::cCallgsubr: {
+              int r = callsubr(cmd == Cs::cCallgsubr);
+              if (r != R_RETURN)
+                  return r;
+              data += ahead;
+              left -= ahead;
+              continue;
+          }
+
+          case Cs::cDotsection:
+            break;
+
+          default:
+            return R_FAIL;
+
+        }
+
+        _sp = 0;
+        data += ahead;
+        left -= ahead;
+    }
+
+    return R_FAIL;
+}
+
+#undef EFONT_FASTINTERP_NUMBER
+
+}
+#endif
@@ -4,6 +4,7 @@
 #include <efont/t1cs.hh>
 #include <efont/otf.hh>
 #include <efont/otfdata.hh>
+#include <mutex>
 namespace Efont {
 
 class TrueTypeBoundsCharstringProgram : public CharstringProgram { public:
@@ -18,6 +19,8 @@ class TrueTypeBoundsCharstringProgram : public CharstringProgram { public:
     PermString glyph_name(int gi) const;
     void glyph_names(Vector<PermString> &) const;
 
+    bool thread_safe() const            { return true; }
+
   private:
 
     const OpenType::Font *_otf;
@@ -27,11 +30,14 @@ class TrueTypeBoundsCharstringProgram : public CharstringProgram { public:
     OpenType::Data _loca;
     OpenType::Data _glyf;
     OpenType::Data _hmtx;
-    mutable Vector<Charstring*> _charstrings;
+    mutable CharstringCache _charstrings;
     mutable Vector<PermString> _glyph_names;
     mutable bool _got_glyph_names;
     mutable Vector<uint32_t> _unicodes;
     mutable bool _got_unicodes;
+    mutable std::mutex _lock;
+
+    Charstring *make_glyph(int gi) const;
 
 };
 
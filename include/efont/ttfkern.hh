@@ -12,6 +12,9 @@ class KernTable { public:
     bool ok() const                     { return _error >= 0; }
 
     bool unparse_automatics(Vector<Positioning> &, ErrorHandler * = 0) const;
+    bool unparse_automatics(Vector<Positioning> &, const Coverage &limit, ErrorHandler * = 0) const;
+    bool unparse_automatics(PositioningVisitor &, ErrorHandler * = 0) const;
+    bool unparse_automatics(PositioningVisitor &, const Coverage &limit, ErrorHandler * = 0) const;
 
   private:
 
@@ -35,6 +38,7 @@ class KernTable { public:
         return _version == 0 ? 4 : 8;
     }
     inline Data subtable(uint32_t &off) const;
+    bool unparse(PositioningVisitor &, const Coverage *limit, ErrorHandler *) const;
 
 };
 
@@ -31,6 +31,11 @@ class Bezier { public:
     inline double bb_top_x() const noexcept;
     inline double bb_bottom_x() const noexcept;
 
+    void exact_bb(Point &bottom_left, Point &top_right) const noexcept;
+    static void exact_extents(int n, const double *p0, const double *p1,
+			      const double *p2, const double *p3,
+			      double *lo, double *hi) noexcept;
+
     void halve(Bezier &, Bezier &) const noexcept;
 
     inline void segmentize(Vector<Point> &) const;
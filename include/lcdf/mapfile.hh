@@ -0,0 +1,19 @@
+// -*- related-file-name: "../../liblcdf/mapfile.cc" -*-
+#ifndef LCDF_MAPFILE_HH
+#define LCDF_MAPFILE_HH
+#include <lcdf/string.hh>
+#include <stdio.h>
+
+/** @brief Return the contents of the regular file open as @a f, mapped
+ * into memory.
+ * @param f open file, positioned at its start
+ * @param min_size smallest file worth mapping
+ *
+ * The result and its substrings refer directly to the mapping, which is
+ * released along with the last String that uses it.  Returns a null String,
+ * leaving @a f untouched, if @a f isn't a regular file (a pipe, say), is
+ * smaller than @a min_size or empty, or can't be mapped on this platform.
+ * The caller should then read @a f normally. */
+String map_file(FILE *f, int min_size = 1);
+
+#endif
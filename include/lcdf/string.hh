@@ -148,6 +148,18 @@ class String { public:
     }
     static String make_fill(int c, int n); // n copies of c
 
+    /** @brief Return a String that directly references the first @a len
+     * characters of @a s, which is owned elsewhere.
+     * @param free_function called as @a free_function(@a s, @a len) when
+     *  the last String referencing @a s is destroyed, or null
+     *
+     * The String and its substrings share @a s without copying it.  Unlike
+     * make_stable(), the String never accesses @a s[@a len]; operations that
+     * need a terminating null character or modifiable data, such as c_str()
+     * and mutable_data(), work on a copy. */
+    static String make_external(const char *s, int len,
+				void (*free_function)(const char *, int));
+
 
     /** @brief Return the string's length. */
     inline int length() const {
@@ -254,12 +266,14 @@ class String { public:
      * pointer.  The returned pointer is semi-temporary; it will persist until
      * the string is destroyed or appended to. */
     inline const char *c_str() const {
-	// We may already have a '\0' in the right place.  If _memo has no
-	// capacity, then this is one of the special strings (null or
-	// stable). We are guaranteed, in these strings, that _data[_length]
-	// exists. Otherwise must check that _data[_length] exists.
+	// We may already have a '\0' in the right place.  If there is no
+	// _memo, then this is one of the special strings (null or stable).
+	// We are guaranteed, in these strings, that _data[_length] exists.
+	// External strings (_memo with no capacity) never touch
+	// _data[_length]. Otherwise must check that _data[_length] exists.
 	const char *end_data = _r.data + _r.length;
-	if ((_r.memo && end_data >= _r.memo->real_data + _r.memo->dirty)
+	if ((_r.memo && (!_r.memo->capacity
+			 || end_data >= _r.memo->real_data + _r.memo->dirty))
 	    || *end_data != '\0') {
 	    if (char *x = const_cast<String *>(this)->append_uninitialized(1)) {
 		*x = '\0';
@@ -563,7 +577,7 @@ class String { public:
 
     /** @brief Return true iff the String's data is shared or immutable. */
     inline bool data_shared() const {
-	return !_r.memo || _r.memo->refcount != 1;
+	return !_r.memo || _r.memo->refcount != 1 || !_r.memo->capacity;
     }
 
     /** @brief Return a compact version of this String.
@@ -630,6 +644,15 @@ class String { public:
 	MEMO_SPACE = sizeof(memo_t) - 8
     };
 
+    // A memo with zero capacity is an external_memo_t, whose data lives
+    // outside the memo.
+    struct external_memo_t {
+	memo_t memo;
+	const char *data;
+	int length;
+	void (*free_function)(const char *, int);
+    };
+
     struct rep_t {
 	const char *data;
 	int length;
@@ -43,6 +43,8 @@ class Transform { public:
     // Transform &operator*=(Transform &, double);
     // Transform operator*(Transform, const Transform &);
     // Transform &operator*=(Transform &, const Transform &);
+    // bool operator==(const Transform &, const Transform &);
+    // bool operator!=(const Transform &, const Transform &);
     friend Point operator*(const Point &, const Transform &);
     friend Point &operator*=(Point &, const Transform &);
     friend Bezier operator*(const Bezier &, const Transform &);
@@ -129,6 +131,21 @@ inline Transform operator*(Transform a, const Transform& b) {
     return a *= b;
 }
 
+inline bool
+operator==(const Transform &a, const Transform &b)
+{
+    for (int i = 0; i < 6; i++)
+	if (a[i] != b[i])
+	    return false;
+    return true;
+}
+
+inline bool
+operator!=(const Transform &a, const Transform &b)
+{
+    return !(a == b);
+}
+
 
 inline Point &
 operator*=(Point &p, const Transform &t)
@@ -149,6 +149,16 @@ static const char * const standard_strings[] = {
 };
 static PermString standard_permstrings[Cff::NSTANDARD_STRINGS];
 static HashMap<PermString, int> standard_permstrings_map(-1);
+static std::once_flag standard_permstrings_once;
+
+static void
+initialize_standard_permstrings()
+{
+    for (int i = 0; i < Cff::NSTANDARD_STRINGS; i++) {
+        standard_permstrings[i] = PermString(standard_strings[i]);
+        standard_permstrings_map.insert(standard_permstrings[i], i);
+    }
+}
 
 static const int standard_encoding[] = {
     // Automatically generated from Appendix B of the CFF specification; do
@@ -336,6 +346,30 @@ default_dict()
 
 #define POS_GT(pos1, pos2)      ((unsigned)(pos1) > (unsigned)(pos2))
 
+// Fills 'v' with a view of each charstring in 'iiter', reading the offset
+// array once. Empty charstrings get empty views.
+static void
+make_charstring_views(const Cff::IndexIterator &iiter, int type, Vector<CharstringView> &v)
+{
+    int n = iiter.nitems();
+    v.clear();
+    v.reserve(n);
+    if (n > 0) {
+        const uint8_t *s0 = iiter[0];
+        for (int i = 0; i < n; i++) {
+            const uint8_t *s1 = iiter[i + 1];
+            v.push_back(CharstringView(type, s0, s1 > s0 ? s1 - s0 : 0));
+            s0 = s1;
+        }
+    }
+}
+
+static inline Charstring *
+view_charstring(const Vector<CharstringView> &v, int i)
+{
+    return v[i].length() ? const_cast<CharstringView *>(&v[i]) : 0;
+}
+
 
 Cff::Cff(const String& s, unsigned units_per_em, ErrorHandler* errh)
     : _data_string(s), _data(reinterpret_cast<const uint8_t *>(_data_string.data())), _len(_data_string.length()),
@@ -352,8 +386,6 @@ Cff::Cff(const String& s, unsigned units_per_em, ErrorHandler* errh)
 
 Cff::~Cff()
 {
-    for (int i = 0; i < _gsubrs_cs.size(); i++)
-        delete _gsubrs_cs[i];
     for (int i = 0; i < _fonts.size(); ++i)
         delete _fonts[i];
 }
@@ -416,7 +448,7 @@ Cff::parse_header(ErrorHandler *errh)
     _gsubrs_index = IndexIterator(_data, global_subr_index_pos, _len, errh, "Gsubrs INDEX");
     if (_gsubrs_index.error() < 0)
         return _gsubrs_index.error();
-    _gsubrs_cs.assign(ngsubrs(), 0);
+    make_charstring_views(_gsubrs_index, 2, _gsubrs_cs);
 
     return 0;
 }
@@ -428,17 +460,13 @@ Cff::sid(PermString s)
         return -1;
 
     // check standard strings
-    if (standard_permstrings_map["a"] < 0)
-        for (int i = 0; i < NSTANDARD_STRINGS; i++) {
-            if (!standard_permstrings[i])
-                standard_permstrings[i] = PermString(standard_strings[i]);
-            standard_permstrings_map.insert(standard_permstrings[i], i);
-        }
+    std::call_once(standard_permstrings_once, initialize_standard_permstrings);
     int sid = standard_permstrings_map[s];
     if (sid >= 0)
         return sid;
 
     // check user strings
+    std::lock_guard<std::mutex> guard(_lock);
     sid = _strings_map[s];
     if (sid >= -1)
         return sid;
@@ -465,8 +493,6 @@ Cff::sid_string(int sid) const
         sid -= NSTANDARD_STRINGS;
         if (sid >= _strings.size())
             return String();
-        else if (_strings[sid])
-            return String(_strings[sid]);
         else
             return String(reinterpret_cast<const char *>(_strings_index[sid]), _strings_index[sid + 1] - _strings_index[sid]);
     }
@@ -478,14 +504,14 @@ Cff::sid_permstring(int sid) const
     if (sid < 0)
         return PermString();
     else if (sid < NSTANDARD_STRINGS) {
-        if (!standard_permstrings[sid])
-            standard_permstrings[sid] = PermString(standard_strings[sid]);
+        std::call_once(standard_permstrings_once, initialize_standard_permstrings);
         return standard_permstrings[sid];
     } else {
         sid -= NSTANDARD_STRINGS;
         if (sid >= _strings.size())
             return PermString();
-        else if (_strings[sid])
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_strings[sid])
             return _strings[sid];
         else {
             PermString s = PermString(reinterpret_cast<const char *>(_strings_index[sid]), _strings_index[sid + 1] - _strings_index[sid]);
@@ -560,16 +586,7 @@ Cff::gsubr(int i)
     i += subr_bias(2, ngsubrs());
     if (i < 0 || i >= ngsubrs())
         return 0;
-    if (!_gsubrs_cs[i]) {
-        const uint8_t *s1 = _gsubrs_index[i];
-        int slen = _gsubrs_index[i + 1] - s1;
-        String cs = data_string().substring(s1 - data(), slen);
-        if (slen == 0)
-            return 0;
-        else
-            _gsubrs_cs[i] = new Type2Charstring(cs);
-    }
-    return _gsubrs_cs[i];
+    return view_charstring(_gsubrs_cs, i);
 }
 
 
@@ -1169,8 +1186,7 @@ Cff::Dict::unparse(ErrorHandler *errh, const char *dict_name) const
 static int
 handle_private(Cff *cff, const Cff::Dict &top_dict, Cff::Dict &private_dict,
                double &default_width_x, double &nominal_width_x,
-               Cff::IndexIterator &subrs_index, Vector<Charstring *> &subrs_cs,
-               ErrorHandler *errh)
+               Cff::IndexIterator &subrs_index, ErrorHandler *errh)
 {
     Vector<double> private_info;
     top_dict.value(Cff::oPrivate, private_info);
@@ -1191,7 +1207,6 @@ handle_private(Cff *cff, const Cff::Dict &top_dict, Cff::Dict &private_dict,
         if (subrs_index.error() < 0)
             return subrs_index.error();
     }
-    subrs_cs.assign(subrs_index.nitems(), 0);
     return 0;
 }
 
@@ -1201,18 +1216,10 @@ Cff::FontParent::FontParent(Cff* cff)
 {
 }
 
-Charstring *
-Cff::FontParent::charstring(const IndexIterator &iiter, int which) const
+void
+Cff::FontParent::make_charstrings(const IndexIterator &iiter, Vector<CharstringView> &v) const
 {
-    const uint8_t *s1 = iiter[which];
-    int slen = iiter[which + 1] - s1;
-    String cs = _cff->data_string().substring(s1 - _cff->data(), slen);
-    if (slen == 0)
-        return 0;
-    else if (_charstring_type == 1)
-        return new Type1Charstring(cs);
-    else
-        return new Type2Charstring(cs);
+    make_charstring_views(iiter, _charstring_type, v);
 }
 
 Charstring *
@@ -1249,7 +1256,7 @@ Cff::Font::Font(Cff *cff, PermString font_name, const Dict &top_dict, ErrorHandl
         _error = _charstrings_index.error();
         return;
     }
-    _charstrings_cs.assign(_charstrings_index.nitems(), 0);
+    make_charstrings(_charstrings_index, _charstrings_cs);
 
     int charset = 0;
     _top_dict.xvalue(oCharset, &charset);
@@ -1270,8 +1277,6 @@ Cff::Font::Font(Cff *cff, PermString font_name, const Dict &top_dict, ErrorHandl
 
 Cff::Font::~Font()
 {
-    for (int i = 0; i < _charstrings_cs.size(); i++)
-        delete _charstrings_cs[i];
     delete _t1encoding;
 }
 
@@ -1397,9 +1402,7 @@ Cff::Font::glyph(int gid) const
 {
     if (gid < 0 || gid >= nglyphs())
         return 0;
-    if (!_charstrings_cs[gid])
-        _charstrings_cs[gid] = charstring(_charstrings_index, gid);
-    return _charstrings_cs[gid];
+    return view_charstring(_charstrings_cs, gid);
 }
 
 Charstring *
@@ -1408,9 +1411,7 @@ Cff::Font::glyph(PermString name) const
     int gid = _charset.sid_to_gid(_cff->sid(name));
     if (gid < 0)
         return 0;
-    if (!_charstrings_cs[gid])
-        _charstrings_cs[gid] = charstring(_charstrings_index, gid);
-    return _charstrings_cs[gid];
+    return view_charstring(_charstrings_cs, gid);
 }
 
 int
@@ -1492,7 +1493,7 @@ Cff::CIDFont::CIDFont(Cff *cff, PermString font_name, const Dict &top_dict, Erro
         _error = _charstrings_index.error();
         return;
     }
-    _charstrings_cs.assign(_charstrings_index.nitems(), 0);
+    make_charstrings(_charstrings_index, _charstrings_cs);
 
     int charset = 0;
     _top_dict.value(oCharset, &charset);
@@ -1536,8 +1537,6 @@ Cff::CIDFont::CIDFont(Cff *cff, PermString font_name, const Dict &top_dict, Erro
 
 Cff::CIDFont::~CIDFont()
 {
-    for (int i = 0; i < _charstrings_cs.size(); i++)
-        delete _charstrings_cs[i];
     for (int i = 0; i < _child_fonts.size(); i++)
         delete _child_fonts[i];
 }
@@ -1582,9 +1581,7 @@ Cff::CIDFont::glyph(int gid) const
 {
     if (gid < 0 || gid >= nglyphs())
         return 0;
-    if (!_charstrings_cs[gid])
-        _charstrings_cs[gid] = charstring(_charstrings_index, gid);
-    return _charstrings_cs[gid];
+    return view_charstring(_charstrings_cs, gid);
 }
 
 int
@@ -1632,8 +1629,9 @@ Cff::ChildFont::ChildFont(Cff *cff, Cff::CIDFont *parent, int charstring_type, c
 
     // extract information from Private DICT
     if (_top_dict.has(oPrivate)
-        && (_error = handle_private(cff, _top_dict, _private_dict, _default_width_x, _nominal_width_x, _subrs_index, _subrs_cs, errh)) < 0)
+        && (_error = handle_private(cff, _top_dict, _private_dict, _default_width_x, _nominal_width_x, _subrs_index, errh)) < 0)
         return;
+    make_charstrings(_subrs_index, _subrs_cs);
 
     // success!
     _error = 0;
@@ -1641,22 +1639,6 @@ Cff::ChildFont::ChildFont(Cff *cff, Cff::CIDFont *parent, int charstring_type, c
 
 Cff::ChildFont::~ChildFont()
 {
-    for (int i = 0; i < _subrs_cs.size(); i++)
-        delete _subrs_cs[i];
-}
-
-Charstring *
-Cff::ChildFont::charstring(const IndexIterator &iiter, int which) const
-{
-    const uint8_t *s1 = iiter[which];
-    int slen = iiter[which + 1] - s1;
-    String cs = _cff->data_string().substring(s1 - _cff->data(), slen);
-    if (slen == 0)
-        return 0;
-    else if (_charstring_type == 1)
-        return new Type1Charstring(cs);
-    else
-        return new Type2Charstring(cs);
 }
 
 Charstring *
@@ -1665,9 +1647,7 @@ Cff::ChildFont::subr(int i) const
     i += Efont::subr_bias(_charstring_type, nsubrs_x());
     if (i < 0 || i >= nsubrs_x())
         return 0;
-    if (!_subrs_cs[i])
-        _subrs_cs[i] = charstring(_subrs_index, i);
-    return _subrs_cs[i];
+    return view_charstring(_subrs_cs, i);
 }
 
 int
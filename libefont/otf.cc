@@ -19,6 +19,7 @@
 #include <efont/otf.hh>
 #include <lcdf/error.hh>
 #include <lcdf/straccum.hh>
+#include <lcdf/hashmap.hh>
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,31 +33,74 @@ namespace Efont { namespace OpenType {
 Vector<PermString> debug_glyph_names;
 
 Font::Font(const String& s, ErrorHandler* errh)
-    : _str(s), _units_per_em(0) {
+    : _str(s), _face(0), _dir(0), _units_per_em(0) {
     _str.align(4);
     _error = parse_header(errh ? errh : ErrorHandler::silent_handler());
 }
 
+Font::Font(const String& s, int face, ErrorHandler* errh)
+    : _str(s), _face(face), _dir(0), _units_per_em(0) {
+    _str.align(4);
+    _error = parse_header(errh ? errh : ErrorHandler::silent_handler());
+}
+
+static bool
+is_collection(const uint8_t *data, int len)
+{
+    return len >= Font::HEADER_SIZE
+        && data[0] == 't' && data[1] == 't' && data[2] == 'c' && data[3] == 'f';
+}
+
+int
+Font::nfaces(const String &str)
+{
+    // COLLECTION HEADER FORMAT:
+    // Tag      'ttcf'
+    // Fixed    version
+    // ULONG    numFonts
+    // ULONG    offsetTable[numFonts]
+    const uint8_t *data = str.udata();
+    if (!is_collection(data, str.length()))
+        return 1;
+    uint32_t n = Data::u32(data + 8);
+    uint32_t max_n = (str.length() - HEADER_SIZE) / 4;
+    return (n < max_n ? n : max_n);
+}
+
 int
 Font::parse_header(ErrorHandler *errh)
 {
+    int len = length();
+    const uint8_t *data = this->data();
+    if (HEADER_SIZE > len)
+        return errh->error("OTF file corrupted (too small)"), -EFAULT;
+
+    // find this face's table directory in a collection; table offsets are
+    // relative to the start of the collection, so faces can share tables
+    if (is_collection(data, len)) {
+        int n = nfaces(_str);
+        if (_face < 0 || _face >= n)
+            return errh->error("face %d out of range (collection has %d faces)", _face, n), -ENOENT;
+        _dir = Data::u32_aligned(data + HEADER_SIZE + 4 * _face);
+        if (_dir % 4 != 0 || _dir > (uint32_t) len - HEADER_SIZE)
+            return errh->error("collection directory for face %d out of range", _face), -EFAULT;
+        data += _dir;
+    } else if (_face != 0)
+        return errh->error("face %d out of range (not a font collection)", _face), -ENOENT;
+
     // HEADER FORMAT:
     // Fixed    sfnt version
     // USHORT   numTables
     // USHORT   searchRange
     // USHORT   entrySelector
     // USHORT   rangeShift
-    int len = length();
-    const uint8_t *data = this->data();
-    if (HEADER_SIZE > len)
-        return errh->error("OTF file corrupted (too small)"), -EFAULT;
     if ((data[0] != 'O' || data[1] != 'T' || data[2] != 'T' || data[3] != 'O')
         && (data[0] != '\000' || data[1] != '\001'))
         return errh->error("not an OpenType font (bad magic number)"), -ERANGE;
     int ntables = Data::u16_aligned(data + 4);
     if (ntables == 0)
         return errh->error("OTF contains no tables"), -EINVAL;
-    if (HEADER_SIZE + TABLE_DIR_ENTRY_SIZE * ntables > len)
+    if (_dir + HEADER_SIZE + TABLE_DIR_ENTRY_SIZE * ntables > (uint32_t) len)
         return errh->error("OTF table directory out of range"), -EFAULT;
 
     // TABLE DIRECTORY ENTRY FORMAT:
@@ -92,7 +136,7 @@ Font::check_checksums(ErrorHandler *errh) const
     int nt = ntables();
     bool ok = true;
     for (int i = 0; i < nt; i++) {
-        const uint8_t *entry = data() + HEADER_SIZE + TABLE_DIR_ENTRY_SIZE * i;
+        const uint8_t *entry = directory() + HEADER_SIZE + TABLE_DIR_ENTRY_SIZE * i;
         String tbl = _str.substring(Data::u32_aligned(entry + 8),
                                     Data::u32_aligned(entry + 12));
         uint32_t sum = checksum(tbl);
@@ -114,7 +158,7 @@ Font::ntables() const
     if (error() < 0)
         return 0;
     else
-        return Data::u16_aligned(data() + 4);
+        return Data::u16_aligned(directory() + 4);
 }
 
 String
@@ -122,7 +166,7 @@ Font::table(Tag tag) const
 {
     if (error() < 0)
         return String();
-    const uint8_t *entry = tag.table_entry(data() + HEADER_SIZE, Data::u16_aligned(data() + 4), TABLE_DIR_ENTRY_SIZE);
+    const uint8_t *entry = tag.table_entry(directory() + HEADER_SIZE, Data::u16_aligned(directory() + 4), TABLE_DIR_ENTRY_SIZE);
     if (entry)
         return _str.substring(Data::u32_aligned(entry + 8), Data::u32_aligned(entry + 12));
     else
@@ -134,7 +178,7 @@ Font::has_table(Tag tag) const
 {
     const uint8_t *entry = 0;
     if (error() >= 0)
-        entry = tag.table_entry(data() + HEADER_SIZE, Data::u16_aligned(data() + 4), TABLE_DIR_ENTRY_SIZE);
+        entry = tag.table_entry(directory() + HEADER_SIZE, Data::u16_aligned(directory() + 4), TABLE_DIR_ENTRY_SIZE);
     return entry != 0;
 }
 
@@ -143,7 +187,7 @@ Font::table_checksum(Tag tag) const
 {
     if (error() < 0)
         return 0;
-    const uint8_t *entry = tag.table_entry(data() + HEADER_SIZE, Data::u16_aligned(data() + 4), TABLE_DIR_ENTRY_SIZE);
+    const uint8_t *entry = tag.table_entry(directory() + HEADER_SIZE, Data::u16_aligned(directory() + 4), TABLE_DIR_ENTRY_SIZE);
     if (entry)
         return Data::u32_aligned(entry + 4);
     else
@@ -156,7 +200,7 @@ Font::table_tag(int i) const
     if (error() < 0 || i < 0 || i >= ntables())
         return Tag();
     else
-        return Tag(Data::u32_aligned(data() + HEADER_SIZE + TABLE_DIR_ENTRY_SIZE * i));
+        return Tag(Data::u32_aligned(directory() + HEADER_SIZE + TABLE_DIR_ENTRY_SIZE * i));
 }
 
 uint32_t
@@ -790,6 +834,34 @@ Coverage::Coverage(const Vector<bool> &gmap) noexcept
     }
 }
 
+Coverage::Coverage(const GlyphSet &gs) noexcept
+{
+    int end = 0;
+    for (int i = GlyphSet::VLEN - 1; i >= 0 && !end; --i)
+        if (const uint32_t *u = gs._v[i])
+            for (int j = GlyphSet::VULEN - 1; j >= 0 && !end; --j)
+                if (uint32_t w = u[j])
+                    for (int k = 31; k >= 0 && !end; --k)
+                        if (w & (1U << k))
+                            end = (i << GlyphSet::SHIFT) + (j << 5) + k + 1;
+    if (end > 0) {
+        _str = String::make_uninitialized(8 + end);
+        _str.align(4);
+        uint8_t *data = _str.mutable_udata();
+        memset(data, 0, 8 + end);
+        data[1] = 3;
+
+        uint32_t n = 0;
+        for (Glyph g = gs.next(0); g >= 0; g = gs.next(g + 1)) {
+            data[8 + g] = 1;
+            ++n;
+        }
+
+        n = htonl(n);
+        memcpy(_str.mutable_udata() + 4, &n, 4);
+    }
+}
+
 Coverage::Coverage(const String &str, ErrorHandler *errh, bool do_check) noexcept
     : _str(str)
 {
@@ -1231,6 +1303,131 @@ GlyphSet::operator=(const GlyphSet &o)
     return *this;
 }
 
+GlyphSet::GlyphSet(const Coverage &c)
+{
+    memset(_v, 0, sizeof(_v));
+    for (Coverage::iterator it = c.begin(); it; ++it)
+        insert(*it);
+}
+
+void
+GlyphSet::clear()
+{
+    for (int i = 0; i < VLEN; i++)
+        if (_v[i])
+            memset(_v[i], 0, sizeof(uint32_t) * VULEN);
+}
+
+int
+GlyphSet::size() const
+{
+    int n = 0;
+    for (int i = 0; i < VLEN; i++)
+        if (const uint32_t *u = _v[i])
+            for (int j = 0; j < VULEN; j++)
+                n += popcount32(u[j]);
+    return n;
+}
+
+static inline int
+ctz32(uint32_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(x);
+#else
+    int n = 0;
+    for (; !(x & 1); x >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+Glyph
+GlyphSet::next(Glyph g) const
+{
+    if (g < 0)
+        g = 0;
+    for (int i = g >> SHIFT; i < VLEN; i++, g = i << SHIFT)
+        if (const uint32_t *u = _v[i])
+            for (int j = (g & MASK) >> 5; j < VULEN; j++) {
+                uint32_t w = u[j];
+                if (j == ((g & MASK) >> 5))
+                    w &= ~0U << (g & 0x1F);
+                if (w)
+                    return (i << SHIFT) + (j << 5) + ctz32(w);
+            }
+    return -1;
+}
+
+// The set operations work a word at a time over each page; the loops are
+// simple enough for compilers to vectorize.
+
+GlyphSet &
+GlyphSet::operator|=(const GlyphSet &o)
+{
+    for (int i = 0; i < VLEN; i++)
+        if (const uint32_t *ou = o._v[i]) {
+            if (!_v[i]) {
+                _v[i] = new uint32_t[VULEN];
+                memcpy(_v[i], ou, sizeof(uint32_t) * VULEN);
+            } else {
+                uint32_t *u = _v[i];
+                for (int j = 0; j < VULEN; j++)
+                    u[j] |= ou[j];
+            }
+        }
+    return *this;
+}
+
+GlyphSet &
+GlyphSet::operator&=(const GlyphSet &o)
+{
+    for (int i = 0; i < VLEN; i++)
+        if (uint32_t *u = _v[i]) {
+            if (const uint32_t *ou = o._v[i]) {
+                for (int j = 0; j < VULEN; j++)
+                    u[j] &= ou[j];
+            } else
+                memset(u, 0, sizeof(uint32_t) * VULEN);
+        }
+    return *this;
+}
+
+GlyphSet &
+GlyphSet::operator-=(const GlyphSet &o)
+{
+    for (int i = 0; i < VLEN; i++)
+        if (uint32_t *u = _v[i])
+            if (const uint32_t *ou = o._v[i])
+                for (int j = 0; j < VULEN; j++)
+                    u[j] &= ~ou[j];
+    return *this;
+}
+
+bool
+GlyphSet::intersects(const GlyphSet &o) const
+{
+    for (int i = 0; i < VLEN; i++)
+        if (const uint32_t *u = _v[i])
+            if (const uint32_t *ou = o._v[i])
+                for (int j = 0; j < VULEN; j++)
+                    if (u[j] & ou[j])
+                        return true;
+    return false;
+}
+
+bool
+GlyphSet::operator==(const GlyphSet &o) const
+{
+    for (int i = 0; i < VLEN; i++) {
+        const uint32_t *u = _v[i], *ou = o._v[i];
+        for (int j = 0; j < VULEN; j++)
+            if ((u ? u[j] : 0) != (ou ? ou[j] : 0))
+                return false;
+    }
+    return true;
+}
+
 
 /**************************
  * ClassDef               *
@@ -1484,6 +1681,134 @@ ClassDef::class_iterator::operator++(int)
 }
 
 
+/**************************
+ * CompiledCoverage       *
+ *                        *
+ **************************/
+
+CompiledCoverage::CompiledCoverage(const Coverage &c)
+    : _raw(c), _use_raw(true), _first(0), _n(0)
+{
+    // byte maps are already fast; other tables compile only if sorted
+    // and indexed by rank, so that lookups match the raw table's
+    const uint8_t *data = c._str.udata();
+    if (!c.ok() || (data[1] != Coverage::T_LIST && data[1] != Coverage::T_RANGES))
+        return;
+    Vector<Glyph> gs;
+    for (Coverage::iterator it = c.begin(); it; ++it) {
+        if ((gs.size() && *it <= gs.back()) || it.coverage_index() != gs.size())
+            return;
+        gs.push_back(*it);
+    }
+    if (!gs.size())
+        return;
+
+    _first = gs[0];
+    _n = gs.back() - _first + 1;
+    _bits.assign((_n + 31) >> 5, 0);
+    _rank.assign(_bits.size(), 0);
+    for (Glyph *it = gs.begin(); it != gs.end(); ++it) {
+        uint32_t x = *it - _first;
+        _bits[x >> 5] |= 1U << (x & 31);
+    }
+    for (int i = 1; i < _bits.size(); ++i)
+        _rank[i] = _rank[i - 1] + popcount32(_bits[i - 1]);
+    _use_raw = false;
+}
+
+
+/**************************
+ * CompiledClassDef       *
+ *                        *
+ **************************/
+
+CompiledClassDef::CompiledClassDef(const ClassDef &cd)
+    : _raw(cd), _use_raw(true), _npages(0)
+{
+    if (!cd.ok())
+        return;
+
+    // collect (first, last, class) ranges
+    const uint8_t *data = cd._str.udata();
+    Vector<int> ranges;
+    if (Data::u16_aligned(data) == ClassDef::T_LIST) {
+        Glyph start = Data::u16_aligned(data + 2);
+        int count = Data::u16_aligned(data + 4);
+        data += ClassDef::LIST_HEADERSIZE;
+        for (int i = 0; i < count; ++i, data += ClassDef::LIST_RECSIZE)
+            if (int c = Data::u16_aligned(data)) {
+                ranges.push_back(start + i);
+                ranges.push_back(start + i);
+                ranges.push_back(c);
+            }
+    } else {
+        int count = Data::u16_aligned(data + 2);
+        data += ClassDef::RANGES_HEADERSIZE;
+        for (int i = 0; i < count; ++i, data += ClassDef::RANGES_RECSIZE) {
+            Glyph first = Data::u16_aligned(data);
+            Glyph last = Data::u16_aligned(data + 2);
+            // the raw lookup binary searches, so require sorted ranges
+            if (last < first || (ranges.size() && first <= ranges[ranges.size() - 2]))
+                return;
+            ranges.push_back(first);
+            ranges.push_back(last);
+            ranges.push_back(Data::u16_aligned(data + 4));
+        }
+    }
+
+    _npages = ranges.size() ? (ranges[ranges.size() - 2] >> 8) + 1 : 0;
+    _page_map.assign(_npages, 0);
+    _classes.assign(256, 0);
+    for (int *it = ranges.begin(); it != ranges.end(); it += 3)
+        if (it[2] != 0)
+            for (Glyph g = it[0]; g <= it[1]; ++g) {
+                uint16_t &p = _page_map[g >> 8];
+                if (!p) {
+                    p = _classes.size() >> 8;
+                    _classes.resize(_classes.size() + 256, 0);
+                }
+                _classes[(p << 8) + (g & 255)] = it[2];
+            }
+    _use_raw = false;
+}
+
+
+/**************************
+ * CompiledTables         *
+ *                        *
+ **************************/
+
+CompiledTables::CompiledTables()
+    : _coverages(0), _class_defs(0)
+{
+}
+
+CompiledTables::~CompiledTables()
+{
+    for (HashMap<uintptr_t, CompiledCoverage *>::iterator it = _coverages.begin(); it; ++it)
+        delete it.value();
+    for (HashMap<uintptr_t, CompiledClassDef *>::iterator it = _class_defs.begin(); it; ++it)
+        delete it.value();
+}
+
+const CompiledCoverage *
+CompiledTables::coverage(const Coverage &c) const
+{
+    CompiledCoverage *&cc = _coverages.find_force(reinterpret_cast<uintptr_t>(c._str.data()));
+    if (!cc)
+        cc = new CompiledCoverage(c);
+    return cc;
+}
+
+const CompiledClassDef *
+CompiledTables::class_def(const ClassDef &cd) const
+{
+    CompiledClassDef *&ccd = _class_defs.find_force(reinterpret_cast<uintptr_t>(cd._str.data()));
+    if (!ccd)
+        ccd = new CompiledClassDef(cd);
+    return ccd;
+}
+
 }}
 
 
@@ -18,6 +18,7 @@
 #endif
 #include <efont/otfcmap.hh>
 #include <lcdf/error.hh>
+#include <algorithm>
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,7 +32,7 @@
 namespace Efont { namespace OpenType {
 
 Cmap::Cmap(const String &s, ErrorHandler *errh)
-    : _str(s)
+    : _str(s), _compiled(false), _compiled_table(-1)
 {
     _str.align(4);
     _error = parse_header(errh ? errh : ErrorHandler::silent_handler());
@@ -373,7 +374,7 @@ Cmap::dump_table(int t, Vector<std::pair<uint32_t, Glyph> > &ugp, ErrorHandler *
     case F_HIBYTE:
         assert(USHORT_AT(data + 6) == 0);
         for (int hi_byte = 0; hi_byte < 256; hi_byte++) {
-            int subh = USHORT_AT(data + 6 + hi_byte * 4);
+            int subh = USHORT_AT(data + 6 + hi_byte * 2);
             if (subh == 0 && hi_byte > 0)
                 continue;
             const uint8_t *tdata = data + 524 + subh;
@@ -402,7 +403,9 @@ Cmap::dump_table(int t, Vector<std::pair<uint32_t, Glyph> > &ugp, ErrorHandler *
             uint32_t startCount = USHORT_AT(startCounts + i);
             int idDelta = SHORT_AT(idDeltas + i);
             int idRangeOffset = USHORT_AT(idRangeOffsets + i);
-            if (idRangeOffset == 0) {
+            if (idRangeOffset == 65535)
+                continue;
+            else if (idRangeOffset == 0) {
                 for (uint32_t u = startCount; u <= endCount; ++u) {
                     Glyph g = (u + idDelta) & 65535;
                     ugp.push_back(std::make_pair(u, g));
@@ -433,7 +436,13 @@ Cmap::dump_table(int t, Vector<std::pair<uint32_t, Glyph> > &ugp, ErrorHandler *
         const uint8_t *groups = data + 16;
         for (uint32_t i = 0; i < nGroups; i++, groups += 12) {
             uint32_t startCharCode = ULONG_AT2(groups);
-            uint32_t nCharCodes = ULONG_AT2(groups + 4) - startCharCode;
+            uint32_t endCharCode = ULONG_AT2(groups + 4);
+            // ignore groups beyond Unicode, which can be enormous
+            if (endCharCode >= (uint32_t) NPLANES << 16)
+                endCharCode = (NPLANES << 16) - 1;
+            if (startCharCode > endCharCode)
+                continue;
+            uint32_t nCharCodes = endCharCode - startCharCode;
             Glyph startGlyphID = ULONG_AT2(groups + 8);
             for (uint32_t i = 0; i <= nCharCodes; i++)
                 ugp.push_back(std::make_pair(startCharCode + i, startGlyphID + i));
@@ -447,16 +456,100 @@ Cmap::dump_table(int t, Vector<std::pair<uint32_t, Glyph> > &ugp, ErrorHandler *
     }
 }
 
+void
+Cmap::compile() const
+{
+    _compiled = true;
+    _compiled_table = check_table(USE_FIRST_UNICODE_TABLE, ErrorHandler::default_handler());
+    memset(_plane_map, 0, sizeof(_plane_map));
+    _page_map.assign(256, 0);
+    _glyphs.assign(256, 0);
+    _unis_pos.clear();
+    _unis.clear();
+    if (_compiled_table < 0)
+        return;
+
+    Vector<std::pair<uint32_t, Glyph> > ugp;
+    dump_table(_compiled_table, ugp);
+
+    Vector<std::pair<Glyph, uint32_t> > gup;
+    Vector<uint32_t> ambiguous;
+    for (std::pair<uint32_t, Glyph> *it = ugp.begin(); it != ugp.end(); ++it) {
+        uint32_t u = it->first;
+        if (it->second <= 0 || u >= (uint32_t) NPLANES << 16)
+            continue;
+        uint16_t &pm = _plane_map[u >> 16];
+        if (!pm) {
+            pm = _page_map.size() >> 8;
+            _page_map.resize(_page_map.size() + 256, 0);
+        }
+        uint16_t &p = _page_map[(pm << 8) + ((u >> 8) & 255)];
+        if (!p) {
+            p = _glyphs.size() >> 8;
+            _glyphs.resize(_glyphs.size() + 256, 0);
+        }
+        Glyph &g = _glyphs[(p << 8) + (u & 255)];
+        if (!g) {
+            g = it->second;
+            gup.push_back(std::make_pair(g, u));
+        } else
+            ambiguous.push_back(u);
+    }
+
+    // leave code points with several mappings out of the reverse map
+    if (ambiguous.size()) {
+        std::sort(ambiguous.begin(), ambiguous.end());
+        std::pair<Glyph, uint32_t> *out = gup.begin();
+        for (std::pair<Glyph, uint32_t> *it = gup.begin(); it != gup.end(); ++it)
+            if (!std::binary_search(ambiguous.begin(), ambiguous.end(), it->second))
+                *out++ = *it;
+        gup.erase(out, gup.end());
+    }
+
+    std::sort(gup.begin(), gup.end());
+    int nglyphs = gup.size() ? gup.back().first + 1 : 0;
+    _unis_pos.assign(nglyphs + 1, 0);
+    _unis.reserve(gup.size());
+    for (std::pair<Glyph, uint32_t> *it = gup.begin(); it != gup.end(); ++it) {
+        _unis_pos[it->first + 1]++;
+        _unis.push_back(it->second);
+    }
+    for (int g = 0; g < nglyphs; ++g)
+        _unis_pos[g + 1] += _unis_pos[g];
+}
+
 int
-Cmap::map_uni(const Vector<uint32_t> &vin, Vector<Glyph> &vout) const
+Cmap::map_uni(const uint32_t *in, int n, Glyph *out) const
 {
-    int t;
-    if ((t = check_table(USE_FIRST_UNICODE_TABLE)) < 0)
+    if (!_compiled)
+        compile();
+    if (_compiled_table < 0)
         return -1;
-    vout.resize(vin.size(), 0);
-    for (int i = 0; i < vin.size(); i++)
-        vout[i] = map_table(t, vin[i]);
+    for (const uint32_t *end = in + n; in != end; ++in, ++out)
+        if (*in < (uint32_t) NPLANES << 16)
+            *out = map_compiled(*in);
+        else
+            *out = map_table(_compiled_table, *in);
     return 0;
 }
 
+int
+Cmap::map_uni(const Vector<uint32_t> &vin, Vector<Glyph> &vout) const
+{
+    vout.resize(vin.size(), 0);
+    return map_uni(vin.begin(), vin.size(), vout.begin());
+}
+
+int
+Cmap::unmap(Glyph g, Vector<uint32_t> &us) const
+{
+    if (!_compiled)
+        compile();
+    if (g < 0 || g + 1 >= _unis_pos.size())
+        return 0;
+    for (int i = _unis_pos[g]; i != _unis_pos[g + 1]; ++i)
+        us.push_back(_unis[i]);
+    return _unis_pos[g + 1] - _unis_pos[g];
+}
+
 }}
@@ -0,0 +1,71 @@
+// -*- related-file-name: "../include/efont/otfgdef.hh" -*-
+
+/* otfgdef.{cc,hh} -- OpenType GDEF table
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <efont/otfgdef.hh>
+#include <lcdf/error.hh>
+
+namespace Efont { namespace OpenType {
+
+Gdef::Gdef(const Data &d, ErrorHandler *errh)
+    : _glyph_classes(class_def(d, 4)), _mark_classes(class_def(d, 10))
+{
+    // Fixed    Version
+    // Offset   GlyphClassDef
+    // Offset   AttachList
+    // Offset   LigCaretList
+    // Offset   MarkAttachClassDef
+    // Offset   MarkGlyphSetsDef        (version 1.2)
+    if (d.length() == 0)
+        throw BlankTable("GDEF");
+    if (d.length() < HEADERSIZE || d.u16(0) != 1)
+        throw Format("GDEF");
+    if (d.u16(2) >= 2 && d.length() >= HEADERSIZE + 2 && d.u16(12) != 0) {
+        Data marksets = d.offset_subtable(12);
+        if (marksets.u16(0) != 1)
+            throw Format("GDEF mark glyph sets");
+        int nsets = marksets.u16(2);
+        for (int i = 0; i < nsets; i++) {
+            uint32_t offset = marksets.u32(MARKSETS_HEADERSIZE + i*MARKSETS_RECSIZE);
+            Coverage c(marksets.subtable(offset), errh);
+            if (!c.ok())
+                throw Format("GDEF mark glyph set coverage");
+            _mark_sets.push_back(c);
+        }
+    }
+}
+
+ClassDef
+Gdef::class_def(const Data &d, int offset_offset)
+{
+    // a missing class definition table puts every glyph in class 0
+    if (d.length() < HEADERSIZE || d.u16(offset_offset) == 0)
+        return ClassDef(String());
+    else
+        return ClassDef(d.offset_subtable(offset_offset));
+}
+
+bool
+Gdef::mark_set_covers(int set, Glyph g) const
+{
+    return set >= 0 && set < _mark_sets.size() && _mark_sets[set].covers(g);
+}
+
+}}
+
+// template instantiations
+#include <lcdf/vector.cc>
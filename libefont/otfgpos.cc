@@ -49,6 +49,12 @@ Gpos::Gpos(const Data &d, ErrorHandler *errh)
     _lookup_list = d.offset_subtable(8);
 }
 
+Gpos::~Gpos()
+{
+    for (GlyphSet **gs = _lookup_glyphs.begin(); gs != _lookup_glyphs.end(); ++gs)
+        delete *gs;
+}
+
 int
 Gpos::nlookups() const
 {
@@ -61,7 +67,25 @@ Gpos::lookup(unsigned i) const
     if (i >= _lookup_list.u16(0))
         throw Error("GPOS lookup out of range");
     else
-        return GposLookup(_lookup_list.offset_subtable(2 + i*2));
+        return GposLookup(_lookup_list.offset_subtable(2 + i*2), &_compiled);
+}
+
+const GlyphSet &
+Gpos::lookup_glyphs(unsigned i) const
+{
+    if (i >= (unsigned) _lookup_glyphs.size())
+        _lookup_glyphs.resize(i + 1, 0);
+    GlyphSet *&gs = _lookup_glyphs[i];
+    if (!gs) {
+        gs = new GlyphSet;
+        try {
+            lookup(i).mark_first_glyphs(*gs);
+        } catch (Error) {
+            // can't tell; the lookup might apply anywhere
+            *gs |= GlyphSet(Coverage(0, 0xFFFF));
+        }
+    }
+    return *gs;
 }
 
 
@@ -79,8 +103,8 @@ const int GposValue::nibble_bitcount_x2[] = { 0, 2, 2, 4, 2, 4, 4, 6,
  *                        *
  **************************/
 
-GposLookup::GposLookup(const Data &d)
-    : _d(d)
+GposLookup::GposLookup(const Data &d, const CompiledTables *compiled)
+    : _d(d), _compiled(compiled)
 {
     if (_d.length() < 6)
         throw Format("GPOS Lookup table");
@@ -105,16 +129,82 @@ GposLookup::subtable(int i) const
         return Data();
 }
 
+static Coverage
+first_coverage(int type, const Data &d)
+{
+    // Context format 3: u16 format, u16 nglyph, u16 npos, offset coverage[]
+    // ChainContext format 3: u16 format, u16 nbacktrack, offset backtrack[],
+    //   u16 ninput, offset input[], ...
+    if (type == GposLookup::L_CONTEXT && d.u16(0) == 3)
+        return Coverage(d.offset_subtable(6));
+    else if (type == GposLookup::L_CHAIN && d.u16(0) == 3)
+        return Coverage(d.offset_subtable(6 + d.u16(2)*2));
+    else
+        return Coverage(d.offset_subtable(2));
+}
+
+// Adds to 'gs' every glyph at which the lookup can start to match.
+void
+GposLookup::mark_first_glyphs(GlyphSet &gs) const
+{
+    int nlookup = _d.u16(4);
+    for (int i = 0; i < nlookup; i++) {
+        Coverage c = first_coverage(_type, subtable(i));
+        if (!c.ok())
+            throw Format("GPOS coverage");
+        for (Coverage::iterator it = c.begin(); it; ++it)
+            gs.insert(*it);
+    }
+}
+
+namespace {
+class PositioningAccum : public PositioningVisitor { public:
+    PositioningAccum(Vector<Positioning> &v) : _v(v) { }
+    bool visit(const Positioning &p) { _v.push_back(p); return true; }
+  private:
+    Vector<Positioning> &_v;
+};
+}
+
 bool
 GposLookup::unparse_automatics(Vector<Positioning> &v, ErrorHandler *errh) const
+{
+    PositioningAccum accum(v);
+    return unparse(accum, 0, errh);
+}
+
+bool
+GposLookup::unparse_automatics(Vector<Positioning> &v, const Coverage &limit, ErrorHandler *errh) const
+{
+    PositioningAccum accum(v);
+    return unparse(accum, &limit, errh);
+}
+
+bool
+GposLookup::unparse_automatics(PositioningVisitor &v, ErrorHandler *errh) const
+{
+    return unparse(v, 0, errh);
+}
+
+bool
+GposLookup::unparse_automatics(PositioningVisitor &v, const Coverage &limit, ErrorHandler *errh) const
+{
+    return unparse(v, &limit, errh);
+}
+
+bool
+GposLookup::unparse(PositioningVisitor &v, const Coverage *limit, ErrorHandler *errh) const
 {
     int nlookup = _d.u16(4), success = 0;
     switch (_type) {
       case L_SINGLE:
-        for (int i = 0; i < nlookup; i++)
+        for (int i = 0; i < nlookup && !v.stopped(); i++)
             try {
-                GposSingle s(subtable(i));
-                s.unparse(v);
+                GposSingle s(subtable(i), _compiled);
+                if (limit)
+                    s.unparse(v, *limit);
+                else
+                    s.unparse(v);
                 success++;
             } catch (Error e) {
                 if (errh)
@@ -122,10 +212,13 @@ GposLookup::unparse_automatics(Vector<Positioning> &v, ErrorHandler *errh) const
             }
         return success > 0;
       case L_PAIR:
-        for (int i = 0; i < nlookup; i++)
+        for (int i = 0; i < nlookup && !v.stopped(); i++)
             try {
-                GposPair p(subtable(i));
-                p.unparse(v);
+                GposPair p(subtable(i), _compiled);
+                if (limit)
+                    p.unparse(v, *limit);
+                else
+                    p.unparse(v);
                 success++;
             } catch (Error e) {
                 if (errh)
@@ -137,14 +230,55 @@ GposLookup::unparse_automatics(Vector<Positioning> &v, ErrorHandler *errh) const
     }
 }
 
+bool
+GposLookup::apply(const Glyph *g, int pos, int n, Positioning &p) const
+{
+    int nlookup = _d.u16(4);
+    switch (_type) {
+      case L_SINGLE:
+        for (int i = 0; i < nlookup; i++) {
+            GposSingle x(subtable(i), _compiled);
+            if (x.apply(g, pos, n, p))
+                return true;
+        }
+        return false;
+      case L_PAIR:
+        for (int i = 0; i < nlookup; i++) {
+            GposPair x(subtable(i), _compiled);
+            if (x.apply(g, pos, n, p))
+                return true;
+        }
+        return false;
+      default:                  // XXX
+        return false;
+    }
+}
+
+// Finds the exit anchor of g[pos] and the entry anchor of g[pos+1] in the
+// first cursive subtable that covers g[pos].
+bool
+GposLookup::apply_cursive(const Glyph *g, int pos, int n,
+                          int &exit_x, int &exit_y, int &entry_x, int &entry_y) const
+{
+    if (_type != L_CURSIVE || pos + 1 >= n)
+        return false;
+    int nlookup = _d.u16(4);
+    for (int i = 0; i < nlookup; i++) {
+        GposCursive x(subtable(i), _compiled);
+        if (x.exit_anchor(g[pos], exit_x, exit_y))
+            return x.entry_anchor(g[pos + 1], entry_x, entry_y);
+    }
+    return false;
+}
+
 
 /**************************
  * GposSingle             *
  *                        *
  **************************/
 
-GposSingle::GposSingle(const Data &d)
-    : _d(d)
+GposSingle::GposSingle(const Data &d, const CompiledTables *compiled)
+    : _d(d), _compiled(compiled)
 {
     if (_d[0] != 0
         || (_d[1] != 1 && _d[1] != 2))
@@ -162,29 +296,53 @@ GposSingle::coverage() const noexcept
 }
 
 void
-GposSingle::unparse(Vector<Positioning> &v) const
+GposSingle::unparse(PositioningVisitor &v) const
+{
+    unparse(v, coverage());
+}
+
+void
+GposSingle::unparse(PositioningVisitor &v, const Coverage &limit) const
 {
     if (_d[1] == 1) {
         int format = _d.u16(4);
         Data value = _d.subtable(6);
         for (Coverage::iterator i = coverage().begin(); i; i++)
-            v.push_back(Positioning(Position(*i, format, value)));
+            if (limit.covers(*i) && !v.emit(Positioning(Position(*i, format, value))))
+                return;
     } else {
         int format = _d.u16(4);
         int size = GposValue::size(format);
         for (Coverage::iterator i = coverage().begin(); i; i++)
-            v.push_back(Positioning(Position(*i, format, _d.subtable(F2_HEADERSIZE + size*i.coverage_index()))));
+            if (limit.covers(*i)
+                && !v.emit(Positioning(Position(*i, format, _d.subtable(F2_HEADERSIZE + size*i.coverage_index())))))
+                return;
     }
 }
 
+bool
+GposSingle::apply(const Glyph *g, int pos, int n, Positioning &p) const
+{
+    int ci;
+    if (pos < n && (ci = coverage_index(_compiled, coverage(), g[pos])) >= 0) {
+        int format = _d.u16(4);
+        if (_d[1] == 1)
+            p = Positioning(Position(g[pos], format, _d.subtable(6)));
+        else
+            p = Positioning(Position(g[pos], format, _d.subtable(F2_HEADERSIZE + GposValue::size(format)*ci)));
+        return true;
+    } else
+        return false;
+}
+
 
 /**************************
  * GposPair               *
  *                        *
  **************************/
 
-GposPair::GposPair(const Data &d)
-    : _d(d)
+GposPair::GposPair(const Data &d, const CompiledTables *compiled)
+    : _d(d), _compiled(compiled)
 {
     if (_d[0] != 0
         || (_d[1] != 1 && _d[1] != 2))
@@ -202,7 +360,7 @@ GposPair::coverage() const noexcept
 }
 
 void
-GposPair::unparse(Vector<Positioning> &v) const
+GposPair::unparse(PositioningVisitor &v) const
 {
     if (_d[1] == 1) {
         int format1 = _d.u16(4);
@@ -214,8 +372,9 @@ GposPair::unparse(Vector<Positioning> &v) const
             int npair = pairset.u16(0);
             for (int j = 0; j < npair; j++) {
                 Data pair = pairset.subtable(PAIRSET_HEADERSIZE + j*pairvalue_size);
-                v.push_back(Positioning(Position(*i, format1, pair.subtable(PAIRVALUE_HEADERSIZE)),
-                                        Position(pair.u16(0), format2, pair.subtable(f2_pos))));
+                if (!v.emit(Positioning(Position(*i, format1, pair.subtable(PAIRVALUE_HEADERSIZE)),
+                                        Position(pair.u16(0), format2, pair.subtable(f2_pos)))))
+                    return;
             }
         }
     } else {                    // _d[1] == 2
@@ -236,12 +395,184 @@ GposPair::unparse(Vector<Positioning> &v) const
                 if (p1 || p2) {
                     for (ClassDef::class_iterator c1i = class1.begin(c1, coverage); c1i; c1i++)
                         for (ClassDef::class_iterator c2i = class2.begin(c2); c2i; c2i++)
-                            v.push_back(Positioning(Position(*c1i, p1), Position(*c2i, p2)));
+                            if (!v.emit(Positioning(Position(*c1i, p1), Position(*c2i, p2))))
+                                return;
+                }
+            }
+    }
+}
+
+void
+GposPair::unparse(PositioningVisitor &v, const Coverage &limit) const
+{
+    // Like unparse(v), but only generate pairs whose glyphs are both in
+    // 'limit'. Class-based pairs are filtered before they're expanded.
+    if (_d[1] == 1) {
+        int format1 = _d.u16(4);
+        int format2 = _d.u16(6);
+        int f2_pos = PAIRVALUE_HEADERSIZE + GposValue::size(format1);
+        int pairvalue_size = f2_pos + GposValue::size(format2);
+        for (Coverage::iterator i = coverage().begin(); i; i++)
+            if (limit.covers(*i)) {
+                Data pairset = _d.offset_subtable(F1_HEADERSIZE + i.coverage_index()*F1_RECSIZE);
+                int npair = pairset.u16(0);
+                for (int j = 0; j < npair; j++) {
+                    Data pair = pairset.subtable(PAIRSET_HEADERSIZE + j*pairvalue_size);
+                    if (limit.covers(pair.u16(0))
+                        && !v.emit(Positioning(Position(*i, format1, pair.subtable(PAIRVALUE_HEADERSIZE)),
+                                               Position(pair.u16(0), format2, pair.subtable(f2_pos)))))
+                        return;
+                }
+            }
+    } else {                    // _d[1] == 2
+        int format1 = _d.u16(4);
+        int format2 = _d.u16(6);
+        int f2_pos = GposValue::size(format1);
+        int recsize = f2_pos + GposValue::size(format2);
+        ClassDef class1(_d.offset_subtable(8));
+        ClassDef class2(_d.offset_subtable(10));
+        Coverage coverage = this->coverage() & limit;
+        int nclass1 = _d.u16(12);
+        int nclass2 = _d.u16(14);
+
+        // sort the second glyphs in 'limit' by class; like unparse(v),
+        // never expand class 0
+        Vector<int> class2_pos(nclass2 + 1, 0);
+        for (Coverage::iterator i = limit.begin(); i; i++) {
+            int c2 = class_lookup(_compiled, class2, *i);
+            if (c2 > 0 && c2 < nclass2)
+                class2_pos[c2 + 1]++;
+        }
+        for (int c2 = 0; c2 < nclass2; c2++)
+            class2_pos[c2 + 1] += class2_pos[c2];
+        Vector<Glyph> class2_glyphs(class2_pos[nclass2], 0);
+        Vector<int> next(class2_pos);
+        for (Coverage::iterator i = limit.begin(); i; i++) {
+            int c2 = class_lookup(_compiled, class2, *i);
+            if (c2 > 0 && c2 < nclass2)
+                class2_glyphs[next[c2]++] = *i;
+        }
+
+        int offset = F2_HEADERSIZE;
+        for (int c1 = 0; c1 < nclass1; c1++)
+            for (int c2 = 0; c2 < nclass2; c2++, offset += recsize) {
+                if (c2 == 0) {
+                    // unparse(v) can't iterate over class 0, and fails
+                    // here if class c1 has any glyphs; so do we
+                    Position p1(format1, _d.subtable(offset));
+                    Position p2(format2, _d.subtable(offset + f2_pos));
+                    if ((p1 || p2) && class1.begin(c1, this->coverage()))
+                        throw Error("cannot iterate over ClassDef class 0");
+                    continue;
+                }
+                if (class2_pos[c2] == class2_pos[c2 + 1])
+                    continue;
+                Position p1(format1, _d.subtable(offset));
+                Position p2(format2, _d.subtable(offset + f2_pos));
+                if (p1 || p2) {
+                    for (ClassDef::class_iterator c1i = class1.begin(c1, coverage); c1i; c1i++)
+                        for (int j = class2_pos[c2]; j < class2_pos[c2 + 1]; j++)
+                            if (!v.emit(Positioning(Position(*c1i, p1), Position(class2_glyphs[j], p2))))
+                                return;
                 }
             }
     }
 }
 
+bool
+GposPair::apply(const Glyph *g, int pos, int n, Positioning &p) const
+{
+    int ci;
+    if (pos + 1 >= n || (ci = coverage_index(_compiled, coverage(), g[pos])) < 0)
+        return false;
+    int format1 = _d.u16(4);
+    int format2 = _d.u16(6);
+    if (_d[1] == 1) {
+        // pair value records are sorted by second glyph
+        int f2_pos = PAIRVALUE_HEADERSIZE + GposValue::size(format1);
+        int pairvalue_size = f2_pos + GposValue::size(format2);
+        Data pairset = _d.offset_subtable(F1_HEADERSIZE + ci*F1_RECSIZE);
+        int l = 0, r = pairset.u16(0);
+        while (l < r) {
+            int m = l + (r - l) / 2;
+            Data pair = pairset.subtable(PAIRSET_HEADERSIZE + m*pairvalue_size);
+            Glyph g2 = pair.u16(0);
+            if (g2 == g[pos + 1]) {
+                p = Positioning(Position(g[pos], format1, pair.subtable(PAIRVALUE_HEADERSIZE)),
+                                Position(g2, format2, pair.subtable(f2_pos)));
+                return true;
+            } else if (g2 < g[pos + 1])
+                l = m + 1;
+            else
+                r = m;
+        }
+        return false;
+    } else {                    // _d[1] == 2
+        int f2_pos = GposValue::size(format1);
+        int recsize = f2_pos + GposValue::size(format2);
+        int c1 = class_lookup(_compiled, ClassDef(_d.offset_subtable(8)), g[pos]);
+        int c2 = class_lookup(_compiled, ClassDef(_d.offset_subtable(10)), g[pos + 1]);
+        if (c1 < 0 || c1 >= _d.u16(12) || c2 < 0 || c2 >= _d.u16(14))
+            return false;
+        int offset = F2_HEADERSIZE + (c1*_d.u16(14) + c2)*recsize;
+        p = Positioning(Position(g[pos], format1, _d.subtable(offset)),
+                        Position(g[pos + 1], format2, _d.subtable(offset + f2_pos)));
+        return true;
+    }
+}
+
+
+/**************************
+ * GposCursive            *
+ *                        *
+ **************************/
+
+GposCursive::GposCursive(const Data &d, const CompiledTables *compiled)
+    : _d(d), _compiled(compiled)
+{
+    if (_d[0] != 0 || _d[1] != 1)
+        throw Format("GPOS Cursive Attachment");
+    Coverage coverage(_d.offset_subtable(2));
+    if (!coverage.ok()
+        || coverage.size() > _d.u16(4))
+        throw Format("GPOS Cursive Attachment coverage");
+}
+
+Coverage
+GposCursive::coverage() const noexcept
+{
+    return Coverage(_d.offset_subtable(2), 0, false);
+}
+
+bool
+GposCursive::anchor(Glyph g, int which, int &x, int &y) const
+{
+    // EntryExitRecord: offset entry anchor, offset exit anchor;
+    // Anchor: u16 format, s16 x, s16 y, ...
+    int ci = coverage_index(_compiled, coverage(), g);
+    if (ci < 0)
+        return false;
+    int offset_offset = HEADERSIZE + ci*RECSIZE + which*2;
+    if (_d.u16(offset_offset) == 0)
+        return false;
+    Data anchor = _d.offset_subtable(offset_offset);
+    x = anchor.s16(2);
+    y = anchor.s16(4);
+    return true;
+}
+
+bool
+GposCursive::entry_anchor(Glyph g, int &x, int &y) const
+{
+    return anchor(g, 0, x, y);
+}
+
+bool
+GposCursive::exit_anchor(Glyph g, int &x, int &y) const
+{
+    return anchor(g, 1, x, y);
+}
+
 
 /**************************
  * Positioning            *
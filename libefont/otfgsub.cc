@@ -594,6 +594,12 @@ Gsub::Gsub(const Data &d, const Font *otf, ErrorHandler *errh)
     }
 }
 
+Gsub::~Gsub()
+{
+    for (GlyphSet **gs = _lookup_glyphs.begin(); gs != _lookup_glyphs.end(); ++gs)
+        delete *gs;
+}
+
 int
 Gsub::nlookups() const
 {
@@ -606,7 +612,25 @@ Gsub::lookup(unsigned i) const
     if (i >= _lookup_list.u16(0))
         throw Error("GSUB lookup out of range");
     else
-        return GsubLookup(_lookup_list.offset_subtable(2 + i*2));
+        return GsubLookup(_lookup_list.offset_subtable(2 + i*2), &_compiled);
+}
+
+const GlyphSet &
+Gsub::lookup_glyphs(unsigned i) const
+{
+    if (i >= (unsigned) _lookup_glyphs.size())
+        _lookup_glyphs.resize(i + 1, 0);
+    GlyphSet *&gs = _lookup_glyphs[i];
+    if (!gs) {
+        gs = new GlyphSet;
+        try {
+            lookup(i).mark_first_glyphs(*gs);
+        } catch (Error) {
+            // can't tell; the lookup might apply anywhere
+            *gs |= GlyphSet(Coverage(0, 0xFFFF));
+        }
+    }
+    return *gs;
 }
 
 
@@ -615,8 +639,8 @@ Gsub::lookup(unsigned i) const
  *                        *
  **************************/
 
-GsubLookup::GsubLookup(const Data &d)
-    : _d(d)
+GsubLookup::GsubLookup(const Data &d, const CompiledTables *compiled)
+    : _d(d), _compiled(compiled)
 {
     if (_d.length() < 6)
         throw Format("GSUB Lookup table");
@@ -641,82 +665,126 @@ GsubLookup::subtable(int i) const
         return Data();
 }
 
+static Coverage
+first_coverage(int type, const Data &d)
+{
+    if (type == GsubLookup::L_CONTEXT && d.u16(0) == 3)
+        return Coverage(d.offset_subtable(GsubContext::F3_HSIZE));
+    else if (type == GsubLookup::L_CHAIN && d.u16(0) == 3) {
+        int input_offset = GsubChainContext::F3_HSIZE + d.u16(2)*2;
+        return Coverage(d.offset_subtable(input_offset + GsubChainContext::F3_INPUT_HSIZE));
+    } else
+        return Coverage(d.offset_subtable(2));
+}
+
+// Adds to 'gs' every glyph at which the lookup can start to match.
+void
+GsubLookup::mark_first_glyphs(GlyphSet &gs) const
+{
+    int nlookup = _d.u16(4);
+    for (int i = 0; i < nlookup; i++) {
+        Coverage c = first_coverage(_type, subtable(i));
+        if (!c.ok())
+            throw Format("GSUB coverage");
+        for (Coverage::iterator it = c.begin(); it; ++it)
+            gs.insert(*it);
+    }
+}
+
+// Adds to 'out' every glyph the lookup can produce from glyphs in 'in'.
+// 'in' and 'out' may be the same set.
 void
-GsubLookup::mark_out_glyphs(const Gsub &gsub, Vector<bool> &gmap) const
+GsubLookup::mark_out_glyphs(const Gsub &gsub, const GlyphSet &in, GlyphSet &out) const
 {
     int nlookup = _d.u16(4);
     switch (_type) {
       case L_SINGLE:
         for (int i = 0; i < nlookup; i++) {
             GsubSingle x(subtable(i)); // this pattern makes gcc-3.3.4 happier
-            x.mark_out_glyphs(gmap);
+            x.mark_out_glyphs(in, out);
         }
         return;
       case L_MULTIPLE:
         for (int i = 0; i < nlookup; i++) {
             GsubMultiple x(subtable(i));
-            x.mark_out_glyphs(gmap);
+            x.mark_out_glyphs(in, out);
         }
         return;
       case L_ALTERNATE:
         for (int i = 0; i < nlookup; i++) {
             GsubMultiple x(subtable(i));
-            x.mark_out_glyphs(gmap);
+            x.mark_out_glyphs(in, out);
         }
         return;
       case L_LIGATURE:
         for (int i = 0; i < nlookup; i++) {
             GsubLigature x(subtable(i));
-            x.mark_out_glyphs(gmap);
+            x.mark_out_glyphs(in, out);
         }
         return;
     case L_CONTEXT:
         for (int i = 0; i < nlookup; i++) {
             GsubContext x(subtable(i));
-            x.mark_out_glyphs(gsub, gmap);
+            x.mark_out_glyphs(gsub, in, out);
         }
         return;
     case L_CHAIN:
         for (int i = 0; i < nlookup; i++) {
             GsubChainContext x(subtable(i));
-            x.mark_out_glyphs(gsub, gmap);
+            x.mark_out_glyphs(gsub, in, out);
         }
         return;
     }
 }
 
+namespace {
+class SubstitutionAccum : public SubstitutionVisitor { public:
+    SubstitutionAccum(Vector<Substitution> &v) : _v(v) { }
+    bool visit(const Substitution &s) { _v.push_back(s); return true; }
+  private:
+    Vector<Substitution> &_v;
+};
+}
+
 bool
 GsubLookup::unparse_automatics(const Gsub &gsub, Vector<Substitution> &v, const Coverage &limit) const
+{
+    SubstitutionAccum accum(v);
+    return unparse_automatics(gsub, accum, limit);
+}
+
+bool
+GsubLookup::unparse_automatics(const Gsub &gsub, SubstitutionVisitor &v, const Coverage &limit) const
 {
     int nlookup = _d.u16(4);
     switch (_type) {
       case L_SINGLE:
-        for (int i = 0; i < nlookup; i++) {
+        for (int i = 0; i < nlookup && !v.stopped(); i++) {
             GsubSingle x(subtable(i)); // this pattern makes gcc-3.3.4 happier
             x.unparse(v, limit);
         }
         return true;
       case L_MULTIPLE:
-        for (int i = 0; i < nlookup; i++) {
+        for (int i = 0; i < nlookup && !v.stopped(); i++) {
             GsubMultiple x(subtable(i));
             x.unparse(v);
         }
         return true;
       case L_ALTERNATE:
-        for (int i = 0; i < nlookup; i++) {
+        for (int i = 0; i < nlookup && !v.stopped(); i++) {
             GsubMultiple x(subtable(i));
             x.unparse(v, true);
         }
         return true;
       case L_LIGATURE:
-        for (int i = 0; i < nlookup; i++) {
+        for (int i = 0; i < nlookup && !v.stopped(); i++) {
             GsubLigature x(subtable(i));
             x.unparse(v);
         }
         return true;
       case L_CONTEXT: {
           bool understood = true;
-          for (int i = 0; i < nlookup; i++) {
+          for (int i = 0; i < nlookup && !v.stopped(); i++) {
               GsubContext x(subtable(i));
               understood &= x.unparse(gsub, v, limit);
           }
@@ -724,7 +792,7 @@ GsubLookup::unparse_automatics(const Gsub &gsub, Vector<Substitution> &v, const
       }
       case L_CHAIN: {
           bool understood = true;
-          for (int i = 0; i < nlookup; i++) {
+          for (int i = 0; i < nlookup && !v.stopped(); i++) {
               GsubChainContext x(subtable(i));
               understood &= x.unparse(gsub, v, limit);
           }
@@ -742,28 +810,28 @@ GsubLookup::apply(const Glyph *g, int pos, int n, Substitution &s) const
     switch (_type) {
       case L_SINGLE:
         for (int i = 0; i < nlookup; i++) {
-            GsubSingle x(subtable(i));
+            GsubSingle x(subtable(i), _compiled);
             if (x.apply(g, pos, n, s))
                 return true;
         }
         return false;
       case L_MULTIPLE:
         for (int i = 0; i < nlookup; i++) {
-            GsubMultiple x(subtable(i));
+            GsubMultiple x(subtable(i), _compiled);
             if (x.apply(g, pos, n, s))
                 return true;
         }
         return false;
       case L_ALTERNATE:
         for (int i = 0; i < nlookup; i++) {
-            GsubMultiple x(subtable(i));
+            GsubMultiple x(subtable(i), _compiled);
             if (x.apply(g, pos, n, s, true))
                 return true;
         }
         return false;
       case L_LIGATURE:
         for (int i = 0; i < nlookup; i++) {
-            GsubLigature x(subtable(i));
+            GsubLigature x(subtable(i), _compiled);
             if (x.apply(g, pos, n, s))
                 return true;
         }
@@ -779,8 +847,8 @@ GsubLookup::apply(const Glyph *g, int pos, int n, Substitution &s) const
  *                        *
  **************************/
 
-GsubSingle::GsubSingle(const Data &d)
-    : _d(d)
+GsubSingle::GsubSingle(const Data &d, const CompiledTables *compiled)
+    : _d(d), _compiled(compiled)
 {
     if (_d[0] != 0
         || (_d[1] != 1 && _d[1] != 2))
@@ -800,7 +868,7 @@ GsubSingle::coverage() const noexcept
 Glyph
 GsubSingle::map(Glyph g) const
 {
-    int ci = coverage().coverage_index(g);
+    int ci = coverage_index(_compiled, coverage(), g);
     if (ci < 0)
         return g;
     else if (_d[1] == 1)
@@ -810,30 +878,33 @@ GsubSingle::map(Glyph g) const
 }
 
 void
-GsubSingle::mark_out_glyphs(Vector<bool> &gmap) const
+GsubSingle::mark_out_glyphs(const GlyphSet &in, GlyphSet &out) const
 {
     if (_d[1] == 1) {
         int delta = _d.s16(4);
         for (Coverage::iterator i = coverage().begin(); i; i++)
-            gmap[*i + delta] = true;
+            if (in.covers(*i))
+                out.insert(*i + delta);
     } else {
         for (Coverage::iterator i = coverage().begin(); i; i++)
-            gmap[_d.u16(HEADERSIZE + i.coverage_index()*FORMAT2_RECSIZE)] = true;
+            if (in.covers(*i))
+                out.insert(_d.u16(HEADERSIZE + i.coverage_index()*FORMAT2_RECSIZE));
     }
 }
 
 void
-GsubSingle::unparse(Vector<Substitution> &v, const Coverage &limit) const
+GsubSingle::unparse(SubstitutionVisitor &v, const Coverage &limit) const
 {
     if (_d[1] == 1) {
         int delta = _d.s16(4);
         for (Coverage::iterator it = coverage().begin(); it; ++it)
-            if (limit.covers(*it))
-                v.push_back(Substitution(*it, *it + delta));
+            if (limit.covers(*it) && !v.emit(Substitution(*it, *it + delta)))
+                return;
     } else {
         for (Coverage::iterator it = coverage().begin(); it; ++it)
-            if (limit.covers(*it))
-                v.push_back(Substitution(*it, _d.u16(HEADERSIZE + it.coverage_index()*FORMAT2_RECSIZE)));
+            if (limit.covers(*it)
+                && !v.emit(Substitution(*it, _d.u16(HEADERSIZE + it.coverage_index()*FORMAT2_RECSIZE))))
+                return;
     }
 }
 
@@ -841,7 +912,7 @@ bool
 GsubSingle::apply(const Glyph *g, int pos, int n, Substitution &s) const
 {
     int ci;
-    if (pos < n && (ci = coverage().coverage_index(g[pos])) >= 0) {
+    if (pos < n && (ci = coverage_index(_compiled, coverage(), g[pos])) >= 0) {
         if (_d[1] == 1)
             s = Substitution(g[pos], g[pos] + _d.s16(4));
         else
@@ -857,8 +928,8 @@ GsubSingle::apply(const Glyph *g, int pos, int n, Substitution &s) const
  *                        *
  **************************/
 
-GsubMultiple::GsubMultiple(const Data &d)
-    : _d(d)
+GsubMultiple::GsubMultiple(const Data &d, const CompiledTables *compiled)
+    : _d(d), _compiled(compiled)
 {
     if (_d[0] != 0 || _d[1] != 1)
         throw Format("GSUB Multiple Substitution");
@@ -878,7 +949,7 @@ bool
 GsubMultiple::map(Glyph g, Vector<Glyph> &v) const
 {
     v.clear();
-    int ci = coverage().coverage_index(g);
+    int ci = coverage_index(_compiled, coverage(), g);
     if (ci < 0) {
         v.push_back(g);
         return false;
@@ -891,17 +962,18 @@ GsubMultiple::map(Glyph g, Vector<Glyph> &v) const
 }
 
 void
-GsubMultiple::mark_out_glyphs(Vector<bool> &gmap) const
+GsubMultiple::mark_out_glyphs(const GlyphSet &in, GlyphSet &out) const
 {
-    for (Coverage::iterator i = coverage().begin(); i; ++i) {
-        Data seq = _d.offset_subtable(HEADERSIZE + i.coverage_index()*RECSIZE);
-        for (int j = 0; j < seq.u16(0); ++j)
-            gmap[seq.u16(SEQ_HEADERSIZE + j*SEQ_RECSIZE)] = true;
-    }
+    for (Coverage::iterator i = coverage().begin(); i; ++i)
+        if (in.covers(*i)) {
+            Data seq = _d.offset_subtable(HEADERSIZE + i.coverage_index()*RECSIZE);
+            for (int j = 0; j < seq.u16(0); ++j)
+                out.insert(seq.u16(SEQ_HEADERSIZE + j*SEQ_RECSIZE));
+        }
 }
 
 void
-GsubMultiple::unparse(Vector<Substitution> &v, bool is_alternate) const
+GsubMultiple::unparse(SubstitutionVisitor &v, bool is_alternate) const
 {
     Vector<Glyph> result;
     for (Coverage::iterator i = coverage().begin(); i; i++) {
@@ -909,7 +981,8 @@ GsubMultiple::unparse(Vector<Substitution> &v, bool is_alternate) const
         result.clear();
         for (int j = 0; j < seq.u16(0); j++)
             result.push_back(seq.u16(SEQ_HEADERSIZE + j*SEQ_RECSIZE));
-        v.push_back(Substitution(*i, result, is_alternate));
+        if (!v.emit(Substitution(*i, result, is_alternate)))
+            return;
     }
 }
 
@@ -917,7 +990,7 @@ bool
 GsubMultiple::apply(const Glyph *g, int pos, int n, Substitution &s, bool is_alternate) const
 {
     int ci;
-    if (pos < n && (ci = coverage().coverage_index(g[pos])) >= 0) {
+    if (pos < n && (ci = coverage_index(_compiled, coverage(), g[pos])) >= 0) {
         Vector<Glyph> result;
         Data seq = _d.offset_subtable(HEADERSIZE + ci*RECSIZE);
         for (int j = 0; j < seq.u16(0); j++)
@@ -934,8 +1007,8 @@ GsubMultiple::apply(const Glyph *g, int pos, int n, Substitution &s, bool is_alt
  *                        *
  **************************/
 
-GsubLigature::GsubLigature(const Data &d)
-    : _d(d)
+GsubLigature::GsubLigature(const Data &d, const CompiledTables *compiled)
+    : _d(d), _compiled(compiled)
 {
     if (_d[0] != 0
         || _d[1] != 1)
@@ -958,7 +1031,7 @@ GsubLigature::map(const Vector<Glyph> &gs, Glyph &result, int &consumed) const
     assert(gs.size() > 0);
     result = gs[0];
     consumed = 1;
-    int ci = coverage().coverage_index(gs[0]);
+    int ci = coverage_index(_compiled, coverage(), gs[0]);
     if (ci < 0)
         return false;
     Data ligset = _d.offset_subtable(HEADERSIZE + ci*RECSIZE);
@@ -980,21 +1053,26 @@ GsubLigature::map(const Vector<Glyph> &gs, Glyph &result, int &consumed) const
 }
 
 void
-GsubLigature::mark_out_glyphs(Vector<bool> &gmap) const
+GsubLigature::mark_out_glyphs(const GlyphSet &in, GlyphSet &out) const
 {
     for (Coverage::iterator i = coverage().begin(); i; i++) {
+        if (!in.covers(*i))
+            continue;
         Data ligset = _d.offset_subtable(HEADERSIZE + i.coverage_index()*RECSIZE);
         int nligset = ligset.u16(0);
-        Vector<Glyph> components(1, *i);
         for (int j = 0; j < nligset; j++) {
             Data lig = ligset.offset_subtable(SET_HEADERSIZE + j*SET_RECSIZE);
-            gmap[lig.u16(0)] = true;
+            int nlig = lig.u16(2), k = 0;
+            while (k < nlig - 1 && in.covers(lig.u16(LIG_HEADERSIZE + k*LIG_RECSIZE)))
+                ++k;
+            if (k >= nlig - 1)
+                out.insert(lig.u16(0));
         }
     }
 }
 
 void
-GsubLigature::unparse(Vector<Substitution> &v) const
+GsubLigature::unparse(SubstitutionVisitor &v) const
 {
     for (Coverage::iterator i = coverage().begin(); i; i++) {
         Data ligset = _d.offset_subtable(HEADERSIZE + i.coverage_index()*RECSIZE);
@@ -1006,7 +1084,8 @@ GsubLigature::unparse(Vector<Substitution> &v) const
             components.resize(1);
             for (int k = 0; k < nlig - 1; k++)
                 components.push_back(lig.u16(LIG_HEADERSIZE + k*LIG_RECSIZE));
-            v.push_back(Substitution(components, lig.u16(0)));
+            if (!v.emit(Substitution(components, lig.u16(0))))
+                return;
         }
     }
 }
@@ -1015,7 +1094,7 @@ bool
 GsubLigature::apply(const Glyph *g, int pos, int n, Substitution &s) const
 {
     int ci;
-    if (pos < n && (ci = coverage().coverage_index(g[pos])) >= 0) {
+    if (pos < n && (ci = coverage_index(_compiled, coverage(), g[pos])) >= 0) {
         Data ligset = _d.offset_subtable(HEADERSIZE + ci*RECSIZE);
         int nligset = ligset.u16(0);
         for (int j = 0; j < nligset; j++) {
@@ -1073,28 +1152,29 @@ GsubContext::coverage() const noexcept
 void
 GsubContext::subruleset_mark_out_glyphs(const Data &data, int nsub,
                                         int subtab_offset, const Gsub &gsub,
-                                        Vector<bool> &gmap)
+                                        const GlyphSet &in, GlyphSet &out)
 {
     for (int j = 0; j < nsub; ++j) {
         int lookup_index = data.u16(subtab_offset + SUBRECSIZE*j + 2);
-        gsub.lookup(lookup_index).mark_out_glyphs(gsub, gmap);
+        if (gsub.lookup_glyphs(lookup_index).intersects(in))
+            gsub.lookup(lookup_index).mark_out_glyphs(gsub, in, out);
     }
 }
 
 void
-GsubContext::mark_out_glyphs(const Gsub &gsub, Vector<bool> &gmap) const
+GsubContext::mark_out_glyphs(const Gsub &gsub, const GlyphSet &in, GlyphSet &out) const
 {
     if (_d.u16(0) != 3)         // XXX
         return;
     int nglyph = _d.u16(2);
     int nsubst = _d.u16(4);
-    subruleset_mark_out_glyphs(_d, nsubst, F3_HSIZE + nglyph*2, gsub, gmap);
+    subruleset_mark_out_glyphs(_d, nsubst, F3_HSIZE + nglyph*2, gsub, in, out);
 }
 
 bool
 GsubContext::f1_unparse(const Data& data,
                         int nsub, int subtab_offset,
-                        const Gsub& gsub, Vector<Substitution>& outsubs,
+                        const Gsub& gsub, SubstitutionVisitor& outsubs,
                         Substitution s) {
     Substitution subtab_sub;
     int napplied = 0;
@@ -1102,12 +1182,14 @@ GsubContext::f1_unparse(const Data& data,
         int seq_index = data.u16(subtab_offset + SUBRECSIZE*j);
         int lookup_index = data.u16(subtab_offset + SUBRECSIZE*j + 2);
         // XXX check seq_index against size of output glyphs?
-        if (gsub.lookup(lookup_index).apply(s.out_glyphptr(), seq_index, s.out_nglyphs(), subtab_sub)) {
+        if (seq_index < s.out_nglyphs()
+            && gsub.lookup_glyphs(lookup_index).covers(s.out_glyph(seq_index))
+            && gsub.lookup(lookup_index).apply(s.out_glyphptr(), seq_index, s.out_nglyphs(), subtab_sub)) {
             napplied++;
             s.out_alter(subtab_sub, seq_index);
         }
     }
-    outsubs.push_back(s);
+    outsubs.emit(s);
     return true;
 }
 
@@ -1115,48 +1197,62 @@ bool
 GsubContext::f3_unparse(const Data &data,
                         int nglyph, int glyphtab_offset, const Coverage &limit,
                         int nsub, int subtab_offset,
-                        const Gsub &gsub, Vector<Substitution> &outsubs,
+                        const Gsub &gsub, SubstitutionVisitor &outsubs,
                         const Substitution &prototype_sub)
 {
-    Vector<Substitution> subs;
-    subs.push_back(prototype_sub);
-    Vector<Substitution> work_subs;
-
-    // get array of possible substitutions including contexts
+    // visit the possible input sequences one at a time, varying the first
+    // input glyph fastest
+    Vector<Coverage> inputc;
+    Vector<Coverage::iterator> inputi;
+    for (int i = 0; i < nglyph; i++)
+        inputc.push_back(Coverage(data.offset_subtable(glyphtab_offset + i*2)) & limit);
     for (int i = 0; i < nglyph; i++) {
-        assert(!work_subs.size());
-        Coverage c(data.offset_subtable(glyphtab_offset + i*2));
-        for (Coverage::iterator ci = (c & limit).begin(); ci; ci++)
-            for (int j = 0; j < subs.size(); j++)
-                work_subs.push_back(subs[j].in_out_append_glyph(*ci));
-        subs.clear();
-        subs.swap(work_subs);
+        inputi.push_back(inputc[i].begin());
+        if (!inputi[i])
+            return true;
     }
 
-    // now, apply referred lookups to the resulting substitution array
     Substitution subtab_sub;
-    for (int i = 0; i < subs.size(); i++) {
-        Substitution &s = subs[i];
+    while (1) {
+        Substitution s(prototype_sub);
+        for (int i = 0; i < nglyph; i++)
+            s = s.in_out_append_glyph(*inputi[i]);
+
+        // apply referred lookups to the substitution
         int napplied = 0;
         for (int j = 0; j < nsub; j++) {
             int seq_index = data.u16(subtab_offset + SUBRECSIZE*j);
             int lookup_index = data.u16(subtab_offset + SUBRECSIZE*j + 2);
             // XXX check seq_index against size of output glyphs?
-            if (gsub.lookup(lookup_index).apply(s.out_glyphptr(), seq_index, s.out_nglyphs(), subtab_sub)) {
+            if (seq_index < s.out_nglyphs()
+                && gsub.lookup_glyphs(lookup_index).covers(s.out_glyph(seq_index))
+                && gsub.lookup(lookup_index).apply(s.out_glyphptr(), seq_index, s.out_nglyphs(), subtab_sub)) {
                 napplied++;
                 s.out_alter(subtab_sub, seq_index);
             }
         }
         // 26.Jun.2003 -- always push substitution back, since the no-op might
         // override a following substitution
-        outsubs.push_back(s);
+        if (!outsubs.emit(s))
+            break;
+
+        // step iterators
+        for (int i = 0; i < nglyph; i++) {
+            inputi[i]++;
+            if (inputi[i])
+                goto next;
+            inputi[i] = inputc[i].begin();
+        }
+        break;
+
+      next: ;
     }
 
     return true;                // XXX
 }
 
 bool
-GsubContext::unparse(const Gsub &gsub, Vector<Substitution> &v, const Coverage &limit) const
+GsubContext::unparse(const Gsub &gsub, SubstitutionVisitor &v, const Coverage &limit) const
 {
     if (_d.u16(0) != 3)         // XXX
         return false;
@@ -1217,7 +1313,7 @@ GsubChainContext::coverage() const noexcept
 }
 
 void
-GsubChainContext::mark_out_glyphs(const Gsub &gsub, Vector<bool> &gmap) const
+GsubChainContext::mark_out_glyphs(const Gsub &gsub, const GlyphSet &in, GlyphSet &out) const
 {
     switch (_d.u16(0)) {
     case 1: {
@@ -1235,7 +1331,7 @@ GsubChainContext::mark_out_glyphs(const Gsub &gsub, Vector<bool> &gmap) const
                 int subst_offset = lookahead_offset + 2 + nlookahead*2;
                 int nsubst = _d.u16(subst_offset);
 
-                GsubContext::subruleset_mark_out_glyphs(_d, nsubst, subst_offset + 2, gsub, gmap);
+                GsubContext::subruleset_mark_out_glyphs(_d, nsubst, subst_offset + 2, gsub, in, out);
             }
         }
         break;
@@ -1249,7 +1345,7 @@ GsubChainContext::mark_out_glyphs(const Gsub &gsub, Vector<bool> &gmap) const
         int subst_offset = lookahead_offset + F3_LOOKAHEAD_HSIZE + nlookahead*2;
         int nsubst = _d.u16(subst_offset);
 
-        GsubContext::subruleset_mark_out_glyphs(_d, nsubst, subst_offset + F3_SUBST_HSIZE, gsub, gmap);
+        GsubContext::subruleset_mark_out_glyphs(_d, nsubst, subst_offset + F3_SUBST_HSIZE, gsub, in, out);
         break;
     }
     default:
@@ -1258,7 +1354,7 @@ GsubChainContext::mark_out_glyphs(const Gsub &gsub, Vector<bool> &gmap) const
 }
 
 bool
-GsubChainContext::f1_unparse(const Gsub &gsub, Vector<Substitution> &v, const Coverage &limit) const
+GsubChainContext::f1_unparse(const Gsub &gsub, SubstitutionVisitor &v, const Coverage &limit) const
 {
     Coverage input0_coverage(_d.offset_subtable(2), 0, false);
     Coverage::iterator i0iter = input0_coverage.begin();
@@ -1299,6 +1395,8 @@ GsubChainContext::f1_unparse(const Gsub &gsub, Vector<Substitution> &v, const Co
 
             // now, apply referred lookups to the resulting substitution array
             GsubContext::f1_unparse(_d, nsubst, subtab_offset, gsub, v, s);
+            if (v.stopped())
+                return true;
         skip: ;
         }
     }
@@ -1307,7 +1405,7 @@ GsubChainContext::f1_unparse(const Gsub &gsub, Vector<Substitution> &v, const Co
 }
 
 bool
-GsubChainContext::f3_unparse(const Gsub &gsub, Vector<Substitution> &v, const Coverage &limit) const
+GsubChainContext::f3_unparse(const Gsub &gsub, SubstitutionVisitor &v, const Coverage &limit) const
 {
     int nbacktrack = _d.u16(2);
     int input_offset = F3_HSIZE + nbacktrack*2;
@@ -1361,6 +1459,8 @@ GsubChainContext::f3_unparse(const Gsub &gsub, Vector<Substitution> &v, const Co
             right_begin[i] = *lookaheadi[i];
 
         any |= GsubContext::f3_unparse(_d, ninput, input_offset + F3_INPUT_HSIZE, limit, nsubst, subst_offset + F3_SUBST_HSIZE, gsub, v, s);
+        if (v.stopped())
+            break;
 
         // step iterators
         for (int i = nlookahead - 1; i >= 0; i--) {
@@ -1384,7 +1484,7 @@ GsubChainContext::f3_unparse(const Gsub &gsub, Vector<Substitution> &v, const Co
 }
 
 bool
-GsubChainContext::unparse(const Gsub &gsub, Vector<Substitution> &v, const Coverage &limit) const
+GsubChainContext::unparse(const Gsub &gsub, SubstitutionVisitor &v, const Coverage &limit) const
 {
     if (_d.u16(0) == 1)
         return f1_unparse(gsub, v, limit);
@@ -0,0 +1,149 @@
+// -*- related-file-name: "../include/efont/otfpairkern.hh" -*-
+
+/* otfpairkern.{cc,hh} -- compiled pair kerning
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <efont/otfpairkern.hh>
+#include <lcdf/error.hh>
+
+namespace Efont { namespace OpenType {
+
+CompiledPairKern::CompiledPairKern()
+{
+}
+
+CompiledPairKern::~CompiledPairKern()
+{
+    for (Layer **l = _layers.begin(); l != _layers.end(); ++l)
+        delete *l;
+    for (CompiledClassDef **c = _class2.begin(); c != _class2.end(); ++c)
+        delete *c;
+}
+
+void
+CompiledPairKern::add_pair(Layer *l, Glyph a, Glyph b, int value, bool sum)
+{
+    if (uint32_t key = pair_key(a, b)) {
+        int &v = l->pairs.find_force(key);
+        if (v == NONE)
+            v = value;
+        else if (sum)
+            v += value;
+    }
+}
+
+bool
+CompiledPairKern::add(const GposLookup &lookup)
+{
+    if (lookup._type != GposLookup::L_PAIR)
+        return false;
+
+    // only the first glyph's x advance can be represented
+    enum { DEVICES = GposValue::F_XPLACEMENT_DEVICE | GposValue::F_YPLACEMENT_DEVICE
+           | GposValue::F_XADVANCE_DEVICE | GposValue::F_YADVANCE_DEVICE };
+    int nsub = lookup._d.u16(4);
+    for (int i = 0; i < nsub; i++) {
+        GposPair p(lookup.subtable(i));
+        if ((p._d.u16(4) & ~(GposValue::F_XADVANCE | DEVICES)) != 0
+            || (p._d.u16(6) & ~DEVICES) != 0)
+            return false;
+    }
+
+    // A first glyph belongs to the first class-based subtable that covers
+    // it; explicit pairs from later subtables can't apply to it.
+    Layer *l = new Layer;
+    try {
+        for (int i = 0; i < nsub; i++) {
+            GposPair p(lookup.subtable(i));
+            const Data &d = p._d;
+            Coverage coverage = p.coverage();
+            int format1 = d.u16(4);
+            int format2 = d.u16(6);
+            if (d[1] == 1) {
+                int f2_pos = GposPair::PAIRVALUE_HEADERSIZE + GposValue::size(format1);
+                int pairvalue_size = f2_pos + GposValue::size(format2);
+                for (Coverage::iterator it = coverage.begin(); it; ++it) {
+                    Glyph a = *it;
+                    if (a < l->first_sub.size() && l->first_sub[a] >= 0)
+                        continue;
+                    Data pairset = d.offset_subtable(GposPair::F1_HEADERSIZE + it.coverage_index()*GposPair::F1_RECSIZE);
+                    int npair = pairset.u16(0);
+                    for (int j = 0; j < npair; j++) {
+                        Data pair = pairset.subtable(GposPair::PAIRSET_HEADERSIZE + j*pairvalue_size);
+                        add_pair(l, a, pair.u16(0), GposValue::xadvance(format1, pair.subtable(GposPair::PAIRVALUE_HEADERSIZE)), false);
+                    }
+                }
+            } else {
+                int recsize = GposValue::size(format1) + GposValue::size(format2);
+                ClassDef class1(d.offset_subtable(8));
+                int nclass1 = d.u16(12);
+                int nclass2 = d.u16(14);
+                int sub = _class2.size();
+                _class2.push_back(new CompiledClassDef(ClassDef(d.offset_subtable(10))));
+                _nclass2.push_back(nclass2);
+                int base = _matrix.size();
+                for (int c = 0; c < nclass1 * nclass2; c++)
+                    _matrix.push_back(GposValue::xadvance(format1, d.subtable(GposPair::F2_HEADERSIZE + c*recsize)));
+                for (Coverage::iterator it = coverage.begin(); it; ++it) {
+                    Glyph a = *it;
+                    int c1 = class1.lookup(a);
+                    if (c1 < 0)
+                        c1 = 0;
+                    if (c1 >= nclass1
+                        || (a < l->first_sub.size() && l->first_sub[a] >= 0))
+                        continue;
+                    if (a >= l->first_sub.size()) {
+                        l->first_sub.resize(a + 1, -1);
+                        l->first_row.resize(a + 1, 0);
+                    }
+                    l->first_sub[a] = sub;
+                    l->first_row[a] = base + c1 * nclass2;
+                }
+            }
+        }
+    } catch (...) {
+        delete l;
+        throw;
+    }
+    _layers.push_back(l);
+    return true;
+}
+
+void
+CompiledPairKern::add(const KernTable &kern, ErrorHandler *errh)
+{
+    Vector<Positioning> poss;
+    kern.unparse_automatics(poss, errh);
+    Layer *l = new Layer;
+    for (Positioning *p = poss.begin(); p != poss.end(); ++p)
+        add_pair(l, p->left_glyph(), p->right_glyph(), p->left().adx, true);
+    _layers.push_back(l);
+}
+
+void
+CompiledPairKern::kern(const Glyph *g, int n, int *out) const
+{
+    for (int i = 0; i < n; i++)
+        out[i] = 0;
+    for (Layer * const *l = _layers.begin(); l != _layers.end(); ++l)
+        for (int i = 0; i < n - 1; i++)
+            out[i] += layer_kern(*l, g[i], g[i + 1]);
+}
+
+}}
+
+// template instantiations
+#include <lcdf/vector.cc>
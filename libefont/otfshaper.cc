@@ -0,0 +1,321 @@
+// -*- related-file-name: "../include/efont/otfshaper.hh" -*-
+
+/* otfshaper.{cc,hh} -- apply OpenType lookups to glyph runs
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <efont/otfshaper.hh>
+#include <lcdf/error.hh>
+#include <algorithm>
+
+namespace Efont { namespace OpenType {
+
+
+/**************************
+ * ShapeBuffer            *
+ *                        *
+ **************************/
+
+void
+ShapeBuffer::clear()
+{
+    _glyphs.clear();
+    _clusters.clear();
+    _pos.clear();
+    _run_ends.clear();
+}
+
+void
+ShapeBuffer::add(Glyph g, int cluster)
+{
+    _glyphs.push_back(g);
+    _clusters.push_back(cluster);
+}
+
+void
+ShapeBuffer::end_run()
+{
+    if (_glyphs.size() > (_run_ends.size() ? _run_ends.back() : 0))
+        _run_ends.push_back(_glyphs.size());
+}
+
+
+/**************************
+ * Shaper                 *
+ *                        *
+ **************************/
+
+Shaper::Shaper(const Font &otf, ErrorHandler *errh)
+    : _gsub(0), _gpos(0), _gdef(0), _nhmtx(0)
+{
+    if (!errh)
+        errh = ErrorHandler::silent_handler();
+    try {
+        _gsub = new Gsub(otf.table("GSUB"), &otf, errh);
+    } catch (BlankTable) {
+    } catch (Error e) {
+        errh->warning("%s, ignoring GSUB", e.description.c_str());
+    }
+    try {
+        _gpos = new Gpos(otf.table("GPOS"), errh);
+    } catch (BlankTable) {
+    } catch (Error e) {
+        errh->warning("%s, ignoring GPOS", e.description.c_str());
+    }
+    try {
+        _gdef = new Gdef(otf.table("GDEF"), errh);
+    } catch (BlankTable) {
+    } catch (Error e) {
+        errh->warning("%s, ignoring GDEF", e.description.c_str());
+    }
+
+    // advance widths, for cursive attachment
+    Data hhea = otf.table("hhea");
+    _hmtx = otf.table("hmtx");
+    if (hhea.length() >= 36)
+        _nhmtx = hhea.u16(34);
+    if (_nhmtx * 4 > _hmtx.length())
+        _nhmtx = _hmtx.length() / 4;
+}
+
+Shaper::~Shaper()
+{
+    clear_stages();
+    delete _gsub;
+    delete _gpos;
+    delete _gdef;
+}
+
+int
+Shaper::advance_width(Glyph g) const
+{
+    if (g < 0 || _nhmtx == 0)
+        return 0;
+    else if (g < _nhmtx)
+        return _hmtx.u16(g * 4);
+    else
+        return _hmtx.u16((_nhmtx - 1) * 4);
+}
+
+void
+Shaper::clear_stages()
+{
+    for (Stage *s = _gpos_stages.begin(); s != _gpos_stages.end(); ++s)
+        delete s->kern;
+    _gsub_stages.clear();
+    _gpos_stages.clear();
+}
+
+template <typename T> void
+Shaper::select_stages(const T *table, Tag script, Tag langsys,
+                      const Vector<Tag> &sorted_features,
+                      Vector<Stage> &stages, ErrorHandler *errh)
+{
+    stages.clear();
+    Vector<int> lookups;
+    if (!table
+        || table->feature_list().lookups(table->script_list(), script, langsys, sorted_features, lookups, errh) < 0)
+        return;
+    for (int *it = lookups.begin(); it != lookups.end(); ++it)
+        try {
+            Stage s;
+            s.lookup = *it;
+            s.flags = table->lookup(*it).flags();
+            s.mark_set = -1;
+            s.kern = 0;
+            if (s.flags & Gdef::F_USE_MARK_FILTERING_SET)
+                s.mark_set = table->lookup(*it).mark_filtering_set();
+            stages.push_back(s);
+        } catch (Error e) {
+            errh->warning("%s, ignoring lookup %d", e.description.c_str(), *it);
+        }
+}
+
+int
+Shaper::select(Tag script, Tag langsys, const Vector<Tag> &features,
+               ErrorHandler *errh)
+{
+    if (!errh)
+        errh = ErrorHandler::silent_handler();
+    Vector<Tag> sorted_features(features);
+    std::sort(sorted_features.begin(), sorted_features.end());
+    clear_stages();
+    select_stages(_gsub, script, langsys, sorted_features, _gsub_stages, errh);
+    select_stages(_gpos, script, langsys, sorted_features, _gpos_stages, errh);
+
+    for (Stage *s = _gpos_stages.begin(); s != _gpos_stages.end(); ++s) {
+        CompiledPairKern *kern = new CompiledPairKern;
+        try {
+            if (kern->add(_gpos->lookup(s->lookup))) {
+                s->kern = kern;
+                continue;
+            }
+        } catch (Error) {
+        }
+        delete kern;
+    }
+    return 0;
+}
+
+// Collects the glyphs in buf[begin, end) that 'stage' doesn't ignore:
+// _view holds their indexes, _view_glyphs the glyphs themselves.
+void
+Shaper::make_view(const Stage &stage, const ShapeBuffer &buf, int begin, int end)
+{
+    _view.clear();
+    _view_glyphs.clear();
+    for (int i = begin; i < end; ++i) {
+        Glyph g = buf._glyphs[i];
+        if (!_gdef || !_gdef->ignores(g, stage.flags, stage.mark_set)) {
+            _view.push_back(i);
+            _view_glyphs.push_back(g);
+        }
+    }
+}
+
+void
+Shaper::substitute(const Stage &stage, ShapeBuffer &buf)
+{
+    GsubLookup l = _gsub->lookup(stage.lookup);
+    const GlyphSet &first = _gsub->lookup_glyphs(stage.lookup);
+    Substitution s;
+    _out_glyphs.clear();
+    _out_clusters.clear();
+    _out_run_ends.clear();
+
+    for (int r = 0, i = 0; r < buf._run_ends.size(); ++r) {
+        int end = buf._run_ends[r];
+        make_view(stage, buf, i, end);
+        // 'consumed' is the view position after the last ligature
+        // component; components are dropped from the output
+        int v = 0, consumed = 0;
+        for (; i < end; ++i) {
+            if (v < _view.size() && _view[v] == i) {
+                if (v < consumed) {
+                    ++v;
+                    continue;
+                }
+                if (first.covers(_view_glyphs[v])
+                    && l.apply(_view_glyphs.begin(), v, _view.size(), s)) {
+                    int cluster = buf._clusters[i];
+                    if (s.is_alternate()) {
+                        _out_glyphs.push_back(s.out_glyph(0));
+                        _out_clusters.push_back(cluster);
+                    } else
+                        for (int k = 0; k < s.out_nglyphs(); ++k) {
+                            _out_glyphs.push_back(s.out_glyph(k));
+                            _out_clusters.push_back(cluster);
+                        }
+                    consumed = v + (s.is_ligature() ? s.in_nglyphs() : 1);
+                    ++v;
+                    continue;
+                }
+                ++v;
+            }
+            _out_glyphs.push_back(buf._glyphs[i]);
+            _out_clusters.push_back(buf._clusters[i]);
+        }
+        _out_run_ends.push_back(_out_glyphs.size());
+    }
+
+    buf._glyphs.swap(_out_glyphs);
+    buf._clusters.swap(_out_clusters);
+    buf._run_ends.swap(_out_run_ends);
+}
+
+void
+Shaper::position(const Stage &stage, ShapeBuffer &buf)
+{
+    GposLookup l = _gpos->lookup(stage.lookup);
+    const GlyphSet &first = _gpos->lookup_glyphs(stage.lookup);
+    bool cursive = l.type() == GposLookup::L_CURSIVE;
+    Positioning p;
+
+    for (int r = 0, begin = 0; r < buf._run_ends.size(); begin = buf._run_ends[r], ++r) {
+        make_view(stage, buf, begin, buf._run_ends[r]);
+        const Glyph *g = _view_glyphs.begin();
+        int n = _view.size();
+        if (stage.kern) {
+            for (int v = 0; v < n - 1; ++v)
+                buf._pos[_view[v]].adx += stage.kern->kern(g[v], g[v + 1]);
+            continue;
+        }
+        for (int v = 0; v < n; ++v) {
+            if (!first.covers(g[v]))
+                continue;
+            Position &pos = buf._pos[_view[v]];
+            int exit_x, exit_y, entry_x, entry_y;
+            if (cursive) {
+                if (l.apply_cursive(g, v, n, exit_x, exit_y, entry_x, entry_y)) {
+                    // end this glyph's advance at its exit anchor, and
+                    // move the next glyph's entry anchor there
+                    Position &next = buf._pos[_view[v + 1]];
+                    pos.adx = exit_x + pos.pdx - advance_width(g[v]);
+                    int d = entry_x + next.pdx;
+                    next.adx -= d;
+                    next.pdx -= d;
+                    next.pdy = pos.pdy + exit_y - entry_y;
+                }
+            } else if (l.apply(g, v, n, p)) {
+                const Position &left = p.left();
+                pos.pdx += left.pdx;
+                pos.pdy += left.pdy;
+                pos.adx += left.adx;
+                pos.ady += left.ady;
+                if (p.is_pair()) {
+                    Position &next = buf._pos[_view[v + 1]];
+                    const Position &right = p.right();
+                    next.pdx += right.pdx;
+                    next.pdy += right.pdy;
+                    next.adx += right.adx;
+                    next.ady += right.ady;
+                }
+            }
+        }
+    }
+}
+
+void
+Shaper::shape(ShapeBuffer &buf)
+{
+    buf.end_run();
+
+    for (const Stage *s = _gsub_stages.begin(); s != _gsub_stages.end(); ++s)
+        try {
+            substitute(*s, buf);
+        } catch (Error) {
+            // leave the buffer as it was before this lookup
+        }
+
+    buf._pos.clear();
+    for (int i = 0; i < buf._glyphs.size(); ++i)
+        buf._pos.push_back(Position(buf._glyphs[i], 0, 0, 0, 0));
+
+    for (const Stage *s = _gpos_stages.begin(); s != _gpos_stages.end(); ++s) {
+        // kerning tables can't fail; other lookups may fail partway
+        if (!s->kern)
+            _saved_pos = buf._pos;
+        try {
+            position(*s, buf);
+        } catch (Error) {
+            buf._pos.swap(_saved_pos);
+        }
+    }
+}
+
+}}
+
+// template instantiations
+#include <lcdf/vector.cc>
@@ -17,9 +17,17 @@
 # include <config.h>
 #endif
 #include <efont/t1bounds.hh>
+#include <efont/t1fastinterp.hh>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <typeinfo>
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_PTHREAD_CREATE)
+# include <pthread.h>
+# define USE_THREADS 1
+#endif
 
 namespace Efont {
 
@@ -52,13 +60,10 @@ CharstringBounds::clear()
 void
 CharstringBounds::xf_mark(const Bezier &b)
 {
-    Bezier b1, b2;
-    b.halve(b1, b2);
-    xf_mark(b1.point(3));
-    if (!xf_controls_inside(b1))
-        xf_mark(b1);
-    if (!xf_controls_inside(b2))
-        xf_mark(b2);
+    Point bl, tr;
+    b.exact_bb(bl, tr);
+    xf_mark(bl);
+    xf_mark(tr);
 }
 
 void
@@ -91,6 +96,25 @@ CharstringBounds::act_curve(int, const Point &p0, const Point &p1, const Point &
     }
 }
 
+namespace {
+// Reports a CharstringFastInterp's outlines to a CharstringBounds without
+// virtual dispatch.
+class FastBounds : public CharstringFastInterp<FastBounds> { public:
+    FastBounds(CharstringBounds &b)             : _b(b) { }
+    void act_width(int cmd, const Point &w) {
+        _b.CharstringBounds::act_width(cmd, w);
+    }
+    void act_line(int cmd, const Point &p0, const Point &p1) {
+        _b.CharstringBounds::act_line(cmd, p0, p1);
+    }
+    void act_curve(int cmd, const Point &p0, const Point &p1, const Point &p2, const Point &p3) {
+        _b.CharstringBounds::act_curve(cmd, p0, p1, p2, p3);
+    }
+  private:
+    CharstringBounds &_b;
+};
+}
+
 void
 CharstringBounds::set_xf(const CharstringProgram *program)
 {
@@ -108,7 +132,15 @@ bool
 CharstringBounds::char_bounds(const CharstringContext &g, bool shift)
 {
     set_xf(g.program);
-    CharstringInterp::interpret(g);
+    // Most charstrings take the fast path. Subclasses may override the
+    // actions, so they, and charstrings the fast path can't finish, go
+    // through CharstringInterp; marks and widths the fast path already
+    // made are harmless, since the interpreter makes them again.
+    if (!careful() && typeid(*this) == typeid(CharstringBounds)
+        && FastBounds(*this).interpret(g))
+        error(errOK);
+    else
+        CharstringInterp::interpret(g);
     if (shift) {
         _xf.raw_translate(_width - _xf.translation());
         _nonfont_xf.raw_translate(_width - _nonfont_xf.translation());
@@ -162,4 +194,95 @@ CharstringBounds::bounds(const CharstringContext &g,
     return b.output(bb, width, true);
 }
 
+
+
+CharstringBoundsTable::CharstringBoundsTable(const CharstringProgram *program,
+                                             const Transform &xf)
+    : _program(program), _xf(xf)
+{
+    int n = std::max(program->nglyphs(), 0);
+    _state.assign(n, S_UNKNOWN);
+    _xmin.assign(n, 0);
+    _ymin.assign(n, 0);
+    _xmax.assign(n, 0);
+    _ymax.assign(n, 0);
+    _width.assign(n, 0);
+}
+
+void
+CharstringBoundsTable::compute(int gi)
+{
+    double bb[4], width;
+    bool ok = CharstringBounds::bounds(_xf, _program->glyph_context(gi), bb, width);
+    _xmin[gi] = bb[0];
+    _ymin[gi] = bb[1];
+    _xmax[gi] = bb[2];
+    _ymax[gi] = bb[3];
+    _width[gi] = width;
+    _state[gi] = (ok ? S_OK : S_ERROR);
+}
+
+bool
+CharstringBoundsTable::bounds(int gi, double bb[4], double &width)
+{
+    if (gi < 0 || gi >= size())
+        return CharstringBounds::bounds(_xf, _program->glyph_context(gi), bb, width);
+    if (_state[gi] == S_UNKNOWN)
+        compute(gi);
+    bb[0] = _xmin[gi];
+    bb[1] = _ymin[gi];
+    bb[2] = _xmax[gi];
+    bb[3] = _ymax[gi];
+    width = _width[gi];
+    return _state[gi] == S_OK;
+}
+
+// Threads claim glyphs in chunks; each glyph is written by one thread.
+struct CharstringBoundsTable::Work {
+    CharstringBoundsTable *table;
+    std::atomic<int> next;
+    enum { CHUNK = 64 };
+};
+
+void *
+CharstringBoundsTable::compute_thread(void *arg)
+{
+    Work *w = static_cast<Work *>(arg);
+    CharstringBoundsTable *t = w->table;
+    int n = t->size();
+    for (int gi; (gi = w->next.fetch_add(Work::CHUNK)) < n; )
+        for (int end = std::min(gi + (int) Work::CHUNK, n); gi < end; ++gi)
+            if (t->_state[gi] == S_UNKNOWN)
+                t->compute(gi);
+    return 0;
+}
+
+void
+CharstringBoundsTable::compute_all(int nthreads)
+{
+    Work w;
+    w.table = this;
+    w.next = 0;
+#if USE_THREADS
+    // the calling thread computes too
+    if (!_program->thread_safe())
+        nthreads = 1;
+    Vector<pthread_t> threads;
+    for (int i = 1; i < nthreads && i * Work::CHUNK < size(); ++i) {
+        pthread_t t;
+        if (pthread_create(&t, 0, compute_thread, &w) == 0)
+            threads.push_back(t);
+    }
+    compute_thread(&w);
+    for (pthread_t *t = threads.begin(); t != threads.end(); ++t)
+        pthread_join(*t, 0);
+#else
+    (void) nthreads;
+    compute_thread(&w);
+#endif
+}
+
 } // namespace Efont
+
+// template instantiations
+#include <lcdf/vector.cc>
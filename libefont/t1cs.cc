@@ -19,6 +19,7 @@
 #include <efont/t1cs.hh>
 #include <efont/t1interp.hh>
 #include <string.h>
+#include <typeinfo>
 namespace Efont {
 
 const char * const Charstring::command_names[] = {
@@ -148,9 +149,12 @@ Type1Charstring::decrypt() const
 bool
 Type1Charstring::process(CharstringInterp &interp) const
 {
-    const uint8_t *data = Type1Charstring::data();
-    int left = _s.length();
+    return process_data(Type1Charstring::data(), _s.length(), interp);
+}
 
+bool
+Type1Charstring::process_data(const uint8_t *data, int left, CharstringInterp &interp)
+{
     while (left > 0) {
         bool more;
         int ahead;
@@ -259,9 +263,12 @@ Type1Charstring::assign_substring(int pos, int len, const String &cs)
 bool
 Type2Charstring::process(CharstringInterp &interp) const
 {
-    const uint8_t *data = Type2Charstring::data();
-    int left = _s.length();
+    return process_data(Type2Charstring::data(), _s.length(), interp);
+}
 
+bool
+Type2Charstring::process_data(const uint8_t *data, int left, CharstringInterp &interp)
+{
     while (left > 0) {
         bool more;
         int ahead;
@@ -326,6 +333,69 @@ Type2Charstring::process(CharstringInterp &interp) const
 }
 
 
+bool
+CharstringView::assign(const Charstring *cs)
+{
+    if (!cs)
+        return false;
+    // Exact types first: a failed dynamic_cast costs as much as
+    // interpreting a short charstring.
+    const std::type_info &type = typeid(*cs);
+    if (type == typeid(Type1Charstring)) {
+        const Type1Charstring *t1 = static_cast<const Type1Charstring *>(cs);
+        _type = 1;
+        _data = t1->data();     // decrypts, so must precede length()
+        _len = t1->length();
+    } else if (type == typeid(Type2Charstring)) {
+        const Type2Charstring *t2 = static_cast<const Type2Charstring *>(cs);
+        _type = 2;
+        _data = t2->data();
+        _len = t2->length();
+    } else if (const CharstringView *v = dynamic_cast<const CharstringView *>(cs))
+        *this = *v;
+    else if (const Type2Charstring *t2 = dynamic_cast<const Type2Charstring *>(cs)) {
+        _type = 2;
+        _data = t2->data();
+        _len = t2->length();
+    } else if (const Type1Charstring *t1 = dynamic_cast<const Type1Charstring *>(cs)) {
+        _type = 1;
+        _data = t1->data();     // decrypts, so must precede length()
+        _len = t1->length();
+    } else
+        return false;
+    return true;
+}
+
+bool
+CharstringView::process(CharstringInterp &interp) const
+{
+    if (_type == 1)
+        return Type1Charstring::process_data(_data, _len, interp);
+    else
+        return Type2Charstring::process_data(_data, _len, interp);
+}
+
+
+CharstringCache::~CharstringCache()
+{
+    for (int i = 0; i < _n; i++)
+        delete _cs[i].load(std::memory_order_relaxed);
+    delete[] _cs;
+}
+
+void
+CharstringCache::assign(int n)
+{
+    for (int i = 0; i < _n; i++)
+        delete _cs[i].load(std::memory_order_relaxed);
+    delete[] _cs;
+    _cs = (n > 0 ? new std::atomic<Charstring *>[n] : 0);
+    _n = (n > 0 ? n : 0);
+    for (int i = 0; i < _n; i++)
+        _cs[i].store(0, std::memory_order_relaxed);
+}
+
+
 CharstringProgram::CharstringProgram(unsigned units_per_em)
     : _parent_program(false),
       _units_per_em(units_per_em ? units_per_em : 1000) {
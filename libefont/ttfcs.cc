@@ -28,7 +28,7 @@ typedef OpenType::Glyph Glyph;
 
 TrueTypeBoundsCharstringProgram::TrueTypeBoundsCharstringProgram(const OpenType::Font* otf)
     : CharstringProgram(otf->units_per_em()),
-      _otf(otf), _nglyphs(-1), _loca_long(false),
+      _otf(otf), _nglyphs(-1), _nhmtx(0), _loca_long(false),
       _loca(otf->table("loca")), _glyf(otf->table("glyf")),
       _hmtx(otf->table("hmtx")), _got_glyph_names(false), _got_unicodes(false)
 {
@@ -44,6 +44,7 @@ TrueTypeBoundsCharstringProgram::TrueTypeBoundsCharstringProgram(const OpenType:
     int loca_onesize = (_loca_long ? 4 : 2);
     if (_nglyphs >= _loca.length() / loca_onesize)
         _nglyphs = (_loca.length() / loca_onesize) - 1;
+    _charstrings.assign(_nglyphs);
 
     // horizontal metrics
     OpenType::Data hhea(_otf->table("hhea"));
@@ -74,8 +75,6 @@ TrueTypeBoundsCharstringProgram::TrueTypeBoundsCharstringProgram(const OpenType:
 
 TrueTypeBoundsCharstringProgram::~TrueTypeBoundsCharstringProgram()
 {
-    for (Charstring **cs = _charstrings.begin(); cs < _charstrings.end(); cs++)
-        delete *cs;
 }
 
 void TrueTypeBoundsCharstringProgram::font_matrix(double matrix[6]) const {
@@ -96,6 +95,8 @@ TrueTypeBoundsCharstringProgram::glyph_name(int gi) const
     if (gi == 0)
         return PermString(".notdef");
 
+    std::lock_guard<std::mutex> guard(_lock);
+
     // try 'post' table glyph names
     if (!_got_glyph_names) {
         OpenType::Post post(_otf->table("post"));
@@ -121,23 +122,15 @@ TrueTypeBoundsCharstringProgram::glyph_name(int gi) const
     if (!_got_unicodes) {
         OpenType::Cmap cmap(_otf->table("cmap"));
         if (cmap.ok()) {
-            Vector<std::pair<uint32_t, Glyph> > ugp;
-            cmap.unmap_all(ugp);
-            std::sort(ugp.begin(), ugp.end());
-            for (Vector<std::pair<uint32_t, Glyph> >::iterator it = ugp.begin();
-                 it != ugp.end(); ) {
-                Vector<std::pair<uint32_t, Glyph> >::iterator nit = it + 1;
-                // ignore code points with multiple glyph mappings
-                if (nit == ugp.end() || nit->first != it->first) {
-                    if (it->second >= _unicodes.size())
-                        _unicodes.resize(it->second + 1, 0);
-                    if (!_unicodes[it->second])
-                        _unicodes[it->second] = it->first;
-                } else
-                    while (nit != ugp.end() && nit->first == it->first)
-                        ++nit;
-                it = nit;
-            }
+            // use each glyph's lowest code point; unmap() already ignores
+            // code points with multiple glyph mappings
+            _unicodes.assign(_nglyphs, 0);
+            Vector<uint32_t> us;
+            for (int g = 0; g < _nglyphs; ++g)
+                if (cmap.unmap(g, us)) {
+                    _unicodes[g] = us[0];
+                    us.clear();
+                }
         }
         _got_unicodes = true;
     }
@@ -163,70 +156,79 @@ TrueTypeBoundsCharstringProgram::glyph(int gi) const
 {
     if (gi < 0 || gi >= _nglyphs)
         return 0;
-    if (_charstrings.size() <= gi)
-        _charstrings.resize(gi + 1, (Charstring *) 0);
-    if (!_charstrings[gi]) {
-        // calculate glyf offsets
-        uint32_t offset, end_offset;
-        if (_loca_long) {
-            offset = _loca.u32(gi * 4);
-            end_offset = _loca.u32(gi * 4 + 4);
-        } else {
-            offset = _loca.u16(gi * 2) * 2;
-            end_offset = _loca.u16(gi * 2 + 2) * 2;
+    Charstring *cs = _charstrings.get(gi);
+    if (!cs) {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (!(cs = _charstrings.get(gi))) {
+            cs = make_glyph(gi);
+            _charstrings.set(gi, cs);
         }
+    }
+    return cs;
+}
 
-        // fetch bounding box from glyf
-        int ncontours, xmin, ymin, xmax, ymax;
-        if (offset != end_offset) {
-            if (offset > end_offset || offset + 10 > end_offset
-                || end_offset > (uint32_t) _glyf.length())
-                return 0;
-
-            ncontours = _glyf.s16(offset);
-            xmin = _glyf.s16(offset + 2);
-            ymin = _glyf.s16(offset + 4);
-            xmax = _glyf.s16(offset + 6);
-            ymax = _glyf.s16(offset + 8);
-        } else
-            ncontours = xmin = ymin = xmax = ymax = 0;
-
-        // fetch horizontal metrics
-        int advance_width, lsb;
-        if (gi >= _nhmtx) {
-            advance_width = (_nhmtx ? _hmtx.u16((_nhmtx - 1) * 4) : 0);
-            int hmtx_offset = _nhmtx * 4 + (gi - _nhmtx) * 2;
-            lsb = (hmtx_offset + 2 <= _hmtx.length() ? _hmtx.s16(hmtx_offset) : 0);
-        } else {
-            advance_width = _hmtx.u16(gi * 4);
-            lsb = _hmtx.s16(gi * 4 + 2);
-        }
+Charstring *
+TrueTypeBoundsCharstringProgram::make_glyph(int gi) const
+{
+    // calculate glyf offsets
+    uint32_t offset, end_offset;
+    if (_loca_long) {
+        offset = _loca.u32(gi * 4);
+        end_offset = _loca.u32(gi * 4 + 4);
+    } else {
+        offset = _loca.u16(gi * 2) * 2;
+        end_offset = _loca.u16(gi * 2 + 2) * 2;
+    }
 
-        // make charstring
-        Type1CharstringGen gen;
-        if (ncontours == 0) {
-            gen.gen_number(0, 'X');
-            gen.gen_number(advance_width);
-            gen.gen_command(Charstring::cHsbw);
-        } else {
-            gen.gen_number(lsb, 'X');
-            gen.gen_number(advance_width);
-            gen.gen_command(Charstring::cHsbw);
-            gen.gen_moveto(Point(xmin, ymin), false, false);
-            if (xmax != xmin || ymax == ymin)
-                gen.gen_number(xmax - xmin, 'x');
-            if (ymax != ymin)
-                gen.gen_number(ymax - ymin, 'y');
-            gen.gen_command(ymax == ymin ? Charstring::cHlineto
-                            : (xmax == xmin ? Charstring::cVlineto
-                               : Charstring::cRlineto));
-            gen.gen_command(Charstring::cClosepath);
-        }
-        gen.gen_command(Charstring::cEndchar);
+    // fetch bounding box from glyf
+    int ncontours, xmin, ymin, xmax, ymax;
+    if (offset != end_offset) {
+        if (offset > end_offset || offset + 10 > end_offset
+            || end_offset > (uint32_t) _glyf.length())
+            return 0;
+
+        ncontours = _glyf.s16(offset);
+        xmin = _glyf.s16(offset + 2);
+        ymin = _glyf.s16(offset + 4);
+        xmax = _glyf.s16(offset + 6);
+        ymax = _glyf.s16(offset + 8);
+    } else
+        ncontours = xmin = ymin = xmax = ymax = 0;
+
+    // fetch horizontal metrics
+    int advance_width, lsb;
+    if (gi >= _nhmtx) {
+        advance_width = (_nhmtx ? _hmtx.u16((_nhmtx - 1) * 4) : 0);
+        int hmtx_offset = _nhmtx * 4 + (gi - _nhmtx) * 2;
+        lsb = (hmtx_offset + 2 <= _hmtx.length() ? _hmtx.s16(hmtx_offset) : 0);
+    } else {
+        advance_width = _hmtx.u16(gi * 4);
+        lsb = _hmtx.s16(gi * 4 + 2);
+    }
 
-        _charstrings[gi] = gen.output();
+    // make charstring
+    Type1CharstringGen gen;
+    if (ncontours == 0) {
+        gen.gen_number(0, 'X');
+        gen.gen_number(advance_width);
+        gen.gen_command(Charstring::cHsbw);
+    } else {
+        gen.gen_number(lsb, 'X');
+        gen.gen_number(advance_width);
+        gen.gen_command(Charstring::cHsbw);
+        gen.gen_moveto(Point(xmin, ymin), false, false);
+        if (xmax != xmin || ymax == ymin)
+            gen.gen_number(xmax - xmin, 'x');
+        if (ymax != ymin)
+            gen.gen_number(ymax - ymin, 'y');
+        gen.gen_command(ymax == ymin ? Charstring::cHlineto
+                        : (xmax == xmin ? Charstring::cVlineto
+                           : Charstring::cRlineto));
+        gen.gen_command(Charstring::cClosepath);
     }
-    return _charstrings[gi];
+    gen.gen_command(Charstring::cEndchar);
+
+    return gen.output();
 }
 
 }
@@ -68,8 +68,43 @@ KernTable::KernTable(const Data &d, ErrorHandler *)
     _error = 0;
 }
 
+namespace {
+class PositioningAccum : public PositioningVisitor { public:
+    PositioningAccum(Vector<Positioning> &v) : _v(v) { }
+    bool visit(const Positioning &p) { _v.push_back(p); return true; }
+  private:
+    Vector<Positioning> &_v;
+};
+}
+
 bool
 KernTable::unparse_automatics(Vector<Positioning> &v, ErrorHandler *errh) const
+{
+    PositioningAccum accum(v);
+    return unparse(accum, 0, errh);
+}
+
+bool
+KernTable::unparse_automatics(Vector<Positioning> &v, const Coverage &limit, ErrorHandler *errh) const
+{
+    PositioningAccum accum(v);
+    return unparse(accum, &limit, errh);
+}
+
+bool
+KernTable::unparse_automatics(PositioningVisitor &v, ErrorHandler *errh) const
+{
+    return unparse(v, 0, errh);
+}
+
+bool
+KernTable::unparse_automatics(PositioningVisitor &v, const Coverage &limit, ErrorHandler *errh) const
+{
+    return unparse(v, &limit, errh);
+}
+
+bool
+KernTable::unparse(PositioningVisitor &v, const Coverage *limit, ErrorHandler *errh) const
 {
     uint32_t ntables = this->ntables();
     uint32_t off = first_offset();
@@ -77,7 +112,7 @@ KernTable::unparse_automatics(Vector<Positioning> &v, ErrorHandler *errh) const
     if (_error < 0)
         return false;
 
-    for (uint16_t i = 0; i < ntables; ++i) {
+    for (uint16_t i = 0; i < ntables && !v.stopped(); ++i) {
         Data subt = _d.subtable(off);
         uint16_t coverage = subt.u16(4);
 
@@ -98,9 +133,12 @@ KernTable::unparse_automatics(Vector<Positioning> &v, ErrorHandler *errh) const
             uint32_t off = (_version ? 16 : 14);
             uint16_t npairs = subt.u16(off - 8);
             for (uint16_t j = 0; j < npairs; ++j, off += 6) {
-                v.push_back(Positioning(Position(subt.u16(off), 0, 0, subt.s16(off + 4), 0),
-                                        Position(subt.u16(off + 2), 0, 0, 0, 0)));
+                Glyph left = subt.u16(off), right = subt.u16(off + 2);
                 ++success;
+                if ((!limit || (limit->covers(left) && limit->covers(right)))
+                    && !v.emit(Positioning(Position(left, 0, 0, subt.s16(off + 4), 0),
+                                           Position(right, 0, 0, 0, 0))))
+                    break;
             }
         } catch (Error e) {
             if (errh)
@@ -17,6 +17,8 @@
 # include <config.h>
 #endif
 #include <lcdf/bezier.hh>
+#include <math.h>
+#include <algorithm>
 
 //
 // bounding box
@@ -39,6 +41,80 @@ Bezier::make_bb() const noexcept
 }
 
 
+//
+// exact bounding box
+//
+// A cubic's extremes along an axis are at its endpoints or where its
+// derivative, the quadratic a*t^2 + b*t + c below, is zero. Roots outside
+// [0, 1] are clamped, which evaluates an endpoint instead.
+//
+
+static inline double
+eval_cubic(double p0, double p1, double p2, double p3, double t)
+{
+    double m = 1.0 - t;
+    return m*m*m*p0 + 3*m*m*t*p1 + 3*m*t*t*p2 + t*t*t*p3;
+}
+
+static inline double
+clamp01(double t)
+{
+    return t < 0 ? 0 : (t > 1 ? 1 : t);
+}
+
+static inline void
+cubic_extent(double p0, double p1, double p2, double p3,
+	     double &lo, double &hi)
+{
+    double a = -p0 + 3*p1 - 3*p2 + p3;
+    double b = 2 * (p0 - 2*p1 + p2);
+    double c = p1 - p0;
+    double disc = b*b - 4*a*c;
+    double sq = sqrt(disc > 0 ? disc : 0);
+    // numerically stable roots: q/a and c/q
+    double q = -0.5 * (b + (b < 0 ? -sq : sq));
+    double t1 = (a != 0 ? q / a : 0);
+    double t2 = (q != 0 ? c / q : 0);
+    if (disc < 0)
+	t1 = t2 = 0;
+    double v1 = eval_cubic(p0, p1, p2, p3, clamp01(t1));
+    double v2 = eval_cubic(p0, p1, p2, p3, clamp01(t2));
+    lo = p0 < p3 ? p0 : p3;
+    hi = p0 < p3 ? p3 : p0;
+    lo = v1 < lo ? v1 : lo;
+    hi = v1 > hi ? v1 : hi;
+    lo = v2 < lo ? v2 : lo;
+    hi = v2 > hi ? v2 : hi;
+}
+
+void
+Bezier::exact_bb(Point &bl, Point &tr) const noexcept
+{
+    // an axis whose control values lie between its endpoints is monotone
+    bl.x = std::min(_p[0].x, _p[3].x);
+    tr.x = std::max(_p[0].x, _p[3].x);
+    if (_p[1].x < bl.x || _p[1].x > tr.x || _p[2].x < bl.x || _p[2].x > tr.x)
+	cubic_extent(_p[0].x, _p[1].x, _p[2].x, _p[3].x, bl.x, tr.x);
+    bl.y = std::min(_p[0].y, _p[3].y);
+    tr.y = std::max(_p[0].y, _p[3].y);
+    if (_p[1].y < bl.y || _p[1].y > tr.y || _p[2].y < bl.y || _p[2].y > tr.y)
+	cubic_extent(_p[0].y, _p[1].y, _p[2].y, _p[3].y, bl.y, tr.y);
+}
+
+// Finds the extents of n one-dimensional cubics stored as separate arrays
+// of control values, for instance all the x coordinates of a glyph's
+// curves. The loop body has no data-dependent branches, so compilers can
+// vectorize it.
+void
+Bezier::exact_extents(int n, const double *p0, const double *p1,
+		      const double *p2, const double *p3,
+		      double *lo, double *hi) noexcept
+{
+    for (int i = 0; i < n; i++)
+	cubic_extent(p0[i], p1[i], p2[i], p3[i], lo[i], hi[i]);
+}
+
+
 //
 // is_flat, eval
 //
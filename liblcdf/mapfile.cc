@@ -0,0 +1,52 @@
+// -*- related-file-name: "../include/lcdf/mapfile.hh" -*-
+
+/* mapfile.{cc,hh} -- map files into Strings
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <lcdf/mapfile.hh>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+# include <sys/mman.h>
+# define USE_MMAP 1
+#endif
+
+#if USE_MMAP
+static void
+unmap_data(const char *data, int len)
+{
+    munmap(const_cast<char *>(data), len);
+}
+#endif
+
+String
+map_file(FILE *f, int min_size)
+{
+#if USE_MMAP
+    struct stat s;
+    if (fstat(fileno(f), &s) < 0 || !S_ISREG(s.st_mode)
+	|| s.st_size <= 0 || s.st_size < min_size || s.st_size > INT_MAX)
+	return String();
+    void *m = mmap(0, s.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+    if (m == MAP_FAILED)
+	return String();
+    return String::make_external(static_cast<const char *>(m), s.st_size, unmap_data);
+#else
+    (void) f, (void) min_size;
+    return String();
+#endif
+}
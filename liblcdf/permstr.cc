@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <mutex>
 
 static PermString::Initializer initializer;
 
@@ -130,6 +131,8 @@ PermString::initialize(const char* s, int length)
 	hash = (hash << 1) + scatter[*mm];
     hash &= (NHASH - 1);
 
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
     Doodad *buck;
     for (buck = buckets[hash]; buck; buck = buck->next)
 	if (length == buck->length && memcmp(s, buck->data, length) == 0) {
@@ -148,9 +151,10 @@ PermString::initialize(const char* s, int length)
     _rep = buck->data;
 }
 
-static int pspos;
-static int pscap = 64;
-static char *psc = (char *)malloc(pscap);
+// permprintf's buffer, one per thread
+static thread_local int pspos;
+static thread_local int pscap = 64;
+static thread_local char *psc = (char *)malloc(pscap);
 
 static void
 append(const char *s, int len)
@@ -130,7 +130,13 @@ String::create_memo(char *space, int dirty, int capacity)
 void
 String::delete_memo(memo_t *memo)
 {
-    assert(memo->capacity > 0);
+    if (memo->capacity == 0) {
+	external_memo_t *xmemo = reinterpret_cast<external_memo_t *>(memo);
+	if (xmemo->free_function)
+	    xmemo->free_function(xmemo->data, xmemo->length);
+	delete xmemo;
+	return;
+    }
     assert(memo->capacity >= memo->dirty);
 #if HAVE_STRING_PROFILING
     int bucket = profile_memo_size_bucket(memo->dirty, memo->capacity);
@@ -267,6 +273,21 @@ String::make_stable(const char *s, int len)
     return String(s, len, 0);
 }
 
+String
+String::make_external(const char *s, int len,
+		      void (*free_function)(const char *, int))
+{
+    assert(s && len > 0);
+    external_memo_t *xmemo = new external_memo_t;
+    xmemo->memo.refcount = 0;
+    xmemo->memo.capacity = 0;
+    xmemo->memo.dirty = 0;
+    xmemo->data = s;
+    xmemo->length = len;
+    xmemo->free_function = free_function;
+    return String(s, len, &xmemo->memo);
+}
+
 String
 String::make_fill(int c, int len)
 {
@@ -404,8 +425,9 @@ String::append(const char *s, int len, memo_t *memo)
 	deref();
 	assign_memo(s, len, memo);
     } else if (likely(!(_r.memo
-			&& s >= _r.memo->real_data
-			&& s + len <= _r.memo->real_data + _r.memo->capacity))) {
+			&& (!_r.memo->capacity
+			    || (s >= _r.memo->real_data
+				&& s + len <= _r.memo->real_data + _r.memo->capacity))))) {
 	if (char *space = append_uninitialized(len))
 	    memcpy(space, s, len);
     } else {
@@ -429,14 +451,14 @@ String::append_fill(int c, int len)
 char *
 String::mutable_data()
 {
-    // If _memo has a capacity (it's not one of the special strings) and it's
-    // uniquely referenced, return _data right away.
-    if (_r.memo && _r.memo->refcount == 1)
+    // If _memo has a capacity (it's not one of the special or external
+    // strings) and it's uniquely referenced, return _data right away.
+    if (_r.memo && _r.memo->refcount == 1 && _r.memo->capacity)
 	return const_cast<char *>(_r.data);
 
     // Otherwise, make a copy of it. Rely on: deref() doesn't change _data or
-    // _length; and if _capacity == 0, then deref() doesn't free _real_data.
-    assert(!_r.memo || _r.memo->refcount > 1);
+    // _length; and the local copy keeps external data alive until the copy
+    // is made.
     // But in multithreaded situations we must hold a local copy of memo!
     String do_not_delete_underlying_memo(*this);
     deref();
@@ -25,6 +25,7 @@
 #include <lcdf/clp.h>
 #include <lcdf/error.hh>
 #include <lcdf/straccum.hh>
+#include <lcdf/mapfile.hh>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -48,6 +49,7 @@ using namespace Efont;
 #define QUIET_OPT		303
 #define VERBOSE_OPT		304
 #define SCRIPT_OPT		305
+#define FACE_OPT		306
 
 #define QUERY_SCRIPTS_OPT	320
 #define QUERY_FEATURES_OPT	321
@@ -63,6 +65,7 @@ using namespace Efont;
 
 const Clp_Option options[] = {
     { "script", 0, SCRIPT_OPT, Clp_ValString, 0 },
+    { "face", 0, FACE_OPT, Clp_ValInt, 0 },
     { "quiet", 'q', QUIET_OPT, 0, Clp_Negate },
     { "verbose", 'V', VERBOSE_OPT, 0, Clp_Negate },
     { "features", 'f', QUERY_FEATURES_OPT, 0, 0 },
@@ -128,6 +131,7 @@ Query options:\n\
 \n\
 Other options:\n\
       --script=SCRIPT[.LANG]   Set script used for --features [latn].\n\
+      --face=N                 Use face N of a font collection [all].\n\
   -V, --verbose                Print progress information to standard error.\n\
   -h, --help                   Print this message and exit.\n\
   -q, --quiet                  Do not generate any error messages.\n\
@@ -159,6 +163,13 @@ read_file(String filename, ErrorHandler *errh, bool warning = false)
 	return String();
     }
 
+    // map large files, such as fonts, rather than copying them
+    if (f != stdin)
+	if (String s = map_file(f, 65536)) {
+	    fclose(f);
+	    return s;
+	}
+
     StringAccum sa;
     int amt;
     do {
@@ -573,6 +584,34 @@ do_dump_table(const OpenType::Font &otf, OpenType::Tag tag, ErrorHandler *errh)
     }
 }
 
+static void
+do_query(const OpenType::Font &otf, int query, OpenType::Tag dump_table,
+	 ErrorHandler *errh, ErrorHandler *result_errh)
+{
+    if (query == QUERY_SCRIPTS_OPT)
+	do_query_scripts(otf, errh, result_errh);
+    else if (query == QUERY_FEATURES_OPT)
+	do_query_features(otf, errh, result_errh);
+    else if (query == QUERY_OPTICAL_SIZE_OPT)
+	do_query_optical_size(otf, errh, result_errh);
+    else if (query == QUERY_POSTSCRIPT_NAME_OPT)
+	do_query_postscript_name(otf, errh, result_errh);
+    else if (query == QUERY_GLYPHS_OPT)
+	do_query_glyphs(otf, errh, result_errh);
+    else if (query == QUERY_UNICODE_OPT)
+	do_query_unicode(otf, errh, result_errh);
+    else if (query == QUERY_FAMILY_OPT)
+	do_query_family_name(otf, errh, result_errh);
+    else if (query == QUERY_FVERSION_OPT)
+	do_query_font_version(otf, errh, result_errh);
+    else if (query == TABLES_OPT)
+	do_tables(otf, errh, result_errh);
+    else if (query == DUMP_TABLE_OPT)
+	do_dump_table(otf, dump_table, errh);
+    else if (query == INFO_OPT)
+	do_info(otf, errh, result_errh);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -584,6 +623,7 @@ main(int argc, char *argv[])
     Vector<const char *> input_files;
     OpenType::Tag dump_table;
     int query = 0;
+    int face = -1;
 
     while (1) {
 	int opt = Clp_Next(clp);
@@ -609,6 +649,12 @@ main(int argc, char *argv[])
 	      break;
 	  }
 
+	  case FACE_OPT:
+	    if (clp->val.i < 0)
+		usage_error(errh, "%<--face%> must be at least 0");
+	    face = clp->val.i;
+	    break;
+
 	  case QUERY_SCRIPTS_OPT:
 	  case QUERY_FEATURES_OPT:
 	  case QUERY_OPTICAL_SIZE_OPT:
@@ -689,36 +735,24 @@ particular purpose.\n");
 	if (errh->nerrors() != before_nerrors)
 	    continue;
 
+	// report on every face of a collection, unless --face says otherwise
 	String input_file = printable_filename(*input_filep);
-	LandmarkErrorHandler cerrh(errh, input_file);
-	OpenType::Font otf(font_data, &cerrh);
-	if (!otf.ok())
-	    continue;
-
-	PrefixErrorHandler stdout_cerrh(&stdout_errh, input_file + ":");
-	ErrorHandler *result_errh = (input_files.size() > 1 ? static_cast<ErrorHandler *>(&stdout_cerrh) : static_cast<ErrorHandler *>(&stdout_errh));
-	if (query == QUERY_SCRIPTS_OPT)
-	    do_query_scripts(otf, &cerrh, result_errh);
-	else if (query == QUERY_FEATURES_OPT)
-	    do_query_features(otf, &cerrh, result_errh);
-	else if (query == QUERY_OPTICAL_SIZE_OPT)
-	    do_query_optical_size(otf, &cerrh, result_errh);
-	else if (query == QUERY_POSTSCRIPT_NAME_OPT)
-	    do_query_postscript_name(otf, &cerrh, result_errh);
-	else if (query == QUERY_GLYPHS_OPT)
-	    do_query_glyphs(otf, &cerrh, result_errh);
-	else if (query == QUERY_UNICODE_OPT)
-	    do_query_unicode(otf, &cerrh, result_errh);
-	else if (query == QUERY_FAMILY_OPT)
-	    do_query_family_name(otf, &cerrh, result_errh);
-	else if (query == QUERY_FVERSION_OPT)
-	    do_query_font_version(otf, &cerrh, result_errh);
-	else if (query == TABLES_OPT)
-	    do_tables(otf, &cerrh, result_errh);
-	else if (query == DUMP_TABLE_OPT)
-	    do_dump_table(otf, dump_table, &cerrh);
-	else if (query == INFO_OPT)
-	    do_info(otf, &cerrh, result_errh);
+	int nfaces = OpenType::Font::nfaces(font_data);
+	bool all_faces = (face < 0 && nfaces > 1);
+	int first_face = (face < 0 ? 0 : face);
+	int last_face = (all_faces ? nfaces : first_face + 1);
+	bool prefix = (input_files.size() > 1 || all_faces);
+	for (int f = first_face; f < last_face; f++) {
+	    String face_file = input_file;
+	    if (all_faces)
+		face_file += ":" + String(f);
+	    LandmarkErrorHandler cerrh(errh, face_file);
+	    OpenType::Font otf(font_data, f, &cerrh);
+	    if (otf.ok()) {
+		PrefixErrorHandler stdout_cerrh(&stdout_errh, face_file + ":");
+		do_query(otf, query, dump_table, &cerrh, prefix ? static_cast<ErrorHandler *>(&stdout_cerrh) : static_cast<ErrorHandler *>(&stdout_errh));
+	    }
+	}
     }
 
     Clp_DeleteParser(clp);
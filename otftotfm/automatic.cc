@@ -62,8 +62,10 @@ enum { T1DOTLESSJ_EXIT_J_NODOT = 2 };
 
 static String odir[NUMODIR];
 static String typeface;
+static bool typeface_override = false;
 static String vendor;
 static String map_file;
+static Vector<String> *recorded_outputs;
 #define DEFAULT_VENDOR "lcdftools"
 #define DEFAULT_TYPEFACE "unknown"
 
@@ -165,9 +167,25 @@ set_typeface(const String &s, bool override)
     bool had = (bool) typeface;
     if (!had || override)
         typeface = s;
+    if (override)
+        typeface_override = true;
     return !had;
 }
 
+void
+forget_typeface()
+{
+    if (!typeface_override)
+        typeface = String();
+#if HAVE_KPATHSEA
+    // directories computed from the old typeface must be recomputed
+    for (int o = 0; o < NUMODIR; ++o)
+        if (odir_kpathsea[o] && odir[o] == odir_kpathsea[o]
+            && odir_info[o].texdir[strlen(odir_info[o].texdir) - 1] == '%')
+            odir[o] = odir_kpathsea[o] = String();
+#endif
+}
+
 String
 getodir(int o, ErrorHandler *errh)
 {
@@ -274,10 +292,18 @@ file_in_kpathsea_odir(int o, const String &file)
 }
 #endif
 
+void
+record_outputs(Vector<String> *outputs)
+{
+    recorded_outputs = outputs;
+}
+
 void
 update_odir(int o, String file, ErrorHandler *errh)
 {
     assert(o >= 0 && o < NUMODIR);
+    if (recorded_outputs && o != O_ENCODING && o != O_MAP)
+        recorded_outputs->push_back(file);
 #if HAVE_KPATHSEA
     if (file.find_left('/') < 0)
         file = odir[o] + "/" + file;
@@ -352,10 +378,19 @@ set_map_file(const String &s)
     return !had;
 }
 
+#if HAVE_AUTO_CFFTOT1 || HAVE_AUTO_TTFTOTYPE42
+// Returns the cfftot1 or ttftotype42 option selecting a collection face.
+static String
+face_option(int face)
+{
+    return face ? " --face=" + String(face) : String();
+}
+#endif
+
 String
-installed_type1(const String &otf_filename, const String &ps_fontname, bool allow_generate, ErrorHandler *errh)
+installed_type1(const String &otf_filename, int face, const String &ps_fontname, bool allow_generate, ErrorHandler *errh)
 {
-    (void) otf_filename, (void) allow_generate, (void) errh;
+    (void) otf_filename, (void) face, (void) allow_generate, (void) errh;
 
     if (!ps_fontname)
         return String();
@@ -388,7 +423,7 @@ installed_type1(const String &otf_filename, const String &ps_fontname, bool allo
         String pfb_filename = odir[O_TYPE1] + "/" + ps_fontname + ".pfb";
         if (pfb_filename.find_left('\'') >= 0 || otf_filename.find_left('\'') >= 0)
             return String();
-        String command = "cfftot1 " + shell_quote(otf_filename) + " -n " + shell_quote(ps_fontname) + " " + shell_quote(pfb_filename);
+        String command = "cfftot1" + face_option(face) + " " + shell_quote(otf_filename) + " -n " + shell_quote(ps_fontname) + " " + shell_quote(pfb_filename);
         int retval = mysystem(command.c_str(), errh);
         if (retval == 127)
             errh->error("could not run %<%s%>", command.c_str());
@@ -407,9 +442,9 @@ installed_type1(const String &otf_filename, const String &ps_fontname, bool allo
 }
 
 String
-installed_type1_dotlessj(const String &otf_filename, const String &ps_fontname, bool allow_generate, ErrorHandler *errh)
+installed_type1_dotlessj(const String &otf_filename, int face, const String &ps_fontname, bool allow_generate, ErrorHandler *errh)
 {
-    (void) otf_filename, (void) allow_generate, (void) errh;
+    (void) otf_filename, (void) face, (void) allow_generate, (void) errh;
 
     if (!ps_fontname)
         return String();
@@ -444,7 +479,7 @@ installed_type1_dotlessj(const String &otf_filename, const String &ps_fontname,
 #if HAVE_AUTO_T1DOTLESSJ
     // if not found, and can generate on the fly, try running t1dotlessj
     if (allow_generate && getodir(O_TYPE1, errh)) {
-        if (String base_filename = installed_type1(otf_filename, ps_fontname, allow_generate, errh)) {
+        if (String base_filename = installed_type1(otf_filename, face, ps_fontname, allow_generate, errh)) {
             String pfb_filename = odir[O_TYPE1] + "/" + j_ps_fontname + ".pfb";
             if (pfb_filename.find_left('\'') >= 0 || base_filename.find_left('\'') >= 0)
                 return String();
@@ -471,8 +506,13 @@ installed_type1_dotlessj(const String &otf_filename, const String &ps_fontname,
 }
 
 String
-installed_truetype(const String &ttf_filename, bool allow_generate, ErrorHandler *errh)
+installed_truetype(const String &ttf_filename, int face, bool allow_generate, ErrorHandler *errh)
 {
+    // A map file line names a font file, not a face within it, so only the
+    // first face of a collection can be used as is.
+    if (face > 0)
+        return String();
+
     String file = pathname_filename(ttf_filename);
 
 #if HAVE_KPATHSEA
@@ -522,9 +562,9 @@ installed_truetype(const String &ttf_filename, bool allow_generate, ErrorHandler
 }
 
 String
-installed_type42(const String &ttf_filename, const String &ps_fontname, bool allow_generate, ErrorHandler *errh)
+installed_type42(const String &ttf_filename, int face, const String &ps_fontname, bool allow_generate, ErrorHandler *errh)
 {
-    (void) allow_generate, (void) ttf_filename, (void) errh;
+    (void) allow_generate, (void) ttf_filename, (void) face, (void) errh;
 
     if (!ps_fontname)
         return String();
@@ -556,7 +596,7 @@ installed_type42(const String &ttf_filename, const String &ps_fontname, bool all
         String t42_filename = odir[O_TYPE42] + "/" + ps_fontname + ".t42";
         if (t42_filename.find_left('\'') >= 0 || ttf_filename.find_left('\'') >= 0)
             return String();
-        String command = "ttftotype42 " + shell_quote(ttf_filename) + " " + shell_quote(t42_filename);
+        String command = "ttftotype42" + face_option(face) + " " + shell_quote(ttf_filename) + " " + shell_quote(t42_filename);
         int retval = mysystem(command.c_str(), errh);
         if (retval == 127)
             errh->error("could not run %<%s%>", command.c_str());
@@ -575,22 +615,25 @@ installed_type42(const String &ttf_filename, const String &ps_fontname, bool all
 }
 
 int
-update_autofont_map(const String &fontname, String mapline, ErrorHandler *errh)
+update_autofont_map(const Vector<String> &fontnames, const Vector<String> &maplines, ErrorHandler *errh)
 {
 #if HAVE_KPATHSEA
     if (automatic && !map_file && getodir(O_MAP, errh))
         map_file = odir[O_MAP] + "/" + get_vendor() + ".map";
 #endif
 
-    if (map_file == "" || map_file == "-")
-        fputs(mapline.c_str(), stdout);
-    else {
+    if (map_file == "" || map_file == "-") {
+        for (const String *m = maplines.begin(); m != maplines.end(); ++m)
+            fputs(m->c_str(), stdout);
+    } else {
         // report no_create/verbose
-        if (no_create) {
-            errh->message("would update %s for %s", map_file.c_str(), String(fontname).c_str());
+        for (const String *fn = fontnames.begin(); fn != fontnames.end(); ++fn)
+            if (no_create)
+                errh->message("would update %s for %s", map_file.c_str(), fn->c_str());
+            else if (verbose)
+                errh->message("updating %s for %s", map_file.c_str(), fn->c_str());
+        if (no_create)
             return 0;
-        } else if (verbose)
-            errh->message("updating %s for %s", map_file.c_str(), String(fontname).c_str());
 
         int fd = open(map_file.c_str(), O_RDWR | O_CREAT, 0666);
         if (fd < 0)
@@ -637,54 +680,57 @@ update_autofont_map(const String &fontname, String mapline, ErrorHandler *errh)
         if (text.back() != '\n')
             text += "\n";
 
-        // append old encodings
-        int fl = 0;
-        int nl = text.find_left('\n') + 1;
+        // replace old lines for each font
         bool changed = created;
-        while (fl < text.length()) {
-            if (fl + fontname.length() + 1 < nl
-                && memcmp(text.data() + fl, fontname.data(), fontname.length()) == 0
-                && text[fl + fontname.length()] == ' ') {
-                // found the old name
-                if (text.substring(fl, nl - fl) == mapline) {
-                    // duplicate of old name, don't change it
-                    fclose(f);
-                    if (verbose)
-                        errh->message("%s unchanged", map_file.c_str());
-                    return 0;
-                } else {
-                    text = text.substring(0, fl) + text.substring(nl);
-                    nl = fl;
-                    changed = true;
+        for (int i = 0; i < fontnames.size(); ++i) {
+            const String &fontname = fontnames[i];
+            const String &mapline = maplines[i];
+            bool found = false;
+            int fl = 0;
+            int nl = text.find_left('\n') + 1;
+            while (fl < text.length()) {
+                if (fl + fontname.length() + 1 < nl
+                    && memcmp(text.data() + fl, fontname.data(), fontname.length()) == 0
+                    && text[fl + fontname.length()] == ' ') {
+                    // found the old name
+                    if (!found && text.substring(fl, nl - fl) == mapline)
+                        // duplicate of old name, don't change it
+                        found = true;
+                    else {
+                        text = text.substring(0, fl) + text.substring(nl);
+                        nl = fl;
+                        changed = true;
+                    }
                 }
+                fl = nl;
+                nl = text.find_left('\n', fl) + 1;
+            }
+            if (!found && mapline) {
+                text += mapline;
+                changed = true;
             }
-            fl = nl;
-            nl = text.find_left('\n', fl) + 1;
         }
 
-        if (!mapline && !changed) {
-            // special case: empty mapline, unchanged file
+        if (!changed) {
+            fclose(f);
             if (verbose)
                 errh->message("%s unchanged", map_file.c_str());
-        } else {
-            // add our text
-            text += mapline;
+            return 0;
+        }
 
-            // rewind file
+        // rewind file
 #if HAVE_FTRUNCATE
-            rewind(f);
-            if (ftruncate(fd, 0) < 0)
+        rewind(f);
+        if (ftruncate(fd, 0) < 0)
 #endif
-            {
-                fclose(f);
-                f = fopen(map_file.c_str(), "w");
-                fd = fileno(f);
-            }
-
-            // write data
-            ignore_result(fwrite(text.data(), 1, text.length(), f));
+        {
+            fclose(f);
+            f = fopen(map_file.c_str(), "w");
+            fd = fileno(f);
         }
 
+        // write data
+        ignore_result(fwrite(text.data(), 1, text.length(), f));
         fclose(f);
 
         // inform about the new file if necessary
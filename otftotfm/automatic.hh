@@ -1,6 +1,7 @@
 #ifndef OTFTOTFM_AUTOMATIC_HH
 #define OTFTOTFM_AUTOMATIC_HH
 #include <lcdf/string.hh>
+#include <lcdf/vector.hh>
 class ErrorHandler;
 
 enum {
@@ -14,14 +15,16 @@ String getodir(int o, ErrorHandler *);
 void setodir(int o, const String &);
 bool set_vendor(const String &);
 bool set_typeface(const String &, bool override);
+void forget_typeface();
 bool set_map_file(const String &);
 const char *odirname(int o);
 void update_odir(int o, String file, ErrorHandler *);
-String installed_type1(const String &otf_filename, const String &ps_fontname, bool allow_generate, ErrorHandler *);
-String installed_type1_dotlessj(const String &otf_filename, const String &ps_fontname, bool allow_generate, ErrorHandler *);
-String installed_truetype(const String &ttf_filename, bool allow_generate, ErrorHandler *errh);
-String installed_type42(const String &ttf_filename, const String &ps_fontname, bool allow_generate, ErrorHandler *errh);
-int update_autofont_map(const String &fontname, String mapline, ErrorHandler *);
+void record_outputs(Vector<String> *);
+String installed_type1(const String &otf_filename, int face, const String &ps_fontname, bool allow_generate, ErrorHandler *);
+String installed_type1_dotlessj(const String &otf_filename, int face, const String &ps_fontname, bool allow_generate, ErrorHandler *);
+String installed_truetype(const String &ttf_filename, int face, bool allow_generate, ErrorHandler *errh);
+String installed_type42(const String &ttf_filename, int face, const String &ps_fontname, bool allow_generate, ErrorHandler *errh);
+int update_autofont_map(const Vector<String> &fontnames, const Vector<String> &maplines, ErrorHandler *);
 String locate_encoding(String encfile, ErrorHandler *, bool literal = false);
 
 #endif
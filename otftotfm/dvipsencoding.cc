@@ -17,6 +17,7 @@
 #include "dvipsencoding.hh"
 #include "metrics.hh"
 #include "secondary.hh"
+#include "glyphlist.hh"
 #include <lcdf/error.hh>
 #include <lcdf/straccum.hh>
 #include <string.h>
@@ -26,82 +27,19 @@
 #include <algorithm>
 #include "util.hh"
 
-enum { GLYPHLIST_ALTERNATIVE = 0x40000000,
-       GLYPHLIST_USEMAP = GLYPHLIST_ALTERNATIVE,
+enum { GLYPHLIST_ALTERNATIVE = Glyphlist::ALTERNATIVE,
        U_EMPTYSLOT = 0xD801,
        U_ALTSELECTOR = 0xD802 };
-static HashMap<String, uint32_t> glyphlist((uint32_t) -1);
-static Vector<uint32_t> glyphmap;
+static Vector<Glyphlist *> glyphlists;
 static PermString::Initializer perm_initializer;
 PermString DvipsEncoding::dot_notdef(".notdef");
 
 #define NEXT_GLYPH_NAME(gn)     ("/" + (gn))
 
 void
-DvipsEncoding::add_glyphlist(String text)
+DvipsEncoding::add_glyphlist(Glyphlist *gl)
 {
-    const char *s = text.begin(), *end = text.end();
-    while (s != end) {
-        // move to first nonblank
-        while (s != end && isspace((unsigned char) *s))
-            ++s;
-        // ignore comments
-        if (s != end && *s == '#') {
-        skip_to_end_of_line:
-            while (s != end && *s != '\n' && *s != '\r')
-                ++s;
-            continue;
-        }
-        // parse glyph name
-        const char *name_start = s;
-        while (s != end && !isspace((unsigned char) *s) && *s != ';')
-            ++s;
-        if (s == name_start)
-            goto skip_to_end_of_line;
-        String glyph_name = text.substring(name_start, s).compact();
-        int map_pos = glyphmap.size();
-        // parse Unicodes
-        while (1) {
-            while (s != end && (*s == ' ' || *s == '\t'))
-                ++s;
-            if (s == end || *s == '\n' || *s == '\r' || *s == '#'
-                || (map_pos == glyphmap.size() && *s != ';' && *s != ','))
-                break;
-            if (*s == ';' || *s == ',') {
-                ++s;
-                while (s != end && (*s == ' ' || *s == '\t'))
-                    ++s;
-                if (s == end || !isxdigit((unsigned char) *s))
-                    goto skip_to_end_of_line;
-                if (map_pos != glyphmap.size())
-                    glyphmap.push_back(GLYPHLIST_ALTERNATIVE);
-            }
-            uint32_t u = 0;
-            while (s != end && isxdigit((unsigned char) *s)) {
-                if (*s >= '0' && *s <= '9')
-                    u = (u << 4) + *s - '0';
-                else if (*s >= 'A' && *s <= 'F')
-                    u = (u << 4) + *s - 'A' + 10;
-                else
-                    u = (u << 4) + *s - 'a' + 10;
-                ++s;
-            }
-            if (u == 0 || u > 0x10FFFF)
-                goto skip_to_end_of_line;
-            glyphmap.push_back(u);
-            if (s != end && !isspace((unsigned char) *s) && *s != ',' && *s != ';')
-                break;
-        }
-        // store result
-        if (map_pos == glyphmap.size() - 1) {
-            glyphlist.insert(glyph_name, glyphmap.back());
-            glyphmap.pop_back();
-        } else {
-            glyphlist.insert(glyph_name, map_pos | GLYPHLIST_USEMAP);
-            glyphmap.push_back(0);
-        }
-        goto skip_to_end_of_line;
-    }
+    glyphlists.push_back(gl);
 }
 
 static void
@@ -141,21 +79,19 @@ DvipsEncoding::glyphname_unicode(String gn, Vector<uint32_t> &unis)
             return false;
     }
 
-    // check glyphlist
-    int value = glyphlist[component];
+    // check glyphlists; later lists override earlier ones
+    const uint32_t *value = 0;
+    for (int i = glyphlists.size() - 1; i >= 0 && !value; --i)
+        value = glyphlists[i]->find(component.data(), component.length());
     uint32_t uval;
-    if (value >= 0 && !(value & GLYPHLIST_USEMAP))
-        unis.push_back(value);
-    else if (value >= 0) {
-        for (int i = (value & ~GLYPHLIST_USEMAP);
-             glyphmap[i];
-             ++i)
-            if (glyphmap[i] == GLYPHLIST_ALTERNATIVE) {
+    if (value) {
+        for (; *value; ++value)
+            if (*value == GLYPHLIST_ALTERNATIVE) {
                 unicode_add_suffix(unis, prefix_start, suffix);
                 unis.push_back(GLYPHLIST_ALTERNATIVE);
                 prefix_start = unis.size();
             } else
-                unis.push_back(glyphmap[i]);
+                unis.push_back(*value);
     } else if (component.length() >= 7
                && (component.length() % 4) == 3
                && (memcmp(component.data(), "uni", 3) == 0
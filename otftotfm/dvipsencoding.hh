@@ -6,12 +6,13 @@
 class Metrics;
 class Secondary;
 class FontInfo;
+class Glyphlist;
 
 class DvipsEncoding { public:
 
     DvipsEncoding();
 
-    static void add_glyphlist(String);
+    static void add_glyphlist(Glyphlist *);
 
     operator bool() const                       { return _e.size() > 0; }
     const String &name() const                  { return _name; }
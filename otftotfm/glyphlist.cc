@@ -0,0 +1,410 @@
+/* glyphlist.{cc,hh} -- compiled glyph lists
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "glyphlist.hh"
+#include "manifest.hh"
+#include "util.hh"
+#include <lcdf/error.hh>
+#include <lcdf/hashmap.hh>
+#include <lcdf/mapfile.hh>
+#include <lcdf/straccum.hh>
+#include <lcdf/vector.hh>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef WIN32
+# define mkdir(dir, access) mkdir(dir)
+#endif
+
+/* Image layout, in native byte order:
+
+   uint32_t header[HEADER_WORDS]:
+       IMAGE_MAGIC, IMAGE_VERSION, nkeys, nbuckets, nseqs, pool_length,
+       source_length, digest_length
+   uint32_t disp[nbuckets]      per-bucket hash seeds
+   uint32_t slots[nkeys][2]     name offset in pool, sequence offset
+   uint32_t seqs[nseqs]         0-terminated code point sequences
+   char pool[pool_length]       NUL-terminated glyph names
+   char source[source_length]   stamp of the source file
+   char digest[digest_length]   digest of the source text
+
+   A name lives in slot name_hash(name, disp[name_hash(name, 0) % nbuckets])
+   % nkeys. */
+
+static inline uint32_t
+name_hash(const char *s, int len, uint32_t seed)
+{
+    uint32_t h = 2166136261U ^ (seed * 0x9E3779B9U);
+    for (; len > 0; --len, ++s)
+        h = (h ^ (unsigned char) *s) * 16777619U;
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35U;
+    h ^= h >> 16;
+    return h;
+}
+
+static void
+parse_glyphlist(const String &text, Vector<String> &names,
+                Vector<int> &seq_pos, Vector<uint32_t> &seqs)
+{
+    HashMap<String, int> name_index(-1);
+    Vector<uint32_t> cur;
+
+    const char *s = text.begin(), *end = text.end();
+    while (s != end) {
+        // move to first nonblank
+        while (s != end && isspace((unsigned char) *s))
+            ++s;
+        // ignore comments
+        if (s != end && *s == '#') {
+        skip_to_end_of_line:
+            while (s != end && *s != '\n' && *s != '\r')
+                ++s;
+            continue;
+        }
+        // parse glyph name
+        const char *name_start = s;
+        while (s != end && !isspace((unsigned char) *s) && *s != ';')
+            ++s;
+        if (s == name_start)
+            goto skip_to_end_of_line;
+        String glyph_name = text.substring(name_start, s);
+        cur.clear();
+        // parse Unicodes
+        while (1) {
+            while (s != end && (*s == ' ' || *s == '\t'))
+                ++s;
+            if (s == end || *s == '\n' || *s == '\r' || *s == '#'
+                || (!cur.size() && *s != ';' && *s != ','))
+                break;
+            if (*s == ';' || *s == ',') {
+                ++s;
+                while (s != end && (*s == ' ' || *s == '\t'))
+                    ++s;
+                if (s == end || !isxdigit((unsigned char) *s))
+                    goto skip_to_end_of_line;
+                if (cur.size())
+                    cur.push_back(Glyphlist::ALTERNATIVE);
+            }
+            uint32_t u = 0;
+            while (s != end && isxdigit((unsigned char) *s)) {
+                if (*s >= '0' && *s <= '9')
+                    u = (u << 4) + *s - '0';
+                else if (*s >= 'A' && *s <= 'F')
+                    u = (u << 4) + *s - 'A' + 10;
+                else
+                    u = (u << 4) + *s - 'a' + 10;
+                ++s;
+            }
+            if (u == 0 || u > 0x10FFFF)
+                goto skip_to_end_of_line;
+            cur.push_back(u);
+            if (s != end && !isspace((unsigned char) *s) && *s != ',' && *s != ';')
+                break;
+        }
+        // store result; later definitions override earlier ones
+        int &index = name_index.find_force(glyph_name, names.size());
+        if (index == names.size()) {
+            names.push_back(glyph_name);
+            seq_pos.push_back(seqs.size());
+        } else
+            seq_pos[index] = seqs.size();
+        for (const uint32_t *u = cur.begin(); u != cur.end(); ++u)
+            seqs.push_back(*u);
+        seqs.push_back(0);
+        goto skip_to_end_of_line;
+    }
+}
+
+static bool
+place_buckets(const Vector<String> &names, uint32_t nbuckets,
+              Vector<uint32_t> &disp, Vector<int> &slot_key)
+{
+    uint32_t nkeys = names.size();
+
+    // sort keys by bucket
+    Vector<uint32_t> bucket_of(nkeys, 0);
+    Vector<int> bucket_pos(nbuckets + 1, 0);
+    for (uint32_t i = 0; i < nkeys; ++i) {
+        bucket_of[i] = name_hash(names[i].data(), names[i].length(), 0) % nbuckets;
+        bucket_pos[bucket_of[i] + 1]++;
+    }
+    for (uint32_t b = 0; b < nbuckets; ++b)
+        bucket_pos[b + 1] += bucket_pos[b];
+    Vector<int> bucket_keys(nkeys, 0);
+    Vector<int> next(bucket_pos);
+    for (uint32_t i = 0; i < nkeys; ++i)
+        bucket_keys[next[bucket_of[i]]++] = i;
+
+    // place the largest buckets first, while the table is empty
+    Vector<std::pair<int, int> > order;
+    for (uint32_t b = 0; b < nbuckets; ++b)
+        if (bucket_pos[b + 1] > bucket_pos[b])
+            order.push_back(std::make_pair(bucket_pos[b] - bucket_pos[b + 1], (int) b));
+    std::sort(order.begin(), order.end());
+
+    disp.assign(nbuckets, 0);
+    slot_key.assign(nkeys, -1);
+    Vector<uint32_t> slots;
+    for (std::pair<int, int> *o = order.begin(); o != order.end(); ++o) {
+        int b = o->second;
+        for (uint32_t d = 1; ; ++d) {
+            if (d == (1U << 20))
+                return false;
+            slots.clear();
+            for (int k = bucket_pos[b]; k != bucket_pos[b + 1]; ++k) {
+                const String &name = names[bucket_keys[k]];
+                uint32_t slot = name_hash(name.data(), name.length(), d) % nkeys;
+                if (slot_key[slot] >= 0
+                    || std::find(slots.begin(), slots.end(), slot) != slots.end())
+                    goto next_seed;
+                slots.push_back(slot);
+            }
+            for (int k = bucket_pos[b]; k != bucket_pos[b + 1]; ++k)
+                slot_key[slots[k - bucket_pos[b]]] = bucket_keys[k];
+            disp[b] = d;
+            break;
+        next_seed: ;
+        }
+    }
+    return true;
+}
+
+static inline void
+append_word(StringAccum &sa, uint32_t x)
+{
+    sa.append(reinterpret_cast<const char *>(&x), 4);
+}
+
+String
+Glyphlist::compile(const String &text, const String &source)
+{
+    Vector<String> names;
+    Vector<int> seq_pos;
+    Vector<uint32_t> seqs;
+    parse_glyphlist(text, names, seq_pos, seqs);
+
+    // build a minimal perfect hash, with about four names per bucket
+    uint32_t nkeys = names.size();
+    uint32_t nbuckets = nkeys / 4 + 1;
+    Vector<uint32_t> disp;
+    Vector<int> slot_key;
+    while (nkeys && !place_buckets(names, nbuckets, disp, slot_key))
+        nbuckets *= 2;
+    if (!nkeys)
+        disp.assign(nbuckets, 0);
+
+    // lay out the name pool
+    Vector<uint32_t> name_pos(nkeys, 0);
+    StringAccum pool;
+    for (uint32_t i = 0; i < nkeys; ++i) {
+        name_pos[i] = pool.length();
+        pool << names[i] << '\0';
+    }
+
+    String digest = string_digest(text);
+    StringAccum sa;
+    append_word(sa, IMAGE_MAGIC);
+    append_word(sa, IMAGE_VERSION);
+    append_word(sa, nkeys);
+    append_word(sa, nbuckets);
+    append_word(sa, seqs.size());
+    append_word(sa, pool.length());
+    append_word(sa, source.length());
+    append_word(sa, digest.length());
+    for (uint32_t b = 0; b < nbuckets; ++b)
+        append_word(sa, disp[b]);
+    for (uint32_t slot = 0; slot < nkeys; ++slot) {
+        append_word(sa, name_pos[slot_key[slot]]);
+        append_word(sa, seq_pos[slot_key[slot]]);
+    }
+    for (const uint32_t *u = seqs.begin(); u != seqs.end(); ++u)
+        append_word(sa, *u);
+    sa << pool << source << digest;
+    return sa.take_string();
+}
+
+Glyphlist::Glyphlist()
+    : _nkeys(0), _nbuckets(0)
+{
+}
+
+bool
+Glyphlist::initialize(const unsigned char *data, size_t length)
+{
+    const uint32_t *header = reinterpret_cast<const uint32_t *>(data);
+    if (length < HEADER_WORDS * 4
+        || header[0] != IMAGE_MAGIC || header[1] != IMAGE_VERSION)
+        return false;
+    _nkeys = header[2];
+    _nbuckets = header[3];
+    _nseqs = header[4];
+    _pool_length = header[5];
+    _source_length = header[6];
+    _digest_length = header[7];
+
+    uint64_t words = (uint64_t) HEADER_WORDS + _nbuckets + 2 * (uint64_t) _nkeys + _nseqs;
+    if (_nbuckets == 0
+        || words * 4 + _pool_length + _source_length + _digest_length != length
+        || (_nseqs && header[words - 1] != 0)
+        || (_pool_length && data[words * 4 + _pool_length - 1] != 0))
+        return false;
+
+    _disp = header + HEADER_WORDS;
+    _slots = _disp + _nbuckets;
+    _seqs = _slots + 2 * _nkeys;
+    _pool = reinterpret_cast<const char *>(_seqs + _nseqs);
+    _source = _pool + _pool_length;
+    _digest = _source + _source_length;
+    return true;
+}
+
+Glyphlist *
+Glyphlist::attach(const String &image)
+{
+    Glyphlist *gl = new Glyphlist;
+    gl->_image = image;
+    gl->_image.align(4);
+    if (!gl->initialize(gl->_image.udata(), gl->_image.length())) {
+        delete gl;
+        return 0;
+    }
+    return gl;
+}
+
+Glyphlist *
+Glyphlist::map(const String &filename)
+{
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+        return 0;
+    String image = map_file(f);
+    fclose(f);
+    if (!image)
+        image = read_file(filename, ErrorHandler::silent_handler());
+    return image ? attach(image) : 0;
+}
+
+String
+Glyphlist::source() const
+{
+    return String(_source, _source_length);
+}
+
+String
+Glyphlist::digest() const
+{
+    return String(_digest, _digest_length);
+}
+
+const uint32_t *
+Glyphlist::find(const char *name, int len) const
+{
+    if (!_nkeys)
+        return 0;
+    uint32_t d = _disp[name_hash(name, len, 0) % _nbuckets];
+    const uint32_t *slot = _slots + 2 * (name_hash(name, len, d) % _nkeys);
+    if ((uint64_t) slot[0] + len >= _pool_length
+        || memcmp(_pool + slot[0], name, len) != 0
+        || _pool[slot[0] + len] != 0
+        || slot[1] >= _nseqs)
+        return 0;
+    return _seqs + slot[1];
+}
+
+
+static String
+glyphlist_cache_directory(String &parent)
+{
+    if (const char *cache_home = getenv("XDG_CACHE_HOME"))
+        parent = cache_home;
+    else if (const char *home = getenv("HOME"))
+        parent = String(home) + "/.cache";
+    else
+        return String();
+    return parent + "/otftotfm";
+}
+
+static void
+write_glyphlist_cache(const String &parent, const String &dir,
+                      const String &cache_file, const String &image)
+{
+#if HAVE_MKSTEMP
+    if (mkdir(parent.c_str(), 0777) < 0 && errno != EEXIST)
+        return;
+    if (mkdir(dir.c_str(), 0777) < 0 && errno != EEXIST)
+        return;
+
+    // write to a temporary file and rename it into place, so concurrent
+    // runs never see a partial image
+    String tmp = cache_file + ".XXXXXX";
+    int fd = mkstemp(tmp.mutable_c_str());
+    if (fd < 0)
+        return;
+    FILE *f = fdopen(fd, "wb");
+    bool ok = f && fwrite(image.data(), 1, image.length(), f) == (size_t) image.length();
+    if (f)
+        ok = (fclose(f) == 0) && ok;
+    else
+        close(fd);
+    if (!ok || rename(tmp.c_str(), cache_file.c_str()) < 0)
+        unlink(tmp.c_str());
+#else
+    (void) parent, (void) dir, (void) cache_file, (void) image;
+#endif
+}
+
+Glyphlist *
+load_glyphlist(const String &filename, ErrorHandler *errh)
+{
+    String stamp = file_stamp(filename);
+    String source = stamp + " " + filename;
+    String parent, dir, cache_file;
+    if (stamp && (dir = glyphlist_cache_directory(parent)))
+        cache_file = dir + "/glyphlist-" + string_digest(filename) + ".bin";
+
+    // use the compiled image if it matches the source file
+    if (cache_file)
+        if (Glyphlist *gl = Glyphlist::map(cache_file)) {
+            if (gl->source() == source)
+                return gl;
+            delete gl;
+        }
+
+    String text = read_file(filename, errh, true);
+    if (!text)
+        return 0;
+    String image = Glyphlist::compile(text, source);
+    if (cache_file && !no_create) {
+        if (verbose)
+            errh->message("caching compiled %s in %s", filename.c_str(), cache_file.c_str());
+        write_glyphlist_cache(parent, dir, cache_file, image);
+    }
+    return Glyphlist::attach(image);
+}
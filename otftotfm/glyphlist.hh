@@ -0,0 +1,57 @@
+#ifndef OTFTOTFM_GLYPHLIST_HH
+#define OTFTOTFM_GLYPHLIST_HH
+#include <lcdf/string.hh>
+#include <lcdf/inttypes.h>
+#include <stddef.h>
+class ErrorHandler;
+
+// A Glyphlist is a compiled glyph list, mapping Adobe glyph names to
+// Unicode sequences. Its image is a minimal perfect hash over the names and
+// a packed array of code point sequences, and can be used directly from a
+// mapped file.
+
+class Glyphlist { public:
+
+    enum { ALTERNATIVE = 0x40000000 };
+
+    static String compile(const String &text, const String &source);
+    static Glyphlist *attach(const String &image);
+    static Glyphlist *map(const String &filename);
+
+    String source() const;
+    String digest() const;
+
+    // Returns a 0-terminated sequence of code points, where ALTERNATIVE
+    // separates alternate sequences, or null if 'name' is not in the list.
+    const uint32_t *find(const char *name, int len) const;
+
+  private:
+
+    String _image;
+
+    const uint32_t *_disp;
+    const uint32_t *_slots;
+    const uint32_t *_seqs;
+    const char *_pool;
+    const char *_source;
+    const char *_digest;
+    uint32_t _nkeys;
+    uint32_t _nbuckets;
+    uint32_t _nseqs;
+    uint32_t _pool_length;
+    uint32_t _source_length;
+    uint32_t _digest_length;
+
+    enum { IMAGE_MAGIC = 0x474C5354, IMAGE_VERSION = 1, HEADER_WORDS = 8 };
+
+    Glyphlist();
+    Glyphlist(const Glyphlist &);
+    Glyphlist &operator=(const Glyphlist &);
+
+    bool initialize(const unsigned char *data, size_t length);
+
+};
+
+Glyphlist *load_glyphlist(const String &filename, ErrorHandler *);
+
+#endif
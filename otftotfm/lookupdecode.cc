@@ -0,0 +1,275 @@
+/* lookupdecode.{cc,hh} -- decode GSUB and GPOS lookups in parallel
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "lookupdecode.hh"
+#include "util.hh"
+#include <lcdf/error.hh>
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_PTHREAD_CREATE)
+# include <pthread.h>
+# define USE_THREADS 1
+#endif
+
+using namespace Efont;
+
+// One decoded lookup, waiting to be applied.
+struct LookupDecoder::Slot {
+    bool done;
+    bool understood;
+    bool failed;
+    String error;                       // description if 'failed'
+    Vector<String> messages;            // errh messages, annotated
+    Vector<OpenType::Substitution> subs;
+    Vector<OpenType::Positioning> poss;
+    Slot()                              : done(false), understood(false), failed(false) { }
+};
+
+// Lookup k decodes into slots[k % nslots]. A worker claims lookup k only
+// once lookup k - nslots has been applied, so at most nslots decoded
+// lookups are held at once.
+struct LookupDecoder::Workers {
+    Slot *slots;
+    int nslots;
+    int next;                           // next lookup to claim
+    int napplied;                       // lookups applied so far
+    bool stop;
+#if USE_THREADS
+    Vector<pthread_t> threads;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+};
+
+LookupDecoder::LookupDecoder(const OpenType::Gsub &gsub, const String &table,
+                             const OpenType::GlyphSet &limit,
+                             const Vector<int> &lookups, int nthreads)
+    : _gsub(&gsub), _gpos(0), _table(table), _limit(limit),
+      _limit_coverage(limit), _lookups(lookups), _workers(0)
+{
+    start(nthreads);
+}
+
+LookupDecoder::LookupDecoder(const OpenType::Gpos &gpos, const String &table,
+                             const OpenType::GlyphSet &limit,
+                             const Vector<int> &lookups, int nthreads)
+    : _gsub(0), _gpos(&gpos), _table(table), _limit(limit),
+      _limit_coverage(limit), _lookups(lookups), _workers(0)
+{
+    start(nthreads);
+}
+
+LookupDecoder::~LookupDecoder()
+{
+#if USE_THREADS
+    if (Workers *w = _workers) {
+        pthread_mutex_lock(&w->lock);
+        w->stop = true;
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+        for (pthread_t *t = w->threads.begin(); t != w->threads.end(); ++t)
+            pthread_join(*t, 0);
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->lock);
+        delete[] w->slots;
+        delete w;
+    }
+#endif
+}
+
+void
+LookupDecoder::start(int nthreads)
+{
+#if USE_THREADS
+    if (nthreads <= 1 || _lookups.size() <= 1)
+        return;
+    Workers *w = new Workers;
+    w->nslots = 2 * nthreads;
+    w->slots = new Slot[w->nslots];
+    w->next = w->napplied = 0;
+    w->stop = false;
+    pthread_mutex_init(&w->lock, 0);
+    pthread_cond_init(&w->cond, 0);
+    _workers = w;
+    for (int i = 0; i < nthreads && i < _lookups.size(); ++i) {
+        pthread_t t;
+        if (pthread_create(&t, 0, decode_thread, this) == 0)
+            w->threads.push_back(t);
+    }
+    if (w->threads.empty()) {
+        // decode on the calling thread after all
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->lock);
+        delete[] w->slots;
+        delete w;
+        _workers = 0;
+    }
+#else
+    (void) nthreads;
+#endif
+}
+
+bool
+LookupDecoder::skip_gpos_lookup(const OpenType::Gpos &gpos, int lookup,
+                                const OpenType::GlyphSet &limit)
+{
+    // single and pair lookups only position glyphs in their first
+    // coverage, so skip those that can't touch 'limit'
+    int type = gpos.lookup(lookup).type();
+    const OpenType::GlyphSet &first = gpos.lookup_glyphs(lookup);
+    return (type == OpenType::GposLookup::L_SINGLE
+            || type == OpenType::GposLookup::L_PAIR)
+        && !first.empty() && !first.intersects(limit);
+}
+
+void *
+LookupDecoder::decode_thread(void *arg)
+{
+#if USE_THREADS
+    LookupDecoder *d = static_cast<LookupDecoder *>(arg);
+    Workers *w = d->_workers;
+    String table(d->_table.data(), d->_table.length());
+    OpenType::Coverage limit(d->_limit);
+    // The table was already read once, on the calling thread, which
+    // reported any problems with it.
+    SilentErrorHandler silent_errh;
+    RecordingErrorHandler errh;
+    OpenType::Gsub *gsub = 0;
+    OpenType::Gpos *gpos = 0;
+    if (d->_gsub) {
+        gsub = new OpenType::Gsub(table, 0, &silent_errh);
+        gsub->set_chaincontext_reverse_backtrack(d->_gsub->chaincontext_reverse_backtrack());
+    } else
+        gpos = new OpenType::Gpos(table, &silent_errh);
+
+    while (1) {
+        pthread_mutex_lock(&w->lock);
+        while (!w->stop && w->next < d->_lookups.size()
+               && w->next >= w->napplied + w->nslots)
+            pthread_cond_wait(&w->cond, &w->lock);
+        if (w->stop || w->next >= d->_lookups.size()) {
+            pthread_mutex_unlock(&w->lock);
+            break;
+        }
+        int k = w->next++;
+        pthread_mutex_unlock(&w->lock);
+
+        Slot &s = w->slots[k % w->nslots];
+        int lookup = d->_lookups[k];
+        errh.set_messages(&s.messages);
+        try {
+            if (gsub) {
+                OpenType::GsubLookup l = gsub->lookup(lookup);
+                s.understood = l.unparse_automatics(*gsub, s.subs, limit);
+            } else if (skip_gpos_lookup(*gpos, lookup, d->_limit))
+                s.understood = true;
+            else {
+                OpenType::GposLookup l = gpos->lookup(lookup);
+                s.understood = l.unparse_automatics(s.poss, limit, &errh);
+            }
+        } catch (OpenType::BlankTable) {
+            s.failed = true;
+        } catch (OpenType::Error e) {
+            s.failed = true;
+            s.error = e.description;
+        }
+
+        pthread_mutex_lock(&w->lock);
+        s.done = true;
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+    }
+
+    delete gsub;
+    delete gpos;
+#else
+    (void) arg;
+#endif
+    return 0;
+}
+
+LookupDecoder::Slot &
+LookupDecoder::wait(int k)
+{
+    Workers *w = _workers;
+    Slot &s = w->slots[k % w->nslots];
+#if USE_THREADS
+    pthread_mutex_lock(&w->lock);
+    while (!s.done)
+        pthread_cond_wait(&w->cond, &w->lock);
+    pthread_mutex_unlock(&w->lock);
+#endif
+    return s;
+}
+
+bool
+LookupDecoder::finish(Slot &s, ErrorHandler *errh)
+{
+    bool understood = s.understood, failed = s.failed;
+    String error = s.error;
+    Vector<String> messages;
+    messages.swap(s.messages);
+
+    // free the slot's memory and let a worker reuse it
+    Vector<OpenType::Substitution>().swap(s.subs);
+    Vector<OpenType::Positioning>().swap(s.poss);
+    s.error = String();
+    s.understood = s.failed = false;
+    Workers *w = _workers;
+#if USE_THREADS
+    pthread_mutex_lock(&w->lock);
+#endif
+    s.done = false;
+    ++w->napplied;
+#if USE_THREADS
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+#endif
+
+    for (const String *m = messages.begin(); m != messages.end(); ++m)
+        errh->xmessage(*m);
+    if (failed && !error)
+        throw OpenType::BlankTable("lookup");
+    else if (failed)
+        throw OpenType::Error(error);
+    return understood;
+}
+
+bool
+LookupDecoder::apply(int k, OpenType::SubstitutionVisitor &v, ErrorHandler *errh)
+{
+    if (!_workers) {
+        OpenType::GsubLookup l = _gsub->lookup(_lookups[k]);
+        return l.unparse_automatics(*_gsub, v, _limit_coverage);
+    }
+    Slot &s = wait(k);
+    for (OpenType::Substitution *it = s.subs.begin(); it != s.subs.end() && v.emit(*it); ++it)
+        /* do nothing */;
+    return finish(s, errh);
+}
+
+bool
+LookupDecoder::apply(int k, OpenType::PositioningVisitor &v, ErrorHandler *errh)
+{
+    if (!_workers) {
+        if (skip_gpos_lookup(*_gpos, _lookups[k], _limit))
+            return true;
+        OpenType::GposLookup l = _gpos->lookup(_lookups[k]);
+        return l.unparse_automatics(v, _limit_coverage, errh);
+    }
+    Slot &s = wait(k);
+    for (OpenType::Positioning *it = s.poss.begin(); it != s.poss.end() && v.emit(*it); ++it)
+        /* do nothing */;
+    return finish(s, errh);
+}
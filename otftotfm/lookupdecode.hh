@@ -0,0 +1,56 @@
+#ifndef OTFTOTFM_LOOKUPDECODE_HH
+#define OTFTOTFM_LOOKUPDECODE_HH
+#include <efont/otfgsub.hh>
+#include <efont/otfgpos.hh>
+
+// A LookupDecoder passes the results of GSUB or GPOS lookups, decoded with
+// unparse_automatics, to visitors in lookup order. With one thread, each
+// lookup is decoded straight into its visitor. With more, worker threads
+// decode lookups ahead of the caller, at most a few lookups ahead, so
+// that only a few decoded lookups wait in memory at once. Workers decode
+// from private copies of the table, because String reference counts are
+// not thread-safe, and record any error or warning so it can be reported
+// when the lookup is applied.
+
+class LookupDecoder { public:
+
+    LookupDecoder(const Efont::OpenType::Gsub &gsub, const String &table,
+                  const Efont::OpenType::GlyphSet &limit,
+                  const Vector<int> &lookups, int nthreads);
+    LookupDecoder(const Efont::OpenType::Gpos &gpos, const String &table,
+                  const Efont::OpenType::GlyphSet &limit,
+                  const Vector<int> &lookups, int nthreads);
+    ~LookupDecoder();
+
+    // Pass the results of lookups[k] to 'v', and return true if the lookup
+    // was fully understood. Call for k = 0, 1, 2, ... in order. Messages
+    // go to 'errh'; a lookup that can't be decoded throws its error.
+    bool apply(int k, Efont::OpenType::SubstitutionVisitor &v, ErrorHandler *errh);
+    bool apply(int k, Efont::OpenType::PositioningVisitor &v, ErrorHandler *errh);
+
+  private:
+
+    struct Slot;
+    struct Workers;
+
+    const Efont::OpenType::Gsub *_gsub;
+    const Efont::OpenType::Gpos *_gpos;
+    String _table;
+    const Efont::OpenType::GlyphSet &_limit;
+    Efont::OpenType::Coverage _limit_coverage;
+    const Vector<int> &_lookups;
+    Workers *_workers;          // null if decoding on the calling thread
+
+    void start(int nthreads);
+    static bool skip_gpos_lookup(const Efont::OpenType::Gpos &, int lookup,
+                                 const Efont::OpenType::GlyphSet &limit);
+    static void *decode_thread(void *);
+    Slot &wait(int k);
+    bool finish(Slot &, ErrorHandler *);
+
+    LookupDecoder(const LookupDecoder &);
+    LookupDecoder &operator=(const LookupDecoder &);
+
+};
+
+#endif
@@ -0,0 +1,221 @@
+/* manifest.{cc,hh} -- remember generated files for incremental rebuilds
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "manifest.hh"
+#include "util.hh"
+#include <lcdf/error.hh>
+#include <lcdf/straccum.hh>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+
+const char *Manifest::default_name = ".otftotfm-manifest";
+
+static const char manifest_header[] = "% Automatically maintained by otftotfm. Do not edit.\n";
+
+String
+Manifest::Entry::unparse() const
+{
+    StringAccum sa;
+    sa << "job " << key << ' ' << font_name << '\n';
+    for (int i = 0; i < files.size(); ++i)
+        sa << "file " << stamps[i] << ' ' << files[i] << '\n';
+    for (int i = 0; i < encoding_files.size(); ++i)
+        sa << "encoding " << encoding_names[i] << ' ' << encoding_files[i] << '\n';
+    for (int i = 0; i < map_fonts.size(); ++i) {
+        sa << "map " << map_fonts[i];
+        if (map_lines[i])
+            sa << ' ' << map_lines[i];
+        else
+            sa << '\n';
+    }
+    return sa.take_string();
+}
+
+static String
+next_word(const char *&s, const char *end)
+{
+    const char *w = s;
+    while (s != end && *s != ' ')
+        ++s;
+    String word(w, s);
+    if (s != end)
+        ++s;
+    return word;
+}
+
+void
+Manifest::parse(const String &text)
+{
+    Entry *e = 0;
+    const char *end = text.end();
+    for (const char *s = text.begin(); s != end; ) {
+        const char *nl = std::find(s, end, '\n');
+        String command = next_word(s, nl);
+        if (command == "job") {
+            _entries.push_back(Entry());
+            e = &_entries.back();
+            e->key = next_word(s, nl);
+            e->font_name = String(s, nl);
+        } else if (command == "file" && e) {
+            String size = next_word(s, nl);
+            String mtime = next_word(s, nl);
+            e->stamps.push_back(size + " " + mtime);
+            e->files.push_back(String(s, nl));
+        } else if (command == "encoding" && e) {
+            e->encoding_names.push_back(next_word(s, nl));
+            e->encoding_files.push_back(String(s, nl));
+        } else if (command == "map" && e) {
+            e->map_fonts.push_back(next_word(s, nl));
+            // map lines keep their newline
+            e->map_lines.push_back(s != nl ? String(s, nl) + "\n" : String());
+        }
+        s = (nl == end ? nl : nl + 1);
+    }
+}
+
+String
+Manifest::unparse() const
+{
+    StringAccum sa;
+    sa << manifest_header;
+    for (const Entry *e = _entries.begin(); e != _entries.end(); ++e)
+        sa << e->unparse();
+    return sa.take_string();
+}
+
+const Manifest::Entry *
+Manifest::find(const String &key) const
+{
+    for (const Entry *e = _entries.begin(); e != _entries.end(); ++e)
+        if (e->key == key)
+            return e;
+    return 0;
+}
+
+void
+Manifest::replace(const Entry &entry)
+{
+    // an entry replaces older entries for the same inputs or font
+    for (int i = 0; i < _entries.size(); )
+        if (_entries[i].key == entry.key || _entries[i].font_name == entry.font_name)
+            _entries.erase(_entries.begin() + i);
+        else
+            ++i;
+    _entries.push_back(entry);
+}
+
+String
+file_stamp(const String &filename)
+{
+    struct stat s;
+    if (stat(filename.c_str(), &s) < 0)
+        return String();
+    StringAccum sa;
+    sa << (unsigned long) s.st_size << ' ' << (long) s.st_mtime;
+    return sa.take_string();
+}
+
+Manifest
+read_manifest(const String &filename)
+{
+    Manifest manifest;
+    if (access(filename.c_str(), R_OK) >= 0)
+        manifest.parse(read_file(filename, ErrorHandler::silent_handler()));
+    return manifest;
+}
+
+int
+update_manifest(const String &filename, const Vector<String> &entry_texts, ErrorHandler *errh)
+{
+    if (no_create) {
+        errh->message("would update manifest %s", filename.c_str());
+        return 0;
+    } else if (verbose)
+        errh->message("updating manifest %s", filename.c_str());
+
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT, 0666);
+    if (fd < 0)
+        return errh->error("%s: %s", filename.c_str(), strerror(errno));
+    FILE *f = fdopen(fd, "r+");
+    // NB: locking follows write_encoding_file and update_autofont_map
+
+#if defined(F_SETLKW) && defined(HAVE_FTRUNCATE)
+    {
+        struct flock lock;
+        lock.l_type = F_WRLCK;
+        lock.l_whence = SEEK_SET;
+        lock.l_start = 0;
+        lock.l_len = 0;
+        int result;
+        while ((result = fcntl(fd, F_SETLKW, &lock)) < 0 && errno == EINTR)
+            /* try again */;
+        if (result < 0) {
+            result = errno;
+            fclose(f);
+            return errh->error("locking %s: %s", filename.c_str(), strerror(result));
+        }
+    }
+#endif
+
+    // read old manifest
+    StringAccum sa;
+    int amt;
+    do {
+        if (char *x = sa.reserve(8192)) {
+            amt = fread(x, 1, 8192, f);
+            sa.adjust_length(amt);
+        } else
+            amt = 0;
+    } while (amt != 0);
+    if (!feof(f) || ferror(f))
+        return errh->error("%s: %s", filename.c_str(), strerror(errno));
+
+    Manifest manifest;
+    manifest.parse(sa.take_string());
+    for (const String *t = entry_texts.begin(); t != entry_texts.end(); ++t) {
+        Manifest entry;
+        entry.parse(*t);
+        for (const Manifest::Entry *e = entry.entries().begin(); e != entry.entries().end(); ++e)
+            manifest.replace(*e);
+    }
+    String text = manifest.unparse();
+
+    // rewind file
+#ifdef HAVE_FTRUNCATE
+    rewind(f);
+    if (ftruncate(fd, 0) < 0)
+#endif
+    {
+        fclose(f);
+        f = fopen(filename.c_str(), "w");
+        fd = fileno(f);
+    }
+
+    ignore_result(fwrite(text.data(), 1, text.length(), f));
+
+    fclose(f);
+    return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef OTFTOTFM_MANIFEST_HH
+#define OTFTOTFM_MANIFEST_HH
+#include <lcdf/string.hh>
+#include <lcdf/vector.hh>
+class ErrorHandler;
+
+// A Manifest records what otftotfm generated for each set of inputs, so a
+// later run with the same inputs can skip the conversion. Entries are keyed
+// by a digest of the inputs. Each lists the files written, with their sizes
+// and modification times, the encodings the job added to encoding files,
+// and the job's map lines.
+
+class Manifest { public:
+
+    struct Entry {
+        String key;
+        String font_name;
+        Vector<String> files;
+        Vector<String> stamps;
+        Vector<String> encoding_files;
+        Vector<String> encoding_names;
+        Vector<String> map_fonts;
+        Vector<String> map_lines;
+
+        String unparse() const;
+    };
+
+    Manifest()                          { }
+
+    void parse(const String &text);
+    String unparse() const;
+
+    const Vector<Entry> &entries() const { return _entries; }
+    const Entry *find(const String &key) const;
+    void replace(const Entry &entry);
+
+    static const char *default_name;
+
+  private:
+
+    Vector<Entry> _entries;
+
+};
+
+String file_stamp(const String &filename);
+Manifest read_manifest(const String &filename);
+int update_manifest(const String &filename, const Vector<String> &entry_texts, ErrorHandler *);
+
+#endif
@@ -26,7 +26,7 @@
 Metrics::Metrics(const Efont::CharstringProgram *font, int nglyphs)
     : _boundary_glyph(nglyphs), _emptyslot_glyph(nglyphs + 1),
       _design_units(1000), _units_per_em(font->units_per_em()),
-      _liveness_marked(false)
+      _letterspace(0), _liveness_marked(false)
 {
     _encoding.assign(256, Char());
     add_mapped_font(font, String());
@@ -283,11 +283,7 @@ Metrics::Ligature *
 Metrics::ligature_obj(Code code1, Code code2)
 {
     assert(valid_code(code1) && valid_code(code2));
-    Char &ch = _encoding[code1];
-    for (Ligature *l = ch.ligatures.begin(); l != ch.ligatures.end(); l++)
-        if (l->in2 == code2)
-            return l;
-    return 0;
+    return _encoding[code1].ligatures.find(code2);
 }
 
 inline void
@@ -353,10 +349,8 @@ Metrics::remove_ligatures(Code in1, Code in2)
         Char &ch = _encoding[in1];
         if (in2 == CODE_ALL)
             ch.ligatures.clear();
-        else if (Ligature *l = ligature_obj(in1, in2)) {
-            *l = ch.ligatures.back();
-            ch.ligatures.pop_back();
-        }
+        else if (Ligature *l = ligature_obj(in1, in2))
+            ch.ligatures.erase(l);
     }
 }
 
@@ -368,22 +362,15 @@ Metrics::Kern *
 Metrics::kern_obj(Code in1, Code in2)
 {
     assert(valid_code(in1) && valid_code(in2));
-    Char &ch = _encoding[in1];
-    for (Kern *k = ch.kerns.begin(); k != ch.kerns.end(); k++)
-        if (k->in2 == in2)
-            return k;
-    return 0;
+    return _encoding[in1].kerns.find(in2);
 }
 
 int
 Metrics::kern(Code in1, Code in2) const
 {
     assert(valid_code(in1) && valid_code(in2));
-    const Char &ch = _encoding[in1];
-    for (const Kern *k = ch.kerns.begin(); k != ch.kerns.end(); k++)
-        if (k->in2 == in2)
-            return k->kern;
-    return 0;
+    const Kern *k = _encoding[in1].kerns.find(in2);
+    return k ? k->kern : 0;
 }
 
 void
@@ -407,10 +394,9 @@ Metrics::set_kern(Code in1, Code in2, int kern)
             assert(kern == 0);
             ch.kerns.clear();
         } else if (Kern *k = kern_obj(in1, in2)) {
-            if (kern == 0) {
-                *k = ch.kerns.back();
-                ch.kerns.pop_back();
-            } else
+            if (kern == 0)
+                ch.kerns.erase(k);
+            else
                 k->kern = kern;
         } else if (kern != 0)
             ch.kerns.push_back(Kern(in2, kern));
@@ -425,10 +411,9 @@ Metrics::reencode_right_ligkern(Code old_in2, Code new_in2)
         for (Ligature *l = ch->ligatures.begin(); l != ch->ligatures.end(); l++)
             if (l->in2 == old_in2) {
                 if (new_in2 >= 0)
-                    l->in2 = new_in2;
+                    ch->ligatures.set_in2(l, new_in2);
                 else {
-                    *l = ch->ligatures.back();
-                    ch->ligatures.pop_back();
+                    ch->ligatures.erase(l);
                     l--;
                 }
                 nchanges++;
@@ -436,10 +421,9 @@ Metrics::reencode_right_ligkern(Code old_in2, Code new_in2)
         for (Kern *k = ch->kerns.begin(); k != ch->kerns.end(); k++)
             if (k->in2 == old_in2) {
                 if (new_in2 >= 0)
-                    k->in2 = new_in2;
+                    ch->kerns.set_in2(k, new_in2);
                 else {
-                    *k = ch->kerns.back();
-                    ch->kerns.pop_back();
+                    ch->kerns.erase(k);
                     k--;
                 }
                 nchanges++;
@@ -716,35 +700,48 @@ Metrics::next_encoding(Vector<Code> &codes, const Vector<Glyph> &glyphs) const
     }
 }
 
-int
-Metrics::apply(const Vector<Substitution>& sv, bool allow_single, int lookup, const GlyphFilter& glyph_filter, const Vector<PermString>& glyph_names)
+Metrics::SubstitutionApplier::SubstitutionApplier(Metrics &m, bool allow_single, int lookup, const GlyphFilter &glyph_filter, const Vector<PermString> &glyph_names)
+    : _m(m), _allow_single(allow_single), _lookup(lookup),
+      _glyph_filter(glyph_filter), _glyph_names(glyph_names),
+      // keep track of what substitutions we have performed
+      _ctx(new ChangedContext(m._encoding.size())),
+      _nvisited(0), _nfailed(0)
 {
-    Vector<Glyph> glyphs;
-    Vector<Code> codes;
-
-    // keep track of what substitutions we have performed
-    ChangedContext ctx(_encoding.size());
+}
 
-    // loop over substitutions
-    int failures = 0;
-    for (const Substitution *s = sv.begin(); s != sv.end(); s++) {
-        bool is_single = s->is_single() || s->is_alternate();
-        bool is_apply_single = is_single && allow_single;
-        bool is_apply_simple_context_ligature = !is_single && !s->is_multiple() && s->is_simple_context();
+Metrics::SubstitutionApplier::~SubstitutionApplier()
+{
+    delete _ctx;
+}
 
-        if (is_apply_single || is_apply_simple_context_ligature) {
-            s->all_in_glyphs(glyphs);
-            for (codes.clear(); next_encoding(codes, glyphs); ) {
-                if (is_apply_single)
-                    apply_single(codes[0], s, lookup, ctx, glyph_filter, glyph_names);
-                else
-                    apply_simple_context_ligature(codes, s, lookup, ctx, glyph_filter, glyph_names);
-            }
-        } else
-            failures++;
-    }
+bool
+Metrics::SubstitutionApplier::visit(const Substitution &s)
+{
+    bool is_single = s.is_single() || s.is_alternate();
+    bool is_apply_single = is_single && _allow_single;
+    bool is_apply_simple_context_ligature = !is_single && !s.is_multiple() && s.is_simple_context();
+
+    _nvisited++;
+    if (is_apply_single || is_apply_simple_context_ligature) {
+        s.all_in_glyphs(_glyphs);
+        for (_codes.clear(); _m.next_encoding(_codes, _glyphs); ) {
+            if (is_apply_single)
+                _m.apply_single(_codes[0], &s, _lookup, *_ctx, _glyph_filter, _glyph_names);
+            else
+                _m.apply_simple_context_ligature(_codes, &s, _lookup, *_ctx, _glyph_filter, _glyph_names);
+        }
+    } else
+        _nfailed++;
+    return true;
+}
 
-    return sv.size() - failures;
+int
+Metrics::apply(const Vector<Substitution>& sv, bool allow_single, int lookup, const GlyphFilter& glyph_filter, const Vector<PermString>& glyph_names)
+{
+    SubstitutionApplier applier(*this, allow_single, lookup, glyph_filter, glyph_names);
+    for (const Substitution *s = sv.begin(); s != sv.end(); s++)
+        applier.visit(*s);
+    return applier.napplied();
 }
 
 void
@@ -787,24 +784,34 @@ Metrics::apply_alternates_ligature(const Vector<Code> &codes,
         }
 }
 
-void
-Metrics::apply_alternates(const Vector<Substitution>& sv, int lookup, const GlyphFilter& glyph_filter, const Vector<PermString>& glyph_names)
+Metrics::AlternateApplier::AlternateApplier(Metrics &m, int lookup, const GlyphFilter &glyph_filter, const Vector<PermString> &glyph_names)
+    : _m(m), _lookup(lookup), _glyph_filter(glyph_filter),
+      _glyph_names(glyph_names)
 {
-    Vector<Glyph> glyphs;
-    Vector<Code> codes;
+}
 
-    for (const Substitution *s = sv.begin(); s != sv.end(); s++) {
-        bool is_single = s->is_single() || s->is_alternate();
-        if (is_single || s->is_ligature()) {
-            s->all_in_glyphs(glyphs);
-            for (codes.clear(); next_encoding(codes, glyphs); ) {
-                if (is_single)
-                    apply_alternates_single(codes[0], s, lookup, glyph_filter, glyph_names);
-                else
-                    apply_alternates_ligature(codes, s, lookup, glyph_filter, glyph_names);
-            }
+bool
+Metrics::AlternateApplier::visit(const Substitution &s)
+{
+    bool is_single = s.is_single() || s.is_alternate();
+    if (is_single || s.is_ligature()) {
+        s.all_in_glyphs(_glyphs);
+        for (_codes.clear(); _m.next_encoding(_codes, _glyphs); ) {
+            if (is_single)
+                _m.apply_alternates_single(_codes[0], &s, _lookup, _glyph_filter, _glyph_names);
+            else
+                _m.apply_alternates_ligature(_codes, &s, _lookup, _glyph_filter, _glyph_names);
         }
     }
+    return true;
+}
+
+void
+Metrics::apply_alternates(const Vector<Substitution>& sv, int lookup, const GlyphFilter& glyph_filter, const Vector<PermString>& glyph_names)
+{
+    AlternateApplier applier(*this, lookup, glyph_filter, glyph_names);
+    for (const Substitution *s = sv.begin(); s != sv.end(); s++)
+        applier.visit(*s);
 }
 
 
@@ -826,40 +833,51 @@ assign_bitvec(int*& bitvec, int e, int n)
         return false;
 }
 
-int
-Metrics::apply(const Vector<Positioning>& pv)
+Metrics::PositioningApplier::PositioningApplier(Metrics &m)
+    : _m(m), _single_changed(0), _pair_changed(m._encoding.size(), 0),
+      _nvisited(0), _napplied(0)
+{
+}
+
+Metrics::PositioningApplier::~PositioningApplier()
 {
-    // keep track of what substitutions we have performed
-    int *single_changed = 0;
-    Vector<int *> pair_changed(_encoding.size(), 0);
-    Vector<Glyph> glyphs;
-    Vector<Code> codes;
-
-    // loop over substitutions
-    int success = 0;
-    for (const Positioning *p = pv.begin(); p != pv.end(); p++) {
-        bool is_single = p->is_single();
-        if (is_single || p->is_pairkern()) {
-            p->all_in_glyphs(glyphs);
-            for (codes.clear(); next_encoding(codes, glyphs); )
-                if (is_single) {
-                    if (!assign_bitvec(single_changed, codes[0], _encoding.size())) {
-                        _encoding[codes[0]].pdx += p->left().pdx;
-                        _encoding[codes[0]].pdy += p->left().pdy;
-                        _encoding[codes[0]].adx += p->left().adx;
-                    }
-                } else {
-                    if (!assign_bitvec(pair_changed[codes[0]], codes[1], _encoding.size()))
-                        add_kern(codes[0], codes[1], p->left().adx);
+    delete[] _single_changed;
+    for (int i = 0; i < _pair_changed.size(); i++)
+        delete[] _pair_changed[i];
+}
+
+bool
+Metrics::PositioningApplier::visit(const Positioning &p)
+{
+    // keep track of what positionings we have performed
+    int n = _pair_changed.size();
+    bool is_single = p.is_single();
+    _nvisited++;
+    if (is_single || p.is_pairkern()) {
+        p.all_in_glyphs(_glyphs);
+        for (_codes.clear(); _m.next_encoding(_codes, _glyphs); )
+            if (is_single) {
+                if (!assign_bitvec(_single_changed, _codes[0], n)) {
+                    _m._encoding[_codes[0]].pdx += p.left().pdx;
+                    _m._encoding[_codes[0]].pdy += p.left().pdy;
+                    _m._encoding[_codes[0]].adx += p.left().adx;
                 }
-            success++;
-        }
+            } else {
+                if (!assign_bitvec(_pair_changed[_codes[0]], _codes[1], n))
+                    _m.add_kern(_codes[0], _codes[1], p.left().adx);
+            }
+        _napplied++;
     }
+    return true;
+}
 
-    delete[] single_changed;
-    for (int i = 0; i < pair_changed.size(); i++)
-        delete[] pair_changed[i];
-    return success;
+int
+Metrics::apply(const Vector<Positioning>& pv)
+{
+    PositioningApplier applier(*this);
+    for (const Positioning *p = pv.begin(); p != pv.end(); p++)
+        applier.visit(*p);
+    return applier.napplied();
 }
 
 
@@ -959,11 +977,11 @@ Metrics::reencode(const Vector<Code> &reencoding)
 {
     for (Char *ch = _encoding.begin(); ch != _encoding.end(); ch++) {
         for (Ligature *l = ch->ligatures.begin(); l != ch->ligatures.end(); l++) {
-            l->in2 = reencoding[l->in2];
+            ch->ligatures.set_in2(l, reencoding[l->in2]);
             l->out = reencoding[l->out];
         }
         for (Kern *k = ch->kerns.begin(); k != ch->kerns.end(); k++)
-            k->in2 = reencoding[k->in2];
+            ch->kerns.set_in2(k, reencoding[k->in2]);
         if (VirtualChar *vc = ch->virtual_char) {
             int font_number = 0;
             for (Setting *s = vc->setting.begin(); s != vc->setting.end(); s++)
@@ -1067,14 +1085,12 @@ Metrics::cut_encoding(int size)
         for (Ligature *l = ch.ligatures.begin(); l != ch.ligatures.end(); l++)
             if (!good[l->in2] || l->in2 >= size
                 || (!good[l->out] && !_encoding[l->out].context_setting(c, l->in2))) {
-                *l = ch.ligatures.back();
-                ch.ligatures.pop_back();
+                ch.ligatures.erase(l);
                 l--;
             }
         for (Kern *k = ch.kerns.begin(); k != ch.kerns.end(); k++)
             if (!good[k->in2] || k->in2 >= size) {
-                *k = ch.kerns.back();
-                ch.kerns.pop_back();
+                ch.kerns.erase(k);
                 k--;
             }
     }
@@ -1384,8 +1400,6 @@ Metrics::need_base()
 bool
 Metrics::setting(Code code, Vector<Setting> &v, SettingMode sm) const
 {
-    extern int letterspace;
-
     if (!(sm & SET_KEEP))
         v.clear();
 
@@ -1430,7 +1444,7 @@ Metrics::setting(Code code, Vector<Setting> &v, SettingMode sm) const
                          && s[1].op == Setting::SHOW) {
                     int k = kern(s[-1].x, s[1].x);
                     if (s->op == Setting::KERNX)
-                        k -= letterspace;
+                        k -= _letterspace;
                     if (k)
                         v.push_back(Setting(Setting::MOVE, k, 0));
                 }
@@ -3,6 +3,8 @@
 #include <efont/otfgsub.hh>
 #include <efont/otfgpos.hh>
 #include "setting.hh"
+#include "pairlist.hh"
+#include <algorithm>
 namespace Efont { class CharstringProgram; }
 class DvipsEncoding;
 class GlyphFilter;
@@ -31,6 +33,9 @@ class Metrics { public:
     int units_per_em() const                    { return _units_per_em; }
     void set_design_units(int du)               { _design_units = du; }
 
+    int letterspace() const                     { return _letterspace; }
+    void set_letterspace(int ls)                { _letterspace = ls; }
+
     int n_mapped_fonts() const                  { return _mapped_fonts.size();}
     const Efont::CharstringProgram *mapped_font(int i) const { return _mapped_fonts[i]; }
     const String &mapped_font_name(int i) const { return _mapped_font_names[i]; }
@@ -72,6 +77,12 @@ class Metrics { public:
     void apply_alternates(const Vector<Substitution>&, int lookup, const GlyphFilter&, const Vector<PermString>& glyph_names);
     int apply(const Vector<Positioning>&);
 
+    // These visitors apply substitutions or positionings as a lookup
+    // decodes them, rather than after it has decoded them all.
+    class SubstitutionApplier;
+    class AlternateApplier;
+    class PositioningApplier;
+
     void apply_base_encoding(const String &font_name, const DvipsEncoding &, const Vector<int> &mapping);
 
     void cut_encoding(int size);
@@ -119,8 +130,8 @@ class Metrics { public:
         Glyph glyph;
         Code base_code;
         uint32_t unicode;
-        Vector<Ligature> ligatures;
-        Vector<Kern> kerns;
+        PairList<Ligature> ligatures;
+        PairList<Kern> kerns;
         VirtualChar *virtual_char;
         int pdx;
         int pdy;
@@ -153,6 +164,7 @@ class Metrics { public:
     String _coding_scheme;
     int _design_units;
     int _units_per_em;
+    int _letterspace;
 
     bool _liveness_marked : 1;
 
@@ -198,6 +210,77 @@ class Metrics { public:
 };
 
 
+class Metrics::SubstitutionApplier : public Efont::OpenType::SubstitutionVisitor { public:
+
+    SubstitutionApplier(Metrics &, bool allow_single, int lookup, const GlyphFilter &, const Vector<PermString> &glyph_names);
+    ~SubstitutionApplier();
+
+    bool visit(const Substitution &);
+
+    int nvisited() const                { return _nvisited; }
+    int napplied() const                { return _nvisited - _nfailed; }
+
+  private:
+
+    Metrics &_m;
+    bool _allow_single;
+    int _lookup;
+    const GlyphFilter &_glyph_filter;
+    const Vector<PermString> &_glyph_names;
+    ChangedContext *_ctx;
+    Vector<Glyph> _glyphs;
+    Vector<Code> _codes;
+    int _nvisited;
+    int _nfailed;
+
+    SubstitutionApplier(const SubstitutionApplier &);
+    SubstitutionApplier &operator=(const SubstitutionApplier &);
+
+};
+
+class Metrics::AlternateApplier : public Efont::OpenType::SubstitutionVisitor { public:
+
+    AlternateApplier(Metrics &, int lookup, const GlyphFilter &, const Vector<PermString> &glyph_names);
+
+    bool visit(const Substitution &);
+
+  private:
+
+    Metrics &_m;
+    int _lookup;
+    const GlyphFilter &_glyph_filter;
+    const Vector<PermString> &_glyph_names;
+    Vector<Glyph> _glyphs;
+    Vector<Code> _codes;
+
+};
+
+class Metrics::PositioningApplier : public Efont::OpenType::PositioningVisitor { public:
+
+    PositioningApplier(Metrics &);
+    ~PositioningApplier();
+
+    bool visit(const Positioning &);
+
+    int nvisited() const                { return _nvisited; }
+    int napplied() const                { return _napplied; }
+
+  private:
+
+    Metrics &_m;
+    int *_single_changed;
+    Vector<int *> _pair_changed;
+    Vector<Glyph> _glyphs;
+    Vector<Code> _codes;
+    int _nvisited;
+    int _napplied;
+
+    PositioningApplier(const PositioningApplier &);
+    PositioningApplier &operator=(const PositioningApplier &);
+
+};
+
+
 inline bool
 Metrics::valid_code(Code code) const
 {
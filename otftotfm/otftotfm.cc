@@ -34,6 +34,11 @@
 #include "kpseinterface.h"
 #include "util.hh"
 #include "otftotfm.hh"
+#include "tfmwriter.hh"
+#include "manifest.hh"
+#include "glyphlist.hh"
+#include "lookupdecode.hh"
+#include "stats.hh"
 #include <lcdf/md5.h>
 #include <lcdf/clp.h>
 #include <lcdf/error.hh>
@@ -63,6 +68,11 @@
 #ifdef HAVE_FCNTL_H
 # include <fcntl.h>
 #endif
+#if defined(HAVE_POLL_H) && defined(HAVE_SYS_WAIT_H) && defined(HAVE_WAITPID) && !defined(WIN32)
+# include <poll.h>
+# include <sys/wait.h>
+# define HAVE_PARALLEL_JOBS 1
+#endif
 
 using namespace Efont;
 
@@ -71,6 +81,7 @@ using namespace Efont;
 #define QUERY_SCRIPTS_OPT       303
 #define QUERY_FEATURES_OPT      304
 #define KPATHSEA_DEBUG_OPT      305
+#define FACE_OPT                306
 
 #define SCRIPT_OPT              311
 #define FEATURE_OPT             312
@@ -107,6 +118,10 @@ using namespace Efont;
 #define ITALIC_ANGLE_OPT        343
 #define PROPORTIONAL_WIDTH_OPT  344
 #define X_HEIGHT_OPT            345
+#define TIMINGS_OPT             346
+#define STATS_OPT               347
+#define CACHE_OPT               348
+#define JOBS_OPT                349
 
 #define AUTOMATIC_OPT           350
 #define FONT_NAME_OPT           351
@@ -117,12 +132,15 @@ using namespace Efont;
 #define NOCREATE_OPT            356
 #define VERBOSE_OPT             357
 #define FORCE_OPT               358
+#define BATCH_OPT               359
 
 #define VIRTUAL_OPT             360
 #define PL_OPT                  361
 #define TFM_OPT                 362
 #define MAP_FILE_OPT            363
 #define OUTPUT_ENCODING_OPT     364
+#define PLTOTF_OPT              365
+#define THREADS_OPT             366
 
 #define DIR_OPTS                380
 #define ENCODING_DIR_OPT        (DIR_OPTS + O_ENCODING)
@@ -207,9 +225,11 @@ static Clp_Option options[] = {
     { "type42", 0, TYPE42_OPT, 0, Clp_Negate },
     { "map-file", 0, MAP_FILE_OPT, Clp_ValString, Clp_Negate },
     { "output-encoding", 0, OUTPUT_ENCODING_OPT, Clp_ValString, Clp_Optional },
+    { "pltotf", 0, PLTOTF_OPT, 0, Clp_Negate },
 
     { "automatic", 'a', AUTOMATIC_OPT, 0, Clp_Negate },
     { "name", 'n', FONT_NAME_OPT, Clp_ValString, 0 },
+    { "face", 0, FACE_OPT, Clp_ValInt, 0 },
     { "vendor", 'v', VENDOR_OPT, Clp_ValString, 0 },
     { "typeface", 0, TYPEFACE_OPT, Clp_ValString, 0 },
 
@@ -227,6 +247,12 @@ static Clp_Option options[] = {
     { "glyphlist", 0, GLYPHLIST_OPT, Clp_ValString, 0 },
     { "no-create", 0, NOCREATE_OPT, 0, 0 },
     { "force", 0, FORCE_OPT, 0, Clp_Negate },
+    { "batch", 0, BATCH_OPT, Clp_ValString, 0 },
+    { "jobs", 'j', JOBS_OPT, Clp_ValInt, 0 },
+    { "threads", 0, THREADS_OPT, Clp_ValInt, 0 },
+    { "cache", 0, CACHE_OPT, 0, Clp_Negate },
+    { "timings", 0, TIMINGS_OPT, 0, Clp_Negate },
+    { "stats", 0, STATS_OPT, Clp_ValString, 0 },
     { "verbose", 'V', VERBOSE_OPT, 0, Clp_Negate },
     { "kpathsea-debug", 0, KPATHSEA_DEBUG_OPT, Clp_ValInt, 0 },
 
@@ -261,33 +287,15 @@ static StringAccum invocation;
 static PermString::Initializer perm_initializer;
 static PermString dot_notdef(".notdef");
 
-static Vector<Efont::OpenType::Tag> interesting_scripts;
-static Vector<Efont::OpenType::Tag> interesting_features;
-static Vector<Efont::OpenType::Tag> altselector_features;
 static GlyphFilter null_filter;
-static HashMap<Efont::OpenType::Tag, GlyphFilter*> feature_filters(0);
-static HashMap<Efont::OpenType::Tag, GlyphFilter*> altselector_feature_filters(0);
-
-static String font_name;
-static String encoding_file;
-static Vector<BaseEncoding *> base_encodings;
-static double extend;
-static double slant;
-int letterspace;
-static double design_size;
-static double minimum_kern = 2.0;
-static double space_factor = 1.0;
-static bool math_spacing = false;
-static int skew_char = -1;
-static bool override_is_fixed_pitch = false;
-static bool is_fixed_pitch;
-static bool override_italic_angle = false;
-static double italic_angle;
-static int override_x_height = FontInfo::x_height_auto;
-static double x_height;
-
-static String out_encoding_file;
-static String out_encoding_name;
+static Vector<GlyphFilter *> allocated_filters;
+
+// Parsed fonts and encodings, shared by all jobs in a batch. Fonts are
+// keyed by file name and face.
+static HashMap<String, String> font_data_cache;
+static HashMap<String, OpenType::Font *> font_cache(0);
+static HashMap<String, DvipsEncoding *> encoding_cache(0);
+static HashMap<String, Vector<BaseEncoding *> > base_encodings_cache;
 
 unsigned output_flags = G_ENCODING | G_METRICS | G_VMETRICS | G_PSFONTSMAP | G_TYPE1 | G_DOTLESSJ | G_UPDMAP | G_TRUETYPE;
 
@@ -296,8 +304,26 @@ bool verbose = false;
 bool no_create = false;
 bool quiet = false;
 bool force = false;
-
-static String otf_data;
+static bool use_pltotf = false;
+static int use_cache = -1;
+static int nthreads = 1;
+static String glyphlist_digest;
+static HashMap<String, String> font_digests;
+
+
+Job::Job()
+    : face(0), literal_encoding(false), have_encoding_file(false),
+      no_ecommand(false), default_ligkern(true), warn_missing(-1),
+      feature_filters(0), altselector_feature_filters(0),
+      current_filter_ptr(&null_filter),
+      extend(0), slant(0), letterspace(0), design_size(0),
+      minimum_kern(2.0), space_factor(1.0), math_spacing(false),
+      skew_char(-1), override_is_fixed_pitch(false), is_fixed_pitch(false),
+      override_italic_angle(false), italic_angle(0),
+      override_x_height(FontInfo::x_height_auto), x_height(0),
+      output_flags(::output_flags), specified_output_flags(0)
+{
+}
 
 
 void
@@ -325,11 +351,13 @@ turn on optional OpenType features, and a %<-e ENC%> option to specify a base\n\
 encoding. Output files are written to the current directory (but see\n\
 %<--automatic%> and the %<directory%> options).\n\
 \n\
-Usage: %s [-a] [OPTIONS] OTFFILE FONTNAME\n\n",
-           program_name);
+Usage: %s [-a] [OPTIONS] OTFFILE FONTNAME\n\
+       %s [-a] [OPTIONS] --batch JOBFILE\n\n",
+           program_name, program_name);
     uerrh.message("\
 Font feature and transformation options:\n\
   -s, --script=SCRIPT[.LANG]   Use features for script SCRIPT[.LANG] [latn].\n\
+      --face=N                 Use face N of a font collection [0].\n\
   -f, --feature=FEAT           Activate feature FEAT.\n\
   --lf, --letter-feature=FEAT  Activate feature FEAT for letters.\n\
       --subs-filter=PAT        Substitute only characters matching PAT.\n\
@@ -385,6 +413,7 @@ Output options:\n\
       --no-encoding            Do not generate an encoding file.\n\
       --no-map                 Do not generate a psfonts.map line.\n\
       --output-encoding[=FILE] Only generate an encoding file.\n\
+      --pltotf                 Run pltotf and vptovf to generate TFM/VFs.\n\
 \n");
     uerrh.message("\
 File location options:\n\
@@ -402,7 +431,14 @@ Other options:\n\
       --glyphlist=FILE         Use FILE to map Adobe glyph names to Unicode.\n\
   -V, --verbose                Print progress information to standard error.\n\
       --no-create              Print messages, don't modify any files.\n\
-      --force                  Generate files even if versions already exist.\n"
+      --force                  Generate files even if versions already exist.\n\
+      --batch=FILE             Run one job per line of FILE, sharing fonts.\n\
+  -j, --jobs=N                 Run up to N batch jobs in parallel.\n\
+      --threads=N              Decode GSUB and GPOS lookups with N threads.\n\
+      --cache                  Skip fonts whose outputs are up to date\n\
+                               [automatic].\n\
+      --timings                Report time and memory used by each phase.\n\
+      --stats=FILE             Append JSON phase statistics to FILE.\n"
 #if HAVE_KPATHSEA
 "      --kpathsea-debug=MASK    Set path searching debug flags to MASK.\n"
 #endif
@@ -472,7 +508,7 @@ make_base_font_name(const String &font_name)
 }
 
 static double
-get_design_size(const FontInfo &finfo)
+get_design_size(const Job &job, const FontInfo &finfo)
 {
     try {
         String gpos_table = finfo.otf->table("GPOS");
@@ -485,7 +521,7 @@ get_design_size(const FontInfo &finfo)
         // extract 'size' feature(s)
         int required_fid;
         Vector<int> fids;
-        for (const OpenType::Tag *t = interesting_scripts.begin(); t < interesting_scripts.end(); t += 2)
+        for (const OpenType::Tag *t = job.interesting_scripts.begin(); t < job.interesting_scripts.end(); t += 2)
             gpos.script_list().features(t[0], t[1], required_fid, fids, 0, false);
 
         int size_fid = gpos.feature_list().find(OpenType::Tag("size"), fids);
@@ -526,15 +562,18 @@ static double max_printed_real;
 
 namespace {
 struct Printer {
-    Printer(FILE* f, unsigned design_units, unsigned units_per_em)
-        : f_(f), du_((double) design_units / units_per_em),
+    Printer(FILE* f, TfmWriter* tfm, unsigned design_units, unsigned units_per_em)
+        : f_(f), tfm_(tfm), du_((double) design_units / units_per_em),
           round_(design_units == 1000) {
     }
     inline double transform(double value) const;
+    String text_transformed(double value) const;
     void print_transformed(const char* prefix, double value) const;
-    void print(const char* prefix, double value) const;
+    void param(int param, const char* prefix, double value) const;
+    void dimen(int which, const char* prefix, double value) const;
     String render(double value) const;
     FILE* f_;
+    TfmWriter* tfm_;
     double du_;
     bool round_;
 };
@@ -546,16 +585,32 @@ inline double Printer::transform(double value) const {
     return value;
 }
 
-void Printer::print_transformed(const char* prefix, double value) const {
+String Printer::text_transformed(double value) const {
+    char buf[128];
     if (round_ || value == 0 || (value > 0.01 && value - floor(value) < 0.01))
-        fprintf(f_, "%s R %g)\n", prefix, value);
+        sprintf(buf, "%g", value);
     else
-        fprintf(f_, "%s R %.4f)\n", prefix, value);
+        sprintf(buf, "%.4f", value);
+    return String(buf);
+}
+
+void Printer::print_transformed(const char* prefix, double value) const {
+    if (f_)
+        fprintf(f_, "%s R %s)\n", prefix, text_transformed(value).c_str());
     max_printed_real = std::max(max_printed_real, fabs(value));
 }
 
-void Printer::print(const char* prefix, double value) const {
-    print_transformed(prefix, transform(value));
+void Printer::param(int param, const char* prefix, double value) const {
+    value = transform(value);
+    print_transformed(prefix, value);
+    if (tfm_)
+        tfm_->set_param(param, text_transformed(value));
+}
+
+void Printer::dimen(int which, const char* prefix, double value) const {
+    print_transformed(prefix, value);
+    if (tfm_)
+        tfm_->set_dimen(which, text_transformed(value));
 }
 
 String Printer::render(double value) const {
@@ -571,93 +626,107 @@ String Printer::render(double value) const {
 } // namespace
 
 double
-font_slant(const FontInfo &finfo)
+font_slant(const Job &job, const FontInfo &finfo)
 {
     double val = finfo.italic_angle();
-    return -tan(val * M_PI / 180.0) + slant;
+    return -tan(val * M_PI / 180.0) + job.slant;
 }
 
+// Generate metrics as a PL or VPL file on 'f', or as binary TFM and VF data
+// in 'tfm'. Either may be null.
 static void
-output_pl(Metrics &metrics, const String &ps_name, int boundary_char,
-          const FontInfo &finfo, bool vpl,
-          const String &filename, ErrorHandler *errh)
+write_metrics(Job &job, Metrics &metrics, const String &ps_name, int boundary_char,
+              const FontInfo &finfo, bool vpl, FILE *f, TfmWriter *tfm)
 {
-    // create file
-    if (no_create) {
-        errh->message("would create %s", filename.c_str());
-        return;
-    }
-
-    if (verbose)
-        errh->message("creating %s", filename.c_str());
-    FILE *f = fopen(filename.c_str(), "w");
-    if (!f) {
-        errh->error("%s: %s", filename.c_str(), strerror(errno));
-        return;
-    }
-
     // XXX check DESIGNSIZE and DESIGNUNITS for correctness
 
-    fprintf(f, "(COMMENT Created by '%s'%s)\n", invocation.c_str(), current_time.c_str());
+    if (f)
+        fprintf(f, "(COMMENT Created by '%s'%s)\n", invocation.c_str(), current_time.c_str());
 
     // calculate a TeX FAMILY name using afm2tfm's algorithm
     String family_name = String("TeX-") + ps_name;
     if (family_name.length() > 19)
         family_name = family_name.substring(0, 9) + family_name.substring(-10);
-    fprintf(f, "(FAMILY %s)\n", family_name.c_str());
-
-    if (metrics.coding_scheme())
-        fprintf(f, "(CODINGSCHEME %.39s)\n", String(metrics.coding_scheme()).c_str());
+    if (f)
+        fprintf(f, "(FAMILY %s)\n", family_name.c_str());
+    if (tfm)
+        tfm->set_family(family_name);
+
+    if (metrics.coding_scheme()) {
+        String coding_scheme = String(metrics.coding_scheme()).substring(0, 39);
+        if (f)
+            fprintf(f, "(CODINGSCHEME %s)\n", coding_scheme.c_str());
+        if (tfm)
+            tfm->set_coding_scheme(coding_scheme);
+    }
     int design_units = metrics.design_units();
 
-    if (design_size <= 0)
-        design_size = get_design_size(finfo);
+    if (job.design_size <= 0)
+        job.design_size = get_design_size(job, finfo);
     max_printed_real = 0;
 
-    fprintf(f, "(DESIGNSIZE R %.1f)\n"
-            "(DESIGNUNITS R %d.0)\n"
-            "(COMMENT DESIGNSIZE (1 em) IS IN POINTS)\n"
-            "(COMMENT OTHER DIMENSIONS ARE MULTIPLES OF DESIGNSIZE/%d)\n"
-            "(FONTDIMEN\n", design_size, design_units, design_units);
+    char design_size_text[64];
+    sprintf(design_size_text, "%.1f", job.design_size);
+    if (f)
+        fprintf(f, "(DESIGNSIZE R %s)\n"
+                "(DESIGNUNITS R %d.0)\n"
+                "(COMMENT DESIGNSIZE (1 em) IS IN POINTS)\n"
+                "(COMMENT OTHER DIMENSIONS ARE MULTIPLES OF DESIGNSIZE/%d)\n"
+                "(FONTDIMEN\n", design_size_text, design_units, design_units);
+    if (tfm) {
+        tfm->set_design_size(design_size_text);
+        tfm->set_design_units(String(design_units));
+    }
 
     // figure out font dimensions
     Transform font_xform;
-    if (extend)
-        font_xform.scale(extend, 1);
-    if (slant)
-        font_xform.shear(slant);
+    if (job.extend)
+        font_xform.scale(job.extend, 1);
+    if (job.slant)
+        font_xform.shear(job.slant);
     double bounds[4], width;
-    Printer pr(f, design_units, metrics.units_per_em());
-
-    double actual_slant = font_slant(finfo);
-    if (actual_slant)
-        fprintf(f, "   (SLANT R %g)\n", actual_slant);
+    Printer pr(f, tfm, design_units, metrics.units_per_em());
+
+    double actual_slant = font_slant(job, finfo);
+    if (actual_slant) {
+        char slant_text[64];
+        sprintf(slant_text, "%g", actual_slant);
+        if (f)
+            fprintf(f, "   (SLANT R %s)\n", slant_text);
+        if (tfm)
+            tfm->set_param(TfmWriter::P_SLANT, slant_text);
+    }
 
     if (char_bounds(bounds, width, finfo, font_xform, ' ')) {
         // advance space width by letterspacing, scale by space_factor
-        double space_width = (width + (vpl ? letterspace : 0)) * space_factor;
-        pr.print("   (SPACE", space_width);
+        double space_width = (width + (vpl ? job.letterspace : 0)) * job.space_factor;
+        pr.param(TfmWriter::P_SPACE, "   (SPACE", space_width);
         if (finfo.is_fixed_pitch()) {
             // fixed-pitch: no space stretch or shrink
-            pr.print("   (STRETCH", 0);
-            pr.print("   (SHRINK", 0);
-            pr.print("   (EXTRASPACE", space_width);
+            pr.param(TfmWriter::P_STRETCH, "   (STRETCH", 0);
+            pr.param(TfmWriter::P_SHRINK, "   (SHRINK", 0);
+            pr.param(TfmWriter::P_EXTRASPACE, "   (EXTRASPACE", space_width);
         } else {
-            pr.print("   (STRETCH", space_width / 2.);
-            pr.print("   (SHRINK", space_width / 3.);
-            pr.print("   (EXTRASPACE", space_width / 6.);
+            pr.param(TfmWriter::P_STRETCH, "   (STRETCH", space_width / 2.);
+            pr.param(TfmWriter::P_SHRINK, "   (SHRINK", space_width / 3.);
+            pr.param(TfmWriter::P_EXTRASPACE, "   (EXTRASPACE", space_width / 6.);
         }
     }
 
     double x_height = finfo.x_height(font_xform);
     if (x_height < finfo.units_per_em())
-        pr.print("   (XHEIGHT", x_height);
+        pr.param(TfmWriter::P_XHEIGHT, "   (XHEIGHT", x_height);
 
-    pr.print("   (QUAD", finfo.units_per_em());
-    fprintf(f, "   )\n");
+    pr.param(TfmWriter::P_QUAD, "   (QUAD", finfo.units_per_em());
+    if (f)
+        fprintf(f, "   )\n");
 
-    if (boundary_char >= 0)
-        fprintf(f, "(BOUNDARYCHAR D %d)\n", boundary_char);
+    if (boundary_char >= 0) {
+        if (f)
+            fprintf(f, "(BOUNDARYCHAR D %d)\n", boundary_char);
+        if (tfm)
+            tfm->set_boundary_char(boundary_char);
+    }
 
     // figure out font mapping
     int mapped_font0 = 0;
@@ -692,8 +761,11 @@ output_pl(Metrics &metrics, const String &ps_name, int boundary_char,
             int j = std::find(font_mapping.begin(), font_mapping.end(), i) - font_mapping.begin();
             String name = metrics.mapped_font_name(j);
             if (!name)
-                name = make_base_font_name(font_name);
-            fprintf(f, "(MAPFONT D %d\n   (FONTNAME %s)\n   (FONTDSIZE R %.1f)\n   )\n", i, name.c_str(), design_size);
+                name = make_base_font_name(job.font_name);
+            if (f)
+                fprintf(f, "(MAPFONT D %d\n   (FONTNAME %s)\n   (FONTDSIZE R %s)\n   )\n", i, name.c_str(), design_size_text);
+            if (tfm)
+                tfm->add_mapped_font(i, name, design_size_text);
         }
     } else
         for (int i = 0; i < metrics.n_mapped_fonts(); i++)
@@ -741,28 +813,37 @@ output_pl(Metrics &metrics, const String &ps_name, int boundary_char,
     glyph_ids.push_back("BOUNDARYCHAR");
 
     // LIGTABLE
-    fprintf(f, "(LIGTABLE\n");
+    if (f)
+        fprintf(f, "(LIGTABLE\n");
     Vector<int> lig_code2, lig_outcode, lig_context, kern_code2, kern_amt;
     // don't print KRN x after printing LIG x
     uint32_t used[8];
     bool any_ligs = false;
     StringAccum omitted_clig_sa;
     for (int i = 0; i <= 256; i++)
-        if (metrics.glyph(i) && minimum_kern < 10000) {
+        if (metrics.glyph(i) && job.minimum_kern < 10000) {
             int any_lig = metrics.ligatures(i, lig_code2, lig_outcode, lig_context);
             int any_kern = metrics.kerns(i, kern_code2, kern_amt);
             if (any_lig || any_kern) {
                 StringAccum kern_sa;
+                bool any_ligkern = false;
                 memset(used, 0, sizeof(used));
                 for (int j = 0; j < lig_code2.size(); j++) {
                     if (lig_outcode[j] < 257) {
-                        kern_sa << "   (" << lig_context_str(lig_context[j])
-                                << ' ' << glyph_ids[lig_code2[j]]
-                                << ' ' << glyph_ids[lig_outcode[j]]
-                                << ')' << glyph_comments[lig_code2[j]]
-                                << glyph_comments[lig_outcode[j]] << '\n';
+                        if (f)
+                            kern_sa << "   (" << lig_context_str(lig_context[j])
+                                    << ' ' << glyph_ids[lig_code2[j]]
+                                    << ' ' << glyph_ids[lig_outcode[j]]
+                                    << ')' << glyph_comments[lig_code2[j]]
+                                    << glyph_comments[lig_outcode[j]] << '\n';
+                        if (tfm) {
+                            if (!any_ligkern)
+                                tfm->begin_ligkern(i);
+                            tfm->add_lig(lig_context[j] == 0 ? 0 : (lig_context[j] < 0 ? 2 : 1), lig_code2[j], lig_outcode[j]);
+                        }
+                        any_ligkern = true;
                         used[lig_code2[j] >> 5] |= (1 << (lig_code2[j] & 0x1F));
-                    } else {
+                    } else if (f) {
                         omitted_clig_sa << "(COMMENT omitted "
                                 << lig_context_str(lig_context[j])
                                 << ' ' << metrics.code_name(i)
@@ -774,22 +855,37 @@ output_pl(Metrics &metrics, const String &ps_name, int boundary_char,
                 for (Vector<int>::const_iterator k2 = kern_code2.begin(); k2 < kern_code2.end(); k2++)
                     if (!(used[*k2 >> 5] & (1 << (*k2 & 0x1F)))) {
                         double this_kern = kern_amt[k2 - kern_code2.begin()];
-                        if (fabs(this_kern) >= minimum_kern)
-                            kern_sa << "   (KRN " << glyph_ids[*k2]
-                                    << " R " << pr.render(this_kern)
-                                    << ')' << glyph_comments[*k2] << '\n';
+                        if (fabs(this_kern) >= job.minimum_kern) {
+                            String amt = pr.render(this_kern);
+                            if (f)
+                                kern_sa << "   (KRN " << glyph_ids[*k2]
+                                        << " R " << amt
+                                        << ')' << glyph_comments[*k2] << '\n';
+                            if (tfm) {
+                                if (!any_ligkern)
+                                    tfm->begin_ligkern(i);
+                                tfm->add_kern(*k2, amt);
+                            }
+                            any_ligkern = true;
+                        }
                     }
-                if (kern_sa) {
-                    if (any_ligs)
-                        fprintf(f, "\n");
-                    fprintf(f, "   (LABEL %s)%s\n%s   (STOP)\n", glyph_ids[i].c_str(), glyph_comments[i].c_str(), kern_sa.c_str());
+                if (any_ligkern) {
+                    if (f) {
+                        if (any_ligs)
+                            fprintf(f, "\n");
+                        fprintf(f, "   (LABEL %s)%s\n%s   (STOP)\n", glyph_ids[i].c_str(), glyph_comments[i].c_str(), kern_sa.c_str());
+                    }
+                    if (tfm)
+                        tfm->end_ligkern();
                     any_ligs = true;
                 }
             }
         }
-    fprintf(f, "   )\n");
-    if (omitted_clig_sa)
-        fprintf(f, "%s\n", omitted_clig_sa.c_str());
+    if (f) {
+        fprintf(f, "   )\n");
+        if (omitted_clig_sa)
+            fprintf(f, "%s\n", omitted_clig_sa.c_str());
+    }
 
     // CHARACTERs
     Vector<Setting> settings;
@@ -798,7 +894,10 @@ output_pl(Metrics &metrics, const String &ps_name, int boundary_char,
 
     for (int i = 0; i < 256; i++)
         if (metrics.setting(i, settings)) {
-            fprintf(f, "(CHARACTER %s%s\n", glyph_ids[i].c_str(), glyph_comments[i].c_str());
+            if (f)
+                fprintf(f, "(CHARACTER %s%s\n", glyph_ids[i].c_str(), glyph_comments[i].c_str());
+            if (tfm)
+                tfm->begin_char(i);
 
             // unparse settings into DVI commands
             sa.clear();
@@ -814,10 +913,14 @@ output_pl(Metrics &metrics, const String &ps_name, int boundary_char,
                         boundser.char_bounds(program->glyph_context(s->y));
                     // 3.Aug.2004 -- reported by Marco Kuhlmann: Don't use
                     // glyph_ids[] array when looking at a different font.
-                    if (program_number == 0)
+                    if (!f)
+                        /* nothing */;
+                    else if (program_number == 0)
                         sa << "      (SETCHAR " << glyph_ids[s->x] << ')' << glyph_base_comments[s->x] << "\n";
                     else
                         sa << "      (SETCHAR D " << s->x << ")\n";
+                    if (tfm)
+                        tfm->add_setchar(s->x);
                     break;
 
                   case Setting::MOVE: {
@@ -826,33 +929,48 @@ output_pl(Metrics &metrics, const String &ps_name, int boundary_char,
                           x += s->x, y += s->y, s++;
                       if (vpl)
                           boundser.translate(s->x + x, s->y + y);
-                      if (s->x + x)
-                          sa << "      (MOVERIGHT R " << pr.render(s->x + x) << ")\n";
-                      if (s->y + y)
-                          sa << "      (MOVEUP R " << pr.render(s->y + y) << ")\n";
+                      String right = (s->x + x ? pr.render(s->x + x) : String());
+                      String up = (s->y + y ? pr.render(s->y + y) : String());
+                      if (f && right)
+                          sa << "      (MOVERIGHT R " << right << ")\n";
+                      if (f && up)
+                          sa << "      (MOVEUP R " << up << ")\n";
+                      if (tfm)
+                          tfm->add_move(right, up);
                       break;
                   }
 
-                  case Setting::RULE:
-                    if (vpl) {
-                        boundser.mark(Point(0, 0));
-                        boundser.mark(Point(s->x, s->y));
-                        boundser.translate(s->x, 0);
-                    }
-                    sa << "      (SETRULE R " << pr.render(s->y) << " R " << pr.render(s->x) << ")\n";
-                    break;
+                  case Setting::RULE: {
+                      if (vpl) {
+                          boundser.mark(Point(0, 0));
+                          boundser.mark(Point(s->x, s->y));
+                          boundser.translate(s->x, 0);
+                      }
+                      String height = pr.render(s->y), width = pr.render(s->x);
+                      if (f)
+                          sa << "      (SETRULE R " << height << " R " << width << ")\n";
+                      if (tfm)
+                          tfm->add_rule(height, width);
+                      break;
+                  }
 
                   case Setting::FONT:
                     if ((int) s->x != program_number) {
                         program = metrics.mapped_font((int) s->x);
                         program_number = (int) s->x;
-                        sa << "      (SELECTFONT D " << font_mapping[program_number] << ")\n";
+                        if (f)
+                            sa << "      (SELECTFONT D " << font_mapping[program_number] << ")\n";
+                        if (tfm)
+                            tfm->add_selectfont(font_mapping[program_number]);
                     }
                     break;
 
                   case Setting::PUSH:
                     push_stack.push_back(boundser.transform(Point(0, 0)));
-                    sa << "      (PUSH)\n";
+                    if (f)
+                        sa << "      (PUSH)\n";
+                    if (tfm)
+                        tfm->add_push();
                     break;
 
                   case Setting::POP: {
@@ -861,7 +979,10 @@ output_pl(Metrics &metrics, const String &ps_name, int boundary_char,
                       if (vpl)
                           boundser.translate(p.x, p.y);
                       push_stack.pop_back();
-                      sa << "      (POP)\n";
+                      if (f)
+                          sa << "      (POP)\n";
+                      if (tfm)
+                          tfm->add_pop();
                       break;
                   }
 
@@ -870,7 +991,9 @@ output_pl(Metrics &metrics, const String &ps_name, int boundary_char,
                       for (const char *str = s->s.begin(); str < s->s.end() && !needhex; str++)
                           if (*str < ' ' || *str > '~' || *str == '(' || *str == ')')
                               needhex = true;
-                      if (needhex) {
+                      if (!f)
+                          /* nothing */;
+                      else if (needhex) {
                           sa << "      (SPECIALHEX ";
                           for (const char *str = s->s.begin(); str < s->s.end(); str++) {
                               static const char hexdig[] = "0123456789ABCDEF";
@@ -880,6 +1003,8 @@ output_pl(Metrics &metrics, const String &ps_name, int boundary_char,
                           sa << ")\n";
                       } else
                           sa << "      (SPECIAL " << s->s << ")\n";
+                      if (tfm)
+                          tfm->add_special(s->s);
                       break;
                   }
 
@@ -889,30 +1014,89 @@ output_pl(Metrics &metrics, const String &ps_name, int boundary_char,
 
             // output information
             boundser.output(bounds, width);
-            pr.print("   (CHARWD", width);
+            pr.dimen(TfmWriter::D_WD, "   (CHARWD", pr.transform(width));
             if (bounds[3] > 0)
-                pr.print("   (CHARHT", bounds[3]);
+                pr.dimen(TfmWriter::D_HT, "   (CHARHT", pr.transform(bounds[3]));
             if (bounds[1] < 0)
-                pr.print("   (CHARDP", -bounds[1]);
+                pr.dimen(TfmWriter::D_DP, "   (CHARDP", pr.transform(-bounds[1]));
             if (bounds[2] > width)
-                pr.print_transformed("   (CHARIC", pr.transform(bounds[2]) - pr.transform(width));
-            if (vpl && (settings.size() > 1 || settings[0].op != Setting::SHOW))
-                fprintf(f, "   (MAP\n%s      )\n", sa.c_str());
-            fprintf(f, "   )\n");
+                pr.dimen(TfmWriter::D_IC, "   (CHARIC", pr.transform(bounds[2]) - pr.transform(width));
+            bool use_map = vpl && (settings.size() > 1 || settings[0].op != Setting::SHOW);
+            if (f) {
+                if (use_map)
+                    fprintf(f, "   (MAP\n%s      )\n", sa.c_str());
+                fprintf(f, "   )\n");
+            }
+            if (tfm)
+                tfm->end_char(use_map);
         }
+}
+
+// Did we print a number too big for TeX to handle? If so, reduce the
+// design units and return true, so the caller tries again.
+static bool
+check_design_units(Metrics &metrics, ErrorHandler *errh)
+{
+    if (max_printed_real < 2047)
+        return false;
+    if (metrics.design_units() <= 1)
+        errh->fatal("This font appears to be broken.  It has characters so big that the PL format\ncannot represent them.");
+    metrics.set_design_units(metrics.design_units() > 200 ? metrics.design_units() - 250 : 1);
+    if (verbose)
+        errh->message("the font%,s metrics overflow the limits of PL files\n(reducing DESIGNUNITS to %d and trying again)", metrics.design_units());
+    return true;
+}
+
+static void
+output_pl(Job &job, Metrics &metrics, const String &ps_name, int boundary_char,
+          const FontInfo &finfo, bool vpl,
+          const String &filename, ErrorHandler *errh)
+{
+    // create file
+    if (no_create) {
+        errh->message("would create %s", filename.c_str());
+        return;
+    }
+
+    if (verbose)
+        errh->message("creating %s", filename.c_str());
+    FILE *f = fopen(filename.c_str(), "w");
+    if (!f) {
+        errh->error("%s: %s", filename.c_str(), strerror(errno));
+        return;
+    }
+
+    write_metrics(job, metrics, ps_name, boundary_char, finfo, vpl, f, 0);
 
     // at last, close the file
     fclose(f);
 
-    // Did we print a number too big for TeX to handle?  If so, try again.
-    if (max_printed_real >= 2047) {
-        if (metrics.design_units() <= 1)
-            errh->fatal("This font appears to be broken.  It has characters so big that the PL format\ncannot represent them.");
-        metrics.set_design_units(metrics.design_units() > 200 ? metrics.design_units() - 250 : 1);
-        if (verbose)
-            errh->message("the font%,s metrics overflow the limits of PL files\n(reducing DESIGNUNITS to %d and trying again)", metrics.design_units());
-        output_pl(metrics, ps_name, boundary_char, finfo, vpl, filename, errh);
-    }
+    if (check_design_units(metrics, errh))
+        output_pl(job, metrics, ps_name, boundary_char, finfo, vpl, filename, errh);
+}
+
+// Updates to the shared map and encoding files are collected while jobs
+// run and committed together at the end, in commit_pending_updates().
+struct PendingUpdate {
+    enum { ENCODING = 'E', MAP = 'M', MANIFEST = 'F', STATS = 'S' };
+    int type;
+    String filename;
+    String name;
+    String text;
+};
+
+static Vector<PendingUpdate> pending_updates;
+
+static void
+add_pending_update(int type, const String &filename, const String &name,
+                   const String &text)
+{
+    PendingUpdate pu;
+    pu.type = type;
+    pu.filename = filename;
+    pu.name = name;
+    pu.text = text;
+    pending_updates.push_back(pu);
 }
 
 struct Lookup {
@@ -924,21 +1108,21 @@ struct Lookup {
 };
 
 static void
-find_lookups(const OpenType::ScriptList& scripts, const OpenType::FeatureList& features, Vector<Lookup>& lookups, ErrorHandler* errh)
+find_lookups(const Job& job, const OpenType::ScriptList& scripts, const OpenType::FeatureList& features, Vector<Lookup>& lookups, ErrorHandler* errh)
 {
     Vector<int> fids, lookupids;
     int required;
 
     // go over all scripts
-    for (int i = 0; i < interesting_scripts.size(); i += 2) {
-        OpenType::Tag script = interesting_scripts[i];
-        OpenType::Tag langsys = interesting_scripts[i+1];
+    for (int i = 0; i < job.interesting_scripts.size(); i += 2) {
+        OpenType::Tag script = job.interesting_scripts[i];
+        OpenType::Tag langsys = job.interesting_scripts[i+1];
 
         // collect features applying to this script
         scripts.features(script, langsys, required, fids, errh);
 
         // only use the selected features
-        features.filter(fids, interesting_features);
+        features.filter(fids, job.interesting_features);
 
         // mark features as having been used
         for (int j = (required < 0 ? 0 : -1); j < fids.size(); j++) {
@@ -963,18 +1147,30 @@ find_lookups(const OpenType::ScriptList& scripts, const OpenType::FeatureList& f
     // now check for compatible glyph filters
     for (Lookup* l = lookups.begin(); l < lookups.end(); l++)
         if (l->used && !l->required) {
-            l->filter = feature_filters[l->features[0]];
+            l->filter = job.feature_filters[l->features[0]];
             for (OpenType::Tag* ft = l->features.begin() + 1; ft < l->features.end(); ft++)
-                if (!l->filter->check_eq(*feature_filters[*ft])) {
+                if (!l->filter->check_eq(*job.feature_filters[*ft])) {
                     errh->error("%<%s%> and %<%s%> features share a lookup, but have different filters", l->features[0].text().c_str(), ft->text().c_str());
                     break;
                 }
         }
 }
 
+static bool
+encoding_file_has(const String &text, const String &encoding_name)
+{
+    for (int pos = text.find_left("\n%%"); pos >= 0; pos = text.find_left("\n%%", pos + 1))
+        if (text.substring(pos + 3, encoding_name.length()) == encoding_name)
+            return true;
+    return false;
+}
+
+// Add encodings to an encoding file. Each element of 'contents' is a
+// complete encoding file for the corresponding encoding name; the most
+// recently added encoding comes first in the result.
 static int
-write_encoding_file(String &filename, const String &encoding_name,
-                    StringAccum &contents, ErrorHandler *errh)
+write_encoding_file(const String &filename, const Vector<String> &encoding_names,
+                    const Vector<String> &contents, ErrorHandler *errh)
 {
     FILE *f;
     int ok_retval = (access(filename.c_str(), R_OK) >= 0 ? 0 : 1);
@@ -1024,22 +1220,32 @@ write_encoding_file(String &filename, const String &encoding_name,
     String old_encodings = sa.take_string();
     bool created = (!old_encodings);
 
-    // append old encodings
-    int pos1 = old_encodings.find_left("\n%%");
-    while (pos1 >= 0 && pos1 < old_encodings.length()) {
-        int pos2 = old_encodings.find_left("\n%%", pos1 + 1);
-        if (pos2 < 0)
-            pos2 = old_encodings.length();
-        if (old_encodings.substring(pos1 + 3, encoding_name.length()) == encoding_name) {
-            // encoding already exists, don't change it
-            fclose(f);
-            if (verbose)
-                errh->message("%s unchanged", filename.c_str());
-            return 0;
-        } else
-            contents << old_encodings.substring(pos1, pos2 - pos1);
-        pos1 = pos2;
+    // find new encodings; encodings that already exist don't change
+    Vector<int> added;
+    for (int i = 0; i < encoding_names.size(); ++i) {
+        bool found = encoding_file_has(old_encodings, encoding_names[i]);
+        for (int *a = added.begin(); a != added.end() && !found; ++a)
+            found = (encoding_names[*a] == encoding_names[i]);
+        if (!found)
+            added.push_back(i);
     }
+    if (!added.size()) {
+        fclose(f);
+        if (verbose)
+            errh->message("%s unchanged", filename.c_str());
+        return 0;
+    }
+
+    // new encodings, newest first, then old encodings
+    StringAccum text;
+    for (int *a = added.end(); a != added.begin(); ) {
+        const String &c = contents[*--a];
+        int pos = c.find_left("\n%%");
+        text << (text.empty() || pos < 0 ? c : c.substring(pos));
+    }
+    int pos1 = old_encodings.find_left("\n%%");
+    if (pos1 >= 0)
+        text << old_encodings.substring(pos1);
 
     // rewind file
 #ifdef HAVE_FTRUNCATE
@@ -1052,7 +1258,7 @@ write_encoding_file(String &filename, const String &encoding_name,
         fd = fileno(f);
     }
 
-    ignore_result(fwrite(contents.data(), 1, contents.length(), f));
+    ignore_result(fwrite(text.data(), 1, text.length(), f));
 
     fclose(f);
 
@@ -1062,8 +1268,53 @@ write_encoding_file(String &filename, const String &encoding_name,
     return 0;
 }
 
+// Write all collected encoding, map, and manifest updates, in job order. Each
+// file is locked and rewritten once, and updmap runs at most once.
+static void
+commit_pending_updates(ErrorHandler *errh)
+{
+    Vector<bool> done(pending_updates.size(), false);
+    for (int i = 0; i < pending_updates.size(); ++i)
+        if (pending_updates[i].type == PendingUpdate::ENCODING && !done[i]) {
+            const String &filename = pending_updates[i].filename;
+            Vector<String> names, contents;
+            for (int j = i; j < pending_updates.size(); ++j)
+                if (pending_updates[j].type == PendingUpdate::ENCODING
+                    && pending_updates[j].filename == filename) {
+                    names.push_back(pending_updates[j].name);
+                    contents.push_back(pending_updates[j].text);
+                    done[j] = true;
+                }
+            write_encoding_file(filename, names, contents, errh);
+        }
+
+    Vector<String> fontnames, maplines;
+    for (PendingUpdate *pu = pending_updates.begin(); pu != pending_updates.end(); ++pu)
+        if (pu->type == PendingUpdate::MAP) {
+            fontnames.push_back(pu->name);
+            maplines.push_back(pu->text);
+        }
+    if (fontnames.size())
+        update_autofont_map(fontnames, maplines, errh);
+
+    for (int i = 0; i < pending_updates.size(); ++i)
+        if (pending_updates[i].type == PendingUpdate::MANIFEST && !done[i]) {
+            const String &filename = pending_updates[i].filename;
+            Vector<String> entries;
+            for (int j = i; j < pending_updates.size(); ++j)
+                if (pending_updates[j].type == PendingUpdate::MANIFEST
+                    && pending_updates[j].filename == filename) {
+                    entries.push_back(pending_updates[j].text);
+                    done[j] = true;
+                }
+            update_manifest(filename, entries, errh);
+        }
+
+    pending_updates.clear();
+}
+
 static bool
-output_encoding(const Metrics &metrics,
+output_encoding(Job &job, const Metrics &metrics,
                 const Vector<PermString> &glyph_names,
                 ErrorHandler *errh)
 {
@@ -1096,15 +1347,15 @@ output_encoding(const Metrics &metrics,
     md5_final_text(text_digest, &md5);
 
     // name encoding using digest
-    out_encoding_name = "AutoEnc_" + String(text_digest);
+    job.out_encoding_name = "AutoEnc_" + String(text_digest);
 
     // create encoding filename
-    bool output_encoding_only = (bool) out_encoding_file;
-    if (!out_encoding_file)
-        out_encoding_file = getodir(O_ENCODING, errh) + String("/a_") + String(text_digest).substring(0, 6) + ".enc";
+    bool output_encoding_only = (bool) job.out_encoding_file;
+    if (!job.out_encoding_file)
+        job.out_encoding_file = getodir(O_ENCODING, errh) + String("/a_") + String(text_digest).substring(0, 6) + ".enc";
 
     // exit if we're not responsible for generating an encoding
-    if (!(output_flags & G_ENCODING))
+    if (!(job.output_flags & G_ENCODING))
         return true;
 
     // put encoding block in a StringAccum
@@ -1113,12 +1364,12 @@ output_encoding(const Metrics &metrics,
     StringAccum contents;
     if (!output_encoding_only)
         contents << "% THIS FILE WAS AUTOMATICALLY GENERATED -- DO NOT EDIT\n\n\
-%%" << out_encoding_name << "\n";
+%%" << job.out_encoding_name << "\n";
     contents << "% Encoding created by otftotfm" << current_time << "\n\
 % Command line follows encoding\n";
 
     // the encoding itself
-    contents << '/' << out_encoding_name << " [\n" << sa << "] def\n";
+    contents << '/' << job.out_encoding_name << " [\n" << sa << "] def\n";
 
     // write banner -- unfortunately this takes some doing
     String banner = String("Command line: '") + String(invocation.data(), invocation.length()) + String("'");
@@ -1146,17 +1397,18 @@ output_encoding(const Metrics &metrics,
     }
 
     // open encoding file
-    if (out_encoding_file == "-")
+    if (job.out_encoding_file == "-")
         ignore_result(fwrite(contents.data(), 1, contents.length(), stdout));
-    else if (write_encoding_file(out_encoding_file, out_encoding_name, contents, errh) == 1)
-        update_odir(O_ENCODING, out_encoding_file, errh);
+    else
+        add_pending_update(PendingUpdate::ENCODING, job.out_encoding_file,
+                           job.out_encoding_name, contents.take_string());
     return true;
 }
 
 static void
-output_tfm(Metrics &metrics, const String &ps_name, int boundary_char,
-           const FontInfo &finfo, String tfm_filename, String vf_filename,
-           String pl_filename, ErrorHandler *errh)
+output_tfm_pltotf(Job &job, Metrics &metrics, const String &ps_name, int boundary_char,
+                  const FontInfo &finfo, String tfm_filename, String vf_filename,
+                  String pl_filename, ErrorHandler *errh)
 {
     bool had_pl_filename = !pl_filename.empty();
     bool vpl = vf_filename;
@@ -1169,7 +1421,7 @@ output_tfm(Metrics &metrics, const String &ps_name, int boundary_char,
             int pl_fd = temporary_file(pl_filename, errh);
             if (pl_fd < 0)
                 return;
-            output_pl(metrics, ps_name, boundary_char, finfo, vpl, pl_filename, errh);
+            output_pl(job, metrics, ps_name, boundary_char, finfo, vpl, pl_filename, errh);
             close(pl_fd);
         }
     }
@@ -1180,6 +1432,7 @@ output_tfm(Metrics &metrics, const String &ps_name, int boundary_char,
     else
         command << "pltotf " << shell_quote(pl_filename) << ' ' << shell_quote(tfm_filename) << " 2>&1";
 
+    StatsTimer t(PH_SUBPROCESS);
     FILE* cmdfile = mypopen(command.c_str(), "r", errh);
     int status;
     if (cmdfile) {
@@ -1218,6 +1471,7 @@ output_tfm(Metrics &metrics, const String &ps_name, int boundary_char,
         status = pclose(cmdfile);
     } else
         status = -1;
+    t.end();
 
     if (!no_create && !had_pl_filename)
         unlink(pl_filename.c_str());
@@ -1231,25 +1485,73 @@ output_tfm(Metrics &metrics, const String &ps_name, int boundary_char,
     }
 }
 
+static void
+output_tfm(Job &job, Metrics &metrics, const String &ps_name, int boundary_char,
+           const FontInfo &finfo, String tfm_filename, String vf_filename,
+           String pl_filename, ErrorHandler *errh)
+{
+    if (use_pltotf) {
+        output_tfm_pltotf(job, metrics, ps_name, boundary_char, finfo, tfm_filename, vf_filename, pl_filename, errh);
+        return;
+    }
+
+    bool vpl = vf_filename;
+    if (no_create) {
+        errh->message("would create %s", tfm_filename.c_str());
+        if (vpl)
+            errh->message("would create %s", vf_filename.c_str());
+        return;
+    }
+
+    // Values too large for a TFM are expected on passes that
+    // check_design_units() retries with smaller design units, so report
+    // the writer's messages from the last pass only.
+    TfmWriter *tfm = 0;
+    Vector<String> messages;
+    RecordingErrorHandler recorder(&messages);
+    do {
+        delete tfm;
+        messages.clear();
+        tfm = new TfmWriter(&recorder);
+        write_metrics(job, metrics, ps_name, boundary_char, finfo, vpl, 0, tfm);
+    } while (check_design_units(metrics, errh));
+    for (const String *m = messages.begin(); m != messages.end(); ++m)
+        errh->xmessage(*m);
+    tfm->set_error_handler(errh);
+
+    if (verbose)
+        errh->message("creating %s", tfm_filename.c_str());
+    if (tfm->write_tfm(tfm_filename)) {
+        update_odir(O_TFM, tfm_filename, errh);
+        if (vpl) {
+            if (verbose)
+                errh->message("creating %s", vf_filename.c_str());
+            if (tfm->write_vf(vf_filename))
+                update_odir(O_VF, vf_filename, errh);
+        }
+    }
+    delete tfm;
+}
+
 void
-output_metrics(Metrics &metrics, const String &ps_name, int boundary_char,
-               const FontInfo &finfo,
+output_metrics(Job &job, Metrics &metrics, const String &ps_name,
+               int boundary_char, const FontInfo &finfo,
                const String &encoding_name, const String &encoding_file,
                const String &font_name,
-               String (*dvips_include)(const String &ps_name, const FontInfo &, ErrorHandler *),
+               String (*dvips_include)(const Job &, const String &ps_name, const FontInfo &, ErrorHandler *),
                ErrorHandler *errh)
 {
     String base_font_name = font_name;
     bool need_virtual = metrics.need_virtual(257);
     if (need_virtual) {
-        if (output_flags & G_VMETRICS)
+        if (job.output_flags & G_VMETRICS)
             base_font_name = make_base_font_name(font_name);
-        else if (output_flags & G_METRICS)
+        else if (job.output_flags & G_METRICS)
             errh->warning("features require virtual fonts");
     }
 
     // output virtual metrics
-    if (!(output_flags & G_VMETRICS))
+    if (!(job.output_flags & G_VMETRICS))
         /* do nothing */;
     else if (!need_virtual) {
         if (automatic) {
@@ -1266,15 +1568,15 @@ output_metrics(Metrics &metrics, const String &ps_name, int boundary_char,
         }
     } else {
         String vplfile;
-        if (output_flags & G_ASCII) {
+        if (job.output_flags & G_ASCII) {
             vplfile = getodir(O_VPL, errh) + "/" + font_name + ".vpl";
-            output_pl(metrics, ps_name, boundary_char, finfo, true, vplfile, errh);
+            output_pl(job, metrics, ps_name, boundary_char, finfo, true, vplfile, errh);
             update_odir(O_VPL, vplfile, errh);
         }
-        if (output_flags & G_BINARY) {
+        if (job.output_flags & G_BINARY) {
             String tfm = getodir(O_TFM, errh) + "/" + font_name + ".tfm";
             String vf = getodir(O_VF, errh) + "/" + font_name + ".vf";
-            output_tfm(metrics, ps_name, boundary_char, finfo, tfm, vf, vplfile, errh);
+            output_tfm(job, metrics, ps_name, boundary_char, finfo, tfm, vf, vplfile, errh);
         }
     }
 
@@ -1284,40 +1586,40 @@ output_metrics(Metrics &metrics, const String &ps_name, int boundary_char,
         return;
 
     // output metrics
-    double save_minimum_kern = minimum_kern;
+    double save_minimum_kern = job.minimum_kern;
     if (need_virtual)
-        minimum_kern = 100000;
-    if (output_flags & G_METRICS) {
+        job.minimum_kern = 100000;
+    if (job.output_flags & G_METRICS) {
         String plfile;
-        if (output_flags & G_ASCII) {
+        if (job.output_flags & G_ASCII) {
             plfile = getodir(O_PL, errh) + "/" + base_font_name + ".pl";
-            output_pl(metrics, ps_name, boundary_char, finfo, false, plfile, errh);
+            output_pl(job, metrics, ps_name, boundary_char, finfo, false, plfile, errh);
             update_odir(O_PL, plfile, errh);
         }
-        if (output_flags & G_BINARY) {
+        if (job.output_flags & G_BINARY) {
             String tfm = getodir(O_TFM, errh) + "/" + base_font_name + ".tfm";
-            output_tfm(metrics, ps_name, boundary_char, finfo, tfm, String(), plfile, errh);
+            output_tfm(job, metrics, ps_name, boundary_char, finfo, tfm, String(), plfile, errh);
         }
     }
-    minimum_kern = save_minimum_kern;
+    job.minimum_kern = save_minimum_kern;
 
     // print DVIPS map line
-    if (errh->nerrors() == 0 && (output_flags & G_PSFONTSMAP)) {
+    if (errh->nerrors() == 0 && (job.output_flags & G_PSFONTSMAP)) {
         StringAccum sa;
         sa << base_font_name << ' ' << ps_name << " \"";
-        if (extend)
-            sa << extend << " ExtendFont ";
-        if (slant)
-            sa << slant << " SlantFont ";
+        if (job.extend)
+            sa << job.extend << " ExtendFont ";
+        if (job.slant)
+            sa << job.slant << " SlantFont ";
         if (encoding_name)
             sa << encoding_name << " ReEncodeFont\" <[" << pathname_filename(encoding_file);
         else
             sa << "\"";
-        sa << ' ' << dvips_include(ps_name, finfo, errh) << '\n';
-        update_autofont_map(base_font_name, sa.take_string(), errh);
+        sa << ' ' << dvips_include(job, ps_name, finfo, errh) << '\n';
+        add_pending_update(PendingUpdate::MAP, String(), base_font_name, sa.take_string());
         // if virtual font, remove any map line for base font name
         if (base_font_name != font_name)
-            update_autofont_map(font_name, "", errh);
+            add_pending_update(PendingUpdate::MAP, String(), font_name, String());
     }
 }
 
@@ -1337,11 +1639,11 @@ static const char * const x_messages[] = {
 };
 
 static void
-report_underused_features(const HashMap<uint32_t, int> &feature_usage, ErrorHandler *errh)
+report_underused_features(const Job &job, const HashMap<uint32_t, int> &feature_usage, ErrorHandler *errh)
 {
     Vector<String> x[X_COUNT];
-    for (int i = 0; i < interesting_features.size(); i++) {
-        OpenType::Tag f = interesting_features[i];
+    for (int i = 0; i < job.interesting_features.size(); i++) {
+        OpenType::Tag f = job.interesting_features[i];
         int fu = feature_usage[f.value()];
         String ftext = errh->format("%<%s%>", f.text().c_str());
         if (fu == 0)
@@ -1385,127 +1687,175 @@ report_underused_features(const HashMap<uint32_t, int> &feature_usage, ErrorHand
         }
 }
 
-static String otf_filename;
-
 static String
-main_dvips_map(const String &ps_name, const FontInfo &finfo, ErrorHandler *errh)
+main_dvips_map(const Job &job, const String &ps_name, const FontInfo &finfo, ErrorHandler *errh)
 {
-    if (String fn = installed_type1(otf_filename, ps_name, (output_flags & G_TYPE1) != 0, errh))
+    const String &otf_filename = job.input_file;
+    if (String fn = installed_type1(otf_filename, job.face, ps_name, (job.output_flags & G_TYPE1) != 0, errh))
         return "<" + pathname_filename(fn);
     if (!finfo.cff) {
+        // Later faces of a collection are installed as Type 42, since a
+        // map file can't select a face from a TrueType collection.
+        unsigned t42_flags = (job.face > 0 ? G_TYPE42 | G_TRUETYPE : G_TYPE42);
         String ttf_fn, t42_fn;
-        ttf_fn = installed_truetype(otf_filename, (output_flags & G_TRUETYPE) != 0, errh);
-        t42_fn = installed_type42(otf_filename, ps_name, (output_flags & G_TYPE42) != 0, errh);
-        if (t42_fn && (!ttf_fn || (output_flags & G_TYPE42) != 0))
+        ttf_fn = installed_truetype(otf_filename, job.face, (job.output_flags & G_TRUETYPE) != 0, errh);
+        t42_fn = installed_type42(otf_filename, job.face, ps_name, (job.output_flags & t42_flags) != 0, errh);
+        if (t42_fn && (!ttf_fn || (job.output_flags & G_TYPE42) != 0))
             return "<" + pathname_filename(t42_fn);
         else if (ttf_fn)
             return "<" + pathname_filename(ttf_fn);
     }
+    if (job.face > 0)
+        errh->warning("%s: map file names the whole collection, so face %d may not be used", otf_filename.c_str(), job.face);
     return "<" + pathname_filename(otf_filename);
 }
 
+namespace {
+// Adds a boundary glyph context to each substitution before passing it on.
+class BoundaryContextVisitor : public OpenType::SubstitutionVisitor { public:
+    BoundaryContextVisitor(OpenType::SubstitutionVisitor &next, OpenType::Glyph left, OpenType::Glyph right)
+        : _next(next), _left(left), _right(right) {
+    }
+    bool visit(const OpenType::Substitution &s) {
+        OpenType::Substitution cs(s);
+        if (_left >= 0)
+            cs.add_outer_left(_left);
+        if (_right >= 0)
+            cs.add_outer_right(_right);
+        return _next.emit(cs);
+    }
+  private:
+    OpenType::SubstitutionVisitor &_next;
+    OpenType::Glyph _left;
+    OpenType::Glyph _right;
+};
+}
+
 static void
-do_gsub(Metrics& metrics, const OpenType::Font& otf,
+do_gsub(Job& job, Metrics& metrics, const OpenType::Font& otf,
         DvipsEncoding& dvipsenc, bool dvipsenc_literal,
         HashMap<uint32_t, int>& feature_usage,
         const Vector<PermString>& glyph_names, ErrorHandler* errh)
 {
     // find activated GSUB features
-    OpenType::Gsub gsub(otf.table("GSUB"), &otf, errh);
+    String gsub_table = otf.table("GSUB");
+    OpenType::Gsub gsub(gsub_table, &otf, errh);
     Vector<Lookup> lookups(gsub.nlookups(), Lookup());
-    find_lookups(gsub.script_list(), gsub.feature_list(), lookups, errh);
+    find_lookups(job, gsub.script_list(), gsub.feature_list(), lookups, errh);
 
-    // find all characters that might result
-    Vector<bool> used(glyph_names.size(), false);
+    // find all characters that might result: the closure of the encoded
+    // glyphs under the activated lookups
+    OpenType::GlyphSet used;
     for (Metrics::Code c = 0; c < metrics.encoding_size(); ++c) {
         Metrics::Glyph g = metrics.glyph(c);
-        if (g >= 0 && g < used.size())
-            used[g] = true;
+        if (g >= 0 && g < glyph_names.size())
+            used.insert(g);
     }
-    for (int i = 0; i < lookups.size(); ++i)
-        if (lookups[i].used) {
-            OpenType::GsubLookup l = gsub.lookup(i);
-            l.mark_out_glyphs(gsub, used);
-        }
-    OpenType::Coverage used_coverage(used);
-
-    // apply activated GSUB features
-    Vector<OpenType::Substitution> subs;
-    for (int i = 0; i < lookups.size(); i++)
-        if (lookups[i].used) {
-            OpenType::GsubLookup l = gsub.lookup(i);
-            subs.clear();
-            bool understood = l.unparse_automatics(gsub, subs, used_coverage);
-
-            // check for -ffina, which should apply only at the ends of words,
-            // and -finit, which should apply only at the beginnings.
-            OpenType::Tag feature = (lookups[i].features.size() == 1 ? lookups[i].features[0] : OpenType::Tag());
-            if (feature == OpenType::Tag("fina") || feature == OpenType::Tag("fin2") || feature == OpenType::Tag("fin3")) {
-                if (dvipsenc.boundary_char() < 0)
-                    errh->warning("%<-ffina%> requires a boundary character\n(The input encoding didn%,t specify a boundary character, but\nI need one to implement %<-ffina%> features correctly.  Try\nthe %<--boundary-char%> option.)");
-                else {
-                    int bg = metrics.boundary_glyph();
-                    for (int j = 0; j < subs.size(); j++)
-                        subs[j].add_outer_right(bg);
-                }
-            } else if (feature == OpenType::Tag("init")) {
-                int bg = metrics.boundary_glyph();
-                for (int j = 0; j < subs.size(); j++)
-                    subs[j].add_outer_left(bg);
+    for (int nused = -1; nused != used.size(); ) {
+        nused = used.size();
+        for (int i = 0; i < lookups.size(); ++i)
+            if (lookups[i].used && gsub.lookup_glyphs(i).intersects(used)) {
+                OpenType::GsubLookup l = gsub.lookup(i);
+                l.mark_out_glyphs(gsub, used, used);
             }
+    }
 
-            //for (int subno = 0; subno < subs.size(); subno++) fprintf(stderr, "%5d\t%s\n", i, subs[subno].unparse().c_str());
+    // decode activated GSUB lookups, possibly in parallel
+    Vector<int> used_lookups;
+    for (int i = 0; i < lookups.size(); i++)
+        if (lookups[i].used)
+            used_lookups.push_back(i);
+    LookupDecoder decoder(gsub, gsub_table, used, used_lookups, nthreads);
+
+    // apply them in order
+    for (int k = 0; k < used_lookups.size(); k++) {
+        int i = used_lookups[k];
+        Metrics::SubstitutionApplier applier(metrics, !dvipsenc_literal, i, *lookups[i].filter, glyph_names);
+        stats_count(SC_LOOKUPS, 1);
+
+        // check for -ffina, which should apply only at the ends of words,
+        // and -finit, which should apply only at the beginnings.
+        OpenType::Glyph left_context = -1, right_context = -1;
+        OpenType::Tag feature = (lookups[i].features.size() == 1 ? lookups[i].features[0] : OpenType::Tag());
+        if (feature == OpenType::Tag("fina") || feature == OpenType::Tag("fin2") || feature == OpenType::Tag("fin3")) {
+            if (dvipsenc.boundary_char() < 0)
+                errh->warning("%<-ffina%> requires a boundary character\n(The input encoding didn%,t specify a boundary character, but\nI need one to implement %<-ffina%> features correctly.  Try\nthe %<--boundary-char%> option.)");
+            else
+                right_context = metrics.boundary_glyph();
+        } else if (feature == OpenType::Tag("init"))
+            left_context = metrics.boundary_glyph();
 
-            // figure out which glyph filter to use
-            int nunderstood = metrics.apply(subs, !dvipsenc_literal, i, *lookups[i].filter, glyph_names);
+        BoundaryContextVisitor bv(applier, left_context, right_context);
+        OpenType::SubstitutionVisitor &v = (left_context >= 0 || right_context >= 0 ? (OpenType::SubstitutionVisitor &) bv : applier);
+        bool understood = decoder.apply(k, v, errh);
 
-            // mark as used
-            int d = (understood && nunderstood == subs.size() ? F_GSUB_ALL : (nunderstood ? F_GSUB_PART : 0)) + F_GSUB_TRY;
-            for (int j = 0; j < lookups[i].features.size(); j++)
-                feature_usage.find_force(lookups[i].features[j].value()) |= d;
-        }
+        // mark as used
+        int nunderstood = applier.napplied();
+        stats_count(SC_SUBSTITUTIONS, applier.nvisited());
+        int d = (understood && nunderstood == applier.nvisited() ? F_GSUB_ALL : (nunderstood ? F_GSUB_PART : 0)) + F_GSUB_TRY;
+        for (int j = 0; j < lookups[i].features.size(); j++)
+            feature_usage.find_force(lookups[i].features[j].value()) |= d;
+    }
 
     // apply alternate selectors
     if (metrics.altselectors() && !dvipsenc_literal) {
         // do lookups
-        altselector_features.swap(interesting_features);
-        altselector_feature_filters.swap(feature_filters);
+        job.altselector_features.swap(job.interesting_features);
+        job.altselector_feature_filters.swap(job.feature_filters);
         Vector<Lookup> alt_lookups(gsub.nlookups(), Lookup());
-        find_lookups(gsub.script_list(), gsub.feature_list(), alt_lookups, ErrorHandler::silent_handler());
-        Vector<OpenType::Substitution> alt_subs;
+        find_lookups(job, gsub.script_list(), gsub.feature_list(), alt_lookups, ErrorHandler::silent_handler());
+        Vector<int> alt_used_lookups;
         for (int i = 0; i < alt_lookups.size(); i++)
-            if (alt_lookups[i].used) {
-                OpenType::GsubLookup l = gsub.lookup(i);
-                alt_subs.clear();
-                (void) l.unparse_automatics(gsub, alt_subs, used_coverage);
-                metrics.apply_alternates(alt_subs, i, *alt_lookups[i].filter, glyph_names);
-            }
-        altselector_features.swap(interesting_features);
-        altselector_feature_filters.swap(feature_filters);
+            if (alt_lookups[i].used)
+                alt_used_lookups.push_back(i);
+        LookupDecoder alt_decoder(gsub, gsub_table, used, alt_used_lookups, nthreads);
+        for (int k = 0; k < alt_used_lookups.size(); k++) {
+            int i = alt_used_lookups[k];
+            Metrics::AlternateApplier applier(metrics, i, *alt_lookups[i].filter, glyph_names);
+            (void) alt_decoder.apply(k, applier, errh);
+            stats_count(SC_LOOKUPS, 1);
+        }
+        job.altselector_features.swap(job.interesting_features);
+        job.altselector_feature_filters.swap(job.feature_filters);
     }
 }
 
 static bool
-kern_feature_requested()
+kern_feature_requested(const Job& job)
+{
+    return std::find(job.interesting_features.begin(), job.interesting_features.end(),
+                     OpenType::Tag("kern")) != job.interesting_features.end();
+}
+
+static OpenType::GlyphSet
+encoded_glyphs(const Metrics& metrics)
 {
-    return std::find(interesting_features.begin(), interesting_features.end(),
-                     OpenType::Tag("kern")) != interesting_features.end();
+    // positionings only matter for glyphs that made it into the encoding
+    OpenType::GlyphSet used;
+    for (Metrics::Code c = 0; c < metrics.encoding_size(); ++c) {
+        Metrics::Glyph g = metrics.glyph(c);
+        if (g >= 0)
+            used.insert(g);
+    }
+    return used;
 }
 
 static void
-do_try_ttf_kern(Metrics& metrics, const OpenType::Font& otf, HashMap<uint32_t, int>& feature_usage, ErrorHandler* errh)
+do_try_ttf_kern(const Job& job, Metrics& metrics, const OpenType::Font& otf, HashMap<uint32_t, int>& feature_usage, ErrorHandler* errh)
 {
     // if no GPOS "kern" lookups and "kern" requested, try "kern" table
-    if (!kern_feature_requested())
+    if (!kern_feature_requested(job))
         return;
     try {
         OpenType::KernTable kern(otf.table("kern"), errh);
-        Vector<OpenType::Positioning> poss;
-        bool understood = kern.unparse_automatics(poss, errh);
-        int nunderstood = metrics.apply(poss);
+        Metrics::PositioningApplier applier(metrics);
+        bool understood = kern.unparse_automatics(applier, OpenType::Coverage(encoded_glyphs(metrics)), errh);
+        int nunderstood = applier.napplied();
+        stats_count(SC_LOOKUPS, 1);
+        stats_count(SC_POSITIONINGS, applier.nvisited());
 
         // mark as used
-        int d = (understood && nunderstood == poss.size() ? F_GPOS_ALL : (nunderstood ? F_GPOS_PART : 0)) + F_GPOS_TRY;
+        int d = (understood && nunderstood == applier.nvisited() ? F_GPOS_ALL : (nunderstood ? F_GPOS_PART : 0)) + F_GPOS_TRY;
         feature_usage.find_force(OpenType::Tag("kern").value()) |= d;
     } catch (OpenType::BlankTable) {
         // nada
@@ -1515,51 +1865,61 @@ do_try_ttf_kern(Metrics& metrics, const OpenType::Font& otf, HashMap<uint32_t, i
 }
 
 static void
-do_gpos(Metrics& metrics, const OpenType::Font& otf, HashMap<uint32_t, int>& feature_usage, ErrorHandler* errh)
+do_gpos(const Job& job, Metrics& metrics, const OpenType::Font& otf, HashMap<uint32_t, int>& feature_usage, ErrorHandler* errh)
 {
-    OpenType::Gpos gpos(otf.table("GPOS"), errh);
+    String gpos_table = otf.table("GPOS");
+    OpenType::Gpos gpos(gpos_table, errh);
     Vector<Lookup> lookups(gpos.nlookups(), Lookup());
-    find_lookups(gpos.script_list(), gpos.feature_list(), lookups, errh);
+    find_lookups(job, gpos.script_list(), gpos.feature_list(), lookups, errh);
 
     // OpenType recommends that if GPOS exists, but the "kern" feature loads
     // no lookups, we use the TrueType "kern" table, if any.
-    if (kern_feature_requested()) {
+    if (kern_feature_requested(job)) {
         OpenType::Tag kern_tag("kern");
         for (Lookup *l = lookups.begin(); l != lookups.end(); ++l)
             if (std::find(l->features.begin(), l->features.end(), kern_tag) != l->features.end())
                 goto skip_ttf_kern;
-        do_try_ttf_kern(metrics, otf, feature_usage, errh);
+        do_try_ttf_kern(job, metrics, otf, feature_usage, errh);
     skip_ttf_kern: ;
     }
 
-    Vector<OpenType::Positioning> poss;
+    // decode activated GPOS lookups, possibly in parallel, then apply them
+    // in order
+    Vector<int> used_lookups;
     for (int i = 0; i < lookups.size(); i++)
-        if (lookups[i].used) {
-            OpenType::GposLookup l = gpos.lookup(i);
-            poss.clear();
-            bool understood = l.unparse_automatics(poss, errh);
-            int nunderstood = metrics.apply(poss);
-
-            // mark as used
-            int d = (understood && nunderstood == poss.size() ? F_GPOS_ALL : (nunderstood ? F_GPOS_PART : 0)) + F_GPOS_TRY;
-            for (int j = 0; j < lookups[i].features.size(); j++)
-                feature_usage.find_force(lookups[i].features[j].value()) |= d;
-        }
+        if (lookups[i].used)
+            used_lookups.push_back(i);
+    OpenType::GlyphSet limit = encoded_glyphs(metrics);
+    LookupDecoder decoder(gpos, gpos_table, limit, used_lookups, nthreads);
+
+    for (int k = 0; k < used_lookups.size(); k++) {
+        int i = used_lookups[k];
+        Metrics::PositioningApplier applier(metrics);
+        bool understood = decoder.apply(k, applier, errh);
+        int nunderstood = applier.napplied();
+        stats_count(SC_LOOKUPS, 1);
+        stats_count(SC_POSITIONINGS, applier.nvisited());
+
+        // mark as used
+        int d = (understood && nunderstood == applier.nvisited() ? F_GPOS_ALL : (nunderstood ? F_GPOS_PART : 0)) + F_GPOS_TRY;
+        for (int j = 0; j < lookups[i].features.size(); j++)
+            feature_usage.find_force(lookups[i].features[j].value()) |= d;
+    }
 }
 
 static void
-do_math_spacing(Metrics &metrics, const FontInfo &finfo,
+do_math_spacing(const Job &job, Metrics &metrics, const FontInfo &finfo,
                 const DvipsEncoding &dvipsenc)
 {
     Transform font_xform;
-    if (extend)
-        font_xform.scale(extend, 1);
-    if (slant)
-        font_xform.shear(slant);
+    if (job.extend)
+        font_xform.scale(job.extend, 1);
+    if (job.slant)
+        font_xform.shear(job.slant);
     CharstringBounds boundser(font_xform);
 
     double x_height = finfo.x_height(font_xform);
-    double actual_slant = font_slant(finfo);
+    double actual_slant = font_slant(job, finfo);
     int boundary_char = dvipsenc.boundary_char();
 
     double bounds[4], width;
@@ -1571,38 +1931,153 @@ do_math_spacing(Metrics &metrics, const FontInfo &finfo,
             int left_sb = (bounds[0] < 0 ? (int) ceil(-bounds[0]) : 0);
             metrics.add_single_positioning(code, left_sb, 0, left_sb);
 
-            if (skew_char >= 0 && code < 256) {
+            if (job.skew_char >= 0 && code < 256) {
                 double sheight = std::max(bounds[3], x_height) - 0.5 * x_height;
                 double right_sb = std::max(bounds[2] - width, 0.0);
                 double desired = left_sb + 0.5 * width + actual_slant * sheight + 0.25 * right_sb;
                 double computed = 0.5 * (left_sb + width + right_sb);
                 int skew = (int) (desired - computed);
-                metrics.add_kern(code, skew_char, skew);
+                metrics.add_kern(code, job.skew_char, skew);
             }
         }
 }
 
+// The manifest lets otftotfm skip jobs whose outputs are up to date. Its
+// entries are keyed by a digest of everything that affects a job's output.
+
+static HashMap<String, Manifest *> manifest_cache(0);
+static Vector<String> job_outputs;
+
+static String
+job_digest(const Job &job, const OpenType::Font &otf,
+           const DvipsEncoding &dvipsenc, ErrorHandler *errh)
+{
+    String *font_digest = font_digests.findp(job.input_file);
+    if (!font_digest) {
+        font_digests.insert(job.input_file, string_digest(otf.data_string()));
+        font_digest = font_digests.findp(job.input_file);
+    }
+
+    StringAccum sa;
+    sa << "otftotfm " << VERSION << '\n'
+       << job.input_file << ' ' << *font_digest << '\n'
+       << "glyphlist " << glyphlist_digest << '\n'
+       << job.options << job.output_flags << '\n';
+    if (dvipsenc.filename())
+        sa << "encoding " << string_digest(read_file(dvipsenc.filename(), ErrorHandler::silent_handler())) << '\n';
+    for (const String *s = job.base_encoding_files.begin(); s != job.base_encoding_files.end(); ++s)
+        sa << "base " << string_digest(read_file(*s, ErrorHandler::silent_handler())) << '\n';
+
+    // output files move if their directories change
+    if (job.output_flags & G_ENCODING)
+        sa << getodir(O_ENCODING, errh) << '\n';
+    if (job.output_flags & G_BINARY) {
+        sa << getodir(O_TFM, errh) << '\n';
+        if (job.output_flags & G_VMETRICS)
+            sa << getodir(O_VF, errh) << '\n';
+    }
+    if (job.output_flags & G_ASCII) {
+        sa << getodir(O_PL, errh) << '\n';
+        if (job.output_flags & G_VMETRICS)
+            sa << getodir(O_VPL, errh) << '\n';
+    }
+    return string_digest(sa.take_string());
+}
+
+static const Manifest *
+load_manifest(const String &filename)
+{
+    if (Manifest **mp = manifest_cache.findp(filename))
+        return *mp;
+    Manifest *m = new Manifest(read_manifest(filename));
+    manifest_cache.insert(filename, m);
+    return m;
+}
+
+static bool
+manifest_entry_current(const Manifest::Entry &e)
+{
+    for (int i = 0; i < e.files.size(); ++i)
+        if (file_stamp(e.files[i]) != e.stamps[i])
+            return false;
+    for (int i = 0; i < e.encoding_files.size(); ++i)
+        if (!encoding_file_has(read_file(e.encoding_files[i], ErrorHandler::silent_handler()), e.encoding_names[i]))
+            return false;
+    return true;
+}
+
+static bool
+is_metrics_file(const String &filename)
+{
+    int dot = filename.find_right('.');
+    String ext = (dot >= 0 ? filename.substring(dot) : String());
+    return ext == ".tfm" || ext == ".vf" || ext == ".pl" || ext == ".vpl";
+}
+
+static void
+add_manifest_entry(const Job &job, const String &manifest_file,
+                   const String &key, int first_update, ErrorHandler *errh)
+{
+    Manifest::Entry entry;
+    entry.key = key;
+    entry.font_name = job.font_name;
+    for (const String *f = job_outputs.begin(); f != job_outputs.end(); ++f)
+        if (std::find(entry.files.begin(), entry.files.end(), *f) == entry.files.end()) {
+            entry.files.push_back(*f);
+            entry.stamps.push_back(file_stamp(*f));
+        }
+    for (const PendingUpdate *pu = pending_updates.begin() + first_update;
+         pu != pending_updates.end(); ++pu)
+        if (pu->type == PendingUpdate::ENCODING) {
+            entry.encoding_files.push_back(pu->filename);
+            entry.encoding_names.push_back(pu->name);
+        } else if (pu->type == PendingUpdate::MAP) {
+            entry.map_fonts.push_back(pu->name);
+            entry.map_lines.push_back(pu->text);
+        }
+
+    // remove metrics left over from earlier versions of this font
+    const Manifest *manifest = load_manifest(manifest_file);
+    for (const Manifest::Entry *e = manifest->entries().begin(); e != manifest->entries().end(); ++e)
+        if (e->key == key || e->font_name == job.font_name)
+            for (const String *f = e->files.begin(); f != e->files.end(); ++f)
+                if (is_metrics_file(*f)
+                    && std::find(entry.files.begin(), entry.files.end(), *f) == entry.files.end()) {
+                    if (no_create) {
+                        errh->message("would remove stale file %<%s%>", f->c_str());
+                        continue;
+                    } else if (verbose)
+                        errh->message("removing stale file %<%s%>", f->c_str());
+                    if (unlink(f->c_str()) < 0 && errno != ENOENT)
+                        errh->error("removing %s: %s", f->c_str(), strerror(errno));
+                }
+
+    add_pending_update(PendingUpdate::MANIFEST, manifest_file, key, entry.unparse());
+}
+
 static void
-do_file(const String &otf_filename, const OpenType::Font &otf,
+do_file(Job &job, const OpenType::Font &otf,
         const DvipsEncoding &dvipsenc_in, bool dvipsenc_literal,
         ErrorHandler *errh)
 {
+    StatsTimer info_timer(PH_FONT_INFO);
     FontInfo finfo(&otf, errh);
     if (!finfo.ok())
         return;
     if (!finfo.cff)
         errh->warning("TrueType-flavored font support is experimental");
-    if (override_is_fixed_pitch)
-        finfo.set_is_fixed_pitch(is_fixed_pitch);
-    if (override_italic_angle)
-        finfo.set_italic_angle(italic_angle);
-    if (override_x_height != FontInfo::x_height_auto)
-        finfo.set_x_height(override_x_height, x_height);
+    if (job.override_is_fixed_pitch)
+        finfo.set_is_fixed_pitch(job.is_fixed_pitch);
+    if (job.override_italic_angle)
+        finfo.set_italic_angle(job.italic_angle);
+    if (job.override_x_height != FontInfo::x_height_auto)
+        finfo.set_x_height(job.override_x_height, job.x_height);
 
     // save glyph names
     Vector<PermString> glyph_names;
     finfo.glyph_names(glyph_names);
     OpenType::debug_glyph_names = glyph_names;
+    info_timer.end();
 
     // set typeface name from font family name
     {
@@ -1614,27 +2089,51 @@ do_file(const String &otf_filename, const OpenType::Font &otf,
             if (isalnum((unsigned char) typeface[i]) || typeface[i] == '_' || typeface[i] == '-' || typeface[i] == '.' || typeface[i] == ',' || typeface[i] == '+')
                 sa << typeface[i];
 
-        set_typeface(sa.length() ? sa.take_string() : font_name, false);
+        set_typeface(sa.length() ? sa.take_string() : job.font_name, false);
+    }
+
+    // skip the job if the manifest says its outputs are up to date
+    String manifest_file, manifest_key;
+    int first_update = pending_updates.size();
+    int nerrors = errh->nerrors();
+    if (use_cache && (job.output_flags & (G_METRICS | G_VMETRICS))
+        && (job.output_flags & (G_BINARY | G_ASCII))) {
+        manifest_file = getodir(job.output_flags & G_BINARY ? O_TFM : O_PL, errh) + "/" + Manifest::default_name;
+        manifest_key = job_digest(job, otf, dvipsenc_in, errh);
+        const Manifest::Entry *e = load_manifest(manifest_file)->find(manifest_key);
+        if (!force && e && manifest_entry_current(*e)) {
+            if (verbose)
+                errh->message("%s is up to date", e->font_name.c_str());
+            for (int i = 0; i < e->map_fonts.size(); ++i)
+                add_pending_update(PendingUpdate::MAP, String(), e->map_fonts[i], e->map_lines[i]);
+            return;
+        }
+        job_outputs.clear();
+        record_outputs(&job_outputs);
     }
 
     // initialize encoding
+    StatsTimer metrics_timer(PH_MAKE_METRICS);
     DvipsEncoding dvipsenc(dvipsenc_in); // make copy
     Metrics metrics(finfo.program(), finfo.nglyphs());
+    metrics.set_letterspace(job.letterspace);
     // encode boundary glyph at 256; pretend its Unicode value is '\n'
     metrics.encode(256, '\n', metrics.boundary_glyph());
     if (dvipsenc_literal)
         dvipsenc.make_metrics(metrics, finfo, 0, true, errh);
     else {
-        T1Secondary secondary(finfo, font_name, otf_filename);
+        T1Secondary secondary(finfo, job);
         dvipsenc.make_metrics(metrics, finfo, &secondary, false, errh);
     }
+    metrics_timer.end();
 
     // maintain statistics about features
     HashMap<uint32_t, int> feature_usage(0);
 
     // apply activated GSUB features
     try {
-        do_gsub(metrics, otf, dvipsenc, dvipsenc_literal, feature_usage, glyph_names, errh);
+        StatsTimer t(PH_GSUB);
+        do_gsub(job, metrics, otf, dvipsenc, dvipsenc_literal, feature_usage, glyph_names, errh);
     } catch (OpenType::BlankTable) {
         // nada
     } catch (OpenType::Error e) {
@@ -1648,14 +2147,18 @@ do_file(const String &otf_filename, const OpenType::Font &otf,
     //metrics.add_threeligature('T', 'h', 'e', '0');
 
     // reencode characters to fit within 8 bytes (+ 1 for the boundary)
-    if (!dvipsenc_literal)
+    if (!dvipsenc_literal) {
+        StatsTimer t(PH_SHRINK_ENCODING);
         metrics.shrink_encoding(257, dvipsenc_in, errh);
+    }
 
     // apply activated GPOS features
     try {
-        do_gpos(metrics, otf, feature_usage, errh);
+        StatsTimer t(PH_GPOS);
+        do_gpos(job, metrics, otf, feature_usage, errh);
     } catch (OpenType::BlankTable) {
-        do_try_ttf_kern(metrics, otf, feature_usage, errh);
+        StatsTimer t(PH_GPOS);
+        do_try_ttf_kern(job, metrics, otf, feature_usage, errh);
     } catch (OpenType::Error e) {
         errh->warning("GPOS %<%s%> error, continuing", e.description.c_str());
     }
@@ -1665,7 +2168,7 @@ do_file(const String &otf_filename, const OpenType::Font &otf,
     dvipsenc.apply_position(metrics, errh);
 
     // use prespecified raw fonts
-    for (BaseEncoding **be = base_encodings.begin(); be != base_encodings.end(); be++)
+    for (BaseEncoding **be = job.base_encodings.begin(); be != job.base_encodings.end(); be++)
         if (!(*be)->secondary) {
             Vector<int> mapp;
             (*be)->encoding.make_base_mappings(mapp, finfo);
@@ -1678,19 +2181,19 @@ do_file(const String &otf_filename, const OpenType::Font &otf,
     int boundary_char = dvipsenc.boundary_char();
 
     // apply letterspacing, if any
-    if (letterspace)
+    if (job.letterspace)
         for (int code = 0; code < metrics.encoding_size(); code++)
             if (metrics.was_base_glyph(code) && code != boundary_char) {
-                metrics.add_single_positioning(code, letterspace / 2, 0, letterspace);
+                metrics.add_single_positioning(code, job.letterspace / 2, 0, job.letterspace);
                 if (code < 256) {
-                    metrics.add_kern(code, 256, -letterspace / 2);
-                    metrics.add_kern(256, code, -letterspace / 2);
+                    metrics.add_kern(code, 256, -job.letterspace / 2);
+                    metrics.add_kern(256, code, -job.letterspace / 2);
                 }
             }
 
     // apply math letterspacing, if any
-    if (math_spacing)
-        do_math_spacing(metrics, finfo, dvipsenc);
+    if (job.math_spacing)
+        do_math_spacing(job, metrics, finfo, dvipsenc);
 
     // reencode right components of boundary_glyph as boundary_char
     if (metrics.reencode_right_ligkern(256, boundary_char) > 0
@@ -1700,63 +2203,73 @@ do_file(const String &otf_filename, const OpenType::Font &otf,
     }
 
     // report unused and underused features if any
-    report_underused_features(feature_usage, errh);
+    report_underused_features(job, feature_usage, errh);
 
     // figure out our FONTNAME
-    if (!font_name) {
+    if (!job.font_name) {
         // derive font name from OpenType font name
-        font_name = finfo.postscript_name();
-        if (encoding_file) {
-            int slash = encoding_file.find_right('/') + 1;
-            int dot = encoding_file.find_right('.');
+        job.font_name = finfo.postscript_name();
+        if (job.encoding_file) {
+            int slash = job.encoding_file.find_right('/') + 1;
+            int dot = job.encoding_file.find_right('.');
             if (dot < slash)    // includes dot < 0 case
-                dot = encoding_file.length();
-            font_name += String("--") + encoding_file.substring(slash, dot - slash);
+                dot = job.encoding_file.length();
+            job.font_name += String("--") + job.encoding_file.substring(slash, dot - slash);
         }
-        if (interesting_scripts.size() != 2 || interesting_scripts[0] != OpenType::Tag("latn") || interesting_scripts[1].valid())
-            for (int i = 0; i < interesting_scripts.size(); i += 2) {
-                font_name += String("--S") + interesting_scripts[i].text();
-                if (interesting_scripts[i+1].valid())
-                    font_name += String(".") + interesting_scripts[i+1].text();
+        if (job.interesting_scripts.size() != 2 || job.interesting_scripts[0] != OpenType::Tag("latn") || job.interesting_scripts[1].valid())
+            for (int i = 0; i < job.interesting_scripts.size(); i += 2) {
+                job.font_name += String("--S") + job.interesting_scripts[i].text();
+                if (job.interesting_scripts[i+1].valid())
+                    job.font_name += String(".") + job.interesting_scripts[i+1].text();
             }
-        for (int i = 0; i < interesting_features.size(); i++)
-            if (feature_usage[interesting_features[i].value()])
-                font_name += String("--F") + interesting_features[i].text();
+        for (int i = 0; i < job.interesting_features.size(); i++)
+            if (feature_usage[job.interesting_features[i].value()])
+                job.font_name += String("--F") + job.interesting_features[i].text();
     }
 
     // output encoding
     if (dvipsenc_literal) {
-        out_encoding_name = dvipsenc_in.name();
-        out_encoding_file = dvipsenc_in.filename();
-    } else
-        output_encoding(metrics, glyph_names, errh);
+        job.out_encoding_name = dvipsenc_in.name();
+        job.out_encoding_file = dvipsenc_in.filename();
+    } else {
+        StatsTimer t(PH_ENCODING_OUTPUT);
+        output_encoding(job, metrics, glyph_names, errh);
+    }
 
     // set up coding scheme
     if (metrics.coding_scheme())
         metrics.set_design_units(1);
     else
-        metrics.set_coding_scheme(out_encoding_name);
+        metrics.set_coding_scheme(job.out_encoding_name);
 
     // force no type 1
-    if (!finfo.cff && (output_flags & G_TYPE1)) {
+    if (!finfo.cff && (job.output_flags & G_TYPE1)) {
         errh->warning("assuming --no-type1 since this font is TrueType-flavored");
-        output_flags &= ~G_TYPE1;
+        job.output_flags &= ~G_TYPE1;
     }
 
     // output
-    ::otf_filename = otf_filename;
-    output_metrics(metrics, finfo.postscript_name(), dvipsenc.boundary_char(),
+    StatsTimer output_timer(PH_METRICS_OUTPUT);
+    output_metrics(job, metrics, finfo.postscript_name(), dvipsenc.boundary_char(),
                    finfo,
-                   out_encoding_name, out_encoding_file,
-                   font_name, main_dvips_map, errh);
+                   job.out_encoding_name, job.out_encoding_file,
+                   job.font_name, main_dvips_map, errh);
+    output_timer.end();
+
+    // remember the outputs for next time
+    if (manifest_key) {
+        record_outputs(0);
+        if (errh->nerrors() == nerrors)
+            add_manifest_entry(job, manifest_file, manifest_key, first_update, errh);
+    }
 }
 
 
 String
-installed_metrics_font_name(const String &base_font_name, const String &secondary)
+installed_metrics_font_name(const Job &job, const String &base_font_name, const String &secondary)
 {
-    for (BaseEncoding **be = base_encodings.begin(); be != base_encodings.end(); be++)
-        if ((*be)->secondary == secondary && ::font_name == base_font_name)
+    for (BaseEncoding * const *be = job.base_encodings.begin(); be != job.base_encodings.end(); be++)
+        if ((*be)->secondary == secondary && job.font_name == base_font_name)
             return (*be)->font_name;
     return String();
 }
@@ -1782,7 +2295,7 @@ clp_parse_char(Clp_Parser *clp, const char *arg, int complain, void *)
 }
 
 static void
-parse_base_encodings(const String &filename, ErrorHandler *errh)
+parse_base_encodings(const String &filename, Vector<BaseEncoding *> &base_encodings, ErrorHandler *errh)
 {
     String str = read_file(filename, errh, true);
     String print_filename = (filename == "-" ? "<stdin>" : filename) + ":";
@@ -1838,254 +2351,788 @@ parse_base_encodings(const String &filename, ErrorHandler *errh)
     }
 }
 
-int
-main(int argc, char *argv[])
+// Handle an option that can differ from job to job. Returns false if 'opt'
+// is not such an option.
+static bool
+parse_job_option(Clp_Parser *clp, int opt, Job &job, ErrorHandler *errh)
 {
-#ifndef WIN32
-    handle_sigchld();
-#endif
-    Clp_Parser *clp =
-        Clp_NewParser(argc, (const char * const *)argv, sizeof(options) / sizeof(options[0]), options);
-    Clp_AddType(clp, CHAR_OPTTYPE, 0, clp_parse_char, 0);
-    program_name = Clp_ProgramName(clp);
-#if HAVE_KPATHSEA
-    kpsei_init(argv[0], "lcdftools");
-#endif
-#ifdef HAVE_CTIME
-    {
-        time_t t = time(0);
-        char *c = ctime(&t);
-        current_time = " on " + String(c).substring(0, -1); // get rid of \n
-    }
-#endif
-    for (int i = 0; i < argc; i++)
-        invocation << (i ? " " : "") << argv[i];
-
-    ErrorHandler *errh = ErrorHandler::static_initialize(new FileErrorHandler(stderr, String(program_name) + ": "));
-    const char *input_file = 0;
-    Vector<String> glyphlist_files;
-    bool literal_encoding = false;
-    bool have_encoding_file = false;
-    Vector<String> ligkern;
-    Vector<String> pos;
-    Vector<String> unicoding;
-    Vector<String> base_encoding_files;
-    bool no_ecommand = false, default_ligkern = true;
-    int warn_missing = -1;
-    unsigned specified_output_flags = 0;
-    String codingscheme;
-    const char* odirs[NUMODIR + 1];
-    for (int i = 0; i <= NUMODIR; ++i) {
-        odirs[i] = 0;
-    }
-
-    GlyphFilter current_substitution_filter;
-    GlyphFilter current_alternate_filter;
-    GlyphFilter* current_filter_ptr = &null_filter;
-    Vector<GlyphFilter*> allocated_filters;
-
-    while (1) {
-        int opt = Clp_Next(clp);
-        switch (opt) {
-
-          case SCRIPT_OPT: {
-              String arg = clp->vstr;
-              int period = arg.find_left('.');
-              OpenType::Tag scr(period <= 0 ? arg : arg.substring(0, period));
-              if (scr.valid() && period > 0) {
-                  OpenType::Tag lang(arg.substring(period + 1));
-                  if (lang.valid()) {
-                      interesting_scripts.push_back(scr);
-                      interesting_scripts.push_back(lang);
-                  } else
-                      usage_error(errh, "bad language tag");
-              } else if (scr.valid()) {
-                  interesting_scripts.push_back(scr);
-                  interesting_scripts.push_back(OpenType::Tag());
+    switch (opt) {
+
+      case SCRIPT_OPT: {
+          String arg = clp->vstr;
+          int period = arg.find_left('.');
+          OpenType::Tag scr(period <= 0 ? arg : arg.substring(0, period));
+          if (scr.valid() && period > 0) {
+              OpenType::Tag lang(arg.substring(period + 1));
+              if (lang.valid()) {
+                  job.interesting_scripts.push_back(scr);
+                  job.interesting_scripts.push_back(lang);
               } else
-                  usage_error(errh, "bad script tag");
-              break;
-          }
-
-          case FEATURE_OPT: {
-              OpenType::Tag t(clp->vstr);
-              if (!t.valid())
-                  usage_error(errh, "bad feature tag");
-              else if (feature_filters[t])
-                  usage_error(errh, "feature %<%s%> included twice", t.text().c_str());
-              else {
-                  if (!current_filter_ptr) {
-                      current_filter_ptr = new GlyphFilter(current_substitution_filter + current_alternate_filter);
-                      allocated_filters.push_back(current_filter_ptr);
-                  }
-                  interesting_features.push_back(t);
-                  feature_filters.insert(t, current_filter_ptr);
+                  usage_error(errh, "bad language tag");
+          } else if (scr.valid()) {
+              job.interesting_scripts.push_back(scr);
+              job.interesting_scripts.push_back(OpenType::Tag());
+          } else
+              usage_error(errh, "bad script tag");
+          break;
+      }
+
+      case FEATURE_OPT: {
+          OpenType::Tag t(clp->vstr);
+          if (!t.valid())
+              usage_error(errh, "bad feature tag");
+          else if (job.feature_filters[t])
+              usage_error(errh, "feature %<%s%> included twice", t.text().c_str());
+          else {
+              if (!job.current_filter_ptr) {
+                  job.current_filter_ptr = new GlyphFilter(job.current_substitution_filter + job.current_alternate_filter);
+                  allocated_filters.push_back(job.current_filter_ptr);
               }
-              break;
+              job.interesting_features.push_back(t);
+              job.feature_filters.insert(t, job.current_filter_ptr);
           }
-
-          case LETTER_FEATURE_OPT: {
-              OpenType::Tag t(clp->vstr);
-              if (!t.valid())
-                  usage_error(errh, "bad feature tag");
-              else if (feature_filters[t])
-                  usage_error(errh, "feature %<%s%> included twice", t.text().c_str());
-              else {
-                  interesting_features.push_back(t);
-                  GlyphFilter* gf = new GlyphFilter;
-                  gf->add_substitution_filter("<Letter>", false, errh);
-                  *gf += current_alternate_filter;
-                  feature_filters.insert(t, gf);
+          break;
+      }
+
+      case LETTER_FEATURE_OPT: {
+          OpenType::Tag t(clp->vstr);
+          if (!t.valid())
+              usage_error(errh, "bad feature tag");
+          else if (job.feature_filters[t])
+              usage_error(errh, "feature %<%s%> included twice", t.text().c_str());
+          else {
+              job.interesting_features.push_back(t);
+              GlyphFilter* gf = new GlyphFilter;
+              gf->add_substitution_filter("<Letter>", false, errh);
+              *gf += job.current_alternate_filter;
+              job.feature_filters.insert(t, gf);
+          }
+          break;
+      }
+
+      case SUBS_FILTER_OPT:
+        job.current_substitution_filter = null_filter;
+        /* fallthru */
+      case EXCLUDE_SUBS_OPT:
+      case INCLUDE_SUBS_OPT:
+        job.current_substitution_filter.add_substitution_filter(clp->vstr, opt == EXCLUDE_SUBS_OPT, errh);
+        job.current_filter_ptr = 0;
+        break;
+
+      case CLEAR_SUBS_OPT:
+        job.current_substitution_filter = null_filter;
+        job.current_filter_ptr = 0;
+        break;
+
+      case ENCODING_OPT:
+        if (job.encoding_file)
+            usage_error(errh, "encoding specified twice");
+        job.encoding_file = clp->vstr;
+        job.have_encoding_file = true;
+        break;
+
+      case LITERAL_ENCODING_OPT:
+        if (job.encoding_file)
+            usage_error(errh, "encoding specified twice");
+        job.encoding_file = clp->vstr;
+        job.have_encoding_file = true;
+        job.literal_encoding = true;
+        break;
+
+      case BASE_ENCODINGS_OPT:
+        job.base_encoding_files.push_back(clp->vstr);
+        break;
+
+      case EXTEND_OPT:
+        if (job.extend)
+            usage_error(errh, "extend value specified twice");
+        job.extend = clp->val.d;
+        break;
+
+      case SLANT_OPT:
+        if (job.slant)
+            usage_error(errh, "slant value specified twice");
+        job.slant = clp->val.d;
+        break;
+
+      case LETTERSPACE_OPT:
+        if (job.letterspace)
+            usage_error(errh, "letterspacing value specified twice");
+        job.letterspace = clp->val.i;
+        break;
+
+      case SPACE_FACTOR_OPT:
+        if (job.space_factor != 1)
+            usage_error(errh, "space factor specified twice");
+        job.space_factor = clp->val.d;
+        break;
+
+      case MATH_SPACING_OPT:
+        job.math_spacing = !clp->negated;
+        if (job.math_spacing && clp->have_val) {
+            if (clp->val.i < 0 || clp->val.i > 255)
+                usage_error(errh, "--math-spacing skew character must be between 0 and 255");
+            job.skew_char = clp->val.i;
+        }
+        break;
+
+      case DESIGN_SIZE_OPT:
+        if (job.design_size > 0)
+            usage_error(errh, "design size value specified twice");
+        else if (clp->val.d <= 0)
+            usage_error(errh, "design size must be > 0");
+        job.design_size = clp->val.d;
+        break;
+
+      case LIGKERN_OPT:
+        job.ligkern.push_back(clp->vstr);
+        break;
+
+      case POSITION_OPT:
+        job.pos.push_back(clp->vstr);
+        break;
+
+      case WARN_MISSING_OPT:
+        job.warn_missing = !clp->negated;
+        break;
+
+      case NO_ECOMMAND_OPT:
+        job.no_ecommand = true;
+        break;
+
+      case DEFAULT_LIGKERN_OPT:
+        job.default_ligkern = !clp->negated;
+        break;
+
+      case BOUNDARY_CHAR_OPT:
+        job.ligkern.push_back(String("|| = ") + String(clp->val.i));
+        break;
+
+      case ALTSELECTOR_CHAR_OPT:
+        job.ligkern.push_back(String("^^ = ") + String(clp->val.i));
+        break;
+
+      case ALTSELECTOR_FEATURE_OPT: {
+          OpenType::Tag t(clp->vstr);
+          if (!t.valid())
+              usage_error(errh, "bad feature tag");
+          else if (job.altselector_feature_filters[t])
+              usage_error(errh, "altselector feature %<%s%> included twice", t.text().c_str());
+          else {
+              if (!job.current_filter_ptr) {
+                  job.current_filter_ptr = new GlyphFilter(job.current_substitution_filter + job.current_alternate_filter);
+                  allocated_filters.push_back(job.current_filter_ptr);
               }
-              break;
+              job.altselector_features.push_back(t);
+              job.altselector_feature_filters.insert(t, job.current_filter_ptr);
           }
+          break;
+      }
+
+      case ALTERNATES_FILTER_OPT:
+        job.current_alternate_filter = null_filter;
+        /* fallthru */
+      case EXCLUDE_ALTERNATES_OPT:
+      case INCLUDE_ALTERNATES_OPT:
+        job.current_alternate_filter.add_alternate_filter(clp->vstr, opt == EXCLUDE_ALTERNATES_OPT, errh);
+        job.current_filter_ptr = 0;
+        break;
+
+      case CLEAR_ALTERNATES_OPT:
+        job.current_alternate_filter = null_filter;
+        job.current_filter_ptr = 0;
+        break;
+
+      case UNICODING_OPT:
+        job.unicoding.push_back(clp->vstr);
+        break;
+
+      case CODINGSCHEME_OPT:
+        if (job.codingscheme)
+            usage_error(errh, "coding scheme specified twice");
+        job.codingscheme = clp->vstr;
+        if (job.codingscheme.length() > 39)
+            errh->warning("only first 39 characters of coding scheme are significant");
+        if (job.codingscheme.find_left('(') >= 0 || job.codingscheme.find_left(')') >= 0)
+            usage_error(errh, "coding scheme cannot contain parentheses");
+        break;
+
+      case VIRTUAL_OPT:
+        if (clp->negated)
+            job.output_flags &= ~G_VMETRICS;
+        else
+            job.output_flags |= G_VMETRICS;
+        job.specified_output_flags |= G_VMETRICS;
+        break;
+
+    case NO_ENCODING_OPT:
+    case NO_TYPE1_OPT:
+    case NO_DOTLESSJ_OPT:
+    case NO_UPDMAP_OPT:
+    case UPDMAP_SYS_OPT:
+        job.output_flags &= ~(opt - NO_OUTPUT_OPTS);
+        job.specified_output_flags |= opt - NO_OUTPUT_OPTS;
+        break;
+
+    case TRUETYPE_OPT:
+    case TYPE42_OPT:
+    case UPDMAP_USER_OPT:
+        if (!clp->negated)
+            job.output_flags |= (opt - YES_OUTPUT_OPTS);
+        else
+            job.output_flags &= ~(opt - YES_OUTPUT_OPTS);
+        job.specified_output_flags |= opt - YES_OUTPUT_OPTS;
+        break;
+
+      case OUTPUT_ENCODING_OPT:
+        if (job.out_encoding_file)
+            usage_error(errh, "encoding output file specified twice");
+        job.out_encoding_file = (clp->have_val ? clp->vstr : "-");
+        job.output_flags = G_ENCODING;
+        job.specified_output_flags = -1;
+        break;
+
+      case MINIMUM_KERN_OPT:
+        job.minimum_kern = clp->val.d;
+        break;
+
+    case PL_OPT:
+        if (clp->negated)
+            job.output_flags &= ~G_ASCII;
+        else
+            job.output_flags |= G_ASCII;
+        job.specified_output_flags |= G_ASCII;
+        break;
 
-          case SUBS_FILTER_OPT:
-            current_substitution_filter = null_filter;
-            /* fallthru */
-          case EXCLUDE_SUBS_OPT:
-          case INCLUDE_SUBS_OPT:
-            current_substitution_filter.add_substitution_filter(clp->vstr, opt == EXCLUDE_SUBS_OPT, errh);
-            current_filter_ptr = 0;
-            break;
+    case TFM_OPT:
+        if (clp->negated)
+            job.output_flags &= ~G_BINARY;
+        else
+            job.output_flags |= G_BINARY;
+        job.specified_output_flags |= G_BINARY;
+        break;
+
+      case FONT_NAME_OPT:
+      font_name:
+        if (job.font_name)
+            usage_error(errh, "font name specified twice");
+        job.font_name = clp->vstr;
+        break;
+
+    case FACE_OPT:
+        if (clp->val.i < 0)
+            usage_error(errh, "%<--face%> must be at least 0");
+        job.face = clp->val.i;
+        break;
+
+    case FIXED_PITCH_OPT:
+        job.override_is_fixed_pitch = true;
+        job.is_fixed_pitch = !clp->negated;
+        break;
+
+    case PROPORTIONAL_WIDTH_OPT:
+        job.override_is_fixed_pitch = true;
+        job.is_fixed_pitch = !!clp->negated;
+        break;
+
+    case ITALIC_ANGLE_OPT:
+        job.override_italic_angle = true;
+        job.italic_angle = clp->val.d;
+        break;
+
+    case X_HEIGHT_OPT: {
+        char* ends;
+        if (strcmp(clp->vstr, "auto") == 0)
+            job.override_x_height = FontInfo::x_height_auto;
+        else if (strcmp(clp->vstr, "x") == 0)
+            job.override_x_height = FontInfo::x_height_x;
+        else if (strcmp(clp->vstr, "font") == 0
+                 || strcmp(clp->vstr, "os/2") == 0)
+            job.override_x_height = FontInfo::x_height_os2;
+        else if ((job.x_height = strtod(clp->vstr, &ends)) >= 0
+                 && *ends == 0 && *clp->vstr != 0)
+            job.override_x_height = FontInfo::x_height_explicit;
+        else
+            usage_error(errh, "bad --x-height option");
+        break;
+    }
 
-          case CLEAR_SUBS_OPT:
-            current_substitution_filter = null_filter;
-            current_filter_ptr = 0;
-            break;
+      case Clp_NotOption:
+        if (job.input_file && job.font_name)
+            usage_error(errh, "too many arguments");
+        else if (job.input_file)
+            goto font_name;
+        else
+            job.input_file = clp->vstr;
+        break;
 
-          case ENCODING_OPT:
-            if (encoding_file)
-                usage_error(errh, "encoding specified twice");
-            encoding_file = clp->vstr;
-            have_encoding_file = true;
-            break;
+      default:
+        return false;
 
-          case LITERAL_ENCODING_OPT:
-            if (encoding_file)
-                usage_error(errh, "encoding specified twice");
-            encoding_file = clp->vstr;
-            have_encoding_file = true;
-            literal_encoding = true;
-            break;
+    }
 
-          case BASE_ENCODINGS_OPT:
-            base_encoding_files.push_back(clp->vstr);
-            break;
+    // remember the option for the manifest
+    StringAccum sa;
+    sa << opt << (clp->negated ? " !" : " ") << (clp->have_val || opt == Clp_NotOption ? clp->vstr : "") << '\n';
+    job.options += sa.take_string();
+    return true;
+}
 
-          case EXTEND_OPT:
-            if (extend)
-                usage_error(errh, "extend value specified twice");
-            extend = clp->val.d;
-            break;
+// Check a job's options once they have all been read, and fill in defaults.
+static void
+finish_job_options(Job &job, ErrorHandler *errh)
+{
+    // check for odd option combinations
+    if (job.warn_missing > 0 && !(job.output_flags & G_VMETRICS))
+        errh->warning("%<--warn-missing%> has no effect with %<--no-virtual%>");
+    if (!(job.specified_output_flags & (G_BINARY | G_ASCII)))
+        job.output_flags |= G_BINARY;
 
-          case SLANT_OPT:
-            if (slant)
-                usage_error(errh, "slant value specified twice");
-            slant = clp->val.d;
-            break;
+    // set up file names
+    if (!job.input_file)
+        usage_error(errh, "no font filename provided");
+    if (job.encoding_file == "-")
+        job.encoding_file = "";
 
-          case LETTERSPACE_OPT:
-            if (letterspace)
-                usage_error(errh, "letterspacing value specified twice");
-            letterspace = clp->val.i;
-            break;
+    // set up feature filters
+    if (!job.altselector_features.size()) {
+        if (!job.current_filter_ptr) {
+            job.current_filter_ptr = new GlyphFilter(job.current_substitution_filter + job.current_alternate_filter);
+            allocated_filters.push_back(job.current_filter_ptr);
+        }
+        job.altselector_features.push_back(OpenType::Tag("dlig"));
+        job.altselector_feature_filters.insert(OpenType::Tag("dlig"), job.current_filter_ptr);
+        job.altselector_features.push_back(OpenType::Tag("salt"));
+        job.altselector_feature_filters.insert(OpenType::Tag("salt"), job.current_filter_ptr);
+    } else if (!job.current_filter_ptr) {
+        errh->warning("some filtering options ignored");
+        errh->message("(--include-*, --exclude-*, and --*-filter options must occur\nbefore the feature options to which they should apply.)");
+    }
 
-          case SPACE_FACTOR_OPT:
-            if (space_factor != 1)
-                usage_error(errh, "space factor specified twice");
-            space_factor = clp->val.d;
+    // figure out scripts we care about
+    if (!job.interesting_scripts.size()) {
+        job.interesting_scripts.push_back(Efont::OpenType::Tag("latn"));
+        job.interesting_scripts.push_back(Efont::OpenType::Tag());
+    }
+    std::sort(job.interesting_features.begin(), job.interesting_features.end());
+    std::sort(job.altselector_features.begin(), job.altselector_features.end());
+}
+
+// Split a job file line into arguments. Whitespace separates arguments;
+// single or double quotes protect it.
+static void
+split_batch_line(const char *s, const char *end, Vector<String> &args)
+{
+    while (1) {
+        while (s != end && isspace((unsigned char) *s))
+            s++;
+        if (s == end)
             break;
+        StringAccum sa;
+        while (s != end && !isspace((unsigned char) *s))
+            if (*s == '\'' || *s == '\"') {
+                char quote = *s++;
+                while (s != end && *s != quote)
+                    sa << *s++;
+                if (s != end)
+                    s++;
+            } else
+                sa << *s++;
+        args.push_back(sa.take_string());
+    }
+}
 
-          case MATH_SPACING_OPT:
-            math_spacing = !clp->negated;
-            if (math_spacing && clp->have_val) {
-                if (clp->val.i < 0 || clp->val.i > 255)
-                    usage_error(errh, "--math-spacing skew character must be between 0 and 255");
-                skew_char = clp->val.i;
+// Each job file line holds the options for one job. They are read as if
+// appended to the command line, so command-line options apply to every job.
+static void
+read_batch_file(const String &filename, const Job &defaults,
+                Vector<Job *> &jobs, ErrorHandler *errh)
+{
+    String str = read_file(filename, errh);
+    String print_filename = (filename == "-" ? "<stdin>" : filename) + ":";
+    int lineno = 1;
+    const char *s_end = str.end();
+    for (const char *s = str.begin(); s != s_end; lineno++) {
+        const char *line = s;
+        while (s != s_end && *s != '\n' && *s != '\r')
+            s++;
+        const char *line_end = s;
+        if (s != s_end && *s == '\r')
+            s++;
+        if (s != s_end && *s == '\n')
+            s++;
+
+        // skip comments and blank lines
+        while (line != line_end && isspace((unsigned char) *line))
+            line++;
+        if (line == line_end || *line == '%' || *line == '#')
+            continue;
+
+        Vector<String> args;
+        split_batch_line(line, line_end, args);
+        Vector<const char *> argv;
+        argv.push_back(program_name);
+        for (String *a = args.begin(); a != args.end(); a++)
+            argv.push_back(a->c_str());
+
+        Job *job = new Job(defaults);
+        job->landmark = print_filename + String(lineno);
+        LandmarkErrorHandler lerrh(errh, job->landmark);
+
+        Clp_Parser *clp = Clp_NewParser(argv.size(), argv.begin(), sizeof(options) / sizeof(options[0]), options);
+        Clp_AddType(clp, CHAR_OPTTYPE, 0, clp_parse_char, 0);
+        while (1) {
+            int opt = Clp_Next(clp);
+            if (opt == Clp_Done)
+                break;
+            else if (opt == Clp_BadOption)
+                usage_error(&lerrh, 0);
+            else if (!parse_job_option(clp, opt, *job, &lerrh))
+                usage_error(&lerrh, "%<%s%> cannot be used in a job file", Clp_CurOptionName(clp));
+        }
+        Clp_DeleteParser(clp);
+
+        finish_job_options(*job, &lerrh);
+        jobs.push_back(job);
+    }
+}
+
+static OpenType::Font *
+load_font(const String &filename, int face, ErrorHandler *errh)
+{
+    String key = filename + "\n" + String(face);
+    if (OpenType::Font **otfp = font_cache.findp(key))
+        return *otfp;
+
+    // the faces of a collection share one copy of its data
+    String *datap = font_data_cache.findp(filename);
+    if (!datap) {
+        int before = errh->nerrors();
+        String data = read_file(filename, errh);
+        if (errh->nerrors() != before)
+            return 0;
+        font_data_cache.insert(filename, data);
+        datap = font_data_cache.findp(filename);
+    }
+
+    LandmarkErrorHandler cerrh(errh, printable_filename(filename));
+    StatsTimer t(PH_FONT_PARSE);
+    OpenType::Font *otf = new OpenType::Font(*datap, face, &cerrh);
+    t.end();
+    if (!otf->ok()) {
+        delete otf;
+        return 0;
+    }
+    font_cache.insert(key, otf);
+    return otf;
+}
+
+static const DvipsEncoding *
+load_encoding(const String &encoding_file, bool no_ecommand, ErrorHandler *errh)
+{
+    String key = encoding_file + (no_ecommand ? "\n1" : "\n0");
+    if (DvipsEncoding **dvipsencp = encoding_cache.findp(key))
+        return *dvipsencp;
+
+    String path = locate_encoding(encoding_file, errh);
+    if (!path)
+        errh->fatal("encoding %<%s%> not found", encoding_file.c_str());
+    DvipsEncoding *dvipsenc = new DvipsEncoding;
+    dvipsenc->parse(path, no_ecommand, no_ecommand, errh);
+    encoding_cache.insert(key, dvipsenc);
+    return dvipsenc;
+}
+
+static void
+run_job(Job &job, ErrorHandler *errh)
+{
+    // a new font may need a new typeface directory
+    forget_typeface();
+    stats_begin_job();
+
+    try {
+        // read font
+        OpenType::Font *otf = load_font(job.input_file, job.face, errh);
+        if (!otf)
+            return;
+
+        LandmarkErrorHandler cerrh(errh, printable_filename(job.input_file));
+        BailErrorHandler bail_errh(&cerrh);
+
+        // read base encodings
+        for (String *s = job.base_encoding_files.begin(); s < job.base_encoding_files.end(); s++) {
+            Vector<BaseEncoding *> *bep = base_encodings_cache.findp(*s);
+            if (!bep) {
+                Vector<BaseEncoding *> base_encodings;
+                parse_base_encodings(*s, base_encodings, errh);
+                base_encodings_cache.insert(*s, base_encodings);
+                bep = base_encodings_cache.findp(*s);
             }
-            break;
+            for (BaseEncoding **be = bep->begin(); be != bep->end(); be++)
+                job.base_encodings.push_back(*be);
+        }
 
-          case DESIGN_SIZE_OPT:
-            if (design_size > 0)
-                usage_error(errh, "design size value specified twice");
-            else if (clp->val.d <= 0)
-                usage_error(errh, "design size must be > 0");
-            design_size = clp->val.d;
-            break;
+        // read encoding
+        DvipsEncoding dvipsenc;
+        if (job.encoding_file)
+            dvipsenc = *load_encoding(job.encoding_file, job.no_ecommand, errh);
+        else {
+            String cff_data(otf->table("CFF"));
+            if (!cff_data) {
+                errh->error("explicit encoding required for TrueType fonts");
+                errh->message("(Use %<-e ENCODING%> to choose an encoding. %<-e texnansx%> often works.)");
+                return;
+            } else if (!job.have_encoding_file) {
+                errh->warning("no encoding provided");
+                errh->message("(Use %<-e ENCODING%> to choose an encoding. %<-e texnansx%> often works,\nor say %<-e -%> to turn off this warning.)");
+            }
 
-          case LIGKERN_OPT:
-            ligkern.push_back(clp->vstr);
-            break;
+            // use encoding from font
+            Cff cff(cff_data, otf->units_per_em(), &bail_errh);
+            Cff::FontParent *font = cff.font(PermString(), &bail_errh);
+            assert(cff.ok() && font->ok());
+            if (Type1Encoding *t1e = font->type1_encoding()) {
+                for (int i = 0; i < 256; i++)
+                    dvipsenc.encode(i, (*t1e)[i]);
+            } else
+                errh->fatal("font has no encoding, specify one explicitly");
+        }
 
-          case POSITION_OPT:
-            pos.push_back(clp->vstr);
-            break;
+        // apply default ligkern commands
+        if (job.default_ligkern)
+            dvipsenc.parse_ligkern(default_ligkerns, 0, ErrorHandler::silent_handler());
 
-          case WARN_MISSING_OPT:
-            warn_missing = !clp->negated;
-            break;
+        // apply command-line ligkern commands and coding scheme
+        cerrh.set_landmark("--ligkern command");
+        for (int i = 0; i < job.ligkern.size(); i++)
+            dvipsenc.parse_ligkern(job.ligkern[i], 1, &cerrh);
+        cerrh.set_landmark("--position command");
+        for (int i = 0; i < job.pos.size(); i++)
+            dvipsenc.parse_position(job.pos[i], 1, &cerrh);
+        cerrh.set_landmark("--unicoding command");
+        for (int i = 0; i < job.unicoding.size(); i++)
+            dvipsenc.parse_unicoding(job.unicoding[i], 1, &cerrh);
+        if (job.codingscheme)
+            dvipsenc.set_coding_scheme(job.codingscheme);
+        if (job.warn_missing >= 0)
+            dvipsenc.set_warn_missing(job.warn_missing);
 
-          case NO_ECOMMAND_OPT:
-            no_ecommand = true;
-            break;
+        do_file(job, *otf, dvipsenc, job.literal_encoding, errh);
 
-          case DEFAULT_LIGKERN_OPT:
-            default_ligkern = !clp->negated;
-            break;
+    } catch (OpenType::Error e) {
+        errh->error("unhandled exception %<%s%>", e.description.c_str());
+    }
+    record_outputs(0);
+    stats_report_job(job.input_file, job.font_name, errh);
+}
 
-          case BOUNDARY_CHAR_OPT:
-            ligkern.push_back(String("|| = ") + String(clp->val.i));
-            break;
+#if HAVE_PARALLEL_JOBS
+// Parallel jobs run in worker processes, since fonts, glyph names, and
+// output directories are global state. Each worker returns its pending
+// updates to the parent, which commits them for all jobs at once, along
+// with its --stats totals.
 
-          case ALTSELECTOR_CHAR_OPT:
-            ligkern.push_back(String("^^ = ") + String(clp->val.i));
-            break;
+static String
+unparse_pending_updates()
+{
+    StringAccum sa;
+    for (PendingUpdate *pu = pending_updates.begin(); pu != pending_updates.end(); ++pu)
+        sa << (char) pu->type
+           << pu->filename.length() << ' ' << pu->filename
+           << pu->name.length() << ' ' << pu->name
+           << pu->text.length() << ' ' << pu->text;
+    return sa.take_string();
+}
 
-          case ALTSELECTOR_FEATURE_OPT: {
-              OpenType::Tag t(clp->vstr);
-              if (!t.valid())
-                  usage_error(errh, "bad feature tag");
-              else if (altselector_feature_filters[t])
-                  usage_error(errh, "altselector feature %<%s%> included twice", t.text().c_str());
-              else {
-                  if (!current_filter_ptr) {
-                      current_filter_ptr = new GlyphFilter(current_substitution_filter + current_alternate_filter);
-                      allocated_filters.push_back(current_filter_ptr);
-                  }
-                  altselector_features.push_back(t);
-                  altselector_feature_filters.insert(t, current_filter_ptr);
-              }
-              break;
-          }
+static bool
+parse_pending_updates(const String &str)
+{
+    const char *s = str.c_str(), *end = str.end();
+    while (s != end) {
+        PendingUpdate pu;
+        pu.type = (unsigned char) *s++;
+        String *fields[3] = { &pu.filename, &pu.name, &pu.text };
+        for (int i = 0; i < 3; ++i) {
+            char *x;
+            unsigned long len = strtoul(s, &x, 10);
+            if (x == s || x == end || *x != ' '
+                || len > (unsigned long) (end - x - 1))
+                return false;
+            *fields[i] = str.substring(x + 1, x + 1 + len);
+            s = x + 1 + len;
+        }
+        if (pu.type == PendingUpdate::STATS) {
+            if (!stats_merge_total(pu.text))
+                return false;
+        } else
+            pending_updates.push_back(pu);
+    }
+    return true;
+}
 
-          case ALTERNATES_FILTER_OPT:
-            current_alternate_filter = null_filter;
-            /* fallthru */
-          case EXCLUDE_ALTERNATES_OPT:
-          case INCLUDE_ALTERNATES_OPT:
-            current_alternate_filter.add_alternate_filter(clp->vstr, opt == EXCLUDE_ALTERNATES_OPT, errh);
-            current_filter_ptr = 0;
-            break;
+struct Worker {
+    pid_t pid;
+    int fd;
+    int job;
+    StringAccum output;
+};
 
-          case CLEAR_ALTERNATES_OPT:
-            current_alternate_filter = null_filter;
-            current_filter_ptr = 0;
+static void
+run_worker(Job &job, int fd, ErrorHandler *errh)
+{
+    LandmarkErrorHandler jerrh(errh, job.landmark);
+    stats_begin_worker();
+    run_job(job, &jerrh);
+    if (stats_enabled)
+        add_pending_update(PendingUpdate::STATS, String(), String(), stats_unparse_total());
+
+    String output = unparse_pending_updates();
+    for (const char *s = output.begin(); s != output.end(); ) {
+        ssize_t w = write(fd, s, output.end() - s);
+        if (w > 0)
+            s += w;
+        else if (w < 0 && errno != EINTR && errno != EAGAIN) {
+            jerrh.error("%s", strerror(errno));
             break;
+        }
+    }
 
-          case UNICODING_OPT:
-            unicoding.push_back(clp->vstr);
-            break;
+    fflush(stdout);
+    fflush(stderr);
+    _exit(jerrh.nerrors() ? 1 : 0);
+}
 
-          case CODINGSCHEME_OPT:
-            if (codingscheme)
-                usage_error(errh, "coding scheme specified twice");
-            codingscheme = clp->vstr;
-            if (codingscheme.length() > 39)
-                errh->warning("only first 39 characters of coding scheme are significant");
-            if (codingscheme.find_left('(') >= 0 || codingscheme.find_left(')') >= 0)
-                usage_error(errh, "coding scheme cannot contain parentheses");
-            break;
+static int
+run_jobs_parallel(const Vector<Job *> &jobs, int nworkers, ErrorHandler *errh)
+{
+    // read fonts first, so that workers share them; errors are reported
+    // later, by the jobs themselves
+    for (Job * const *jp = jobs.begin(); jp != jobs.end(); ++jp)
+        (void) load_font((*jp)->input_file, (*jp)->face, ErrorHandler::silent_handler());
+
+    Vector<String> outputs(jobs.size(), String());
+    Vector<Worker *> workers;
+    Vector<struct pollfd> pfds;
+    int next_job = 0, nfailed = 0;
+
+    while (next_job < jobs.size() || workers.size()) {
+        // start workers
+        while (next_job < jobs.size() && workers.size() < nworkers) {
+            int p[2];
+            if (pipe(p) < 0)
+                errh->fatal("pipe: %s", strerror(errno));
+            fflush(0);
+            pid_t child = fork();
+            if (child < 0)
+                errh->fatal("fork: %s", strerror(errno));
+            else if (child == 0) {
+                close(p[0]);
+                for (Worker **w = workers.begin(); w != workers.end(); ++w)
+                    close((*w)->fd);
+                run_worker(*jobs[next_job], p[1], errh);
+            }
+            close(p[1]);
+            Worker *w = new Worker;
+            w->pid = child;
+            w->fd = p[0];
+            w->job = next_job;
+            workers.push_back(w);
+            ++next_job;
+        }
+
+        // wait for worker output
+        pfds.clear();
+        for (Worker **w = workers.begin(); w != workers.end(); ++w) {
+            struct pollfd pfd;
+            pfd.fd = (*w)->fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            pfds.push_back(pfd);
+        }
+        if (poll(pfds.begin(), pfds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            errh->fatal("poll: %s", strerror(errno));
+        }
+
+        // collect output; a worker is finished at end of file
+        for (int i = workers.size() - 1; i >= 0; --i) {
+            if (!pfds[i].revents)
+                continue;
+            Worker *w = workers[i];
+            ssize_t amt = 0;
+            if (char *x = w->output.reserve(8192)) {
+                amt = read(w->fd, x, 8192);
+                if (amt > 0) {
+                    w->output.adjust_length(amt);
+                    continue;
+                } else if (amt < 0 && (errno == EINTR || errno == EAGAIN))
+                    continue;
+            }
+
+            close(w->fd);
+            int status, result;
+            while ((result = waitpid(w->pid, &status, 0)) < 0 && errno == EINTR)
+                /* try again */;
+            if (result >= 0 && WIFSIGNALED(status))
+                errh->error("%s: worker killed by signal %d", jobs[w->job]->landmark.c_str(), WTERMSIG(status));
+            if (result < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                ++nfailed;
+            outputs[w->job] = w->output.take_string();
+
+            delete w;
+            workers[i] = workers.back();
+            workers.pop_back();
+        }
+    }
+
+    for (int i = 0; i < outputs.size(); ++i)
+        if (!parse_pending_updates(outputs[i]))
+            errh->error("%s: bad worker output", jobs[i]->landmark.c_str());
+    return nfailed;
+}
+#endif
+
+int
+main(int argc, char *argv[])
+{
+#ifndef WIN32
+    handle_sigchld();
+#endif
+    Clp_Parser *clp =
+        Clp_NewParser(argc, (const char * const *)argv, sizeof(options) / sizeof(options[0]), options);
+    Clp_AddType(clp, CHAR_OPTTYPE, 0, clp_parse_char, 0);
+    program_name = Clp_ProgramName(clp);
+#if HAVE_KPATHSEA
+    kpsei_init(argv[0], "lcdftools");
+#endif
+#ifdef HAVE_CTIME
+    {
+        time_t t = time(0);
+        char *c = ctime(&t);
+        current_time = " on " + String(c).substring(0, -1); // get rid of \n
+    }
+#endif
+    for (int i = 0; i < argc; i++)
+        invocation << (i ? " " : "") << argv[i];
+
+    ErrorHandler *errh = ErrorHandler::static_initialize(new FileErrorHandler(stderr, String(program_name) + ": "));
+    Job job;
+    String batch_file;
+    int njobs = 1;
+    bool timings = false;
+    String stats_file;
+    Vector<String> glyphlist_files;
+    const char* odirs[NUMODIR + 1];
+    for (int i = 0; i <= NUMODIR; ++i) {
+        odirs[i] = 0;
+    }
+
+    while (1) {
+        int opt = Clp_Next(clp);
+        if (parse_job_option(clp, opt, job, errh))
+            continue;
+        switch (opt) {
 
           case AUTOMATIC_OPT:
             automatic = !clp->negated;
@@ -2101,70 +3148,19 @@ main(int argc, char *argv[])
                 usage_error(errh, "typeface name specified twice");
             break;
 
-          case VIRTUAL_OPT:
-            if (clp->negated)
-                output_flags &= ~G_VMETRICS;
-            else
-                output_flags |= G_VMETRICS;
-            specified_output_flags |= G_VMETRICS;
-            break;
-
-        case NO_ENCODING_OPT:
-        case NO_TYPE1_OPT:
-        case NO_DOTLESSJ_OPT:
-        case NO_UPDMAP_OPT:
-        case UPDMAP_SYS_OPT:
-            output_flags &= ~(opt - NO_OUTPUT_OPTS);
-            specified_output_flags |= opt - NO_OUTPUT_OPTS;
-            break;
-
-        case TRUETYPE_OPT:
-        case TYPE42_OPT:
-        case UPDMAP_USER_OPT:
-            if (!clp->negated)
-                output_flags |= (opt - YES_OUTPUT_OPTS);
-            else
-                output_flags &= ~(opt - YES_OUTPUT_OPTS);
-            specified_output_flags |= opt - YES_OUTPUT_OPTS;
-            break;
-
-          case OUTPUT_ENCODING_OPT:
-            if (out_encoding_file)
-                usage_error(errh, "encoding output file specified twice");
-            out_encoding_file = (clp->have_val ? clp->vstr : "-");
-            output_flags = G_ENCODING;
-            specified_output_flags = -1;
-            break;
-
-          case MINIMUM_KERN_OPT:
-            minimum_kern = clp->val.d;
-            break;
-
           case MAP_FILE_OPT:
             if (clp->negated)
-                output_flags &= ~G_PSFONTSMAP;
+                job.output_flags &= ~G_PSFONTSMAP;
             else {
-                output_flags |= G_PSFONTSMAP;
+                job.output_flags |= G_PSFONTSMAP;
                 if (!set_map_file(clp->vstr))
                     usage_error(errh, "map file specified twice");
             }
-            specified_output_flags |= G_PSFONTSMAP;
+            job.specified_output_flags |= G_PSFONTSMAP;
             break;
 
-        case PL_OPT:
-            if (clp->negated)
-                output_flags &= ~G_ASCII;
-            else
-                output_flags |= G_ASCII;
-            specified_output_flags |= G_ASCII;
-            break;
-
-        case TFM_OPT:
-            if (clp->negated)
-                output_flags &= ~G_BINARY;
-            else
-                output_flags |= G_BINARY;
-            specified_output_flags |= G_BINARY;
+        case PLTOTF_OPT:
+            use_pltotf = !clp->negated;
             break;
 
         case ENCODING_DIR_OPT:
@@ -2182,28 +3178,6 @@ main(int argc, char *argv[])
                 usage_error(errh, "%s directory specified twice", odirname(opt - DIR_OPTS));
             break;
 
-          case FONT_NAME_OPT:
-          font_name:
-            if (font_name)
-                usage_error(errh, "font name specified twice");
-            font_name = clp->vstr;
-            break;
-
-        case FIXED_PITCH_OPT:
-            override_is_fixed_pitch = true;
-            is_fixed_pitch = !clp->negated;
-            break;
-
-        case PROPORTIONAL_WIDTH_OPT:
-            override_is_fixed_pitch = true;
-            is_fixed_pitch = !!clp->negated;
-            break;
-
-        case ITALIC_ANGLE_OPT:
-            override_italic_angle = true;
-            italic_angle = clp->val.d;
-            break;
-
           case GLYPHLIST_OPT:
             glyphlist_files.push_back(clp->vstr);
             break;
@@ -2237,6 +3211,36 @@ main(int argc, char *argv[])
             force = !clp->negated;
             break;
 
+          case BATCH_OPT:
+            if (batch_file)
+                usage_error(errh, "job file specified twice");
+            batch_file = clp->vstr;
+            break;
+
+          case CACHE_OPT:
+            use_cache = !clp->negated;
+            break;
+
+          case JOBS_OPT:
+            if (clp->val.i < 1)
+                usage_error(errh, "%<--jobs%> must be at least 1");
+            njobs = clp->val.i;
+            break;
+
+          case THREADS_OPT:
+            if (clp->val.i < 1)
+                usage_error(errh, "%<--threads%> must be at least 1");
+            nthreads = clp->val.i;
+            break;
+
+          case TIMINGS_OPT:
+            timings = !clp->negated;
+            break;
+
+          case STATS_OPT:
+            stats_file = clp->vstr;
+            break;
+
           case KPATHSEA_DEBUG_OPT:
 #if HAVE_KPATHSEA
             kpsei_set_debug_flags(clp->val.u);
@@ -2245,23 +3249,6 @@ main(int argc, char *argv[])
 #endif
             break;
 
-        case X_HEIGHT_OPT: {
-            char* ends;
-            if (strcmp(clp->vstr, "auto") == 0)
-                override_x_height = FontInfo::x_height_auto;
-            else if (strcmp(clp->vstr, "x") == 0)
-                override_x_height = FontInfo::x_height_x;
-            else if (strcmp(clp->vstr, "font") == 0
-                     || strcmp(clp->vstr, "os/2") == 0)
-                override_x_height = FontInfo::x_height_os2;
-            else if ((x_height = strtod(clp->vstr, &ends)) >= 0
-                     && *ends == 0 && *clp->vstr != 0)
-                override_x_height = FontInfo::x_height_explicit;
-            else
-                usage_error(errh, "bad --x-height option");
-            break;
-        }
-
           case VERSION_OPT:
             printf("otftotfm (LCDF typetools) %s\n", VERSION);
             printf("Copyright (C) 2002-2019 Eddie Kohler\n\
@@ -2276,15 +3263,6 @@ particular purpose.\n");
             exit(0);
             break;
 
-          case Clp_NotOption:
-            if (input_file && font_name)
-                usage_error(errh, "too many arguments");
-            else if (input_file)
-                goto font_name;
-            else
-                input_file = clp->vstr;
-            break;
-
           case Clp_Done:
             goto done;
 
@@ -2299,17 +3277,19 @@ particular purpose.\n");
     }
 
   done:
-    // check for odd option combinations
-    if (warn_missing > 0 && !(output_flags & G_VMETRICS))
-        errh->warning("%<--warn-missing%> has no effect with %<--no-virtual%>");
-    if (!(specified_output_flags & (G_BINARY | G_ASCII)))
-        output_flags |= G_BINARY;
+    // updmap settings apply to the whole run
+    output_flags = job.output_flags;
 
-    // set up file names
-    if (!input_file)
-        usage_error(errh, "no font filename provided");
-    if (encoding_file == "-")
-        encoding_file = "";
+    // collect jobs
+    Vector<Job *> jobs;
+    if (batch_file) {
+        read_batch_file(batch_file, job, jobs, errh);
+        if (errh->nerrors())
+            exit(1);
+    } else {
+        finish_job_options(job, errh);
+        jobs.push_back(new Job(job));
+    }
 
     // set up output directories
     if (odirs[NUMODIR]) {
@@ -2321,123 +3301,70 @@ particular purpose.\n");
         if (odirs[i])
             setodir(i, odirs[i]);
 
-    // set up feature filters
-    if (!altselector_features.size()) {
-        if (!current_filter_ptr) {
-            current_filter_ptr = new GlyphFilter(current_substitution_filter + current_alternate_filter);
-            allocated_filters.push_back(current_filter_ptr);
-        }
-        altselector_features.push_back(OpenType::Tag("dlig"));
-        altselector_feature_filters.insert(OpenType::Tag("dlig"), current_filter_ptr);
-        altselector_features.push_back(OpenType::Tag("salt"));
-        altselector_feature_filters.insert(OpenType::Tag("salt"), current_filter_ptr);
-    } else if (!current_filter_ptr) {
-        errh->warning("some filtering options ignored");
-        errh->message("(--include-*, --exclude-*, and --*-filter options must occur\nbefore the feature options to which they should apply.)");
-    }
-
-    try {
-        // read font
-        otf_data = read_file(input_file, errh);
-        if (errh->nerrors())
-            exit(1);
-
-        LandmarkErrorHandler cerrh(errh, printable_filename(input_file));
-        BailErrorHandler bail_errh(&cerrh);
-
-        OpenType::Font otf(otf_data, &bail_errh);
-        assert(otf.ok());
-
-        // figure out scripts we care about
-        if (!interesting_scripts.size()) {
-            interesting_scripts.push_back(Efont::OpenType::Tag("latn"));
-            interesting_scripts.push_back(Efont::OpenType::Tag());
-        }
-        std::sort(interesting_features.begin(), interesting_features.end());
-        std::sort(altselector_features.begin(), altselector_features.end());
-
-        // find glyphlist
-        if (!glyphlist_files.size()) {
+    // find glyphlist
+    if (!glyphlist_files.size()) {
 #if HAVE_KPATHSEA
-            if (String g = kpsei_find_file("glyphlist.txt", KPSEI_FMT_MAP)) {
-                glyphlist_files.push_back(g);
-                if (verbose)
-                    errh->message("glyphlist.txt found with kpathsea at %s", g.c_str());
-            } else
+        if (String g = kpsei_find_file("glyphlist.txt", KPSEI_FMT_MAP)) {
+            glyphlist_files.push_back(g);
+            if (verbose)
+                errh->message("glyphlist.txt found with kpathsea at %s", g.c_str());
+        } else
 #endif
-                glyphlist_files.push_back(GLYPHLISTDIR "/glyphlist.txt");
+            glyphlist_files.push_back(GLYPHLISTDIR "/glyphlist.txt");
 #if HAVE_KPATHSEA
-            if (String g = kpsei_find_file("texglyphlist.txt", KPSEI_FMT_MAP)) {
-                glyphlist_files.push_back(g);
-                if (verbose)
-                    errh->message("texglyphlist.txt found with kpathsea at %s", g.c_str());
-            } else
+        if (String g = kpsei_find_file("texglyphlist.txt", KPSEI_FMT_MAP)) {
+            glyphlist_files.push_back(g);
+            if (verbose)
+                errh->message("texglyphlist.txt found with kpathsea at %s", g.c_str());
+        } else
 #endif
-                glyphlist_files.push_back(GLYPHLISTDIR "/texglyphlist.txt");
-        }
-
-        // read glyphlist
-        for (String *g = glyphlist_files.begin(); g < glyphlist_files.end(); g++)
-            if (String s = read_file(*g, errh, true))
-                DvipsEncoding::add_glyphlist(s);
-
-        // read base encodings
-        for (String *s = base_encoding_files.begin(); s < base_encoding_files.end(); s++)
-            parse_base_encodings(*s, errh);
+            glyphlist_files.push_back(GLYPHLISTDIR "/texglyphlist.txt");
+    }
 
-        // read encoding
-        DvipsEncoding dvipsenc;
-        if (encoding_file) {
-            if (String path = locate_encoding(encoding_file, errh))
-                dvipsenc.parse(path, no_ecommand, no_ecommand, errh);
-            else
-                errh->fatal("encoding %<%s%> not found", encoding_file.c_str());
-        } else {
-            String cff_data(otf.table("CFF"));
-            if (!cff_data) {
-                errh->error("explicit encoding required for TrueType fonts");
-                errh->message("(Use %<-e ENCODING%> to choose an encoding. %<-e texnansx%> often works.)");
-                exit(1);
-            } else if (!have_encoding_file) {
-                errh->warning("no encoding provided");
-                errh->message("(Use %<-e ENCODING%> to choose an encoding. %<-e texnansx%> often works,\nor say %<-e -%> to turn off this warning.)");
-            }
+    // start timing after option processing
+    stats_configure(timings, stats_file);
 
-            // use encoding from font
-            Cff cff(cff_data, otf.units_per_em(), &bail_errh);
-            Cff::FontParent *font = cff.font(PermString(), &bail_errh);
-            assert(cff.ok() && font->ok());
-            if (Type1Encoding *t1e = font->type1_encoding()) {
-                for (int i = 0; i < 256; i++)
-                    dvipsenc.encode(i, (*t1e)[i]);
-            } else
-                errh->fatal("font has no encoding, specify one explicitly");
+    // read glyphlist
+    StringAccum glyphlist_sa;
+    for (String *g = glyphlist_files.begin(); g < glyphlist_files.end(); g++)
+        if (Glyphlist *gl = load_glyphlist(*g, errh)) {
+            DvipsEncoding::add_glyphlist(gl);
+            glyphlist_sa << gl->digest() << '\n';
         }
+    glyphlist_digest = string_digest(glyphlist_sa.take_string());
+    if (use_cache < 0)
+        use_cache = automatic;
+
+    // run jobs
+    int nfailed = 0;
+    if (njobs > 1 && !batch_file)
+        errh->warning("%<--jobs%> has no effect without %<--batch%>");
+#if HAVE_PARALLEL_JOBS
+    if (njobs > 1 && jobs.size() > 1)
+        nfailed = run_jobs_parallel(jobs, njobs, errh);
+    else
+#else
+    if (njobs > 1 && jobs.size() > 1)
+        errh->warning("parallel jobs not supported on this platform");
+#endif
+    for (Job **jp = jobs.begin(); jp != jobs.end(); ++jp) {
+        LandmarkErrorHandler jerrh(errh, (*jp)->landmark);
+        run_job(**jp, &jerrh);
+        if (jerrh.nerrors())
+            ++nfailed;
+    }
+    if (batch_file && nfailed)
+        errh->error("%d of %d jobs failed", nfailed, jobs.size());
 
-        // apply default ligkern commands
-        if (default_ligkern)
-            dvipsenc.parse_ligkern(default_ligkerns, 0, ErrorHandler::silent_handler());
-
-        // apply command-line ligkern commands and coding scheme
-        cerrh.set_landmark("--ligkern command");
-        for (int i = 0; i < ligkern.size(); i++)
-            dvipsenc.parse_ligkern(ligkern[i], 1, &cerrh);
-        cerrh.set_landmark("--position command");
-        for (int i = 0; i < pos.size(); i++)
-            dvipsenc.parse_position(pos[i], 1, &cerrh);
-        cerrh.set_landmark("--unicoding command");
-        for (int i = 0; i < unicoding.size(); i++)
-            dvipsenc.parse_unicoding(unicoding[i], 1, &cerrh);
-        if (codingscheme)
-            dvipsenc.set_coding_scheme(codingscheme);
-        if (warn_missing >= 0)
-            dvipsenc.set_warn_missing(warn_missing);
-
-        do_file(input_file, otf, dvipsenc, literal_encoding, errh);
-
-    } catch (OpenType::Error e) {
-        errh->error("unhandled exception %<%s%>", e.description.c_str());
+    // update encoding and map files for all jobs
+    {
+        StatsTimer t(PH_MAP_UPDATE);
+        commit_pending_updates(errh);
     }
+    stats_report_total(errh);
+
+    for (Job **jp = jobs.begin(); jp != jobs.end(); ++jp)
+        delete *jp;
 
     for (int i = 0; i < allocated_filters.size(); ++i)
         delete allocated_filters[i];
@@ -1,24 +1,84 @@
 #ifndef OTFTOTFM_OTFTOTFM_HH
 #define OTFTOTFM_OTFTOTFM_HH
 #include <lcdf/string.hh>
+#include <lcdf/hashmap.hh>
+#include "glyphfilter.hh"
 class Metrics;
 class FontInfo;
 class StringAccum;
 class ErrorHandler;
+struct BaseEncoding;
+
+// Settings for converting one font: the options from otftotfm's command
+// line, extended by one line of the job file in --batch mode.
+struct Job {
+
+    String input_file;
+    int face;
+    String font_name;
+    String landmark;
+    String options;
+
+    String encoding_file;
+    bool literal_encoding;
+    bool have_encoding_file;
+    String codingscheme;
+    Vector<String> ligkern;
+    Vector<String> pos;
+    Vector<String> unicoding;
+    bool no_ecommand;
+    bool default_ligkern;
+    int warn_missing;
+    Vector<String> base_encoding_files;
+    Vector<BaseEncoding *> base_encodings;
+
+    Vector<Efont::OpenType::Tag> interesting_scripts;
+    Vector<Efont::OpenType::Tag> interesting_features;
+    Vector<Efont::OpenType::Tag> altselector_features;
+    HashMap<Efont::OpenType::Tag, GlyphFilter *> feature_filters;
+    HashMap<Efont::OpenType::Tag, GlyphFilter *> altselector_feature_filters;
+    GlyphFilter current_substitution_filter;
+    GlyphFilter current_alternate_filter;
+    GlyphFilter *current_filter_ptr;
+
+    double extend;
+    double slant;
+    int letterspace;
+    double design_size;
+    double minimum_kern;
+    double space_factor;
+    bool math_spacing;
+    int skew_char;
+    bool override_is_fixed_pitch;
+    bool is_fixed_pitch;
+    bool override_italic_angle;
+    double italic_angle;
+    int override_x_height;
+    double x_height;
+
+    unsigned output_flags;
+    unsigned specified_output_flags;
+
+    String out_encoding_file;
+    String out_encoding_name;
+
+    Job();
+
+};
 
 String suffix_font_name(const String &font_name, const String &suffix);
 
-String installed_metrics_font_name(const String &font_name, const String &secondary);
+String installed_metrics_font_name(const Job &job, const String &font_name, const String &secondary);
 
-void output_metrics(Metrics &metrics, const String &ps_name, int boundary_char,
-        const FontInfo &finfo,
+void output_metrics(Job &job, Metrics &metrics, const String &ps_name,
+        int boundary_char, const FontInfo &finfo,
         const String &encoding_name, const String &encoding_file,
         const String &font_name,
-        String (*dvips_include)(const String &ps_name, const FontInfo &, ErrorHandler *),
+        String (*dvips_include)(const Job &, const String &ps_name, const FontInfo &, ErrorHandler *),
         ErrorHandler *errh);
 
 double font_cap_height(const FontInfo &, const Transform &);
 double font_ascender(const FontInfo &, const Transform &);
-double font_slant(const FontInfo &);
+double font_slant(const Job &, const FontInfo &);
 
 #endif
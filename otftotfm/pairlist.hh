@@ -0,0 +1,144 @@
+#ifndef OTFTOTFM_PAIRLIST_HH
+#define OTFTOTFM_PAIRLIST_HH
+#include <lcdf/vector.hh>
+#include <lcdf/hashmap.hh>
+#include <algorithm>
+
+// A PairList holds the ligatures or kerns starting with one character, in
+// the order they were added; T has an 'in2' member naming the second
+// character. Long lists are indexed by 'in2', since fonts with class
+// kerning can add a kern for nearly every pair of characters.
+template <typename T> class PairList { public:
+
+    PairList()                      : _index(0), _index_dups(false) { }
+    PairList(const PairList<T> &x)  : _v(x._v), _index(0), _index_dups(false) { }
+    ~PairList()                     { delete _index; }
+    inline PairList<T> &operator=(const PairList<T> &);
+
+    typedef T *iterator;
+    typedef const T *const_iterator;
+    iterator begin()                { return _v.begin(); }
+    iterator end()                  { return _v.end(); }
+    const_iterator begin() const    { return _v.begin(); }
+    const_iterator end() const      { return _v.end(); }
+    int size() const                { return _v.size(); }
+
+    inline T *find(int in2) const;
+    inline void push_back(const T &);
+    inline void erase(iterator);
+    inline void set_in2(iterator x, int in2);
+    void clear()                    { _v.clear(); unindex(); }
+    inline void swap(PairList<T> &x);
+
+  private:
+
+    Vector<T> _v;
+    mutable HashMap<int, int> *_index; // in2 + 1 => position in _v
+    mutable bool _index_dups;       // some in2 appears more than once
+
+    enum { INDEX_THRESHOLD = 8 };
+    void unindex()                  { delete _index; _index = 0; _index_dups = false; }
+    inline void index_add(int in2, int i) const;
+    inline void index_remove(int in2, int i) const;
+
+};
+
+
+template <typename T> inline PairList<T> &
+PairList<T>::operator=(const PairList<T> &x)
+{
+    _v = x._v;
+    unindex();
+    return *this;
+}
+
+template <typename T> inline T *
+PairList<T>::find(int in2) const
+{
+    if (!_index && _v.size() > INDEX_THRESHOLD) {
+        // index the first of any duplicates, as a linear search would find
+        _index = new HashMap<int, int>(-1);
+        for (int i = _v.size() - 1; i >= 0; --i)
+            index_add(_v[i].in2, i);
+    }
+    if (_index) {
+        int i = _index->find(in2 + 1);
+        return i >= 0 ? const_cast<T *>(&_v[i]) : 0;
+    }
+    for (const T *x = _v.begin(); x != _v.end(); ++x)
+        if (x->in2 == in2)
+            return const_cast<T *>(x);
+    return 0;
+}
+
+template <typename T> inline void
+PairList<T>::push_back(const T &x)
+{
+    _v.push_back(x);
+    if (_index)
+        index_add(x.in2, _v.size() - 1);
+}
+
+template <typename T> inline void
+PairList<T>::erase(iterator x)
+{
+    // fill the hole with the last element
+    int i = x - _v.begin(), last = _v.size() - 1;
+    int in2 = x->in2, moved_in2 = _v.back().in2;
+    *x = _v.back();
+    _v.pop_back();
+    if (_index) {
+        index_remove(in2, i);
+        if (i != last) {
+            index_remove(moved_in2, last);
+            index_add(moved_in2, i);
+        }
+    }
+}
+
+template <typename T> inline void
+PairList<T>::set_in2(iterator x, int in2)
+{
+    int old_in2 = x->in2;
+    x->in2 = in2;
+    if (_index) {
+        index_remove(old_in2, x - _v.begin());
+        index_add(in2, x - _v.begin());
+    }
+}
+
+template <typename T> inline void
+PairList<T>::swap(PairList<T> &x)
+{
+    _v.swap(x._v);
+    std::swap(_index, x._index);
+    std::swap(_index_dups, x._index_dups);
+}
+
+template <typename T> inline void
+PairList<T>::index_add(int in2, int i) const
+{
+    // the index points at the first entry with each in2
+    int &pos = _index->find_force(in2 + 1);
+    if (pos >= 0 && pos != i)
+        _index_dups = true;
+    if (pos < 0 || pos > i)
+        pos = i;
+}
+
+template <typename T> inline void
+PairList<T>::index_remove(int in2, int i) const
+{
+    // position i no longer holds in2; point at the next entry that does
+    int &pos = _index->find_force(in2 + 1);
+    if (pos == i) {
+        pos = -1;
+        for (int j = i + 1; _index_dups && j < _v.size(); ++j)
+            if (_v[j].in2 == in2) {
+                pos = j;
+                break;
+            }
+    }
+}
+
+#endif
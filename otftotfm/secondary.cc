@@ -125,6 +125,9 @@ FontInfo::~FontInfo()
     delete cff_file;
     delete post;
     delete name;
+    for (Efont::CharstringBoundsTable **t = _bounds_tables.begin();
+         t != _bounds_tables.end(); ++t)
+        delete *t;
     delete _ttb_program;
 }
 
@@ -191,6 +194,17 @@ FontInfo::program() const
     }
 }
 
+Efont::CharstringBoundsTable &
+FontInfo::bounds_table(const Transform &font_xform) const
+{
+    for (Efont::CharstringBoundsTable **t = _bounds_tables.begin();
+         t != _bounds_tables.end(); ++t)
+        if ((*t)->transform() == font_xform)
+            return **t;
+    _bounds_tables.push_back(new Efont::CharstringBoundsTable(program(), font_xform));
+    return *_bounds_tables.back();
+}
+
 bool
 FontInfo::is_fixed_pitch() const
 {
@@ -289,9 +303,9 @@ Secondary::encode_uni(int code, PermString name,
     return true;
 }
 
-T1Secondary::T1Secondary(const FontInfo &finfo, const String &font_name,
-                         const String &otf_file_name)
-    : Secondary(finfo), _font_name(font_name), _otf_file_name(otf_file_name),
+T1Secondary::T1Secondary(const FontInfo &finfo, Job &job)
+    : Secondary(finfo), _job(job), _font_name(job.font_name),
+      _otf_file_name(job.input_file),
       _units_per_em(finfo.units_per_em()),
       _xheight((int) ceil(finfo.x_height(Transform()))),
       _spacewidth(_units_per_em)
@@ -337,7 +351,7 @@ SettingSet& SettingSet::show(int uni) {
 static String dotlessj_file_name;
 
 static String
-dotlessj_dvips_include(const String &, const FontInfo &, ErrorHandler *)
+dotlessj_dvips_include(const Job &, const String &, const FontInfo &, ErrorHandler *)
 {
     return "<" + pathname_filename(dotlessj_file_name);
 }
@@ -351,7 +365,7 @@ T1Secondary::dotlessj_font(Metrics &metrics, ErrorHandler *errh, Glyph &dj_glyph
     String dj_name;
     bool install_metrics;
     // XXX make sure dotlessj is for the main font?
-    if ((dj_name = installed_metrics_font_name(_font_name, "dotlessj")))
+    if ((dj_name = installed_metrics_font_name(_job, _font_name, "dotlessj")))
         install_metrics = false;
     else {
         dj_name = suffix_font_name(_font_name, "--lcdfj");
@@ -363,7 +377,7 @@ T1Secondary::dotlessj_font(Metrics &metrics, ErrorHandler *errh, Glyph &dj_glyph
         if (metrics.mapped_font_name(i) == dj_name)
             return i;
 
-    if (String filename = installed_type1_dotlessj(_otf_file_name, _finfo.cff->font_name(), (output_flags & G_DOTLESSJ), errh)) {
+    if (String filename = installed_type1_dotlessj(_otf_file_name, _job.face, _finfo.cff->font_name(), (_job.output_flags & G_DOTLESSJ), errh)) {
 
         // check for special case: "\0" means the font's "j" is already
         // dotless
@@ -410,7 +424,7 @@ T1Secondary::dotlessj_font(Metrics &metrics, ErrorHandler *errh, Glyph &dj_glyph
             Metrics dj_metrics(font, 256);
             dj_metrics.encode('j', U_DOTLESSJ, dj_glyph);
             ::dotlessj_file_name = filename;
-            output_metrics(dj_metrics, font->font_name(), -1, _finfo, String(), String(), dj_name, dotlessj_dvips_include, errh);
+            output_metrics(_job, dj_metrics, font->font_name(), -1, _finfo, String(), String(), dj_name, dotlessj_dvips_include, errh);
         } else if (verbose)
             errh->message("using %<%s%> for dotless-J font metrics", dj_name.c_str());
 
@@ -425,7 +439,7 @@ int
 T1Secondary::setting(uint32_t uni, SettingSet& set, ErrorHandler *errh)
 {
     Transform xform;
-    extern int letterspace;
+    int letterspace = set.metrics().letterspace();
 
     if (set.show(uni).check())
         return 1;
@@ -656,7 +670,7 @@ char_bounds(double bounds[4], double& width, const FontInfo &finfo,
             const Transform &transform, uint32_t uni)
 {
     if (Efont::OpenType::Glyph g = finfo.cmap->map_uni(uni))
-        return Efont::CharstringBounds::bounds(transform, finfo.program()->glyph_context(g), bounds, width);
+        return finfo.bounds_table(transform).bounds(g, bounds, width);
     else
         return false;
 }
@@ -6,7 +6,8 @@
 class Metrics;
 class Secondary;
 class Transform;
-namespace Efont { class TrueTypeBoundsCharstringProgram; }
+struct Job;
+namespace Efont { class TrueTypeBoundsCharstringProgram; class CharstringBoundsTable; }
 
 struct FontInfo {
 
@@ -31,6 +32,8 @@ struct FontInfo {
     int units_per_em() const {
         return program()->units_per_em();
     }
+    // Glyph bounds under 'font_xform', computed once per glyph.
+    Efont::CharstringBoundsTable &bounds_table(const Transform &font_xform) const;
 
     bool is_fixed_pitch() const;
     double italic_angle() const;
@@ -61,6 +64,7 @@ struct FontInfo {
     mutable bool _got_glyph_names;
     mutable Vector<uint32_t> _unicodes;
     mutable Efont::TrueTypeBoundsCharstringProgram *_ttb_program;
+    mutable Vector<Efont::CharstringBoundsTable *> _bounds_tables;
     bool _override_is_fixed_pitch;
     bool _override_italic_angle;
     bool _is_fixed_pitch;
@@ -109,9 +113,10 @@ class Secondary { public:
 };
 
 class T1Secondary : public Secondary { public:
-    T1Secondary(const FontInfo &, const String &font_name, const String &otf_file_name);
+    T1Secondary(const FontInfo &, Job &);
     int setting(uint32_t uni, SettingSet&, ErrorHandler *);
   private:
+    Job &_job;
     String _font_name;
     String _otf_file_name;
     int _units_per_em;
@@ -0,0 +1,347 @@
+/* stats.{cc,hh} -- per-phase timing and memory statistics
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "stats.hh"
+#include <lcdf/error.hh>
+#include <lcdf/straccum.hh>
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef HAVE_SYS_TIME_H
+# include <sys/time.h>
+#endif
+#if defined(HAVE_SYS_RESOURCE_H) && defined(HAVE_GETRUSAGE)
+# include <sys/resource.h>
+# define USE_GETRUSAGE 1
+#endif
+
+bool stats_enabled = false;
+long stats_counters[SC_COUNT];
+
+static bool print_timings = false;
+static String json_file;
+
+static const char * const phase_names[] = {
+    "other", "font parse", "font info", "make metrics", "gsub",
+    "shrink encoding", "gpos", "encoding output", "metrics output",
+    "subprocess", "map update"
+};
+
+static const char * const phase_keys[] = {
+    "other", "font_parse", "font_info", "make_metrics", "gsub",
+    "shrink_encoding", "gpos", "encoding_output", "metrics_output",
+    "subprocess", "map_update"
+};
+
+static const char * const counter_keys[] = {
+    "lookups", "substitutions", "positionings"
+};
+
+namespace {
+struct PhaseStats {
+    double wall;
+    double cpu;
+    long maxrss_kb;
+    int count;
+};
+}
+
+static PhaseStats job_phases[PH_COUNT];
+static PhaseStats total_phases[PH_COUNT];
+static long total_counters[SC_COUNT];
+static int current_phase = PH_OTHER;
+static double last_wall;
+static double last_cpu;
+
+static void
+sample(double &wall, double &cpu, long &maxrss_kb)
+{
+#ifdef HAVE_SYS_TIME_H
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    wall = tv.tv_sec + tv.tv_usec / 1e6;
+#else
+    wall = (double) time(0);
+#endif
+#if USE_GETRUSAGE
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    cpu = self.ru_utime.tv_sec + self.ru_utime.tv_usec / 1e6
+        + self.ru_stime.tv_sec + self.ru_stime.tv_usec / 1e6
+        + children.ru_utime.tv_sec + children.ru_utime.tv_usec / 1e6
+        + children.ru_stime.tv_sec + children.ru_stime.tv_usec / 1e6;
+# ifdef __APPLE__
+    maxrss_kb = self.ru_maxrss / 1024;
+# else
+    maxrss_kb = self.ru_maxrss;
+# endif
+#else
+    cpu = (double) clock() / CLOCKS_PER_SEC;
+    maxrss_kb = 0;
+#endif
+}
+
+static void
+charge()
+{
+    double wall, cpu;
+    long maxrss_kb;
+    sample(wall, cpu, maxrss_kb);
+    PhaseStats &p = job_phases[current_phase];
+    p.wall += wall - last_wall;
+    p.cpu += cpu - last_cpu;
+    if (maxrss_kb > p.maxrss_kb)
+        p.maxrss_kb = maxrss_kb;
+    last_wall = wall;
+    last_cpu = cpu;
+}
+
+void
+stats_configure(bool timings, const String &json)
+{
+    print_timings = timings;
+    json_file = json;
+    stats_enabled = timings || json;
+    if (stats_enabled) {
+        long maxrss_kb;
+        sample(last_wall, last_cpu, maxrss_kb);
+    }
+}
+
+void
+stats_switch(int &phase)
+{
+    charge();
+    if (phase != current_phase)
+        job_phases[phase].count++;
+    std::swap(phase, current_phase);
+}
+
+static void
+fold_job()
+{
+    for (int i = 0; i < PH_COUNT; ++i) {
+        PhaseStats &t = total_phases[i], &j = job_phases[i];
+        t.wall += j.wall;
+        t.cpu += j.cpu;
+        if (j.maxrss_kb > t.maxrss_kb)
+            t.maxrss_kb = j.maxrss_kb;
+        t.count += j.count;
+    }
+    for (int i = 0; i < SC_COUNT; ++i)
+        total_counters[i] += stats_counters[i];
+    memset(job_phases, 0, sizeof(job_phases));
+    memset(stats_counters, 0, sizeof(stats_counters));
+}
+
+void
+stats_begin_job()
+{
+    if (stats_enabled) {
+        charge();
+        fold_job();
+    }
+}
+
+static void
+json_quote(StringAccum &sa, const String &s)
+{
+    sa << '\"';
+    for (const char *x = s.begin(); x != s.end(); ++x)
+        if (*x == '\"' || *x == '\\')
+            sa << '\\' << *x;
+        else if ((unsigned char) *x < 32)
+            sa.snprintf(8, "\\u%04x", (unsigned char) *x);
+        else
+            sa << *x;
+    sa << '\"';
+}
+
+static void
+report(const char *what, const String &input_file, const String &font_name,
+       const PhaseStats *phases, const long *counters, ErrorHandler *errh)
+{
+    if (print_timings) {
+        StringAccum sa;
+        sa << "timings for ";
+        if (input_file)
+            sa << input_file;
+        else
+            sa << "all jobs";
+        if (font_name)
+            sa << " (" << font_name << ')';
+        sa << ":\n";
+        sa.snprintf(80, "  %-16s %10s %10s %12s\n", "phase", "wall ms", "cpu ms", "peak RSS KB");
+        double wall = 0, cpu = 0;
+        long maxrss_kb = 0;
+        for (int i = 0; i < PH_COUNT; ++i) {
+            const PhaseStats &p = phases[i];
+            if (p.count || p.wall >= 0.0005) {
+                sa.snprintf(80, "  %-16s %10.1f %10.1f %12ld\n", phase_names[i], p.wall * 1000, p.cpu * 1000, p.maxrss_kb);
+                wall += p.wall;
+                cpu += p.cpu;
+                if (p.maxrss_kb > maxrss_kb)
+                    maxrss_kb = p.maxrss_kb;
+            }
+        }
+        sa.snprintf(80, "  %-16s %10.1f %10.1f %12ld\n", "total", wall * 1000, cpu * 1000, maxrss_kb);
+        sa << "  " << counters[SC_LOOKUPS] << " lookups, "
+           << counters[SC_SUBSTITUTIONS] << " substitutions, "
+           << counters[SC_POSITIONINGS] << " positionings";
+        errh->message("%s", sa.c_str());
+    }
+
+    if (json_file) {
+        StringAccum sa;
+        sa << "{\"record\":\"" << what << '\"';
+        if (input_file) {
+            sa << ",\"file\":";
+            json_quote(sa, input_file);
+        }
+        if (font_name) {
+            sa << ",\"font\":";
+            json_quote(sa, font_name);
+        }
+        sa << ",\"phases\":{";
+        bool first = true;
+        for (int i = 0; i < PH_COUNT; ++i) {
+            const PhaseStats &p = phases[i];
+            if (p.count || p.wall >= 0.0005) {
+                sa << (first ? "" : ",") << '\"' << phase_keys[i] << "\":";
+                sa.snprintf(120, "{\"wall\":%.6f,\"cpu\":%.6f,\"maxrss_kb\":%ld}", p.wall, p.cpu, p.maxrss_kb);
+                first = false;
+            }
+        }
+        sa << '}';
+        for (int i = 0; i < SC_COUNT; ++i)
+            sa << ",\"" << counter_keys[i] << "\":" << counters[i];
+        sa << "}\n";
+
+        // append each record with one write(2) to an O_APPEND descriptor,
+        // so records from parallel workers don't mix
+        int fd;
+        if (json_file == "-") {
+            fflush(stdout);
+            fd = STDOUT_FILENO;
+        } else
+            fd = open(json_file.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0666);
+        if (fd < 0)
+            errh->error("%s: %s", json_file.c_str(), strerror(errno));
+        else {
+            ssize_t w;
+            while ((w = write(fd, sa.data(), sa.length())) < 0 && errno == EINTR)
+                /* try again */;
+            if (w < 0)
+                errh->error("%s: %s", json_file.c_str(), strerror(errno));
+            if (fd != STDOUT_FILENO)
+                close(fd);
+        }
+    }
+}
+
+void
+stats_report_job(const String &input_file, const String &font_name, ErrorHandler *errh)
+{
+    if (stats_enabled) {
+        charge();
+        report("job", input_file, font_name, job_phases, stats_counters, errh);
+        fold_job();
+    }
+}
+
+void
+stats_report_total(ErrorHandler *errh)
+{
+    if (stats_enabled) {
+        charge();
+        fold_job();
+        report("total", String(), String(), total_phases, total_counters, errh);
+    }
+}
+
+void
+stats_begin_worker()
+{
+    // a forked worker has its own CPU clock and reports only its own jobs
+    if (stats_enabled) {
+        memset(job_phases, 0, sizeof(job_phases));
+        memset(total_phases, 0, sizeof(total_phases));
+        memset(stats_counters, 0, sizeof(stats_counters));
+        memset(total_counters, 0, sizeof(total_counters));
+        long maxrss_kb;
+        sample(last_wall, last_cpu, maxrss_kb);
+    }
+}
+
+String
+stats_unparse_total()
+{
+    StringAccum sa;
+    if (stats_enabled) {
+        charge();
+        fold_job();
+        for (int i = 0; i < PH_COUNT; ++i) {
+            const PhaseStats &p = total_phases[i];
+            sa.snprintf(100, "%.9g %.9g %ld %d ", p.wall, p.cpu, p.maxrss_kb, p.count);
+        }
+        for (int i = 0; i < SC_COUNT; ++i)
+            sa << total_counters[i] << ' ';
+    }
+    return sa.take_string();
+}
+
+bool
+stats_merge_total(const String &str)
+{
+    PhaseStats phases[PH_COUNT];
+    long counters[SC_COUNT];
+    const char *s = str.c_str();
+    int n;
+    for (int i = 0; i < PH_COUNT; ++i, s += n) {
+        PhaseStats &p = phases[i];
+        if (sscanf(s, "%lf %lf %ld %d %n", &p.wall, &p.cpu, &p.maxrss_kb, &p.count, &n) != 4)
+            return false;
+    }
+    for (int i = 0; i < SC_COUNT; ++i, s += n)
+        if (sscanf(s, "%ld %n", &counters[i], &n) != 1)
+            return false;
+
+    double cpu = 0;
+    for (int i = 0; i < PH_COUNT; ++i) {
+        PhaseStats &t = total_phases[i], &p = phases[i];
+        t.wall += p.wall;
+        t.cpu += p.cpu;
+        if (p.maxrss_kb > t.maxrss_kb)
+            t.maxrss_kb = p.maxrss_kb;
+        t.count += p.count;
+        cpu += p.cpu;
+    }
+    for (int i = 0; i < SC_COUNT; ++i)
+        total_counters[i] += counters[i];
+    // This process's CPU time already includes the reaped worker's, which
+    // would otherwise be charged again to the current phase.
+    last_cpu += cpu;
+    return true;
+}
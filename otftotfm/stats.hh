@@ -0,0 +1,71 @@
+#ifndef OTFTOTFM_STATS_HH
+#define OTFTOTFM_STATS_HH
+#include <lcdf/string.hh>
+class ErrorHandler;
+
+// Per-phase instrumentation for --timings and --stats. Each phase collects
+// wall time, CPU time (including waited-for child processes), and the peak
+// resident set size seen while it ran. Time spent in a nested phase is
+// charged to that phase only, and time outside any phase to PH_OTHER.
+
+enum StatsPhase {
+    PH_OTHER = 0, PH_FONT_PARSE, PH_FONT_INFO, PH_MAKE_METRICS, PH_GSUB,
+    PH_SHRINK_ENCODING, PH_GPOS, PH_ENCODING_OUTPUT, PH_METRICS_OUTPUT,
+    PH_SUBPROCESS, PH_MAP_UPDATE, PH_COUNT
+};
+
+enum StatsCounter {
+    SC_LOOKUPS = 0, SC_SUBSTITUTIONS, SC_POSITIONINGS, SC_COUNT
+};
+
+extern bool stats_enabled;
+
+void stats_configure(bool timings, const String &json_file);
+void stats_begin_job();
+void stats_report_job(const String &input_file, const String &font_name, ErrorHandler *);
+void stats_report_total(ErrorHandler *);
+
+// A parallel batch worker starts fresh statistics, and returns its totals
+// to the parent process, which adds them to its own.
+void stats_begin_worker();
+String stats_unparse_total();
+bool stats_merge_total(const String &);
+
+void stats_switch(int &phase);
+
+class StatsTimer { public:
+
+    StatsTimer(int phase)               : _phase(phase), _running(false) {
+        if (stats_enabled) {
+            stats_switch(_phase);
+            _running = true;
+        }
+    }
+    ~StatsTimer()                       { end(); }
+
+    void end() {
+        if (_running) {
+            stats_switch(_phase);
+            _running = false;
+        }
+    }
+
+  private:
+
+    int _phase;
+    bool _running;
+
+    StatsTimer(const StatsTimer &);
+    StatsTimer &operator=(const StatsTimer &);
+
+};
+
+extern long stats_counters[SC_COUNT];
+
+inline void
+stats_count(int counter, int n)
+{
+    stats_counters[counter] += n;
+}
+
+#endif
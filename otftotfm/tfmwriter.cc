@@ -0,0 +1,582 @@
+/* tfmwriter.{cc,hh} -- write binary TeX font metrics and virtual fonts
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "tfmwriter.hh"
+#include <lcdf/error.hh>
+#include <lcdf/hashmap.hh>
+#include <algorithm>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNITY           0x100000        /* 1.0 as a fix_word */
+
+// DVI and VF opcodes
+enum { SET1 = 128, SET_RULE = 132, PUSH = 141, POP = 142, RIGHT1 = 143,
+       DOWN1 = 157, FNT_NUM_0 = 171, FNT1 = 235, XXX1 = 239, XXX4 = 242,
+       FNT_DEF1 = 243, PRE = 247, POST = 248, VF_ID = 202, LONG_CHAR = 242 };
+
+// lig/kern instruction flags
+enum { STOP_FLAG = 128, KERN_FLAG = 128 };
+
+TfmWriter::TfmWriter(ErrorHandler *errh)
+    : _errh(errh), _design_size(10 * UNITY), _design_units(UNITY),
+      _nparams(0), _bchar(-1), _cur(-1), _kern_map(-1), _prepared(false)
+{
+    for (int i = 0; i <= NPARAMS; ++i)
+        _params[i] = 0;
+}
+
+int
+TfmWriter::scan_fix(const String &real, bool scaled)
+{
+    // pltotf's algorithm: at most 7 fraction digits are significant, and
+    // the integer part must be less than 2048
+    String text = real;
+    if (text.find_left('e') >= 0 || text.find_left('E') >= 0) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.7f", strtod(real.c_str(), 0));
+        text = String(buf);
+    }
+
+    const char *s = text.begin(), *end = text.end();
+    bool negative = false;
+    for (; s != end && (*s == '+' || *s == '-'); ++s)
+        if (*s == '-')
+            negative = !negative;
+
+    int acc = 0;
+    for (; s != end && isdigit((unsigned char) *s); ++s) {
+        acc = acc * 10 + *s - '0';
+        if (acc >= 2048) {
+            _errh->error("real constant %<%s%> must be less than 2048", real.c_str());
+            return 0;
+        }
+    }
+
+    int digits[7], ndigits = 0;
+    if (s != end && *s == '.')
+        for (++s; s != end && isdigit((unsigned char) *s); ++s)
+            if (ndigits < 7)
+                digits[ndigits++] = *s - '0';
+    int f = 0;
+    while (ndigits > 0)
+        f = digits[--ndigits] * 0x200000 + f / 10;
+    f = (f + 10) / 20;
+
+    int64_t value = (int64_t) acc * UNITY + f;
+    if (scaled && _design_units != UNITY) {
+        int64_t num = 2 * value * UNITY;
+        value = (num + _design_units) / (2 * (int64_t) _design_units);
+    }
+    if (scaled && value >= 16 * UNITY) {
+        _errh->error("value %<%s%> too large for a TFM file", real.c_str());
+        return 0;
+    }
+    return (int) (negative ? -value : value);
+}
+
+void
+TfmWriter::set_design_size(const String &real)
+{
+    _design_size = scan_fix(real, false);
+    if (_design_size < UNITY) {
+        _errh->error("design size %<%s%> must be at least 1", real.c_str());
+        _design_size = 10 * UNITY;
+    }
+}
+
+void
+TfmWriter::set_design_units(const String &real)
+{
+    _design_units = scan_fix(real, false);
+    if (_design_units <= 0) {
+        _errh->error("design units %<%s%> must be positive", real.c_str());
+        _design_units = UNITY;
+    }
+}
+
+void
+TfmWriter::set_param(int param, const String &real)
+{
+    assert(param >= 1 && param <= NPARAMS);
+    _params[param] = scan_fix(real, param != P_SLANT);
+    _nparams = std::max(_nparams, param);
+}
+
+void
+TfmWriter::add_mapped_font(int number, const String &name, const String &dsize)
+{
+    MappedFont mf;
+    mf.number = number;
+    mf.name = name;
+    mf.dsize = scan_fix(dsize, false);
+    _fonts.push_back(mf);
+}
+
+
+// LIGATURE/KERN PROGRAMS
+
+void
+TfmWriter::begin_ligkern(int c)
+{
+    assert(c >= 0 && c <= BOUNDARY && _chars[c].label < 0);
+    _chars[c].label = _ligkern.size();
+    _prepared = false;
+}
+
+void
+TfmWriter::add_lig(int op, int c2, int out)
+{
+    _ligkern.push_back(LigKern(0, c2, op, out));
+}
+
+void
+TfmWriter::add_kern(int c2, const String &real)
+{
+    // share identical kern amounts, as pltotf does
+    int amount = scan_fix(real, true);
+    int &k = _kern_map.find_force((uint32_t) amount ^ 0x80000000U, -1);
+    if (k < 0) {
+        k = _kerns.size();
+        _kerns.push_back(amount);
+    }
+    _ligkern.push_back(LigKern(0, c2, KERN_FLAG + (k >> 8), k & 0xFF));
+}
+
+void
+TfmWriter::end_ligkern()
+{
+    assert(_ligkern.size());
+    _ligkern.back().skip = STOP_FLAG;
+}
+
+
+// CHARACTERS
+
+void
+TfmWriter::begin_char(int c)
+{
+    assert(c >= 0 && c < 256 && _cur < 0);
+    _cur = c;
+    _chars[c].exists = true;
+    for (int i = 0; i < NDIMEN; ++i)
+        _chars[c].dimen[i] = 0;
+    _map.clear();
+    _prepared = false;
+}
+
+void
+TfmWriter::set_dimen(int which, const String &real)
+{
+    assert(_cur >= 0 && which >= 0 && which < NDIMEN);
+    _chars[_cur].dimen[which] = scan_fix(real, true);
+}
+
+void
+TfmWriter::add_setchar(int c)
+{
+    if (c >= 128)
+        _map << (char) SET1;
+    _map << (char) c;
+}
+
+static void
+append_int(StringAccum &sa, int x, int nbytes)
+{
+    for (int i = nbytes - 1; i >= 0; --i)
+        sa << (char) ((uint32_t) x >> (8 * i));
+}
+
+void
+TfmWriter::add_dvi_move(int op, int amount)
+{
+    int nbytes;
+    if (amount >= -0x80 && amount < 0x80)
+        nbytes = 1;
+    else if (amount >= -0x8000 && amount < 0x8000)
+        nbytes = 2;
+    else if (amount >= -0x800000 && amount < 0x800000)
+        nbytes = 3;
+    else
+        nbytes = 4;
+    _map << (char) (op + nbytes - 1);
+    append_int(_map, amount, nbytes);
+}
+
+void
+TfmWriter::add_move(const String &right, const String &up)
+{
+    if (right)
+        add_dvi_move(RIGHT1, scan_fix(right, true));
+    if (up)
+        add_dvi_move(DOWN1, -scan_fix(up, true));
+}
+
+void
+TfmWriter::add_rule(const String &height, const String &width)
+{
+    _map << (char) SET_RULE;
+    append_int(_map, scan_fix(height, true), 4);
+    append_int(_map, scan_fix(width, true), 4);
+}
+
+void
+TfmWriter::add_selectfont(int font)
+{
+    if (font < 64)
+        _map << (char) (FNT_NUM_0 + font);
+    else {
+        _map << (char) FNT1;
+        append_int(_map, font, 1);
+    }
+}
+
+void
+TfmWriter::add_push()
+{
+    _map << (char) PUSH;
+}
+
+void
+TfmWriter::add_pop()
+{
+    _map << (char) POP;
+}
+
+void
+TfmWriter::add_special(const String &s)
+{
+    if (s.length() < 256) {
+        _map << (char) XXX1;
+        append_int(_map, s.length(), 1);
+    } else {
+        _map << (char) XXX4;
+        append_int(_map, s.length(), 4);
+    }
+    _map << s;
+}
+
+void
+TfmWriter::end_char(bool use_map)
+{
+    assert(_cur >= 0);
+    if (!use_map) {
+        // vptovf's default packet sets the character from the first font
+        _map.clear();
+        add_setchar(_cur);
+    }
+    _chars[_cur].map = _map.take_string();
+    _cur = -1;
+}
+
+
+// DIMENSION TABLES
+
+namespace {
+struct DimenCover {
+    const Vector<int> &v;
+    int next_d;
+    DimenCover(const Vector<int> &v_) : v(v_) { }
+    int min_cover(int d);
+};
+
+// Return the minimum number of intervals of length d that cover v, and set
+// next_d to the smallest length that would produce fewer intervals.
+int
+DimenCover::min_cover(int d)
+{
+    int m = 0;
+    next_d = 0x7FFFFFFF;
+    for (int p = 0; p < v.size(); ) {
+        ++m;
+        int l = v[p];
+        while (p + 1 < v.size() && v[p + 1] <= l + d)
+            ++p;
+        ++p;
+        if (p < v.size() && v[p] - l < next_d)
+            next_d = v[p] - l;
+    }
+    return m;
+}
+}
+
+void
+TfmWriter::index_dimens(int which, int max_size)
+{
+    // collect sorted distinct values; 0 has its own index except for widths
+    Vector<int> v;
+    for (int c = 0; c < 256; ++c)
+        if (_chars[c].exists && (which == D_WD || _chars[c].dimen[which]))
+            v.push_back(_chars[c].dimen[which]);
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+
+    // too many values: find the smallest d so that intervals of length d
+    // cover the values in max_size - 1 groups, exactly like pltotf
+    int d = 0, excess = v.size() - (max_size - 1);
+    if (excess > 0) {
+        DimenCover cover(v);
+        int k = cover.min_cover(0);
+        d = cover.next_d;
+        do {
+            d += d;
+            k = cover.min_cover(d);
+        } while (k > max_size - 1);
+        d /= 2;
+        k = cover.min_cover(d);
+        while (k > max_size - 1) {
+            d = cover.next_d;
+            k = cover.min_cover(d);
+        }
+        static const char * const names[] = { "widths", "heights", "depths", "italic corrections" };
+        _errh->warning("had to round some %s by %.7f units", names[which],
+                       (d / 2.) * _design_units / ((double) UNITY * UNITY));
+    }
+
+    // assign indexes and replace each group by its midpoint
+    Vector<int> index(v.size(), 0);
+    Vector<int> &dimens = _dimens[which];
+    dimens.assign(1, 0);
+    for (int p = 0; p < v.size(); ) {
+        int l = v[p];
+        index[p] = dimens.size();
+        while (p + 1 < v.size() && v[p + 1] <= l + d) {
+            ++p;
+            index[p] = dimens.size();
+            if (--excess == 0)
+                d = 0;
+        }
+        dimens.push_back(l + (v[p] - l) / 2);
+        ++p;
+    }
+
+    for (int c = 0; c < 256; ++c)
+        if (_chars[c].exists) {
+            int x = _chars[c].dimen[which];
+            if (which != D_WD && x == 0)
+                _chars[c].index[which] = 0;
+            else
+                _chars[c].index[which] = index[std::lower_bound(v.begin(), v.end(), x) - v.begin()];
+        }
+}
+
+bool
+TfmWriter::prepare()
+{
+    if (_prepared)
+        return true;
+    int before_nerrors = _errh->nerrors();
+
+    for (_bc = 0; _bc < 256 && !_chars[_bc].exists; ++_bc)
+        /* nada */;
+    for (_ec = 255; _ec >= 0 && !_chars[_ec].exists; --_ec)
+        /* nada */;
+    if (_bc > _ec)
+        _bc = 1, _ec = 0;
+
+    index_dimens(D_WD, 256);
+    index_dimens(D_HT, 16);
+    index_dimens(D_DP, 16);
+    index_dimens(D_IC, 64);
+
+    // Labels above 255 can't be stored in a char_info remainder, so they
+    // need indirect instructions at the start of the lig/kern program.
+    // The first instruction may also name the boundary character.
+    int base = (_bchar >= 0 && _bchar < 256 ? 1 : 0);
+    int nindirect = 0;
+    while (1) {
+        int n = 0;
+        for (int c = 0; c < 256; ++c)
+            if (_chars[c].label >= 0 && _chars[c].label + base + nindirect > 255)
+                ++n;
+        if (n == nindirect)
+            break;
+        nindirect = n;
+    }
+    int offset = base + nindirect;
+    if (offset > 256)
+        _errh->error("too many ligature/kern programs");
+
+    _ligkern_out.clear();
+    if (base)
+        _ligkern_out.push_back(LigKern(255, _bchar, 0, 0));
+    for (int c = 0; c < 256; ++c)
+        if (_chars[c].label < 0)
+            _chars[c].remainder = 0;
+        else if (_chars[c].label + offset <= 255)
+            _chars[c].remainder = _chars[c].label + offset;
+        else {
+            int addr = _chars[c].label + offset;
+            _chars[c].remainder = _ligkern_out.size();
+            _ligkern_out.push_back(LigKern(STOP_FLAG + 1, 0, addr >> 8, addr & 0xFF));
+        }
+    for (LigKern *lk = _ligkern.begin(); lk != _ligkern.end(); ++lk)
+        _ligkern_out.push_back(*lk);
+    if (_chars[BOUNDARY].label >= 0) {
+        int addr = _chars[BOUNDARY].label + offset;
+        _ligkern_out.push_back(LigKern(255, 0, addr >> 8, addr & 0xFF));
+    }
+    if (_ligkern_out.size() > 32767)
+        _errh->error("ligature/kern program too long");
+    if (_kerns.size() > 32768)
+        _errh->error("too many distinct kerns");
+
+    // pltotf's checksum
+    uint32_t c0 = _bc, c1 = _ec, c2 = _bc, c3 = _ec;
+    for (int c = _bc; c <= _ec; ++c)
+        if (_chars[c].exists) {
+            int64_t w = _dimens[D_WD][_chars[c].index[D_WD]] + (int64_t) (c + 4) * 0x400000;
+            c0 = (c0 + c0 + w) % 255;
+            c1 = (c1 + c1 + w) % 253;
+            c2 = (c2 + c2 + w) % 251;
+            c3 = (c3 + c3 + w) % 247;
+        }
+    _checksum = (c0 << 24) | (c1 << 16) | (c2 << 8) | c3;
+
+    _prepared = (_errh->nerrors() == before_nerrors);
+    return _prepared;
+}
+
+
+// OUTPUT
+
+bool
+TfmWriter::write_file(const String &filename, const StringAccum &sa)
+{
+    FILE *f = fopen(filename.c_str(), "wb");
+    if (!f) {
+        _errh->error("%s: %s", filename.c_str(), strerror(errno));
+        return false;
+    }
+    size_t amt = fwrite(sa.data(), 1, sa.length(), f);
+    if (fclose(f) != 0 || amt != (size_t) sa.length()) {
+        _errh->error("%s: %s", filename.c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static void
+append_bcpl(StringAccum &sa, const String &s, int size)
+{
+    // pltotf stores BCPL strings in upper case
+    int len = std::min(s.length(), size - 1);
+    sa << (char) len;
+    for (int i = 0; i < len; ++i)
+        sa << (char) toupper((unsigned char) s[i]);
+    for (int i = len + 1; i < size; ++i)
+        sa << '\0';
+}
+
+bool
+TfmWriter::write_tfm(const String &filename)
+{
+    if (!prepare())
+        return false;
+
+    const int lh = 18;
+    int nw = _dimens[D_WD].size(), nh = _dimens[D_HT].size(),
+        nd = _dimens[D_DP].size(), ni = _dimens[D_IC].size(),
+        nl = _ligkern_out.size(), nk = _kerns.size(), np = _nparams;
+    int lf = 6 + lh + (_ec - _bc + 1) + nw + nh + nd + ni + nl + nk + np;
+
+    StringAccum sa(lf * 4);
+    int sizes[] = { lf, lh, _bc, _ec, nw, nh, nd, ni, nl, nk, 0, np };
+    for (int i = 0; i < 12; ++i)
+        append_int(sa, sizes[i], 2);
+
+    // header
+    append_int(sa, _checksum, 4);
+    append_int(sa, _design_size, 4);
+    append_bcpl(sa, _coding_scheme, 40);
+    append_bcpl(sa, _family, 20);
+    append_int(sa, 0, 4);
+
+    // char_info
+    for (int c = _bc; c <= _ec; ++c)
+        if (_chars[c].exists) {
+            const Char &ch = _chars[c];
+            sa << (char) ch.index[D_WD]
+               << (char) ((ch.index[D_HT] << 4) | ch.index[D_DP])
+               << (char) ((ch.index[D_IC] << 2) | (ch.label >= 0 ? 1 : 0))
+               << (char) ch.remainder;
+        } else
+            append_int(sa, 0, 4);
+
+    // dimensions
+    for (int which = 0; which < NDIMEN; ++which)
+        for (int *d = _dimens[which].begin(); d != _dimens[which].end(); ++d)
+            append_int(sa, *d, 4);
+
+    // lig/kern program and kerns
+    for (LigKern *lk = _ligkern_out.begin(); lk != _ligkern_out.end(); ++lk)
+        sa << (char) lk->skip << (char) lk->next << (char) lk->op << (char) lk->rem;
+    for (int *k = _kerns.begin(); k != _kerns.end(); ++k)
+        append_int(sa, *k, 4);
+
+    // parameters
+    for (int i = 1; i <= np; ++i)
+        append_int(sa, _params[i], 4);
+
+    assert(sa.length() == lf * 4);
+    return write_file(filename, sa);
+}
+
+bool
+TfmWriter::write_vf(const String &filename)
+{
+    if (!prepare())
+        return false;
+
+    StringAccum sa;
+    sa << (char) PRE << (char) VF_ID << (char) 0;
+    append_int(sa, _checksum, 4);
+    append_int(sa, _design_size, 4);
+
+    for (MappedFont *mf = _fonts.begin(); mf != _fonts.end(); ++mf) {
+        sa << (char) FNT_DEF1;
+        append_int(sa, mf->number, 1);
+        append_int(sa, 0, 4);       // checksum unknown
+        append_int(sa, UNITY, 4);   // at size 1.0
+        append_int(sa, mf->dsize, 4);
+        sa << (char) 0 << (char) mf->name.length() << mf->name;
+    }
+
+    for (int c = _bc; c <= _ec; ++c)
+        if (_chars[c].exists) {
+            const String &map = _chars[c].map;
+            int width = _dimens[D_WD][_chars[c].index[D_WD]];
+            if (map.length() < LONG_CHAR && width >= 0 && width < 0x1000000) {
+                append_int(sa, map.length(), 1);
+                append_int(sa, c, 1);
+                append_int(sa, width, 3);
+            } else {
+                sa << (char) LONG_CHAR;
+                append_int(sa, map.length(), 4);
+                append_int(sa, c, 4);
+                append_int(sa, width, 4);
+            }
+            sa << map;
+        }
+
+    do {
+        sa << (char) POST;
+    } while (sa.length() % 4 != 0);
+    return write_file(filename, sa);
+}
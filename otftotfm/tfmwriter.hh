@@ -0,0 +1,113 @@
+#ifndef OTFTOTFM_TFMWRITER_HH
+#define OTFTOTFM_TFMWRITER_HH
+#include <lcdf/string.hh>
+#include <lcdf/vector.hh>
+#include <lcdf/straccum.hh>
+#include <lcdf/hashmap.hh>
+class ErrorHandler;
+
+// TfmWriter accepts the information otftotfm would write to a PL or VPL
+// file and serializes it directly as binary TFM and VF, the way pltotf and
+// vptovf would. Real values are passed as the text that would appear in the
+// property list, so they are rounded exactly as pltotf rounds them.
+
+class TfmWriter { public:
+
+    TfmWriter(ErrorHandler *);
+
+    void set_error_handler(ErrorHandler *errh)  { _errh = errh; }
+
+    enum { P_SLANT = 1, P_SPACE, P_STRETCH, P_SHRINK, P_XHEIGHT, P_QUAD,
+           P_EXTRASPACE, NPARAMS = P_EXTRASPACE };
+    enum { D_WD = 0, D_HT, D_DP, D_IC, NDIMEN };
+    enum { BOUNDARY = 256 };
+
+    void set_family(const String &s)            { _family = s; }
+    void set_coding_scheme(const String &s)     { _coding_scheme = s; }
+    void set_design_size(const String &real);
+    void set_design_units(const String &real);
+    void set_param(int param, const String &real);
+    void set_boundary_char(int c)               { _bchar = c; }
+
+    void add_mapped_font(int number, const String &name, const String &dsize);
+
+    void begin_ligkern(int c);
+    void add_lig(int op, int c2, int out);
+    void add_kern(int c2, const String &real);
+    void end_ligkern();
+
+    void begin_char(int c);
+    void set_dimen(int which, const String &real);
+    void add_setchar(int c);
+    void add_move(const String &right, const String &up);
+    void add_rule(const String &height, const String &width);
+    void add_selectfont(int font);
+    void add_push();
+    void add_pop();
+    void add_special(const String &s);
+    void end_char(bool use_map);
+
+    bool write_tfm(const String &filename);
+    bool write_vf(const String &filename);
+
+  private:
+
+    struct Char {
+        bool exists;
+        int dimen[NDIMEN];
+        int index[NDIMEN];
+        int label;
+        int remainder;
+        String map;
+        Char()                          : exists(false), label(-1) { }
+    };
+
+    struct LigKern {
+        unsigned char skip;
+        unsigned char next;
+        unsigned char op;
+        unsigned char rem;
+        LigKern(int s, int n, int o, int r) : skip(s), next(n), op(o), rem(r) { }
+    };
+
+    struct MappedFont {
+        int number;
+        String name;
+        int dsize;
+    };
+
+    ErrorHandler *_errh;
+
+    String _family;
+    String _coding_scheme;
+    int _design_size;
+    int _design_units;
+    int _params[NPARAMS + 1];
+    int _nparams;
+    int _bchar;
+
+    Char _chars[257];
+    int _cur;
+    StringAccum _map;
+
+    Vector<LigKern> _ligkern;
+    Vector<int> _kerns;
+    HashMap<uint32_t, int> _kern_map;
+    Vector<MappedFont> _fonts;
+
+    bool _prepared;
+    int _bc;
+    int _ec;
+    Vector<int> _dimens[NDIMEN];
+    Vector<LigKern> _ligkern_out;
+    uint32_t _checksum;
+
+    int scan_fix(const String &real, bool scaled);
+    void add_dvi_move(int op, int amount);
+    void index_dimens(int which, int max_size);
+    bool prepare();
+    bool write_file(const String &filename, const StringAccum &);
+
+};
+
+#endif
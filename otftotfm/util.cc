@@ -15,9 +15,12 @@
 # include <config.h>
 #endif
 #include "util.hh"
+#include "stats.hh"
 #include <lcdf/error.hh>
 #include <lcdf/straccum.hh>
 #include <lcdf/vector.hh>
+#include <lcdf/md5.h>
+#include <lcdf/mapfile.hh>
 #include <ctype.h>
 #include <stdio.h>
 #include <errno.h>
@@ -48,6 +51,13 @@ read_file(String filename, ErrorHandler *errh, bool warning)
         return String();
     }
 
+    // map large files, such as fonts, rather than copying them
+    if (f != stdin)
+        if (String s = map_file(f, 65536)) {
+            fclose(f);
+            return s;
+        }
+
     StringAccum sa;
     int amt;
     do {
@@ -158,6 +168,7 @@ mysystem(const char *command, ErrorHandler *errh)
     } else {
         if (verbose)
             errh->message("running %s", command);
+        StatsTimer t(PH_SUBPROCESS);
         return system(command);
     }
 }
@@ -297,3 +308,21 @@ shell_command_output(String cmdline, const String &input, ErrorHandler *errh, bo
     return sa.take_string();
 }
 #endif
+
+String
+string_digest(const String &s)
+{
+    MD5_CONTEXT md5;
+    md5_init(&md5);
+    md5_update(&md5, (const unsigned char *) s.data(), s.length());
+    char text_digest[MD5_TEXT_DIGEST_SIZE + 1];
+    md5_final_text(text_digest, &md5);
+    return String(text_digest);
+}
+
+String
+RecordingErrorHandler::decorate(const String &str)
+{
+    _messages->push_back(str);
+    return String();
+}
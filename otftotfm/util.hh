@@ -2,8 +2,9 @@
 #define OTFTOTFM_UTIL_HH
 #include <lcdf/string.hh>
 #include <lcdf/globmatch.hh>
+#include <lcdf/error.hh>
+#include <lcdf/vector.hh>
 #include <stdio.h>
-class ErrorHandler;
 
 extern bool no_create;
 extern bool verbose;
@@ -24,6 +25,17 @@ int temporary_file(String &, ErrorHandler *);
 int mysystem(const char *command, ErrorHandler *);
 FILE* mypopen(const char* command, const char* type, ErrorHandler* errh);
 bool parse_unicode_number(const char*, const char*, int require_prefix, uint32_t& result);
+String string_digest(const String &);
+
+// Records messages instead of printing them. Report them later with
+// ErrorHandler::xmessage().
+class RecordingErrorHandler : public ErrorHandler { public:
+    RecordingErrorHandler(Vector<String> *m = 0) : _messages(m) { }
+    void set_messages(Vector<String> *m) { _messages = m; }
+    String decorate(const String &str);
+  private:
+    Vector<String> *_messages;
+};
 
 #ifdef WIN32
 #define WEXITSTATUS(es) (es)
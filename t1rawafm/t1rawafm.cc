@@ -179,10 +179,10 @@ strip_newlines(const String &str)
 }
 
 static void
-write_char(FILE *outf, int c, PermString n, Type1Charstring *g, const Transform &font_transform, Type1Font *font)
+write_char(FILE *outf, int c, PermString n, int gi, CharstringBoundsTable &bounds)
 {
     double bb[4], wx;
-    CharstringBounds::bounds(font_transform, CharstringContext(font, g), bb, wx);
+    bounds.bounds(gi, bb, wx);
     fprintf(outf, "C %d ; WX %d ; N %s ; B %d %d %d %d ;\n",
             c, (int) ceil(wx), n.c_str(),
             (int) floor(bb[0]), (int) floor(bb[1]),
@@ -215,24 +215,33 @@ Comment Generated by t1rawafm\n");
         font_transform.scale(1000);
     }
 
+    // Every glyph's bounds are needed for FontBBox and again for its
+    // metrics line, so compute them once.
+    CharstringBoundsTable bounds(font, font_transform);
+    bounds.compute_all();
+    HashMap<PermString, int> glyph_index(-1);
+    for (int i = 0; i < font->nglyphs(); ++i)
+        glyph_index.insert(font->glyph_name(i), i);
+
     double bb[4], wx;
-    if (Type1Charstring *t1cs = font->glyph("H")) {
-        CharstringBounds::bounds(font_transform, CharstringContext(font, t1cs), bb, wx);
+    int gi;
+    if ((gi = glyph_index["H"]) >= 0) {
+        bounds.bounds(gi, bb, wx);
         if (bb[3])
             fprintf(outf, "CapHeight %d\n", (int) ceil(bb[3]));
     }
-    if (Type1Charstring *t1cs = font->glyph("x")) {
-        CharstringBounds::bounds(font_transform, CharstringContext(font, t1cs), bb, wx);
+    if ((gi = glyph_index["x"]) >= 0) {
+        bounds.bounds(gi, bb, wx);
         if (bb[3])
             fprintf(outf, "XHeight %d\n", (int) ceil(bb[3]));
     }
-    if (Type1Charstring *t1cs = font->glyph("d")) {
-        CharstringBounds::bounds(font_transform, CharstringContext(font, t1cs), bb, wx);
+    if ((gi = glyph_index["d"]) >= 0) {
+        bounds.bounds(gi, bb, wx);
         if (bb[3])
             fprintf(outf, "Ascender %d\n", (int) ceil(bb[3]));
     }
-    if (Type1Charstring *t1cs = font->glyph("p")) {
-        CharstringBounds::bounds(font_transform, CharstringContext(font, t1cs), bb, wx);
+    if ((gi = glyph_index["p"]) >= 0) {
+        bounds.bounds(gi, bb, wx);
         if (bb[1])
             fprintf(outf, "Descender %d\n", (int) floor(bb[1]));
     }
@@ -247,7 +256,7 @@ Comment Generated by t1rawafm\n");
 
     double fontbb[4] = { 1000000, 1000000, -1000000, -1000000 };
     for (int i = 0; i < font->nglyphs(); ++i) {
-        CharstringBounds::bounds(font_transform, CharstringContext(font, font->glyph(i)), bb, wx);
+        bounds.bounds(i, bb, wx);
         fontbb[0] = std::min(fontbb[0], bb[0]);
         fontbb[1] = std::min(fontbb[1], bb[1]);
         fontbb[2] = std::max(fontbb[2], bb[2]);
@@ -271,17 +280,16 @@ Comment Generated by t1rawafm\n");
     if (Type1Encoding *enc = font->type1_encoding()) {
         for (int i = 0; i < 256; ++i) {
             PermString n = enc->elt(i);
-            if (!done_yet[n])
-                if (Type1Charstring *g = font->glyph(n)) {
-                    write_char(outf, i, n, g, font_transform, font);
-                    done_yet.insert(n, true);
-                }
+            if (!done_yet[n] && (gi = glyph_index[n]) >= 0) {
+                write_char(outf, i, n, gi, bounds);
+                done_yet.insert(n, true);
+            }
         }
     }
     for (int i = 0; i < font->nglyphs(); ++i) {
         PermString n = font->glyph_name(i);
         if (!done_yet[n])
-            write_char(outf, -1, n, font->glyph(i), font_transform, font);
+            write_char(outf, -1, n, i, bounds);
     }
     fprintf(outf, "EndCharMetrics\n");
 
@@ -0,0 +1,147 @@
+/* benchbezierbounds.cc -- time exact Bezier bounds against subdivision
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// Bound the same curves three ways: by the recursive subdivision
+// CharstringBounds used before, by Bezier::exact_bb one curve at a time,
+// and by Bezier::exact_extents over arrays of coordinates. The curves are
+// random cubics, then every curve of every glyph in each font. Font curves
+// are mostly small and monotone, which favors subdivision; random curves
+// are large and often turn.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include "subdivisionbox.hh"
+#include <efont/t1interp.hh>
+#include <lcdf/error.hh>
+#include <stdio.h>
+#include <math.h>
+using namespace Efont;
+
+enum { MIN_CURVES = 2000000, NRANDOM = 50000 };
+
+static uint32_t rng_state = 88675123U;
+
+static uint32_t
+rng()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static double
+random_coord()
+{
+    return (int) (rng() % 4001) - 2000 + (rng() % 64) / 64.;
+}
+
+// Each method sums its boxes' widths and heights, so the compiler can't
+// skip the work and the methods can be compared.
+static void
+bench_curves(const String &what, const Vector<Bezier> &curves, ErrorHandler *errh)
+{
+    int n = curves.size();
+    if (!n)
+        return;
+    int rounds = (MIN_CURVES + n - 1) / n;
+
+    double subdivision_sum = 0;
+    double t0 = test_now();
+    for (int r = 0; r < rounds; r++)
+        for (const Bezier *b = curves.begin(); b != curves.end(); ++b) {
+            SubdivisionBox sub(*b);
+            subdivision_sum += sub.top_right().x - sub.bottom_left().x
+                + sub.top_right().y - sub.bottom_left().y;
+        }
+    double subdivision_time = test_now() - t0;
+
+    double exact_bb_sum = 0;
+    t0 = test_now();
+    for (int r = 0; r < rounds; r++)
+        for (const Bezier *b = curves.begin(); b != curves.end(); ++b) {
+            Point bl, tr;
+            b->exact_bb(bl, tr);
+            exact_bb_sum += tr.x - bl.x + tr.y - bl.y;
+        }
+    double exact_bb_time = test_now() - t0;
+
+    // coordinates by axis and control point, as exact_extents takes them
+    Vector<double> p[8], lo(n, 0), hi(n, 0);
+    for (int k = 0; k < 8; k++)
+        for (const Bezier *b = curves.begin(); b != curves.end(); ++b)
+            p[k].push_back(k & 1 ? b->point(k >> 1).y : b->point(k >> 1).x);
+    double exact_extents_sum = 0;
+    t0 = test_now();
+    for (int r = 0; r < rounds; r++)
+        for (int axis = 0; axis < 2; axis++) {
+            Bezier::exact_extents(n, p[axis].begin(), p[2 + axis].begin(),
+                                  p[4 + axis].begin(), p[6 + axis].begin(),
+                                  lo.begin(), hi.begin());
+            for (int i = 0; i < n; i++)
+                exact_extents_sum += hi[i] - lo[i];
+        }
+    double exact_extents_time = test_now() - t0;
+
+    double tol = 1e-6 * exact_bb_sum;
+    if (fabs(subdivision_sum - exact_bb_sum) > tol
+        || fabs(exact_extents_sum - exact_bb_sum) > tol)
+        errh->error("%s: boxes differ", what.c_str());
+
+    double ns = 1e9 / ((double) rounds * n);
+    printf("%s: %d curves, %d rounds\n", what.c_str(), n, rounds);
+    printf("  subdivision %6.1f ns/curve   exact_bb %6.1f ns/curve   exact_extents %6.1f ns/curve\n",
+           subdivision_time * ns, exact_bb_time * ns, exact_extents_time * ns);
+}
+
+namespace {
+class CurveCollector : public CharstringInterp { public:
+    Vector<Bezier> curves;
+    void act_curve(int, const Point &p0, const Point &p1, const Point &p2, const Point &p3) {
+        curves.push_back(Bezier(p0, p1, p2, p3));
+    }
+};
+}
+
+int
+main(int argc, char **argv)
+{
+    ErrorHandler *errh = test_initialize("benchbezierbounds");
+
+    Vector<Bezier> random;
+    for (int i = 0; i < NRANDOM; i++) {
+        Point p[4];
+        for (int k = 0; k < 4; k++)
+            p[k] = Point(random_coord(), random_coord());
+        random.push_back(Bezier(p));
+    }
+    bench_curves("random", random, errh);
+
+    Vector<String> filenames = test_font_filenames(argc, argv);
+    for (String *fn = filenames.begin(); fn != filenames.end(); ++fn) {
+        TestFont font(*fn, errh);
+        if (!font.ok())
+            continue;
+        CurveCollector cc;
+        for (int gi = 0; gi < font.program()->nglyphs(); gi++)
+            cc.interpret(font.program()->glyph_context(gi));
+        bench_curves(font.filename(), cc.curves, errh);
+    }
+
+    return errh->nerrors() ? 1 : 0;
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
@@ -0,0 +1,192 @@
+/* benchclasskern.cc -- time otftotfm's kern lists on a 1000x1000 class kern
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// Decode a synthetic class kern in which each of 1000 glyphs has its own
+// first and second class, so every one of the million pairs kerns. Add the
+// pairs to per-glyph kern lists as Metrics::add_kern does, once with
+// otftotfm's PairList and once with the linear search Metrics used before.
+// Then change each pair's second glyph and look it up again, as
+// re-encoding does.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include "../otftotfm/pairlist.hh"
+#include <efont/otfgpos.hh>
+#include <lcdf/error.hh>
+#include <lcdf/straccum.hh>
+#include <stdio.h>
+using namespace Efont;
+using namespace Efont::OpenType;
+
+enum { NGLYPHS = 1000, CLASSES_PER_SUBTABLE = 25 };
+
+namespace {
+struct Kern {
+    int in2;
+    int kern;
+    Kern(int in2_, int kern_)           : in2(in2_), kern(kern_) { }
+};
+
+struct KernPair {
+    int in1;
+    int in2;
+    int kern;
+};
+
+class PairCollector : public PositioningVisitor { public:
+    bool visit(const Positioning &p) {
+        KernPair k = { p.left_glyph(), p.right_glyph(), p.left().adx };
+        pairs.push_back(k);
+        return true;
+    }
+    Vector<KernPair> pairs;
+};
+}
+
+static void
+append_u16(StringAccum &sa, int x)
+{
+    sa << (char) (x >> 8) << (char) x;
+}
+
+// A PairPos format 2 subtable for first glyphs [first, first + n), each in
+// its own first class, against every glyph in its own second class. Second
+// class 0, which holds no glyphs, has no kerns. A whole 1000x1000 class
+// matrix can't fit in one subtable's 16-bit offsets, so fonts split it
+// across subtables the same way.
+static String
+class_pair_subtable(int first, int n)
+{
+    int records = GposPair::F2_HEADERSIZE, coverage = records + n * (NGLYPHS + 1) * 2;
+    int class1 = coverage + 4 + n * 2, class2 = class1 + 6 + n * 2;
+
+    StringAccum sa;
+    append_u16(sa, 2);
+    append_u16(sa, coverage);
+    append_u16(sa, GposValue::F_XADVANCE);
+    append_u16(sa, 0);
+    append_u16(sa, class1);
+    append_u16(sa, class2);
+    append_u16(sa, n);
+    append_u16(sa, NGLYPHS + 1);
+    for (int c1 = 0; c1 < n; c1++)
+        for (int c2 = 0; c2 <= NGLYPHS; c2++)
+            append_u16(sa, c2 ? -1 - (first + c1 + c2) % 97 : 0);
+
+    append_u16(sa, 1);
+    append_u16(sa, n);
+    for (int i = 0; i < n; i++)
+        append_u16(sa, first + i);
+
+    append_u16(sa, 1);
+    append_u16(sa, first);
+    append_u16(sa, n);
+    for (int i = 0; i < n; i++)
+        append_u16(sa, i);
+
+    append_u16(sa, 1);
+    append_u16(sa, 0);
+    append_u16(sa, NGLYPHS);
+    for (int g = 0; g < NGLYPHS; g++)
+        append_u16(sa, g + 1);
+    return sa.take_string();
+}
+
+static Kern *
+linear_find(Vector<Kern> &v, int in2)
+{
+    for (Kern *k = v.begin(); k != v.end(); ++k)
+        if (k->in2 == in2)
+            return k;
+    return 0;
+}
+
+int
+main(int, char **)
+{
+    ErrorHandler *errh = test_initialize("benchclasskern");
+
+    // decode the pairs as otftotfm does, limited to encoded glyphs
+    Coverage limit(0, NGLYPHS - 1);
+    double t0 = test_now();
+    PairCollector pc;
+    for (int first = 0; first < NGLYPHS; first += CLASSES_PER_SUBTABLE) {
+        String subtable = class_pair_subtable(first, CLASSES_PER_SUBTABLE);
+        GposPair(Data(subtable)).unparse(pc, limit);
+    }
+    double decode_time = test_now() - t0;
+    const Vector<KernPair> &pairs = pc.pairs;
+
+    // add every pair
+    Vector<PairList<Kern> > lists(NGLYPHS, PairList<Kern>());
+    t0 = test_now();
+    for (const KernPair *p = pairs.begin(); p != pairs.end(); ++p)
+        if (Kern *k = lists[p->in1].find(p->in2))
+            k->kern += p->kern;
+        else
+            lists[p->in1].push_back(Kern(p->in2, p->kern));
+    double index_add_time = test_now() - t0;
+
+    Vector<Vector<Kern> > linear(NGLYPHS, Vector<Kern>());
+    t0 = test_now();
+    for (const KernPair *p = pairs.begin(); p != pairs.end(); ++p)
+        if (Kern *k = linear_find(linear[p->in1], p->in2))
+            k->kern += p->kern;
+        else
+            linear[p->in1].push_back(Kern(p->in2, p->kern));
+    double linear_add_time = test_now() - t0;
+
+    // move every pair to a new second glyph, and find it there
+    long found = 0;
+    t0 = test_now();
+    for (PairList<Kern> *l = lists.begin(); l != lists.end(); ++l)
+        for (Kern *k = l->begin(); k != l->end(); ++k) {
+            l->set_in2(k, k->in2 + NGLYPHS);
+            found += l->find(k->in2) != 0;
+        }
+    double index_edit_time = test_now() - t0;
+
+    t0 = test_now();
+    for (Vector<Kern> *l = linear.begin(); l != linear.end(); ++l)
+        for (Kern *k = l->begin(); k != l->end(); ++k) {
+            k->in2 += NGLYPHS;
+            found += linear_find(*l, k->in2) != 0;
+        }
+    double linear_edit_time = test_now() - t0;
+
+    for (int g = 0; g < NGLYPHS; g++) {
+        const PairList<Kern> &l = lists[g];
+        const Vector<Kern> &v = linear[g];
+        bool same = l.size() == v.size();
+        for (int i = 0; same && i < v.size(); i++)
+            same = l.begin()[i].in2 == v[i].in2 && l.begin()[i].kern == v[i].kern;
+        if (!same)
+            errh->error("glyph %d: PairList and linear kerns differ", g);
+    }
+    if (found != 2 * (long) pairs.size())
+        errh->error("%ld of %d edited kerns found", found, 2 * pairs.size());
+
+    printf("%d kern pairs from %d subtables: decode %.1f ms\n", pairs.size(),
+           NGLYPHS / CLASSES_PER_SUBTABLE, decode_time * 1000);
+    printf("  add:           PairList %8.1f ms   linear search %8.1f ms\n",
+           index_add_time * 1000, linear_add_time * 1000);
+    printf("  edit and find: PairList %8.1f ms   linear search %8.1f ms\n",
+           index_edit_time * 1000, linear_edit_time * 1000);
+    return errh->nerrors() ? 1 : 0;
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
+#include <lcdf/hashmap.cc>
@@ -0,0 +1,252 @@
+/* benchcompiledtables.cc -- time compiled Coverage and ClassDef tables
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// Look up the same random glyphs in every table of a set, three ways: in
+// the raw table, through CompiledTables as GposSingle and GposPair do, and
+// in the compiled table directly. The sets are synthetic tables of several
+// sizes, then every coverage and pair-class table in the GSUB and GPOS of
+// each font.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include <efont/otf.hh>
+#include <lcdf/error.hh>
+#include <lcdf/straccum.hh>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+using namespace Efont;
+using namespace Efont::OpenType;
+
+enum { NQUERIES = 4096, NSYNTHETIC = 50 };
+
+static uint32_t rng_state = 2463534242U;
+
+static uint32_t
+rng()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void
+append_u16(StringAccum &sa, int x)
+{
+    sa << (char) (x >> 8) << (char) x;
+}
+
+namespace {
+struct TableSet {
+    Vector<Coverage> coverages;
+    Vector<ClassDef> class_defs;
+    int maxglyph;
+};
+}
+
+static void
+bench_set(const String &what, const TableSet &ts, ErrorHandler *errh)
+{
+    if (!ts.coverages.size() && !ts.class_defs.size())
+        return;
+    Vector<Glyph> gs;
+    for (int i = 0; i < NQUERIES; i++)
+        gs.push_back(rng() % (ts.maxglyph + 1));
+
+    // raw tables
+    long raw_sum = 0;
+    double t0 = test_now();
+    for (const Coverage *c = ts.coverages.begin(); c != ts.coverages.end(); ++c)
+        for (const Glyph *g = gs.begin(); g != gs.end(); ++g)
+            raw_sum += c->coverage_index(*g);
+    double raw_coverage_time = test_now() - t0;
+    long raw_class_sum = 0;
+    t0 = test_now();
+    for (const ClassDef *cd = ts.class_defs.begin(); cd != ts.class_defs.end(); ++cd)
+        for (const Glyph *g = gs.begin(); g != gs.end(); ++g)
+            raw_class_sum += cd->lookup(*g);
+    double raw_class_time = test_now() - t0;
+
+    // compile every table
+    CompiledTables ct;
+    t0 = test_now();
+    for (const Coverage *c = ts.coverages.begin(); c != ts.coverages.end(); ++c)
+        (void) ct.coverage(*c);
+    for (const ClassDef *cd = ts.class_defs.begin(); cd != ts.class_defs.end(); ++cd)
+        (void) ct.class_def(*cd);
+    double compile_time = test_now() - t0;
+
+    // through CompiledTables, which finds the compiled table on each query
+    long ct_sum = 0;
+    t0 = test_now();
+    for (const Coverage *c = ts.coverages.begin(); c != ts.coverages.end(); ++c)
+        for (const Glyph *g = gs.begin(); g != gs.end(); ++g)
+            ct_sum += coverage_index(&ct, *c, *g);
+    double ct_coverage_time = test_now() - t0;
+    long ct_class_sum = 0;
+    t0 = test_now();
+    for (const ClassDef *cd = ts.class_defs.begin(); cd != ts.class_defs.end(); ++cd)
+        for (const Glyph *g = gs.begin(); g != gs.end(); ++g)
+            ct_class_sum += class_lookup(&ct, *cd, *g);
+    double ct_class_time = test_now() - t0;
+
+    // compiled tables directly
+    long compiled_sum = 0;
+    t0 = test_now();
+    for (const Coverage *c = ts.coverages.begin(); c != ts.coverages.end(); ++c) {
+        const CompiledCoverage *cc = ct.coverage(*c);
+        for (const Glyph *g = gs.begin(); g != gs.end(); ++g)
+            compiled_sum += cc->coverage_index(*g);
+    }
+    double compiled_coverage_time = test_now() - t0;
+    long compiled_class_sum = 0;
+    t0 = test_now();
+    for (const ClassDef *cd = ts.class_defs.begin(); cd != ts.class_defs.end(); ++cd) {
+        const CompiledClassDef *ccd = ct.class_def(*cd);
+        for (const Glyph *g = gs.begin(); g != gs.end(); ++g)
+            compiled_class_sum += ccd->lookup(*g);
+    }
+    double compiled_class_time = test_now() - t0;
+
+    if (ct_sum != raw_sum || compiled_sum != raw_sum
+        || ct_class_sum != raw_class_sum || compiled_class_sum != raw_class_sum)
+        errh->error("%s: compiled and raw tables differ", what.c_str());
+
+    printf("%s: %d coverage and %d class tables, %d glyphs each, compile %.1f ms\n",
+           what.c_str(), ts.coverages.size(), ts.class_defs.size(), NQUERIES,
+           compile_time * 1000);
+    printf("  coverage: raw %8.1f ms   CompiledTables %8.1f ms   compiled %8.1f ms\n",
+           raw_coverage_time * 1000, ct_coverage_time * 1000, compiled_coverage_time * 1000);
+    printf("  class:    raw %8.1f ms   CompiledTables %8.1f ms   compiled %8.1f ms\n",
+           raw_class_time * 1000, ct_class_time * 1000, compiled_class_time * 1000);
+}
+
+// NSYNTHETIC tables of each format, each covering about 'n' of 'maxglyph'
+// glyphs.
+static void
+synthetic_set(TableSet &ts, int n, int maxglyph)
+{
+    ts.maxglyph = maxglyph;
+    for (int t = 0; t < NSYNTHETIC; t++) {
+        Vector<int> gs;
+        for (int i = 0; i < n; i++)
+            gs.push_back(rng() % (maxglyph + 1));
+        std::sort(gs.begin(), gs.end());
+        gs.erase(std::unique(gs.begin(), gs.end()), gs.end());
+        StringAccum sa;
+
+        // Coverage format 1
+        append_u16(sa, 1);
+        append_u16(sa, gs.size());
+        for (int *g = gs.begin(); g != gs.end(); ++g)
+            append_u16(sa, *g);
+        ts.coverages.push_back(Coverage(sa.take_string(), 0, false));
+
+        // Coverage format 2, a range for each run of 4 glyphs
+        append_u16(sa, 2);
+        append_u16(sa, gs.size() / 4);
+        for (int i = 0, index = 0; i + 3 < gs.size(); i += 4) {
+            append_u16(sa, gs[i]);
+            append_u16(sa, gs[i + 3]);
+            append_u16(sa, index);
+            index += gs[i + 3] - gs[i] + 1;
+        }
+        ts.coverages.push_back(Coverage(sa.take_string(), 0, false));
+
+        // ClassDef format 1 over the covered span
+        int first = gs[0], count = gs.back() - gs[0] + 1;
+        append_u16(sa, 1);
+        append_u16(sa, first);
+        append_u16(sa, count);
+        for (int i = 0; i < count; i++)
+            append_u16(sa, rng() % 4 ? rng() % 20 : 0);
+        ts.class_defs.push_back(ClassDef(sa.take_string()));
+
+        // ClassDef format 2, a range for each pair of glyphs
+        append_u16(sa, 2);
+        append_u16(sa, gs.size() / 2);
+        for (int i = 0; i + 1 < gs.size(); i += 2) {
+            append_u16(sa, gs[i]);
+            append_u16(sa, gs[i + 1]);
+            append_u16(sa, rng() % 20);
+        }
+        ts.class_defs.push_back(ClassDef(sa.take_string()));
+    }
+}
+
+static void
+font_set(TableSet &ts, const TestFont &font, const char *tag)
+{
+    String str = font.otf()->table(tag);
+    if (!str)
+        return;
+    int extension_type = (strcmp(tag, "GSUB") == 0 ? 7 : 9);
+    Data lookup_list = Data(str).offset_subtable(8);
+    for (int i = 0; i < lookup_list.u16(0); i++) {
+        Data lookup = lookup_list.offset_subtable(2 + i*2);
+        int type = lookup.u16(0);
+        for (int j = 0; j < lookup.u16(4); j++)
+            try {
+                Data sub = lookup.offset_subtable(6 + j*2);
+                int sub_type = type;
+                if (type == extension_type) {
+                    sub_type = sub.u16(2);
+                    sub = sub.subtable(sub.u32(4));
+                }
+                // context format 3 has no coverage at offset 2
+                if (sub.u16(0) != 3) {
+                    Coverage c(sub.offset_subtable(2), 0, false);
+                    if (c.ok())
+                        ts.coverages.push_back(c);
+                }
+                if (strcmp(tag, "GPOS") == 0 && sub_type == 2 && sub.u16(0) == 2) {
+                    ts.class_defs.push_back(ClassDef(sub.offset_subtable(8)));
+                    ts.class_defs.push_back(ClassDef(sub.offset_subtable(10)));
+                }
+            } catch (Error) {
+            }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    ErrorHandler *errh = test_initialize("benchcompiledtables");
+
+    static const int sizes[] = { 10, 100, 1000 };
+    for (int i = 0; i < 3; i++) {
+        TableSet ts;
+        synthetic_set(ts, sizes[i], 3000);
+        bench_set("synthetic, " + String(sizes[i]) + " of 3000 glyphs", ts, errh);
+    }
+
+    Vector<String> filenames = test_font_filenames(argc, argv);
+    for (String *fn = filenames.begin(); fn != filenames.end(); ++fn) {
+        TestFont font(*fn, errh);
+        if (font.ok() && font.otf()) {
+            TableSet ts;
+            ts.maxglyph = std::max(font.program()->nglyphs() - 1, 0);
+            font_set(ts, font, "GSUB");
+            font_set(ts, font, "GPOS");
+            bench_set(font.filename(), ts, errh);
+        }
+    }
+
+    return errh->nerrors() ? 1 : 0;
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
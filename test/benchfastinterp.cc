@@ -0,0 +1,143 @@
+/* benchfastinterp.cc -- time CharstringFastInterp against CharstringInterp
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// Interpret every glyph of each font, repeatedly, with CharstringInterp
+// and with CharstringFastInterp, both summing the curves' end points.
+// Then compute every glyph's bounds with CharstringBounds, which takes the
+// fast path, and with a subclass, which CharstringBounds always sends
+// through CharstringInterp.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include <efont/t1bounds.hh>
+#include <efont/t1fastinterp.hh>
+#include <lcdf/error.hh>
+#include <stdio.h>
+using namespace Efont;
+
+enum { MIN_GLYPHS = 200000 };
+
+namespace {
+class FastSum : public CharstringFastInterp<FastSum> { public:
+    double sum;
+    FastSum()                                   : sum(0) { }
+    void act_curve(int, const Point &, const Point &, const Point &, const Point &p3) {
+        sum += p3.x + p3.y;
+    }
+};
+
+class InterpSum : public CharstringInterp { public:
+    double sum;
+    InterpSum()                                 : sum(0) { }
+    void act_line(int, const Point &, const Point &p1) {
+        sum += p1.x + p1.y;
+    }
+    void act_curve(int, const Point &, const Point &, const Point &, const Point &p3) {
+        sum += p3.x + p3.y;
+    }
+};
+
+class CarefulBounds : public CharstringBounds { public:
+    CarefulBounds(const Transform &xf)          : CharstringBounds(xf) { }
+};
+}
+
+template <typename B> static double
+bounds_sum(B &b, const CharstringProgram *program, int rounds)
+{
+    double sum = 0;
+    for (int r = 0; r < rounds; r++)
+        for (int gi = 0; gi < program->nglyphs(); gi++) {
+            double bb[4] = { 0, 0, 0, 0 }, width = 0;
+            b.clear();
+            b.char_bounds(program->glyph_context(gi), false);
+            if (b.output(bb, width, true))
+                sum += bb[0] + bb[1] + bb[2] + bb[3] + width;
+        }
+    return sum;
+}
+
+static void
+bench_font(const TestFont &font, ErrorHandler *errh)
+{
+    const CharstringProgram *program = font.program();
+    int n = program->nglyphs();
+    if (!n)
+        return;
+    int rounds = (MIN_GLYPHS + n - 1) / n;
+
+    // warm the glyph caches, and count the glyphs the fast path gives up on
+    int nfallback = 0;
+    for (int gi = 0; gi < n; gi++) {
+        FastSum fast;
+        nfallback += !fast.interpret(program->glyph_context(gi));
+    }
+
+    InterpSum interp;
+    double t0 = test_now();
+    for (int r = 0; r < rounds; r++)
+        for (int gi = 0; gi < n; gi++)
+            interp.interpret(program->glyph_context(gi));
+    double interp_time = test_now() - t0;
+
+    FastSum fast;
+    t0 = test_now();
+    for (int r = 0; r < rounds; r++)
+        for (int gi = 0; gi < n; gi++)
+            if (!fast.interpret(program->glyph_context(gi))) {
+                InterpSum slow;
+                slow.interpret(program->glyph_context(gi));
+                fast.sum += slow.sum;
+            }
+    double fast_time = test_now() - t0;
+
+    CharstringBounds b;
+    t0 = test_now();
+    double bounds = bounds_sum(b, program, rounds);
+    double bounds_time = test_now() - t0;
+
+    CarefulBounds cb((Transform()));
+    t0 = test_now();
+    double careful_bounds = bounds_sum(cb, program, rounds);
+    double careful_bounds_time = test_now() - t0;
+
+    if (fast.sum != interp.sum)
+        errh->error("%s: interpreters' curves differ", font.filename().c_str());
+    if (bounds != careful_bounds)
+        errh->error("%s: bounds differ", font.filename().c_str());
+
+    double ns = 1e9 / ((double) rounds * n);
+    printf("%s: %d glyphs, %d rounds, %d fall back\n", font.filename().c_str(), n, rounds, nfallback);
+    printf("  interpret: CharstringInterp %8.1f ns/glyph   CharstringFastInterp %8.1f ns/glyph\n",
+           interp_time * ns, fast_time * ns);
+    printf("  bounds:    careful          %8.1f ns/glyph   CharstringBounds     %8.1f ns/glyph\n",
+           careful_bounds_time * ns, bounds_time * ns);
+}
+
+int
+main(int argc, char **argv)
+{
+    ErrorHandler *errh = test_initialize("benchfastinterp");
+    Vector<String> filenames = test_font_filenames(argc, argv);
+    for (String *fn = filenames.begin(); fn != filenames.end(); ++fn) {
+        TestFont font(*fn, errh);
+        if (font.ok())
+            bench_font(font, errh);
+    }
+    return errh->nerrors() ? 1 : 0;
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
@@ -0,0 +1,134 @@
+/* benchshaper.cc -- time Shaper on English text
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// Map lines of English text to each font's glyphs and shape them for the
+// Latin script with "kern", with "liga kern", and with every Latin feature,
+// passing one line per ShapeBuffer and then a batch of lines per buffer.
+// Reports glyphs shaped per second.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include <efont/otfshaper.hh>
+#include <efont/otfcmap.hh>
+#include <lcdf/error.hh>
+#include <stdio.h>
+using namespace Efont;
+using namespace Efont::OpenType;
+
+enum { MIN_GLYPHS = 2000000, BATCH = 64 };
+
+static const char * const text[] = {
+    "The office staff flew to Sheffield for the affluent firm's final",
+    "offer, a fifty-five-page proposal of efficient workflow fixes.",
+    "AVAWAY: Typography, kerning and ligatures (fi, fl, ff, ffi, ffl)",
+    "Quick brown foxes jump over lazy dogs; 0123456789 -- \"quoted\".",
+    "Wolfgang's Tavern offered Yvonne and LaToya a fjord-view table,",
+    "while the chef's baffled waiters shuffled trays of truffles.",
+    "P.S. Very few typefaces handle 'To', 'Ty', 'Vo' and 'We' well.",
+    "Fiji's fluffy afghans: offline, ineffable, and difficult to find."
+};
+
+static void
+make_lines(const Cmap &cmap, Vector<Vector<Glyph> > &lines)
+{
+    for (int i = 0; i < (int) (sizeof(text) / sizeof(text[0])); i++) {
+        Vector<Glyph> line;
+        for (const char *s = text[i]; *s; ++s)
+            line.push_back(cmap.map_uni((unsigned char) *s));
+        lines.push_back(line);
+    }
+}
+
+// Returns glyphs shaped per second, passing 'batch' lines per buffer.
+static double
+bench_shape(Shaper &shaper, const Vector<Vector<Glyph> > &lines, int batch)
+{
+    ShapeBuffer buf;
+    long nglyphs = 0;
+    int l = 0;
+    double t0 = test_now();
+    while (nglyphs < MIN_GLYPHS) {
+        buf.clear();
+        for (int r = 0; r < batch; r++, l = (l + 1) % lines.size()) {
+            const Vector<Glyph> &line = lines[l];
+            for (int i = 0; i < line.size(); i++)
+                buf.add(line[i], i);
+            buf.end_run();
+            nglyphs += line.size();
+        }
+        shaper.shape(buf);
+    }
+    return nglyphs / (test_now() - t0);
+}
+
+static void
+bench_font(const TestFont &font, ErrorHandler *errh)
+{
+    const Font &otf = *font.otf();
+    Cmap cmap(otf.table("cmap"), errh);
+    Shaper shaper(otf, errh);
+    if (!cmap.ok() || (!shaper.has_gsub() && !shaper.has_gpos()))
+        return;
+    Vector<Vector<Glyph> > lines;
+    make_lines(cmap, lines);
+
+    Vector<Tag> kern, liga_kern, all;
+    kern.push_back(Tag("kern"));
+    liga_kern.push_back(Tag("liga"));
+    liga_kern.push_back(Tag("kern"));
+    int required;
+    Vector<int> fids;
+    try {
+        Gsub gsub(otf.table("GSUB"), &otf, errh);
+        if (gsub.script_list().features(Tag("latn"), Tag(), required, fids) >= 0)
+            for (int *f = fids.begin(); f != fids.end(); ++f)
+                all.push_back(gsub.feature_list().tag(*f));
+    } catch (Error) {
+    }
+    try {
+        Gpos gpos(otf.table("GPOS"), errh);
+        if (gpos.script_list().features(Tag("latn"), Tag(), required, fids) >= 0)
+            for (int *f = fids.begin(); f != fids.end(); ++f)
+                all.push_back(gpos.feature_list().tag(*f));
+    } catch (Error) {
+    }
+
+    printf("%s:\n", font.filename().c_str());
+    const Vector<Tag> *sets[] = { &kern, &liga_kern, &all };
+    const char * const names[] = { "kern", "liga kern", "all features" };
+    for (int i = 0; i < 3; i++) {
+        shaper.select(Tag("latn"), Tag(), *sets[i], errh);
+        double one = bench_shape(shaper, lines, 1);
+        double many = bench_shape(shaper, lines, BATCH);
+        printf("  %-12s  1 line/buffer %7.2f M glyphs/s   %d lines/buffer %7.2f M glyphs/s\n",
+               names[i], one / 1e6, BATCH, many / 1e6);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    ErrorHandler *errh = test_initialize("benchshaper");
+    Vector<String> filenames = test_font_filenames(argc, argv);
+    for (String *fn = filenames.begin(); fn != filenames.end(); ++fn) {
+        TestFont font(*fn, errh);
+        if (font.ok() && font.otf())
+            bench_font(font, errh);
+    }
+    return errh->nerrors() ? 1 : 0;
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
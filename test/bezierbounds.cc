@@ -0,0 +1,191 @@
+/* bezierbounds.cc -- check exact Bezier bounds against subdivision
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// Bezier::exact_bb and Bezier::exact_extents must agree, within rounding,
+// with the recursive subdivision CharstringBounds used before them, and
+// every point on a curve must lie in its exact box. Check random cubics,
+// including degenerate ones, and every curve of every glyph in each font.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include "subdivisionbox.hh"
+#include <efont/t1interp.hh>
+#include <lcdf/bezier.hh>
+#include <lcdf/error.hh>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+using namespace Efont;
+
+static uint32_t rng_state = 88675123U;
+
+static uint32_t
+rng()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static double
+random_coord()
+{
+    return (int) (rng() % 4001) - 2000 + (rng() % 64) / 64.;
+}
+
+static double
+tolerance(const Bezier &b)
+{
+    double m = 1;
+    for (int i = 0; i < 4; i++)
+        m = std::max(m, std::max(fabs(b.point(i).x), fabs(b.point(i).y)));
+    return m * 1e-9;
+}
+
+static bool
+check_curve(const Bezier &b, const String &what, ErrorHandler *errh)
+{
+    Point bl, tr;
+    b.exact_bb(bl, tr);
+    SubdivisionBox sub(b);
+    double tol = tolerance(b);
+    if (fabs(bl.x - sub.bottom_left().x) > tol
+        || fabs(bl.y - sub.bottom_left().y) > tol
+        || fabs(tr.x - sub.top_right().x) > tol
+        || fabs(tr.y - sub.top_right().y) > tol) {
+        errh->error("%s: curve (%g,%g) (%g,%g) (%g,%g) (%g,%g): exact box (%.10g,%.10g)-(%.10g,%.10g), subdivision (%.10g,%.10g)-(%.10g,%.10g)", what.c_str(), b.point(0).x, b.point(0).y, b.point(1).x, b.point(1).y, b.point(2).x, b.point(2).y, b.point(3).x, b.point(3).y, bl.x, bl.y, tr.x, tr.y, sub.bottom_left().x, sub.bottom_left().y, sub.top_right().x, sub.top_right().y);
+        return false;
+    }
+    for (int i = 0; i <= 32; i++) {
+        Point p = b.eval(i / 32.);
+        if (p.x < bl.x - tol || p.x > tr.x + tol
+            || p.y < bl.y - tol || p.y > tr.y + tol) {
+            errh->error("%s: curve point (%g,%g) at %g outside exact box (%g,%g)-(%g,%g)", what.c_str(), p.x, p.y, i / 32., bl.x, bl.y, tr.x, tr.y);
+            return false;
+        }
+    }
+    return true;
+}
+
+// exact_extents, which always solves, must match exact_bb, which skips
+// monotone axes.
+static bool
+check_extents(const Vector<Bezier> &curves, const String &what, ErrorHandler *errh)
+{
+    int n = curves.size();
+    Vector<double> p[4], lo(n, 0), hi(n, 0);
+    for (int axis = 0; axis < 2; axis++) {
+        for (int k = 0; k < 4; k++) {
+            p[k].clear();
+            for (int i = 0; i < n; i++)
+                p[k].push_back(axis ? curves[i].point(k).y : curves[i].point(k).x);
+        }
+        Bezier::exact_extents(n, p[0].begin(), p[1].begin(), p[2].begin(), p[3].begin(), lo.begin(), hi.begin());
+        for (int i = 0; i < n; i++) {
+            Point bl, tr;
+            curves[i].exact_bb(bl, tr);
+            double tol = tolerance(curves[i]);
+            if (fabs(lo[i] - (axis ? bl.y : bl.x)) > tol
+                || fabs(hi[i] - (axis ? tr.y : tr.x)) > tol) {
+                errh->error("%s: curve %d: exact_extents %c [%g,%g], exact_bb [%g,%g]", what.c_str(), i, axis ? 'y' : 'x', lo[i], hi[i], axis ? bl.y : bl.x, axis ? tr.y : tr.x);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void
+check_random(ErrorHandler *errh)
+{
+    Vector<Bezier> curves;
+    for (int i = 0; i < 50000; i++) {
+        Point p[4];
+        for (int k = 0; k < 4; k++)
+            p[k] = Point(random_coord(), random_coord());
+        switch (rng() % 8) {
+          case 0:               // control points on the endpoints
+            p[1] = p[0];
+            p[2] = p[3];
+            break;
+          case 1:               // quadratic-like
+            p[2] = p[1];
+            break;
+          case 2:               // constant along one axis
+            p[1].y = p[2].y = p[3].y = p[0].y;
+            break;
+          case 3:               // collinear
+            p[1] = p[0] + (p[3] - p[0]) * ((int) (rng() % 5) - 1);
+            p[2] = p[0] + (p[3] - p[0]) * ((int) (rng() % 5) - 1);
+            break;
+          case 4:               // a loop
+            std::swap(p[1], p[2]);
+            break;
+          default:
+            break;
+        }
+        Bezier b(p);
+        if (!check_curve(b, "random", errh))
+            return;
+        curves.push_back(b);
+    }
+    check_extents(curves, "random", errh);
+}
+
+namespace {
+class CurveCollector : public CharstringInterp { public:
+    Vector<Bezier> curves;
+    void act_curve(int, const Point &p0, const Point &p1, const Point &p2, const Point &p3) {
+        curves.push_back(Bezier(p0, p1, p2, p3));
+    }
+};
+}
+
+static void
+check_font(const TestFont &font, ErrorHandler *errh)
+{
+    const CharstringProgram *program = font.program();
+    CurveCollector cc;
+    for (int gi = 0; gi < program->nglyphs(); gi++) {
+        cc.curves.clear();
+        cc.interpret(program->glyph_context(gi));
+        String what = font.filename() + " glyph " + String(gi);
+        for (const Bezier *b = cc.curves.begin(); b != cc.curves.end(); ++b)
+            if (!check_curve(*b, what, errh))
+                return;
+        if (!check_extents(cc.curves, what, errh))
+            return;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    ErrorHandler *errh = test_initialize("bezierbounds");
+    Vector<String> filenames = test_font_filenames(argc, argv);
+
+    check_random(errh);
+    for (String *fn = filenames.begin(); fn != filenames.end(); ++fn) {
+        TestFont font(*fn, errh);
+        if (font.ok())
+            check_font(font, errh);
+    }
+
+    return errh->nerrors() ? 1 : 0;
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
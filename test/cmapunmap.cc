@@ -0,0 +1,153 @@
+/* cmapunmap.cc -- check the compiled cmap's reverse map
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// Cmap::unmap must list, for each glyph, the code points the raw table maps
+// to it, except code points that the table maps more than once; TrueType
+// glyph names have always ignored those. Check each font's cmap against
+// unmap_all, then a table that maps some code points twice. Only a
+// malformed table can do that: here subheader 0 of a format 2 table runs
+// past the single-byte codes into those of high byte 1.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include <efont/otfcmap.hh>
+#include <lcdf/error.hh>
+#include <lcdf/straccum.hh>
+#include <stdio.h>
+#include <algorithm>
+using namespace Efont;
+using namespace Efont::OpenType;
+
+static void
+append_u16(StringAccum &sa, int x)
+{
+    sa << (char) (x >> 8) << (char) x;
+}
+
+// Returns the reverse map built from unmap_all, leaving out code points
+// with several mappings, as glyph names did before Cmap::unmap existed.
+static void
+reference_unmap(const Cmap &cmap, Vector<Vector<uint32_t> > &ref)
+{
+    Vector<std::pair<uint32_t, Glyph> > ugp;
+    cmap.unmap_all(ugp);
+    std::sort(ugp.begin(), ugp.end());
+    for (std::pair<uint32_t, Glyph> *it = ugp.begin(); it != ugp.end(); ) {
+        std::pair<uint32_t, Glyph> *nit = it + 1;
+        if (nit == ugp.end() || nit->first != it->first) {
+            if (it->second > 0) {
+                if (it->second >= ref.size())
+                    ref.resize(it->second + 1);
+                ref[it->second].push_back(it->first);
+            }
+        } else
+            while (nit != ugp.end() && nit->first == it->first)
+                ++nit;
+        it = nit;
+    }
+}
+
+static bool
+check_unmap(const Cmap &cmap, int nglyphs, const String &what, ErrorHandler *errh)
+{
+    Vector<Vector<uint32_t> > ref;
+    reference_unmap(cmap, ref);
+    if (nglyphs < ref.size())
+        nglyphs = ref.size();
+    for (Glyph g = 0; g <= nglyphs; g++) {
+        Vector<uint32_t> us;
+        int n = cmap.unmap(g, us);
+        const Vector<uint32_t> empty, &r = (g < ref.size() ? ref[g] : empty);
+        if (n != us.size() || us.size() != r.size()
+            || !std::equal(us.begin(), us.end(), r.begin())) {
+            errh->error("%s: glyph %d: unmap gives %d code points, expected %d", what.c_str(), g, us.size(), r.size());
+            return false;
+        }
+        for (uint32_t *u = us.begin(); u != us.end(); ++u)
+            if (cmap.map_uni(*u) != g) {
+                errh->error("%s: glyph %d: unmap gives U+%04X, which maps to %d", what.c_str(), g, *u, cmap.map_uni(*u));
+                return false;
+            }
+    }
+    return true;
+}
+
+// A format 2 table whose subheader 0 maps codes 0-511 to glyphs 1-512, and
+// whose high byte 1 maps codes 0x100-0x10F to glyphs 600-615 again. Cmap
+// reads subheaders at offset 524, and glyph arrays relative to the
+// subheader's idRangeOffset field.
+static String
+ambiguous_cmap()
+{
+    StringAccum sa;
+    append_u16(sa, 0);          // cmap header
+    append_u16(sa, 1);
+    append_u16(sa, 3);
+    append_u16(sa, 1);
+    append_u16(sa, 0);
+    append_u16(sa, 12);
+
+    append_u16(sa, 2);          // format 2 table
+    append_u16(sa, 1596);
+    append_u16(sa, 0);
+    for (int hi_byte = 0; hi_byte < 256; hi_byte++)
+        append_u16(sa, hi_byte == 1 ? 8 : 0);
+    append_u16(sa, 0);          // padding up to offset 524
+    append_u16(sa, 0);
+    append_u16(sa, 0);
+    append_u16(sa, 0);          // subheader 0
+    append_u16(sa, 512);
+    append_u16(sa, 0);
+    append_u16(sa, 10);
+    append_u16(sa, 0);          // subheader 8
+    append_u16(sa, 16);
+    append_u16(sa, 0);
+    append_u16(sa, 1026);
+    for (int c = 0; c < 512; c++)
+        append_u16(sa, c + 1);
+    for (int c = 0; c < 16; c++)
+        append_u16(sa, 600 + c);
+    return sa.take_string();
+}
+
+int
+main(int argc, char **argv)
+{
+    ErrorHandler *errh = test_initialize("cmapunmap");
+
+    Cmap cmap(ambiguous_cmap(), errh);
+    if (!cmap.ok())
+        errh->fatal("synthetic cmap: bad table");
+    check_unmap(cmap, 615, "synthetic cmap", errh);
+    Vector<uint32_t> us;
+    if (cmap.unmap(257, us) || cmap.unmap(600, us) || cmap.unmap(256, us) != 1
+        || us[0] != 0xFF || cmap.map_uni(0x100) != 257 || cmap.map_uni(0x110) != 273)
+        errh->error("synthetic cmap: wrong mappings");
+
+    Vector<String> filenames = test_font_filenames(argc, argv);
+    for (String *fn = filenames.begin(); fn != filenames.end(); ++fn) {
+        TestFont font(*fn, errh);
+        if (!font.otf() || !font.otf()->has_table("cmap"))
+            continue;
+        Cmap fcmap(font.otf()->table("cmap"), errh);
+        if (fcmap.ok())
+            check_unmap(fcmap, font.program() ? font.program()->nglyphs() : 0, *fn, errh);
+    }
+
+    return errh->nerrors() ? 1 : 0;
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
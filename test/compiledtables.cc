@@ -0,0 +1,207 @@
+/* compiledtables.cc -- check compiled Coverage and ClassDef tables
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// Every CompiledCoverage and CompiledClassDef must answer exactly as the
+// raw table does. Check random tables, including unsorted ones, and then
+// every coverage and pair-class table in the GSUB and GPOS of each font.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include <efont/otf.hh>
+#include <lcdf/error.hh>
+#include <lcdf/straccum.hh>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+using namespace Efont;
+using namespace Efont::OpenType;
+
+static uint32_t rng_state = 2463534242U;
+
+static uint32_t
+rng()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void
+append_u16(StringAccum &sa, int x)
+{
+    sa << (char) (x >> 8) << (char) x;
+}
+
+static bool
+check_coverage(const Coverage &c, const CompiledTables &ct, int maxglyph,
+               const String &what, ErrorHandler *errh)
+{
+    const CompiledCoverage *cc = ct.coverage(c);
+    if (ct.coverage(c) != cc) {
+        errh->error("%s: coverage compiled twice", what.c_str());
+        return false;
+    }
+    for (Glyph g = -1; g <= maxglyph; g++)
+        if (cc->coverage_index(g) != c.coverage_index(g)) {
+            errh->error("%s: glyph %d: compiled coverage index %d, raw %d", what.c_str(), g, cc->coverage_index(g), c.coverage_index(g));
+            return false;
+        }
+    return true;
+}
+
+static bool
+check_class_def(const ClassDef &cd, const CompiledTables &ct, int maxglyph,
+                const String &what, ErrorHandler *errh)
+{
+    const CompiledClassDef *ccd = ct.class_def(cd);
+    if (ct.class_def(cd) != ccd) {
+        errh->error("%s: class table compiled twice", what.c_str());
+        return false;
+    }
+    for (Glyph g = -1; g <= maxglyph; g++)
+        if (ccd->lookup(g) != cd.lookup(g)) {
+            errh->error("%s: glyph %d: compiled class %d, raw %d", what.c_str(), g, ccd->lookup(g), cd.lookup(g));
+            return false;
+        }
+    return true;
+}
+
+static Vector<int>
+random_glyphs(int n, int maxglyph, bool sorted)
+{
+    Vector<int> gs;
+    for (int i = 0; i < n; i++)
+        gs.push_back(rng() % (maxglyph + 1));
+    if (sorted) {
+        std::sort(gs.begin(), gs.end());
+        gs.erase(std::unique(gs.begin(), gs.end()), gs.end());
+    }
+    return gs;
+}
+
+static void
+check_random_tables(ErrorHandler *errh)
+{
+    const int maxglyph = 3000;
+    CompiledTables ct;
+    Vector<String> keep;        // table addresses must outlive 'ct'
+
+    for (int trial = 0; trial < 200; trial++) {
+        bool sorted = trial % 4 != 3;
+        Vector<int> gs = random_glyphs(1 + rng() % 300, maxglyph, sorted);
+        StringAccum sa;
+
+        // Coverage format 1
+        append_u16(sa, 1);
+        append_u16(sa, gs.size());
+        for (int *g = gs.begin(); g != gs.end(); ++g)
+            append_u16(sa, *g);
+        keep.push_back(sa.take_string());
+        check_coverage(Coverage(keep.back(), 0, false), ct, maxglyph, "random format 1 coverage", errh);
+
+        // Coverage format 2, ranges from consecutive pairs
+        append_u16(sa, 2);
+        append_u16(sa, gs.size() / 2);
+        for (int i = 0, index = 0; i + 1 < gs.size(); i += 2) {
+            int first = std::min(gs[i], gs[i + 1]), last = std::max(gs[i], gs[i + 1]);
+            append_u16(sa, first);
+            append_u16(sa, last);
+            append_u16(sa, trial % 5 == 4 ? rng() % 100 : index);
+            index += last - first + 1;
+        }
+        keep.push_back(sa.take_string());
+        check_coverage(Coverage(keep.back(), 0, false), ct, maxglyph, "random format 2 coverage", errh);
+
+        // ClassDef format 1
+        int start = rng() % 200, count = rng() % 500;
+        append_u16(sa, 1);
+        append_u16(sa, start);
+        append_u16(sa, count);
+        for (int i = 0; i < count; i++)
+            append_u16(sa, rng() % 4 ? rng() % 20 : 0);
+        keep.push_back(sa.take_string());
+        check_class_def(ClassDef(keep.back()), ct, maxglyph, "random format 1 class table", errh);
+
+        // ClassDef format 2
+        append_u16(sa, 2);
+        append_u16(sa, gs.size() / 2);
+        for (int i = 0; i + 1 < gs.size(); i += 2) {
+            append_u16(sa, std::min(gs[i], gs[i + 1]));
+            append_u16(sa, std::max(gs[i], gs[i + 1]));
+            append_u16(sa, rng() % 20);
+        }
+        keep.push_back(sa.take_string());
+        check_class_def(ClassDef(keep.back()), ct, maxglyph, "random format 2 class table", errh);
+    }
+}
+
+static void
+check_layout_table(const TestFont &font, const char *tag, ErrorHandler *errh)
+{
+    String str = font.otf()->table(tag);
+    if (!str)
+        return;
+    CompiledTables ct;
+    int maxglyph = font.program()->nglyphs() + 16;
+    int extension_type = (strcmp(tag, "GSUB") == 0 ? 7 : 9);
+    String what = font.filename() + " " + tag;
+    Data lookup_list = Data(str).offset_subtable(8);
+    for (int i = 0; i < lookup_list.u16(0); i++) {
+        Data lookup = lookup_list.offset_subtable(2 + i*2);
+        int type = lookup.u16(0);
+        for (int j = 0; j < lookup.u16(4); j++)
+            try {
+                Data sub = lookup.offset_subtable(6 + j*2);
+                int sub_type = type;
+                if (type == extension_type) {
+                    sub_type = sub.u16(2);
+                    sub = sub.subtable(sub.u32(4));
+                }
+                // context format 3 has no coverage at offset 2
+                if (sub.u16(0) != 3) {
+                    Coverage c(sub.offset_subtable(2), 0, false);
+                    if (c.ok())
+                        check_coverage(c, ct, maxglyph, what, errh);
+                }
+                if (strcmp(tag, "GPOS") == 0 && sub_type == 2 && sub.u16(0) == 2) {
+                    check_class_def(ClassDef(sub.offset_subtable(8)), ct, maxglyph, what, errh);
+                    check_class_def(ClassDef(sub.offset_subtable(10)), ct, maxglyph, what, errh);
+                }
+            } catch (Error) {
+            }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    ErrorHandler *errh = test_initialize("compiledtables");
+    check_random_tables(errh);
+
+    Vector<String> filenames = test_font_filenames(argc, argv);
+    for (String *fn = filenames.begin(); fn != filenames.end(); ++fn) {
+        TestFont font(*fn, errh);
+        if (font.ok() && font.otf()) {
+            check_layout_table(font, "GSUB", errh);
+            check_layout_table(font, "GPOS", errh);
+        }
+    }
+
+    return errh->nerrors() ? 1 : 0;
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
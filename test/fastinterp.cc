@@ -0,0 +1,164 @@
+/* fastinterp.cc -- check CharstringFastInterp against CharstringInterp
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// On every glyph of each font, CharstringFastInterp must report exactly
+// the actions CharstringInterp does, or, when it gives up, a prefix of
+// them. CharstringBounds, which takes the fast path, must compute the same
+// bounds and width as a subclass, which CharstringBounds always sends
+// through CharstringInterp.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include <efont/t1bounds.hh>
+#include <efont/t1fastinterp.hh>
+#include <lcdf/error.hh>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+using namespace Efont;
+
+// Actions, recorded as a code followed by their arguments.
+class ActionLog { public:
+
+    void add(int code, const Point &p0, const Point &p1) {
+        _v.push_back(code);
+        _v.push_back(p0.x);
+        _v.push_back(p0.y);
+        _v.push_back(p1.x);
+        _v.push_back(p1.y);
+    }
+    void add(int code, const Point &p0, const Point &p1, const Point &p2, const Point &p3) {
+        add(code, p0, p1);
+        add(code, p2, p3);
+    }
+    void add(int code, double a, double b) {
+        _v.push_back(code);
+        _v.push_back(a);
+        _v.push_back(b);
+    }
+    void add_mask(const uint8_t *data, int nhints) {
+        _v.push_back('m');
+        _v.push_back(nhints);
+        for (int i = 0; i < (nhints + 7) / 8; i++)
+            _v.push_back(data[i]);
+    }
+
+    const Vector<double> &values() const { return _v; }
+
+  private:
+
+    Vector<double> _v;
+
+};
+
+namespace {
+class FastLog : public CharstringFastInterp<FastLog> { public:
+    ActionLog log;
+    void act_sidebearing(int, const Point &p)   { log.add('s', p.x, p.y); }
+    void act_width(int, const Point &p)         { log.add('w', p.x, p.y); }
+    void act_line(int, const Point &p0, const Point &p1) { log.add('l', p0, p1); }
+    void act_curve(int, const Point &p0, const Point &p1, const Point &p2, const Point &p3) { log.add('c', p0, p1, p2, p3); }
+    void act_closepath(int)                     { log.add('z', 0, 0); }
+    void act_hstem(int, double y, double dy)    { log.add('h', y, dy); }
+    void act_vstem(int, double x, double dx)    { log.add('v', x, dx); }
+    void act_hintmask(int, const uint8_t *data, int nhints) { log.add_mask(data, nhints); }
+};
+
+class InterpLog : public CharstringInterp { public:
+    ActionLog log;
+    void act_sidebearing(int, const Point &p)   { log.add('s', p.x, p.y); }
+    void act_width(int, const Point &p)         { log.add('w', p.x, p.y); }
+    void act_line(int, const Point &p0, const Point &p1) { log.add('l', p0, p1); }
+    void act_curve(int, const Point &p0, const Point &p1, const Point &p2, const Point &p3) { log.add('c', p0, p1, p2, p3); }
+    void act_closepath(int)                     { log.add('z', 0, 0); }
+    void act_hstem(int, double y, double dy)    { log.add('h', y, dy); }
+    void act_vstem(int, double x, double dx)    { log.add('v', x, dx); }
+    void act_hintmask(int, const uint8_t *data, int nhints) { log.add_mask(data, nhints); }
+};
+
+// CharstringBounds only takes the fast path for exact CharstringBounds
+// objects.
+class CarefulBounds : public CharstringBounds { public:
+    CarefulBounds(const Transform &xf)          : CharstringBounds(xf) { }
+};
+}
+
+static void
+check_font(const TestFont &font, ErrorHandler *errh)
+{
+    const CharstringProgram *program = font.program();
+    Transform xfs[2];
+    xfs[1].scale(0.37, 1.1);
+    xfs[1].shear(0.2);
+    int nerrors = 0;
+
+    for (int gi = 0; gi < program->nglyphs() && nerrors < 5; gi++) {
+        CharstringContext g = program->glyph_context(gi);
+        String what = font.filename() + " glyph " + String(gi);
+
+        FastLog fast;
+        InterpLog interp;
+        bool fast_ok = fast.interpret(g);
+        bool interp_ok = interp.interpret(g);
+        const Vector<double> &fv = fast.log.values(), &iv = interp.log.values();
+        if (fast_ok && (!interp_ok || fv.size() != iv.size()
+                        || !std::equal(fv.begin(), fv.end(), iv.begin()))) {
+            errh->error("%s: fast interpreter actions differ", what.c_str());
+            nerrors++;
+        } else if (!fast_ok && (fv.size() > iv.size()
+                                || !std::equal(fv.begin(), fv.end(), iv.begin()))) {
+            errh->error("%s: fast interpreter actions before fallback differ", what.c_str());
+            nerrors++;
+        }
+
+        for (int x = 0; x < 2; x++) {
+            CharstringBounds b(xfs[x]);
+            CarefulBounds cb(xfs[x]);
+            double bb[4] = { 0, 0, 0, 0 }, cbb[4] = { 0, 0, 0, 0 };
+            double width = 0, cwidth = 0;
+            b.char_bounds(g, false);
+            cb.char_bounds(g, false);
+            bool ok = b.output(bb, width, true);
+            bool cok = cb.output(cbb, cwidth, true);
+            if (ok != cok || (ok && (memcmp(bb, cbb, sizeof(bb)) != 0 || width != cwidth))) {
+                errh->error("%s: bounds [%g %g %g %g] width %g, careful bounds [%g %g %g %g] width %g", what.c_str(), bb[0], bb[1], bb[2], bb[3], width, cbb[0], cbb[1], cbb[2], cbb[3], cwidth);
+                nerrors++;
+            }
+        }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    ErrorHandler *errh = test_initialize("fastinterp");
+    Vector<String> filenames = test_font_filenames(argc, argv);
+    int nchecked = 0;
+
+    for (String *fn = filenames.begin(); fn != filenames.end(); ++fn) {
+        TestFont font(*fn, errh);
+        if (!font.ok())
+            continue;
+        check_font(font, errh);
+        nchecked++;
+    }
+
+    if (errh->nerrors())
+        return 1;
+    return nchecked ? 0 : TEST_SKIP;
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
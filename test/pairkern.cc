@@ -0,0 +1,201 @@
+/* pairkern.cc -- check CompiledPairKern against lookup application
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// CompiledPairKern::kern(a, b) must equal the first glyph's x advance
+// adjustment from GposLookup::apply on the pair, summed over lookups, and
+// the kern table's value for the pair. Check every pair the lookups
+// define, plus the pairs of every glyph with a sample of second glyphs.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include <efont/otfpairkern.hh>
+#include <lcdf/error.hh>
+#include <lcdf/hashmap.hh>
+#include <stdio.h>
+using namespace Efont;
+using namespace Efont::OpenType;
+
+static uint32_t rng_state = 521288629U;
+
+static uint32_t
+rng()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int
+apply_kern(const Vector<GposLookup> &lookups, Glyph a, Glyph b)
+{
+    Glyph g[2] = { a, b };
+    int k = 0;
+    for (const GposLookup *l = lookups.begin(); l != lookups.end(); ++l) {
+        Positioning p;
+        if (l->apply(g, 0, 2, p))
+            k += p.left().adx;
+    }
+    return k;
+}
+
+static uint32_t
+pair_key(Glyph a, Glyph b)
+{
+    // HashMap keys must be nonzero
+    return (((uint32_t) a << 16) | (uint32_t) b) + 1;
+}
+
+static Vector<Glyph>
+sample_glyphs(int nglyphs)
+{
+    Vector<Glyph> gs;
+    for (Glyph g = 0; g < nglyphs && g < 128; g++)
+        gs.push_back(g);
+    for (int i = 0; i < 128 && nglyphs > 128; i++)
+        gs.push_back(128 + rng() % (nglyphs - 128));
+    gs.push_back(nglyphs);
+    return gs;
+}
+
+static void
+check_runs(const CompiledPairKern &ck, int nglyphs, const String &what, ErrorHandler *errh)
+{
+    Glyph g[50];
+    int out[50];
+    for (int trial = 0; trial < 100; trial++) {
+        for (int i = 0; i < 50; i++)
+            g[i] = rng() % nglyphs;
+        ck.kern(g, 50, out);
+        for (int i = 0; i < 50; i++)
+            if (out[i] != (i < 49 ? ck.kern(g[i], g[i + 1]) : 0)) {
+                errh->error("%s: run kerning differs from pair kerning at %d", what.c_str(), i);
+                return;
+            }
+    }
+}
+
+static void
+check_gpos(const TestFont &font, ErrorHandler *errh)
+{
+    String table = font.otf()->table("GPOS");
+    if (!table)
+        return;
+    Gpos gpos(table, errh);
+    int nglyphs = font.program()->nglyphs();
+    Vector<Glyph> seconds = sample_glyphs(nglyphs);
+    Vector<GposLookup> added;
+    CompiledPairKern all;
+
+    for (int i = 0; i < gpos.nlookups(); i++) {
+        GposLookup l = gpos.lookup(i);
+        CompiledPairKern ck;
+        if (!ck.add(l))
+            continue;
+        all.add(l);
+        added.push_back(l);
+        Vector<GposLookup> one(1, l);
+        String what = font.filename() + " GPOS lookup " + String(i);
+
+        Vector<Positioning> poss;
+        l.unparse_automatics(poss);
+        for (Positioning *p = poss.begin(); p != poss.end(); ++p) {
+            Glyph a = p->left_glyph(), b = p->right_glyph();
+            if (ck.kern(a, b) != apply_kern(one, a, b)) {
+                errh->error("%s: pair %d %d: compiled %d, applied %d", what.c_str(), a, b, ck.kern(a, b), apply_kern(one, a, b));
+                goto next_lookup;
+            }
+        }
+        for (Glyph a = 0; a <= nglyphs; a++)
+            for (Glyph *b = seconds.begin(); b != seconds.end(); ++b)
+                if (ck.kern(a, *b) != apply_kern(one, a, *b)) {
+                    errh->error("%s: pair %d %d: compiled %d, applied %d", what.c_str(), a, *b, ck.kern(a, *b), apply_kern(one, a, *b));
+                    goto next_lookup;
+                }
+      next_lookup: ;
+    }
+
+    String what = font.filename() + " GPOS";
+    for (Glyph a = 0; a <= nglyphs; a++)
+        for (Glyph *b = seconds.begin(); b != seconds.end(); ++b)
+            if (all.kern(a, *b) != apply_kern(added, a, *b)) {
+                errh->error("%s: pair %d %d: compiled %d, applied %d", what.c_str(), a, *b, all.kern(a, *b), apply_kern(added, a, *b));
+                return;
+            }
+    if (nglyphs)
+        check_runs(all, nglyphs, what, errh);
+}
+
+static void
+check_kern_table(const TestFont &font, ErrorHandler *errh)
+{
+    String table = font.otf()->table("kern");
+    if (!table)
+        return;
+    KernTable kern(table, errh);
+    if (!kern.ok())
+        return;
+    CompiledPairKern ck;
+    ck.add(kern, errh);
+    String what = font.filename() + " kern";
+
+    Vector<Positioning> poss;
+    kern.unparse_automatics(poss, errh);
+    HashMap<uint32_t, int> expected(0);
+    for (Positioning *p = poss.begin(); p != poss.end(); ++p)
+        expected.find_force(pair_key(p->left_glyph(), p->right_glyph())) += p->left().adx;
+    for (Positioning *p = poss.begin(); p != poss.end(); ++p) {
+        Glyph a = p->left_glyph(), b = p->right_glyph();
+        if (ck.kern(a, b) != expected[pair_key(a, b)]) {
+            errh->error("%s: pair %d %d: compiled %d, table %d", what.c_str(), a, b, ck.kern(a, b), expected[pair_key(a, b)]);
+            return;
+        }
+    }
+
+    int nglyphs = font.program()->nglyphs();
+    Vector<Glyph> seconds = sample_glyphs(nglyphs);
+    for (Glyph a = 0; a <= nglyphs; a++)
+        for (Glyph *b = seconds.begin(); b != seconds.end(); ++b)
+            if (ck.kern(a, *b) != expected[pair_key(a, *b)]) {
+                errh->error("%s: pair %d %d: compiled %d, table %d", what.c_str(), a, *b, ck.kern(a, *b), expected[pair_key(a, *b)]);
+                return;
+            }
+    if (nglyphs)
+        check_runs(ck, nglyphs, what, errh);
+}
+
+int
+main(int argc, char **argv)
+{
+    ErrorHandler *errh = test_initialize("pairkern");
+    Vector<String> filenames = test_font_filenames(argc, argv);
+    int nchecked = 0;
+
+    for (String *fn = filenames.begin(); fn != filenames.end(); ++fn) {
+        TestFont font(*fn, errh);
+        if (!font.ok() || !font.otf())
+            continue;
+        check_gpos(font, errh);
+        check_kern_table(font, errh);
+        nchecked++;
+    }
+
+    if (errh->nerrors())
+        return 1;
+    return nchecked ? 0 : TEST_SKIP;
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
@@ -0,0 +1,215 @@
+/* pairunparse.cc -- check pair positionings limited to a glyph set
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// Unparsing a pair lookup with a limit must produce exactly the pairs of
+// the unlimited unparse whose glyphs are both in the limit, and must fail
+// where the unlimited unparse fails. Check random class-based subtables,
+// some with class 0 values, and every pair lookup in each font's GPOS.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include <efont/otfgpos.hh>
+#include <lcdf/error.hh>
+#include <lcdf/straccum.hh>
+#include <stdio.h>
+#include <algorithm>
+using namespace Efont;
+using namespace Efont::OpenType;
+
+static uint32_t rng_state = 88172645U;
+
+static uint32_t
+rng()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+namespace {
+
+class PairCollector : public PositioningVisitor { public:
+    PairCollector(const Coverage *limit)    : _limit(limit) { }
+    bool visit(const Positioning &p) {
+        if (!_limit || (_limit->covers(p.left_glyph()) && _limit->covers(p.right_glyph()))) {
+            const Position &l = p.left(), &r = p.right();
+            StringAccum sa;
+            sa << l.g << ' ' << l.pdx << ' ' << l.pdy << ' ' << l.adx << ' ' << l.ady << ' '
+               << r.g << ' ' << r.pdx << ' ' << r.pdy << ' ' << r.adx << ' ' << r.ady;
+            pairs.push_back(sa.take_string());
+        }
+        return true;
+    }
+    Vector<String> pairs;
+  private:
+    const Coverage *_limit;
+};
+
+class CountingErrorHandler : public ErrorHandler { public:
+    CountingErrorHandler()              : nmessages(0) { }
+    String decorate(const String &) {
+        ++nmessages;
+        return String();
+    }
+    int nmessages;
+};
+
+}
+
+static void
+append_u16(StringAccum &sa, int x)
+{
+    sa << (char) (x >> 8) << (char) x;
+}
+
+static bool
+same_pairs(Vector<String> &a, Vector<String> &b)
+{
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+// A PairPos format 2 subtable over glyphs [0, nglyphs), with X advance
+// adjustments on both glyphs.
+static String
+random_class_pair_subtable(int nglyphs, bool class0_values)
+{
+    int nclass1 = 1 + rng() % 6, nclass2 = 1 + rng() % 6;
+    int records = 16, coverage = records + nclass1 * nclass2 * 4;
+    int class1 = coverage + 4 + nglyphs * 2, class2 = class1 + 6 + nglyphs * 2;
+
+    StringAccum sa;
+    append_u16(sa, 2);
+    append_u16(sa, coverage);
+    append_u16(sa, GposValue::F_XADVANCE);
+    append_u16(sa, GposValue::F_XADVANCE);
+    append_u16(sa, class1);
+    append_u16(sa, class2);
+    append_u16(sa, nclass1);
+    append_u16(sa, nclass2);
+    for (int c1 = 0; c1 < nclass1; c1++)
+        for (int c2 = 0; c2 < nclass2; c2++)
+            for (int i = 0; i < 2; i++)
+                append_u16(sa, (c2 > 0 || class0_values) && rng() % 2 ? rng() % 200 - 100 : 0);
+
+    // coverage: a random subset of the glyphs, padded to a fixed size
+    Vector<int> covered;
+    for (int g = 0; g < nglyphs; g++)
+        if (rng() % 3)
+            covered.push_back(g);
+    append_u16(sa, 1);
+    append_u16(sa, covered.size());
+    for (int i = 0; i < nglyphs; i++)
+        append_u16(sa, i < covered.size() ? covered[i] : 0);
+
+    // class tables: format 1 over every glyph
+    int nclass[2] = { nclass1, nclass2 };
+    for (int which = 0; which < 2; which++) {
+        append_u16(sa, 1);
+        append_u16(sa, 0);
+        append_u16(sa, nglyphs);
+        for (int g = 0; g < nglyphs; g++)
+            append_u16(sa, rng() % nclass[which]);
+    }
+    return sa.take_string();
+}
+
+static int
+unparse(const GposPair &pair, const Coverage *limit, PairCollector &out)
+{
+    try {
+        if (limit)
+            pair.unparse(out, *limit);
+        else
+            pair.unparse(out);
+        return 0;
+    } catch (Error) {
+        return 1;
+    }
+}
+
+static Coverage
+random_limit(int nglyphs, int one_in)
+{
+    Vector<bool> gmap(nglyphs, false);
+    for (int g = 0; g < nglyphs; g++)
+        gmap[g] = rng() % one_in == 0;
+    return Coverage(gmap);
+}
+
+static void
+check_random_subtables(ErrorHandler *errh)
+{
+    const int nglyphs = 60;
+    for (int trial = 0; trial < 500; trial++) {
+        GposPair pair(Data(random_class_pair_subtable(nglyphs, trial % 4 == 0)));
+        Coverage limit = random_limit(nglyphs, 1 + trial % 3);
+        PairCollector expected(&limit), actual(0);
+        int expected_failed = unparse(pair, 0, expected);
+        int actual_failed = unparse(pair, &limit, actual);
+        if (expected_failed != actual_failed)
+            errh->error("random subtable %d: unparse %s, limited unparse %s", trial,
+                        expected_failed ? "fails" : "succeeds", actual_failed ? "fails" : "succeeds");
+        else if (!expected_failed && !same_pairs(expected.pairs, actual.pairs))
+            errh->error("random subtable %d: %d pairs in limit, but limited unparse gives %d", trial, expected.pairs.size(), actual.pairs.size());
+    }
+}
+
+static void
+check_font(const TestFont &font, ErrorHandler *errh)
+{
+    String table = font.otf()->table("GPOS");
+    if (!table)
+        return;
+    Gpos gpos(table, errh);
+    int nglyphs = font.program()->nglyphs();
+    Coverage limits[3] = { Coverage(0, 255), random_limit(nglyphs, 2), random_limit(nglyphs, 7) };
+    for (int i = 0; i < gpos.nlookups(); i++) {
+        GposLookup l = gpos.lookup(i);
+        if (l.type() != GposLookup::L_PAIR)
+            continue;
+        for (int j = 0; j < 3; j++) {
+            PairCollector expected(&limits[j]), actual(0);
+            CountingErrorHandler expected_errh, actual_errh;
+            bool expected_ok = l.unparse_automatics(expected, &expected_errh);
+            bool actual_ok = l.unparse_automatics(actual, limits[j], &actual_errh);
+            if (expected_ok != actual_ok || expected_errh.nmessages != actual_errh.nmessages)
+                errh->error("%s: lookup %d: unparse and limited unparse report differently", font.filename().c_str(), i);
+            else if (!same_pairs(expected.pairs, actual.pairs))
+                errh->error("%s: lookup %d: %d pairs in limit, but limited unparse gives %d", font.filename().c_str(), i, expected.pairs.size(), actual.pairs.size());
+        }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    ErrorHandler *errh = test_initialize("pairunparse");
+    check_random_subtables(errh);
+
+    Vector<String> filenames = test_font_filenames(argc, argv);
+    for (String *fn = filenames.begin(); fn != filenames.end(); ++fn) {
+        TestFont font(*fn, errh);
+        if (font.ok() && font.otf())
+            check_font(font, errh);
+    }
+
+    return errh->nerrors() ? 1 : 0;
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
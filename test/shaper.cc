@@ -0,0 +1,451 @@
+/* shaper.cc -- check Shaper against plain lookup application
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// Shaper::shape must produce the same glyphs, clusters and positions as
+// applying the selected lookups one at a time, in order, to each run: a
+// reference that reads GDEF classes straight from the table, tries every
+// glyph without the per-lookup glyph sets, and applies pair lookups with
+// GposLookup::apply rather than CompiledPairKern. Check every language
+// system with "liga kern" and with all of its features, on batches of
+// runs built from ligature inputs, positioned glyphs, marks and random
+// glyphs.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include <efont/otfshaper.hh>
+#include <lcdf/error.hh>
+#include <algorithm>
+#include <stdio.h>
+using namespace Efont;
+using namespace Efont::OpenType;
+
+static uint32_t rng_state = 2463534242U;
+
+static uint32_t
+rng()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// GDEF classes, read without CompiledClassDef.
+class RefGdef { public:
+
+    RefGdef(const String &table)
+        : _glyph_classes(String()), _mark_classes(String()) {
+        Data d(table);
+        if (d.length() >= Gdef::HEADERSIZE && d.u16(0) == 1) {
+            if (d.u16(4))
+                _glyph_classes = ClassDef(d.offset_subtable(4));
+            if (d.u16(10))
+                _mark_classes = ClassDef(d.offset_subtable(10));
+            if (d.u16(2) >= 2 && d.length() >= Gdef::HEADERSIZE + 2 && d.u16(12)) {
+                Data sets = d.offset_subtable(12);
+                for (int i = 0; i < sets.u16(2); i++)
+                    _mark_sets.push_back(Coverage(sets.subtable(sets.u32(Gdef::MARKSETS_HEADERSIZE + i*Gdef::MARKSETS_RECSIZE))));
+            }
+        }
+    }
+
+    bool is_mark(Glyph g) const {
+        return _glyph_classes.ok() && _glyph_classes.lookup(g) == Gdef::C_MARK;
+    }
+
+    bool ignores(Glyph g, uint16_t flags, int mark_set) const {
+        int c = _glyph_classes.ok() ? _glyph_classes.lookup(g) : 0;
+        if (c == Gdef::C_BASE)
+            return flags & Gdef::F_IGNORE_BASE_GLYPHS;
+        else if (c == Gdef::C_LIGATURE)
+            return flags & Gdef::F_IGNORE_LIGATURES;
+        else if (c != Gdef::C_MARK)
+            return false;
+        else if (flags & Gdef::F_IGNORE_MARKS)
+            return true;
+        else if (flags & Gdef::F_USE_MARK_FILTERING_SET)
+            return mark_set < 0 || mark_set >= _mark_sets.size()
+                || !_mark_sets[mark_set].covers(g);
+        else if (flags & Gdef::F_MARK_ATTACHMENT_TYPE)
+            return (_mark_classes.ok() ? _mark_classes.lookup(g) : 0) != (flags >> 8);
+        else
+            return false;
+    }
+
+  private:
+
+    ClassDef _glyph_classes;
+    ClassDef _mark_classes;
+    Vector<Coverage> _mark_sets;
+
+};
+
+struct RefRun {
+    Vector<Glyph> glyphs;
+    Vector<int> clusters;
+    Vector<Position> pos;
+};
+
+struct RefStage {
+    int lookup;
+    uint16_t flags;
+    int mark_set;
+};
+
+template <typename T> static Vector<RefStage>
+ref_stages(const T *table, Tag script, Tag langsys, const Vector<Tag> &features)
+{
+    Vector<RefStage> stages;
+    Vector<Tag> sorted_features(features);
+    std::sort(sorted_features.begin(), sorted_features.end());
+    Vector<int> lookups;
+    if (table)
+        table->feature_list().lookups(table->script_list(), script, langsys, sorted_features, lookups);
+    for (int *it = lookups.begin(); it != lookups.end(); ++it)
+        try {
+            RefStage s;
+            s.lookup = *it;
+            s.flags = table->lookup(*it).flags();
+            s.mark_set = -1;
+            if (s.flags & Gdef::F_USE_MARK_FILTERING_SET)
+                s.mark_set = table->lookup(*it).mark_filtering_set();
+            stages.push_back(s);
+        } catch (Error) {
+        }
+    return stages;
+}
+
+static void
+ref_view(const RefGdef &gdef, const RefStage &stage, const RefRun &run,
+         Vector<int> &view, Vector<Glyph> &view_glyphs)
+{
+    view.clear();
+    view_glyphs.clear();
+    for (int i = 0; i < run.glyphs.size(); i++)
+        if (!gdef.ignores(run.glyphs[i], stage.flags, stage.mark_set)) {
+            view.push_back(i);
+            view_glyphs.push_back(run.glyphs[i]);
+        }
+}
+
+static void
+ref_substitute(const Gsub &gsub, const RefGdef &gdef, const RefStage &stage,
+               Vector<RefRun> &runs)
+{
+    GsubLookup l = gsub.lookup(stage.lookup);
+    Vector<RefRun> out(runs.size(), RefRun());
+    for (int r = 0; r < runs.size(); r++) {
+        const RefRun &run = runs[r];
+        Vector<int> view;
+        Vector<Glyph> vg;
+        ref_view(gdef, stage, run, view, vg);
+
+        // mark what happens to each glyph, then rebuild the run
+        Vector<int> action(run.glyphs.size(), -1); // -1 keep, -2 drop
+        Vector<Substitution> subs;
+        for (int v = 0; v < view.size(); ) {
+            Substitution s;
+            if (l.apply(vg.begin(), v, view.size(), s)) {
+                action[view[v]] = subs.size();
+                subs.push_back(s);
+                int n = s.is_ligature() ? s.in_nglyphs() : 1;
+                for (int k = 1; k < n; k++)
+                    action[view[v + k]] = -2;
+                v += n;
+            } else
+                v++;
+        }
+
+        for (int i = 0; i < run.glyphs.size(); i++)
+            if (action[i] == -1) {
+                out[r].glyphs.push_back(run.glyphs[i]);
+                out[r].clusters.push_back(run.clusters[i]);
+            } else if (action[i] >= 0) {
+                const Substitution &s = subs[action[i]];
+                int n = s.is_alternate() ? 1 : s.out_nglyphs();
+                for (int k = 0; k < n; k++) {
+                    out[r].glyphs.push_back(s.out_glyph(k));
+                    out[r].clusters.push_back(run.clusters[i]);
+                }
+            }
+    }
+    runs.swap(out);
+}
+
+static void
+ref_position(const Gpos &gpos, const RefGdef &gdef, const Shaper &shaper,
+             const RefStage &stage, Vector<RefRun> &runs)
+{
+    GposLookup l = gpos.lookup(stage.lookup);
+    Vector<RefRun> out(runs);
+    for (int r = 0; r < out.size(); r++) {
+        RefRun &run = out[r];
+        Vector<int> view;
+        Vector<Glyph> vg;
+        ref_view(gdef, stage, run, view, vg);
+        int n = view.size();
+        for (int v = 0; v < n; v++) {
+            Position &pos = run.pos[view[v]];
+            Positioning p;
+            int exit_x, exit_y, entry_x, entry_y;
+            if (l.type() == GposLookup::L_CURSIVE) {
+                if (l.apply_cursive(vg.begin(), v, n, exit_x, exit_y, entry_x, entry_y)) {
+                    Position &next = run.pos[view[v + 1]];
+                    pos.adx = pos.pdx + exit_x - shaper.advance_width(vg[v]);
+                    next.adx -= entry_x + next.pdx;
+                    next.pdx = -entry_x;
+                    next.pdy = pos.pdy + exit_y - entry_y;
+                }
+            } else if (l.apply(vg.begin(), v, n, p)) {
+                pos.pdx += p.left().pdx;
+                pos.pdy += p.left().pdy;
+                pos.adx += p.left().adx;
+                pos.ady += p.left().ady;
+                if (p.is_pair()) {
+                    Position &next = run.pos[view[v + 1]];
+                    next.pdx += p.right().pdx;
+                    next.pdy += p.right().pdy;
+                    next.adx += p.right().adx;
+                    next.ady += p.right().ady;
+                }
+            }
+        }
+    }
+    runs.swap(out);
+}
+
+// Glyphs and glyph sequences that runs are built from.
+struct Pieces {
+    Vector<Vector<Glyph> > phrases;
+    Vector<Glyph> marks;
+    int nglyphs;
+};
+
+static Pieces
+make_pieces(const Gsub *gsub, const Gpos *gpos, const RefGdef &gdef, int nglyphs)
+{
+    Pieces pieces;
+    pieces.nglyphs = nglyphs;
+    Coverage all(0, nglyphs - 1);
+    for (int i = 0; gsub && i < gsub->nlookups(); i++) {
+        Vector<Substitution> subs;
+        try {
+            gsub->lookup(i).unparse_automatics(*gsub, subs, all);
+        } catch (Error) {
+            continue;
+        }
+        // a sample of each lookup's inputs
+        for (int k = 0; k < subs.size() && k < 1000; k += 1 + rng() % 8) {
+            Vector<Glyph> in;
+            if (subs[k].all_in_glyphs(in) && in.size())
+                pieces.phrases.push_back(in);
+        }
+    }
+    for (int i = 0; gpos && i < gpos->nlookups(); i++) {
+        const GlyphSet &first = gpos->lookup_glyphs(i);
+        int n = 0;
+        for (Glyph g = rng() % 4; g < nglyphs && n < 200; g += 1 + rng() % 4)
+            if (first.covers(g)) {
+                pieces.phrases.push_back(Vector<Glyph>(1, g));
+                n++;
+            }
+    }
+    for (Glyph g = 0; g < nglyphs; g++)
+        if (gdef.is_mark(g))
+            pieces.marks.push_back(g);
+    return pieces;
+}
+
+static void
+make_run(const Pieces &pieces, Vector<Glyph> &run)
+{
+    run.clear();
+    int n = 1 + rng() % 12;
+    for (int i = 0; i < n; i++) {
+        unsigned x = rng() % 8;
+        if (x < 5 && pieces.phrases.size()) {
+            const Vector<Glyph> &p = pieces.phrases[rng() % pieces.phrases.size()];
+            for (const Glyph *g = p.begin(); g != p.end(); ++g)
+                run.push_back(*g);
+        } else if (x < 7 && pieces.marks.size())
+            run.push_back(pieces.marks[rng() % pieces.marks.size()]);
+        else
+            run.push_back(rng() % pieces.nglyphs);
+    }
+}
+
+static bool
+same_position(const Position &a, const Position &b)
+{
+    return a.pdx == b.pdx && a.pdy == b.pdy && a.adx == b.adx && a.ady == b.ady;
+}
+
+static bool
+check_batch(const ShapeBuffer &buf, const Vector<RefRun> &runs,
+            const String &what, ErrorHandler *errh)
+{
+    if (buf.nruns() != runs.size()) {
+        errh->error("%s: %d runs, expected %d", what.c_str(), buf.nruns(), runs.size());
+        return false;
+    }
+    for (int r = 0; r < runs.size(); r++) {
+        const RefRun &run = runs[r];
+        int b = buf.run_begin(r);
+        if (buf.run_end(r) - b != run.glyphs.size()) {
+            errh->error("%s: run %d has %d glyphs, expected %d", what.c_str(), r, buf.run_end(r) - b, run.glyphs.size());
+            return false;
+        }
+        for (int i = 0; i < run.glyphs.size(); i++)
+            if (buf.glyph(b + i) != run.glyphs[i]
+                || buf.cluster(b + i) != run.clusters[i]
+                || !same_position(buf.position(b + i), run.pos[i])) {
+                const Position &p = buf.position(b + i), &q = run.pos[i];
+                errh->error("%s: run %d glyph %d: shaped %d/%d (%d,%d,%d,%d), expected %d/%d (%d,%d,%d,%d)", what.c_str(), r, i, buf.glyph(b + i), buf.cluster(b + i), p.pdx, p.pdy, p.adx, p.ady, run.glyphs[i], run.clusters[i], q.pdx, q.pdy, q.adx, q.ady);
+                return false;
+            }
+    }
+    return true;
+}
+
+static void
+check_features(const TestFont &font, Shaper &shaper, const Gsub *gsub,
+               const Gpos *gpos, const RefGdef &gdef, const Pieces &pieces,
+               Tag script, Tag langsys, const Vector<Tag> &features,
+               ErrorHandler *errh)
+{
+    shaper.select(script, langsys, features);
+    Vector<RefStage> gsub_stages = ref_stages(gsub, script, langsys, features);
+    Vector<RefStage> gpos_stages = ref_stages(gpos, script, langsys, features);
+    String what = font.filename() + " " + Tag::langsys_text(script, langsys);
+    for (const Tag *f = features.begin(); f != features.end(); ++f)
+        what += (f == features.begin() ? " " : ",") + f->text();
+
+    ShapeBuffer buf;
+    Vector<Glyph> glyphs;
+    for (int batch = 0; batch < 20; batch++) {
+        buf.clear();
+        Vector<RefRun> runs;
+        for (int r = 0; r < 1 + batch; r++) {
+            make_run(pieces, glyphs);
+            RefRun run;
+            for (int i = 0; i < glyphs.size(); i++) {
+                buf.add(glyphs[i], i);
+                run.glyphs.push_back(glyphs[i]);
+                run.clusters.push_back(i);
+            }
+            buf.end_run();
+            runs.push_back(run);
+        }
+        shaper.shape(buf);
+
+        for (const RefStage *s = gsub_stages.begin(); s != gsub_stages.end(); ++s)
+            try {
+                ref_substitute(*gsub, gdef, *s, runs);
+            } catch (Error) {
+            }
+        for (RefRun *run = runs.begin(); run != runs.end(); ++run)
+            for (int i = 0; i < run->glyphs.size(); i++)
+                run->pos.push_back(Position(run->glyphs[i], 0, 0, 0, 0));
+        for (const RefStage *s = gpos_stages.begin(); s != gpos_stages.end(); ++s)
+            try {
+                ref_position(*gpos, gdef, shaper, *s, runs);
+            } catch (Error) {
+            }
+
+        if (!check_batch(buf, runs, what, errh))
+            return;
+    }
+}
+
+static void
+check_font(const TestFont &font, ErrorHandler *errh)
+{
+    const Font &otf = *font.otf();
+    Shaper shaper(otf, errh);
+    Gsub *gsub = 0;
+    Gpos *gpos = 0;
+    try {
+        gsub = new Gsub(otf.table("GSUB"), &otf, errh);
+    } catch (Error) {
+    }
+    try {
+        gpos = new Gpos(otf.table("GPOS"), errh);
+    } catch (Error) {
+    }
+    RefGdef gdef(otf.table("GDEF"));
+    int nglyphs = font.program()->nglyphs();
+    Pieces pieces = make_pieces(gsub, gpos, gdef, nglyphs);
+
+    // every language system in either table
+    Vector<Tag> scripts, langsys;
+    if (gsub)
+        gsub->script_list().language_systems(scripts, langsys);
+    if (gpos) {
+        Vector<Tag> s, l;
+        gpos->script_list().language_systems(s, l);
+        for (int i = 0; i < s.size(); i++) {
+            int j = 0;
+            while (j < scripts.size() && (scripts[j] != s[i] || langsys[j] != l[i]))
+                j++;
+            if (j == scripts.size()) {
+                scripts.push_back(s[i]);
+                langsys.push_back(l[i]);
+            }
+        }
+    }
+
+    Vector<Tag> liga_kern;
+    liga_kern.push_back(Tag("liga"));
+    liga_kern.push_back(Tag("kern"));
+    for (int i = 0; i < scripts.size() && nglyphs; i++) {
+        Vector<Tag> all;
+        int required;
+        Vector<int> fids;
+        if (gsub && gsub->script_list().features(scripts[i], langsys[i], required, fids) >= 0)
+            for (int *f = fids.begin(); f != fids.end(); ++f)
+                all.push_back(gsub->feature_list().tag(*f));
+        if (gpos && gpos->script_list().features(scripts[i], langsys[i], required, fids) >= 0)
+            for (int *f = fids.begin(); f != fids.end(); ++f)
+                all.push_back(gpos->feature_list().tag(*f));
+        check_features(font, shaper, gsub, gpos, gdef, pieces, scripts[i], langsys[i], liga_kern, errh);
+        check_features(font, shaper, gsub, gpos, gdef, pieces, scripts[i], langsys[i], all, errh);
+    }
+
+    delete gsub;
+    delete gpos;
+}
+
+int
+main(int argc, char **argv)
+{
+    ErrorHandler *errh = test_initialize("shaper");
+    Vector<String> filenames = test_font_filenames(argc, argv);
+    int nchecked = 0;
+
+    for (String *fn = filenames.begin(); fn != filenames.end(); ++fn) {
+        TestFont font(*fn, errh);
+        if (!font.ok() || !font.otf())
+            continue;
+        check_font(font, errh);
+        nchecked++;
+    }
+
+    if (errh->nerrors())
+        return 1;
+    return nchecked ? 0 : TEST_SKIP;
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
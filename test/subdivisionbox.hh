@@ -0,0 +1,54 @@
+// -*- c++ -*-
+#ifndef LCDF_TEST_SUBDIVISIONBOX_HH
+#define LCDF_TEST_SUBDIVISIONBOX_HH
+#include <lcdf/bezier.hh>
+
+// The bounding box algorithm CharstringBounds used before exact_bb: halve
+// the curve, mark the midpoint, and recurse into halves whose control
+// points lie outside the box so far. The depth limit only guards against
+// runaway recursion on values that differ in the last bit.
+class SubdivisionBox { public:
+
+    SubdivisionBox(const Bezier &b)
+        : _lb(b.point(0)), _rt(b.point(0)) {
+        mark(b.point(3));
+        if (!controls_inside(b))
+            mark(b, 0);
+    }
+
+    const Point &bottom_left() const    { return _lb; }
+    const Point &top_right() const      { return _rt; }
+
+  private:
+
+    Point _lb;
+    Point _rt;
+
+    void mark(const Point &p) {
+        _lb.x = (p.x < _lb.x ? p.x : _lb.x);
+        _lb.y = (p.y < _lb.y ? p.y : _lb.y);
+        _rt.x = (p.x > _rt.x ? p.x : _rt.x);
+        _rt.y = (p.y > _rt.y ? p.y : _rt.y);
+    }
+
+    bool inside(const Point &p) const {
+        return p.x >= _lb.x && p.x <= _rt.x && p.y >= _lb.y && p.y <= _rt.y;
+    }
+
+    bool controls_inside(const Bezier &b) const {
+        return inside(b.point(1)) && inside(b.point(2));
+    }
+
+    void mark(const Bezier &b, int depth) {
+        Bezier b1, b2;
+        b.halve(b1, b2);
+        mark(b1.point(3));
+        if (depth < 64 && !controls_inside(b1))
+            mark(b1, depth + 1);
+        if (depth < 64 && !controls_inside(b2))
+            mark(b2, depth + 1);
+    }
+
+};
+
+#endif
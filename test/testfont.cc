@@ -0,0 +1,144 @@
+// -*- related-file-name: "testfont.hh" -*-
+
+/* testfont.{cc,hh} -- fonts for the check programs
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include <efont/cff.hh>
+#include <efont/t1font.hh>
+#include <efont/t1rw.hh>
+#include <efont/ttfcs.hh>
+#include <lcdf/error.hh>
+#include <lcdf/straccum.hh>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#ifdef HAVE_SYS_TIME_H
+# include <sys/time.h>
+#endif
+#include <time.h>
+using namespace Efont;
+
+ErrorHandler *
+test_initialize(const char *name)
+{
+    return ErrorHandler::static_initialize(new FileErrorHandler(stderr, String(name) + ": "));
+}
+
+Vector<String>
+test_font_filenames(int argc, char **argv)
+{
+    Vector<String> filenames;
+    for (int i = 1; i < argc; i++)
+        filenames.push_back(argv[i]);
+    if (argc <= 1)
+        if (const char *s = getenv("TEST_FONTS"))
+            while (*s) {
+                while (isspace((unsigned char) *s))
+                    s++;
+                const char *first = s;
+                while (*s && !isspace((unsigned char) *s))
+                    s++;
+                if (s != first)
+                    filenames.push_back(String(first, s - first));
+            }
+    return filenames;
+}
+
+double
+test_now()
+{
+#ifdef HAVE_SYS_TIME_H
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+#else
+    return (double) clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static String
+read_file(const String &filename, ErrorHandler *errh)
+{
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f) {
+        errh->error("%s: %s", filename.c_str(), strerror(errno));
+        return String();
+    }
+    StringAccum sa;
+    while (char *x = sa.reserve(8192)) {
+        size_t amt = fread(x, 1, 8192, f);
+        if (amt == 0)
+            break;
+        sa.adjust_length(amt);
+    }
+    fclose(f);
+    return sa.take_string();
+}
+
+TestFont::TestFont(const String &filename, ErrorHandler *errh)
+    : _filename(filename), _kind(NONE), _otf(0), _cff(0), _ttf(0), _t1(0),
+      _program(0)
+{
+    String data = read_file(filename, errh);
+    if (!data)
+        return;
+
+    if ((unsigned char) data[0] == 128 || data.substring(0, 2) == "%!") {
+        FILE *f = fopen(filename.c_str(), "rb");
+        if (!f)
+            return;
+        Type1Reader *reader;
+        if ((unsigned char) data[0] == 128)
+            reader = new Type1PFBReader(f);
+        else
+            reader = new Type1PFAReader(f);
+        _t1 = new Type1Font(*reader);
+        delete reader;
+        fclose(f);
+        if (_t1->ok()) {
+            _kind = TYPE1;
+            _program = _t1;
+        } else
+            errh->error("%s: bad Type 1 font", filename.c_str());
+        return;
+    }
+
+    _otf = new OpenType::Font(data, errh);
+    if (!_otf->ok())
+        return;
+    if (String cff_data = _otf->table("CFF")) {
+        _cff = new Cff(cff_data, _otf->units_per_em(), errh);
+        if (_cff->ok() && (_program = _cff->font(PermString(), errh)))
+            _kind = CFF;
+    } else if (_otf->table("glyf")) {
+        _ttf = new TrueTypeBoundsCharstringProgram(_otf);
+        _kind = TRUETYPE;
+        _program = _ttf;
+    }
+    if (!_program)
+        errh->error("%s: no usable glyphs", filename.c_str());
+}
+
+TestFont::~TestFont()
+{
+    delete _ttf;
+    delete _cff;
+    delete _t1;
+    delete _otf;
+}
@@ -0,0 +1,64 @@
+// -*- related-file-name: "testfont.cc" -*-
+#ifndef LCDF_TEST_TESTFONT_HH
+#define LCDF_TEST_TESTFONT_HH
+#include <efont/otf.hh>
+#include <efont/t1cs.hh>
+class ErrorHandler;
+namespace Efont {
+class Cff;
+class Type1Font;
+class TrueTypeBoundsCharstringProgram;
+}
+
+// The programs in this directory check optimized code paths against the
+// code they replaced.  Those that need fonts read them from the command line
+// or, under "make check", from the TEST_FONTS variable:
+//
+//      make check TEST_FONTS="Font.otf Font.ttf Font.pfb"
+//
+// A check with nothing to check exits with TEST_SKIP, which the test driver
+// reports as a skipped test.
+//
+// The bench programs time those paths against the same code and print the
+// results. "make bench" builds and runs them, with fonts from TEST_FONTS.
+
+enum { TEST_SKIP = 77 };
+
+class ErrorHandler *test_initialize(const char *name);
+Vector<String> test_font_filenames(int argc, char **argv);
+
+// Returns a wall-clock time in seconds, for timing benchmarks.
+double test_now();
+
+class TestFont { public:
+
+    enum Kind { NONE = 0, CFF, TRUETYPE, TYPE1 };
+
+    TestFont(const String &filename, ErrorHandler *errh);
+    ~TestFont();
+
+    const String &filename() const      { return _filename; }
+    Kind kind() const                   { return _kind; }
+    bool ok() const                     { return _program != 0; }
+
+    // null for Type 1 fonts
+    const Efont::OpenType::Font *otf() const { return _otf; }
+    // CFF, TrueType or Type 1 glyphs; each TestFont gets fresh caches
+    const Efont::CharstringProgram *program() const { return _program; }
+
+  private:
+
+    String _filename;
+    Kind _kind;
+    Efont::OpenType::Font *_otf;
+    Efont::Cff *_cff;
+    Efont::TrueTypeBoundsCharstringProgram *_ttf;
+    Efont::Type1Font *_t1;
+    const Efont::CharstringProgram *_program;
+
+    TestFont(const TestFont &);
+    TestFont &operator=(const TestFont &);
+
+};
+
+#endif
@@ -0,0 +1,128 @@
+/* threadstress.cc -- check charstring programs shared between threads
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// Programs that claim thread_safe() build their glyph caches lazily.  Start
+// several threads on a fresh program, each at a different glyph, so the
+// threads race to fill the caches, then compare every thread's bounds and
+// names with a single-threaded pass over another fresh program.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include <efont/t1bounds.hh>
+#include <lcdf/error.hh>
+#include <stdio.h>
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_PTHREAD_CREATE)
+# include <pthread.h>
+# define USE_THREADS 1
+#endif
+using namespace Efont;
+
+enum { NTHREADS = 8, NROUNDS = 4 };
+
+struct GlyphResult {
+    bool ok;
+    double bb[4];
+    double width;
+    PermString name;
+};
+
+struct Work {
+    const CharstringProgram *program;
+    int start;
+    Vector<GlyphResult> results;
+};
+
+static void *
+run_thread(void *arg)
+{
+    Work *w = static_cast<Work *>(arg);
+    const CharstringProgram *p = w->program;
+    int n = p->nglyphs();
+    w->results.assign(n, GlyphResult());
+    for (int k = 0; k < n; k++) {
+        int gi = (k + w->start) % n;
+        GlyphResult &r = w->results[gi];
+        r.ok = CharstringBounds::bounds(p->glyph_context(gi), r.bb, r.width);
+        r.name = p->glyph_name(gi);
+    }
+    return 0;
+}
+
+static bool
+same_result(const GlyphResult &a, const GlyphResult &b)
+{
+    if (a.ok != b.ok || a.name != b.name)
+        return false;
+    if (!a.ok)
+        return true;
+    return a.bb[0] == b.bb[0] && a.bb[1] == b.bb[1] && a.bb[2] == b.bb[2]
+        && a.bb[3] == b.bb[3] && a.width == b.width;
+}
+
+int
+main(int argc, char **argv)
+{
+    ErrorHandler *errh = test_initialize("threadstress");
+#if USE_THREADS
+    Vector<String> filenames = test_font_filenames(argc, argv);
+    int nchecked = 0;
+
+    for (String *fn = filenames.begin(); fn != filenames.end(); ++fn) {
+        Work reference;
+        {
+            TestFont font(*fn, errh);
+            if (!font.ok() || !font.program()->thread_safe())
+                continue;
+            reference.program = font.program();
+            reference.start = 0;
+            run_thread(&reference);
+        }
+
+        for (int round = 0; round < NROUNDS; round++) {
+            TestFont font(*fn, errh);
+            int n = font.program()->nglyphs();
+            Work work[NTHREADS];
+            pthread_t threads[NTHREADS];
+            for (int i = 0; i < NTHREADS; i++) {
+                work[i].program = font.program();
+                work[i].start = (i * 101 + round * 37) % (n ? n : 1);
+                if (pthread_create(&threads[i], 0, run_thread, &work[i]) != 0)
+                    errh->fatal("%s: cannot create thread", fn->c_str());
+            }
+            for (int i = 0; i < NTHREADS; i++)
+                pthread_join(threads[i], 0);
+
+            for (int i = 0; i < NTHREADS; i++)
+                for (int gi = 0; gi < n; gi++)
+                    if (!same_result(work[i].results[gi], reference.results[gi])) {
+                        errh->error("%s: glyph %d differs in thread %d", fn->c_str(), gi, i);
+                        break;
+                    }
+        }
+        nchecked++;
+    }
+
+    if (errh->nerrors())
+        return 1;
+    return nchecked ? 0 : TEST_SKIP;
+#else
+    (void) argc, (void) argv;
+    errh->message("built without threads");
+    return TEST_SKIP;
+#endif
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
@@ -0,0 +1,197 @@
+/* ttcmap.cc -- check otftotfm's map lines for faces of a TrueType collection
+ *
+ * Copyright (c) 2019 Eddie Kohler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ */
+
+// Build a two-face collection from TrueType test fonts and run otftotfm on
+// each face. A map line can name only a file, which dvips and pdftex read as
+// the collection's first face, so face 0 may use the collection itself but
+// face 1 must use a Type 42 font made from that face.
+//
+// OTFTOTFM names the otftotfm program; "make check" sets it and puts
+// ttftotype42 on the PATH.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include "testfont.hh"
+#include <efont/otfname.hh>
+#include <lcdf/error.hh>
+#include <lcdf/straccum.hh>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+using namespace Efont;
+
+static void
+append_u32(StringAccum &sa, uint32_t x)
+{
+    sa << (char) (x >> 24) << (char) (x >> 16) << (char) (x >> 8) << (char) x;
+}
+
+// Returns a collection holding each font in turn. Each face keeps its own
+// table directory and tables; only the table offsets move.
+static String
+make_collection(const Vector<String> &fonts)
+{
+    StringAccum sa;
+    sa << "ttcf";
+    append_u32(sa, 0x00010000);
+    append_u32(sa, fonts.size());
+    uint32_t offset = 12 + 4 * fonts.size();
+    for (int i = 0; i < fonts.size(); i++) {
+        append_u32(sa, offset);
+        offset += (fonts[i].length() + 3) & ~3;
+    }
+
+    for (int i = 0; i < fonts.size(); i++) {
+        uint32_t base = sa.length();
+        sa << fonts[i];
+        unsigned char *d = reinterpret_cast<unsigned char *>(sa.data()) + base;
+        int ntables = (d[4] << 8) | d[5];
+        for (int t = 0; t < ntables; t++) {
+            unsigned char *o = d + 12 + 16 * t + 8;
+            uint32_t x = ((o[0] << 24) | (o[1] << 16) | (o[2] << 8) | o[3]) + base;
+            o[0] = x >> 24, o[1] = x >> 16, o[2] = x >> 8, o[3] = x;
+        }
+        while (sa.length() & 3)
+            sa << '\0';
+    }
+    return sa.take_string();
+}
+
+static bool
+write_file(const String &filename, const String &data, ErrorHandler *errh)
+{
+    FILE *f = fopen(filename.c_str(), "wb");
+    if (!f || fwrite(data.data(), 1, data.length(), f) != (size_t) data.length()) {
+        errh->error("%s: %s", filename.c_str(), strerror(errno));
+        if (f)
+            fclose(f);
+        return false;
+    }
+    fclose(f);
+    return true;
+}
+
+static String
+read_file(const String &filename)
+{
+    StringAccum sa;
+    if (FILE *f = fopen(filename.c_str(), "rb")) {
+        char buf[BUFSIZ];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+            sa.append(buf, n);
+        fclose(f);
+    }
+    return sa.take_string();
+}
+
+static bool
+ends_with(const String &s, const String &suffix)
+{
+    return s.length() >= suffix.length()
+        && s.substring(s.length() - suffix.length()) == suffix;
+}
+
+// Returns the map line for TeX font `texname`.
+static String
+map_line(const String &map, const String &texname)
+{
+    for (int pos = 0; pos < map.length(); ) {
+        int nl = map.find_left('\n', pos);
+        if (nl < 0)
+            nl = map.length();
+        String line = map.substring(pos, nl - pos);
+        if (line.length() > texname.length() && line.starts_with(texname)
+            && line[texname.length()] == ' ')
+            return line;
+        pos = nl + 1;
+    }
+    return String();
+}
+
+int
+main(int argc, char **argv)
+{
+    ErrorHandler *errh = test_initialize("ttcmap");
+    const char *otftotfm = getenv("OTFTOTFM");
+    if (!otftotfm || access(otftotfm, X_OK) != 0) {
+        errh->message("set OTFTOTFM to run otftotfm");
+        return TEST_SKIP;
+    }
+
+    // two different TrueType fonts if there are two, else one twice
+    Vector<String> fonts, ps_names;
+    Vector<String> filenames = test_font_filenames(argc, argv);
+    for (String *fn = filenames.begin(); fn != filenames.end() && fonts.size() < 2; ++fn) {
+        TestFont font(*fn, errh);
+        if (!font.ok() || font.kind() != TestFont::TRUETYPE
+            || OpenType::Font::nfaces(font.otf()->data_string()) > 1)
+            continue;
+        OpenType::Name name(font.otf()->table("name"), errh);
+        String ps_name = name.english_name(OpenType::Name::N_POSTSCRIPT);
+        if (!ps_name || (ps_names.size() && ps_names[0] == ps_name))
+            continue;
+        fonts.push_back(font.otf()->data_string());
+        ps_names.push_back(ps_name);
+    }
+    if (!fonts.size())
+        return TEST_SKIP;
+    if (fonts.size() == 1) {
+        fonts.push_back(fonts[0]);
+        ps_names.push_back(ps_names[0]);
+    }
+
+    char dirbuf[] = "/tmp/ttcmapXXXXXX";
+    if (!mkdtemp(dirbuf))
+        errh->fatal("mkdtemp: %s", strerror(errno));
+    String dir(dirbuf);
+    if (!write_file(dir + "/test.ttc", make_collection(fonts), errh)
+        || !write_file(dir + "/test.enc", "/TestEncoding [ /A /B /C /a /b /c ] def\n", errh))
+        errh->fatal("cannot create test files");
+
+    for (int face = 0; face < 2; face++) {
+        StringAccum cmd;
+        cmd << otftotfm << " -q --face=" << face << " -e " << dir << "/test.enc"
+            << " --directory=" << dir << " --truetype-directory=" << dir
+            << " --type42-directory=" << dir << " --no-updmap --map-file="
+            << dir << "/test.map " << dir << "/test.ttc face" << face;
+        if (system(cmd.c_str()) != 0)
+            errh->error("%<%s%> failed", cmd.c_str());
+    }
+
+    String map = read_file(dir + "/test.map");
+    String line0 = map_line(map, "face0"), line1 = map_line(map, "face1");
+    if (!line0.starts_with("face0 " + ps_names[0] + " ")
+        || !ends_with(line0, " <test.ttc"))
+        errh->error("face 0: bad map line %<%s%>", line0.c_str());
+    if (!line1.starts_with("face1 " + ps_names[1] + " ")
+        || !ends_with(line1, " <" + ps_names[1] + ".t42"))
+        errh->error("face 1: bad map line %<%s%>", line1.c_str());
+
+    // the Type 42 font was made from face 1
+    String t42 = read_file(dir + "/" + ps_names[1] + ".t42");
+    if (t42.find_left("/FontName /" + ps_names[1] + " ") < 0)
+        errh->error("face 1: %s.t42 doesn't define font %s", ps_names[1].c_str(), ps_names[1].c_str());
+
+    if (system(("rm -rf " + dir).c_str()) != 0)
+        errh->warning("cannot remove %s", dir.c_str());
+    return errh->nerrors() ? 1 : 0;
+}
+
+// template instantiations
+#include <lcdf/vector.cc>
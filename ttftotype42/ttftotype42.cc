@@ -26,6 +26,7 @@
 #include <efont/otfcmap.hh>
 #include <efont/ttfcs.hh>
 #include <lcdf/md5.h>
+#include <lcdf/mapfile.hh>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -47,8 +48,10 @@ using namespace Efont;
 #define HELP_OPT	302
 #define QUIET_OPT	303
 #define OUTPUT_OPT	306
+#define FACE_OPT	307
 
 const Clp_Option options[] = {
+    { "face", 0, FACE_OPT, Clp_ValInt, 0 },
     { "help", 'h', HELP_OPT, 0, 0 },
     { "output", 'o', OUTPUT_OPT, Clp_ValString, 0 },
     { "quiet", 'q', QUIET_OPT, 0, Clp_Negate },
@@ -57,6 +60,7 @@ const Clp_Option options[] = {
 
 
 static const char *program_name;
+static int face = 0;
 
 
 void
@@ -84,6 +88,7 @@ files. The result is usually written to the standard output.\n\
 Usage: %s [OPTIONS] [FONTFILE [OUTPUTFILE]]\n\
 \n\
 Options:\n\
+      --face=N                 Select face N from a TrueType collection.\n\
   -o, --output=FILE            Write output to FILE.\n\
   -q, --quiet                  Do not generate any error messages.\n\
   -h, --help                   Print this message and exit.\n\
@@ -179,22 +184,28 @@ do_file(const char *infn, const char *outfn, ErrorHandler *errh)
     if (c == EOF)
 	errh->fatal("%s: empty file", infn);
 
-    StringAccum sa(150000);
-    int amt;
-    do {
-	if (char *x = sa.reserve(32768)) {
-	    amt = fread(x, 1, 32768, f);
-	    sa.adjust_length(amt);
-	} else
-	    amt = 0;
-    } while (amt != 0);
-    if (!feof(f) || ferror(f))
-	errh->error("%s: %s", infn, strerror(errno));
+    String data;
+    if (f != stdin)
+	data = map_file(f);
+    if (!data) {
+	StringAccum sa(150000);
+	int amt;
+	do {
+	    if (char *x = sa.reserve(32768)) {
+		amt = fread(x, 1, 32768, f);
+		sa.adjust_length(amt);
+	    } else
+		amt = 0;
+	} while (amt != 0);
+	if (!feof(f) || ferror(f))
+	    errh->error("%s: %s", infn, strerror(errno));
+	data = sa.take_string();
+    }
     if (f != stdin)
 	fclose(f);
 
     LandmarkErrorHandler cerrh(errh, infn);
-    OpenType::Font otf(sa.take_string(), &cerrh);
+    OpenType::Font otf(data, face, &cerrh);
     if (!otf.ok() || !otf.check_checksums(&cerrh))
 	return;
     if (otf.table("CFF"))
@@ -288,9 +299,14 @@ do_file(const char *infn, const char *outfn, ErrorHandler *errh)
 
     // encoding
     fprintf(f, "/Encoding 256 array\n0 1 255{1 index exch/.notdef put}for\n");
+    uint32_t codes[256];
+    OpenType::Glyph glyphs[256];
     for (int i = 0; i < 256; i++)
-	if (OpenType::Glyph g = cmap.map_uni(i))
-	    fprintf(f, "dup %d /%s put\n", i, gn[g].c_str());
+	codes[i] = i;
+    if (cmap.map_uni(codes, 256, glyphs) >= 0)
+	for (int i = 0; i < 256; i++)
+	    if (OpenType::Glyph g = glyphs[i])
+		fprintf(f, "dup %d /%s put\n", i, gn[g].c_str());
     fprintf(f, "readonly def\n");
 
     // print 'sfnts' array
@@ -367,6 +383,12 @@ particular purpose.\n");
 	    exit(0);
 	    break;
 
+	  case FACE_OPT:
+	    if (clp->val.i < 0)
+		usage_error(errh, "%<--face%> must be at least 0");
+	    face = clp->val.i;
+	    break;
+
 	  case OUTPUT_OPT:
 	  output_file:
 	    if (output_file)